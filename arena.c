@@ -0,0 +1,105 @@
+/***********************************************************
+ * File: arena.c
+ *
+ * Description:
+ *   Double-buffered per-frame bump allocator. See arena.h.
+ *
+ ***********************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_ALIGN(n) (((n) + FRAME_ARENA_ALIGNMENT - 1) & ~(size_t)(FRAME_ARENA_ALIGNMENT - 1))
+
+/***********************************************************
+ * Name: frame_arena_init
+ *
+ * Arguments:
+ *   FRAME_ARENA_T *arena = arena to initialise
+ *   uint32_t capacity = bytes available per frame
+ *
+ * Description:
+ *   Allocates both regions up front, the only heap allocation the arena ever makes
+ *
+ * Returns:
+ *   int = 0 on success, -1 on allocation failure
+ *
+ ***********************************************************/
+int frame_arena_init(FRAME_ARENA_T *arena, uint32_t capacity)
+{
+	memset(arena, 0, sizeof(*arena));
+	capacity = ARENA_ALIGN(capacity);
+	for (int i = 0; i < 2; i++)
+	{
+		if (posix_memalign((void **)&arena->regions[i], FRAME_ARENA_ALIGNMENT, capacity) != 0)
+		{
+			arena->regions[i] = NULL;
+			frame_arena_destroy(arena);
+			return -1;
+		}
+	}
+	arena->capacity = capacity;
+	return 0;
+}
+
+/***********************************************************
+ * Name: frame_arena_begin_frame
+ *
+ * Arguments:
+ *   FRAME_ARENA_T *arena = arena to reset
+ *
+ * Description:
+ *   Switches to the region used two frames ago and empties it. Pointers from the
+ *   previous frame remain valid until the next call.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void frame_arena_begin_frame(FRAME_ARENA_T *arena)
+{
+	arena->current ^= 1;
+	arena->used = 0;
+	arena->requested = 0;
+}
+
+/***********************************************************
+ * Name: frame_arena_alloc
+ *
+ * Arguments:
+ *   FRAME_ARENA_T *arena = arena to allocate from
+ *   size_t bytes = size of the allocation
+ *
+ * Description:
+ *   Bumps the current region's offset. Memory is uninitialised.
+ *
+ * Returns:
+ *   void * = FRAME_ARENA_ALIGNMENT-aligned memory valid until the next frame but one,
+ *     or NULL if the region is exhausted
+ *
+ ***********************************************************/
+void *frame_arena_alloc(FRAME_ARENA_T *arena, size_t bytes)
+{
+	size_t size = ARENA_ALIGN(bytes);
+
+	// Count what the frame would have needed so high_water tells how large to make it
+	arena->requested = size > UINT32_MAX - arena->requested ? UINT32_MAX : arena->requested + (uint32_t)size;
+	if (arena->requested > arena->high_water) arena->high_water = arena->requested;
+	if (size > arena->capacity - arena->used)
+	{
+		arena->failed++;
+		return NULL;
+	}
+
+	void *p = arena->regions[arena->current] + arena->used;
+	arena->used += size;
+	return p;
+}
+
+void frame_arena_destroy(FRAME_ARENA_T *arena)
+{
+	free(arena->regions[0]);
+	free(arena->regions[1]);
+	memset(arena, 0, sizeof(*arena));
+}
@@ -0,0 +1,42 @@
+/***********************************************************
+ * File: arena.h
+ *
+ * Description:
+ *   Frame-scoped bump allocator for transient render data such as command lists and
+ *   per-frame vertex staging. Two regions alternate: frame_arena_begin_frame() switches
+ *   to the other region and empties it in O(1), so data allocated in frame N stays valid
+ *   while frame N + 1 records. Nothing is ever freed individually.
+ *
+ *   Allocation is not thread-safe. Carve per-thread blocks on the owning thread and hand
+ *   them to workers.
+ *
+ ***********************************************************/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FRAME_ARENA_ALIGNMENT 16 // Every allocation starts on this boundary
+#define FRAME_ARENA_DEFAULT_BYTES (256 * 1024) // Per region
+
+typedef struct
+{
+	uint8_t *regions[2];
+	uint32_t capacity; // Bytes per region
+	uint32_t current; // Region allocations come from this frame
+	uint32_t used; // Bytes allocated from the current region this frame
+	uint32_t requested; // Bytes asked for this frame, including refused requests
+
+	// Sizing statistics
+	uint32_t high_water; // Largest per-frame request total seen
+	uint32_t failed; // Allocations refused because the region was full
+} FRAME_ARENA_T;
+
+int frame_arena_init(FRAME_ARENA_T *arena, uint32_t capacity);
+void frame_arena_begin_frame(FRAME_ARENA_T *arena);
+void *frame_arena_alloc(FRAME_ARENA_T *arena, size_t bytes);
+void frame_arena_destroy(FRAME_ARENA_T *arena);
+
+#endif
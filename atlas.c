@@ -0,0 +1,141 @@
+/***********************************************************
+ * File: atlas.c
+ *
+ * Description:
+ *   Atlas manifest loading. See atlas.h.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "atlas.h"
+
+/***********************************************************
+ * Name: atlas_load
+ *
+ * Arguments:
+ *   ATLAS_T *atlas = atlas to create
+ *   TEXTURE_MANAGER_T *textures = manager the pages are requested from
+ *   const char *path = manifest written by atlaspack.bin
+ *
+ * Description:
+ *   Reads the manifest and queues every page for background decoding. Sprites can be
+ *   looked up straight away; their page texture is 0 until it has been uploaded.
+ *
+ * Returns:
+ *   int = 0 on success, -1 if the manifest cannot be read or is invalid
+ *
+ ***********************************************************/
+int atlas_load(ATLAS_T *atlas, TEXTURE_MANAGER_T *textures, const char *path)
+{
+	char line[ATLAS_PATH_LENGTH + 64], file[ATLAS_PATH_LENGTH];
+	uint32_t page_size[ATLAS_MAX_PAGES][2] = { { 0 } };
+	uint32_t capacity = 0, version = 0;
+	int result = 0;
+
+	memset(atlas, 0, sizeof(*atlas));
+	for (int i = 0; i < ATLAS_MAX_PAGES; i++) atlas->pages[i] = -1;
+
+	FILE *in = fopen(path, "r");
+	if (!in) return -1;
+
+	// Page files are named relative to the manifest
+	const char *slash = strrchr(path, '/');
+	int directory = slash ? (int)(slash - path + 1) : 0;
+
+	while (result == 0 && fgets(line, sizeof(line), in))
+	{
+		ATLAS_SPRITE_T sprite;
+		uint32_t x, y;
+		if (line[0] == '#' || line[0] == '\n') continue;
+
+		if (sscanf(line, "atlas %u", &version) == 1)
+		{
+			if (version != ATLAS_VERSION) result = -1;
+		}
+		else if (sscanf(line, "page %255s %u %u", file, &x, &y) == 3)
+		{
+			if (atlas->page_count == ATLAS_MAX_PAGES || !x || !y ||
+				snprintf(atlas->page_paths[atlas->page_count], ATLAS_PATH_LENGTH, "%.*s%s", directory, path, file) >= ATLAS_PATH_LENGTH)
+			{
+				result = -1;
+				continue;
+			}
+			page_size[atlas->page_count][0] = x;
+			page_size[atlas->page_count][1] = y;
+			atlas->page_count++;
+		}
+		else if (sscanf(line, "sprite %31s %u %u %u %u %u", sprite.name, &sprite.page, &x, &y, &sprite.width, &sprite.height) == 6)
+		{
+			const uint32_t *size = page_size[sprite.page < atlas->page_count ? sprite.page : 0];
+			if (sprite.page >= atlas->page_count || x + sprite.width > size[0] || y + sprite.height > size[1])
+			{
+				result = -1;
+				continue;
+			}
+			sprite.uv[0] = (GLfloat)x / size[0];
+			sprite.uv[1] = (GLfloat)y / size[1];
+			sprite.uv[2] = (GLfloat)(x + sprite.width) / size[0];
+			sprite.uv[3] = (GLfloat)(y + sprite.height) / size[1];
+
+			if (atlas->sprite_count == capacity)
+			{
+				ATLAS_SPRITE_T *grown = realloc(atlas->sprites, (capacity ? capacity * 2 : 64) * sizeof(ATLAS_SPRITE_T));
+				if (!grown)
+				{
+					result = -1;
+					continue;
+				}
+				atlas->sprites = grown;
+				capacity = capacity ? capacity * 2 : 64;
+			}
+			atlas->sprites[atlas->sprite_count++] = sprite;
+		}
+		else
+		{
+			result = -1;
+		}
+	}
+	fclose(in);
+
+	if (version != ATLAS_VERSION || !atlas->page_count) result = -1;
+	for (uint32_t i = 0; result == 0 && i < atlas->page_count; i++)
+	{
+		atlas->pages[i] = texture_request(textures, atlas->page_paths[i], texture_decode_file, NULL);
+		if (atlas->pages[i] < 0) result = -1;
+	}
+	if (result != 0) atlas_destroy(atlas, textures, NULL);
+	return result;
+}
+
+const ATLAS_SPRITE_T *atlas_find(const ATLAS_T *atlas, const char *name)
+{
+	for (uint32_t i = 0; i < atlas->sprite_count; i++)
+		if (strcmp(atlas->sprites[i].name, name) == 0) return &atlas->sprites[i];
+	return NULL;
+}
+
+/***********************************************************
+ * Name: atlas_destroy
+ *
+ * Arguments:
+ *   ATLAS_T *atlas = atlas to free
+ *   TEXTURE_MANAGER_T *textures = manager the pages came from
+ *   GL_CACHE_T *cache = state cache to drop page bindings from, NULL if no page was uploaded
+ *
+ * Description:
+ *   Releases the page textures and the sprite table
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void atlas_destroy(ATLAS_T *atlas, TEXTURE_MANAGER_T *textures, GL_CACHE_T *cache)
+{
+	for (uint32_t i = 0; i < atlas->page_count; i++) texture_release(textures, cache, atlas->pages[i]);
+	free(atlas->sprites);
+	atlas->sprites = NULL;
+	atlas->sprite_count = 0;
+	atlas->page_count = 0;
+}
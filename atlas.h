@@ -0,0 +1,50 @@
+/***********************************************************
+ * File: atlas.h
+ *
+ * Description:
+ *   Texture atlases written by atlaspack.bin. Many small sprites share a few large
+ *   pages, so a scene drawing them binds one texture per page rather than one per
+ *   sprite. Pages are streamed through the texture manager like any other texture.
+ *
+ *   The manifest is a text file:
+ *     atlas 1
+ *     page <file> <width> <height>                       one per page, file relative to the manifest
+ *     sprite <name> <page> <x> <y> <width> <height>      pixel rectangle, top-left origin
+ *
+ ***********************************************************/
+
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <stdint.h>
+#include "GLES2/gl2.h"
+#include "texture.h"
+
+#define ATLAS_VERSION 1
+#define ATLAS_MAX_PAGES 8
+#define ATLAS_NAME_LENGTH 32
+#define ATLAS_PATH_LENGTH 256
+
+typedef struct
+{
+	char name[ATLAS_NAME_LENGTH];
+	uint32_t page;
+	uint32_t width; // Size in pixels
+	uint32_t height;
+	GLfloat uv[4]; // u0, v0 (top-left), u1, v1 (bottom-right) in the page
+} ATLAS_SPRITE_T;
+
+typedef struct
+{
+	char page_paths[ATLAS_MAX_PAGES][ATLAS_PATH_LENGTH]; // Kept for the decode threads
+	int pages[ATLAS_MAX_PAGES]; // Texture manager handles
+	uint32_t page_count;
+	ATLAS_SPRITE_T *sprites; // Grouped by page
+	uint32_t sprite_count;
+} ATLAS_T;
+
+int atlas_load(ATLAS_T *atlas, TEXTURE_MANAGER_T *textures, const char *path);
+const ATLAS_SPRITE_T *atlas_find(const ATLAS_T *atlas, const char *name);
+void atlas_destroy(ATLAS_T *atlas, TEXTURE_MANAGER_T *textures, GL_CACHE_T *cache);
+
+#endif
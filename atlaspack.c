@@ -0,0 +1,298 @@
+/***********************************************************
+ * File: atlaspack.c
+ *
+ * Description:
+ *   Offline sprite atlas packer. Reads PGM/PPM sprites, packs them onto square pages
+ *   with shelf packing, tallest first, and writes every page as an ETC1 PKM file plus
+ *   the manifest described in atlas.h. Sprite cells start on 4-pixel boundaries, so no
+ *   ETC1 block is shared by two sprites, and edge pixels are repeated into the padding
+ *   so bilinear filtering does not bleed between neighbours.
+ *
+ *   Usage: atlaspack.bin [--page-size N] [--padding N] [--raw] output sprite.ppm...
+ *   writes output.atlas and output_0.pkm, output_1.pkm, ...
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <getopt.h>
+#include "etc1.h"
+#include "texture.h"
+#include "atlas.h"
+
+#define ATLASPACK_DEFAULT_PAGE_SIZE 1024
+#define ATLASPACK_MAX_PAGE_SIZE 4096
+#define ATLASPACK_DEFAULT_PADDING 2
+
+typedef struct
+{
+	char name[ATLAS_NAME_LENGTH];
+	uint8_t *pixels; // RGB
+	uint32_t width;
+	uint32_t height;
+	uint32_t page; // Placement of the sprite's own pixels, inside the padding
+	uint32_t x;
+	uint32_t y;
+} SPRITE_T;
+
+static uint32_t align4(uint32_t value)
+{
+	return (value + 3) & ~3u;
+}
+
+static int sprite_taller(const void *a, const void *b)
+{
+	const SPRITE_T *sa = (const SPRITE_T *)a, *sb = (const SPRITE_T *)b;
+	if (sa->height != sb->height) return sa->height > sb->height ? -1 : 1;
+	if (sa->width != sb->width) return sa->width > sb->width ? -1 : 1;
+	return strcmp(sa->name, sb->name);
+}
+
+/***********************************************************
+ * Name: sprite_load
+ *
+ * Arguments:
+ *   SPRITE_T *sprite = receives the RGB pixels and name
+ *   const char *path = PGM or PPM file, named after its base name without extension
+ *   TEXTURE_IMAGE_T *scratch = decode buffer big enough for one page
+ *
+ * Description:
+ *   Decodes a sprite with the renderer's own netpbm reader and converts it to RGB
+ *
+ * Returns:
+ *   int = 0 on success, -1 on error
+ *
+ ***********************************************************/
+static int sprite_load(SPRITE_T *sprite, const char *path, TEXTURE_IMAGE_T *scratch)
+{
+	if (texture_decode_pnm(path, NULL, scratch) != 0) return -1;
+
+	const char *base = strrchr(path, '/');
+	base = base ? base + 1 : path;
+	size_t length = strcspn(base, ".");
+	if (length >= ATLAS_NAME_LENGTH) length = ATLAS_NAME_LENGTH - 1;
+	memcpy(sprite->name, base, length);
+	sprite->name[length] = '\0';
+	for (char *c = sprite->name; *c; c++)
+		if (isspace((unsigned char)*c)) *c = '_';
+
+	sprite->width = scratch->width;
+	sprite->height = scratch->height;
+	sprite->pixels = malloc((size_t)sprite->width * sprite->height * 3);
+	if (!sprite->pixels) return -1;
+	uint32_t pixel_bytes = scratch->format == GL_LUMINANCE ? 1 : 3;
+	for (uint32_t i = 0; i < sprite->width * sprite->height; i++)
+		for (int c = 0; c < 3; c++) sprite->pixels[i * 3 + c] = scratch->pixels[i * pixel_bytes + (pixel_bytes == 3 ? c : 0)];
+	return 0;
+}
+
+/***********************************************************
+ * Name: atlas_pack
+ *
+ * Arguments:
+ *   SPRITE_T *sprites = sprites sorted tallest first, receive their placement
+ *   uint32_t count = number of sprites
+ *   uint32_t size = page width and height
+ *   uint32_t padding = pixels around each sprite
+ *
+ * Description:
+ *   Places sprites left to right on shelves as tall as their first sprite, starting a
+ *   new shelf when a row is full and a new page when a page is full
+ *
+ * Returns:
+ *   int = number of pages used, -1 if a sprite is larger than a page or pages run out
+ *
+ ***********************************************************/
+static int atlas_pack(SPRITE_T *sprites, uint32_t count, uint32_t size, uint32_t padding)
+{
+	uint32_t page = 0, x = 0, y = 0, shelf = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		SPRITE_T *sprite = &sprites[i];
+		uint32_t width = align4(sprite->width + 2 * padding), height = align4(sprite->height + 2 * padding);
+		if (width > size || height > size)
+		{
+			fprintf(stderr, "%s: %ux%u does not fit on a %u page\n", sprite->name, sprite->width, sprite->height, size);
+			return -1;
+		}
+		if (x + width > size)
+		{
+			x = 0;
+			y += shelf;
+			shelf = 0;
+		}
+		if (y + height > size)
+		{
+			page++;
+			x = y = shelf = 0;
+		}
+		if (page == ATLAS_MAX_PAGES)
+		{
+			fprintf(stderr, "More than %d pages needed, use a larger --page-size\n", ATLAS_MAX_PAGES);
+			return -1;
+		}
+
+		sprite->page = page;
+		sprite->x = x + padding;
+		sprite->y = y + padding;
+		x += width;
+		if (height > shelf) shelf = height;
+	}
+	return count ? (int)page + 1 : 0;
+}
+
+// Copies a sprite and its clamped border into an RGB page
+static void sprite_blit(const SPRITE_T *sprite, uint8_t *page, uint32_t size, uint32_t padding)
+{
+	for (int32_t y = -(int32_t)padding; y < (int32_t)(sprite->height + padding); y++)
+		for (int32_t x = -(int32_t)padding; x < (int32_t)(sprite->width + padding); x++)
+		{
+			int32_t sx = x < 0 ? 0 : x >= (int32_t)sprite->width ? (int32_t)sprite->width - 1 : x;
+			int32_t sy = y < 0 ? 0 : y >= (int32_t)sprite->height ? (int32_t)sprite->height - 1 : y;
+			const uint8_t *src = sprite->pixels + ((size_t)sy * sprite->width + sx) * 3;
+			uint8_t *dst = page + ((size_t)(sprite->y + y) * size + sprite->x + x) * 3;
+			memcpy(dst, src, 3);
+		}
+}
+
+static int write_ppm(const char *path, const uint8_t *pixels, uint32_t size)
+{
+	FILE *out = fopen(path, "wb");
+	if (!out) return -1;
+	size_t bytes = (size_t)size * size * 3;
+	int ok = fprintf(out, "P6\n%u %u\n255\n", size, size) > 0 && fwrite(pixels, 1, bytes, out) == bytes;
+	if (fclose(out) != 0) ok = 0;
+	return ok ? 0 : -1;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [options] output sprite.ppm...\n", argv0);
+	fprintf(stderr, "  -s, --page-size N   Page width and height in pixels (default %d)\n", ATLASPACK_DEFAULT_PAGE_SIZE);
+	fprintf(stderr, "  -p, --padding N     Repeated edge pixels around each sprite (default %d)\n", ATLASPACK_DEFAULT_PADDING);
+	fprintf(stderr, "  -r, --raw           Write PPM pages instead of ETC1 PKM\n");
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option long_options[] =
+	{
+		{ "page-size", required_argument, NULL, 's' },
+		{ "padding",   required_argument, NULL, 'p' },
+		{ "raw",       no_argument,       NULL, 'r' },
+		{ NULL, 0, NULL, 0 }
+	};
+	uint32_t size = ATLASPACK_DEFAULT_PAGE_SIZE, padding = ATLASPACK_DEFAULT_PADDING;
+	int raw = 0, opt;
+
+	while ((opt = getopt_long(argc, argv, "s:p:r", long_options, NULL)) != -1)
+	{
+		switch (opt)
+		{
+			case 's': size = (uint32_t)strtoul(optarg, NULL, 10); break;
+			case 'p': padding = (uint32_t)strtoul(optarg, NULL, 10); break;
+			case 'r': raw = 1; break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+	if (argc - optind < 2 || size < 4 || size > ATLASPACK_MAX_PAGE_SIZE || size % 4)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	const char *output = argv[optind];
+	uint32_t count = argc - optind - 1;
+
+	// One decode buffer, as large as the largest sprite a page can hold
+	TEXTURE_IMAGE_T scratch;
+	memset(&scratch, 0, sizeof(scratch));
+	scratch.capacity = size * size * 3;
+	scratch.pixels = malloc(scratch.capacity);
+	SPRITE_T *sprites = calloc(count, sizeof(SPRITE_T));
+	uint8_t *page = malloc((size_t)size * size * 3);
+	uint8_t *blocks = malloc(etc1_image_bytes(size, size));
+	if (!scratch.pixels || !sprites || !page || !blocks)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (sprite_load(&sprites[i], argv[optind + 1 + i], &scratch) != 0)
+		{
+			fprintf(stderr, "%s: not a readable PGM/PPM image of at most %ux%u\n", argv[optind + 1 + i], size, size);
+			return 1;
+		}
+	}
+	qsort(sprites, count, sizeof(SPRITE_T), sprite_taller);
+	int pages = atlas_pack(sprites, count, size, padding);
+	if (pages < 0) return 1;
+
+	char path[ATLAS_PATH_LENGTH];
+	snprintf(path, sizeof(path), "%s.atlas", output);
+	FILE *manifest = fopen(path, "w");
+	if (!manifest)
+	{
+		perror(path);
+		return 1;
+	}
+	fprintf(manifest, "atlas %d\n", ATLAS_VERSION);
+
+	// Manifest page names are relative to the manifest itself
+	const char *base = strrchr(output, '/');
+	base = base ? base + 1 : output;
+	uint64_t stored = 0;
+	for (int p = 0; p < pages; p++)
+	{
+		memset(page, 0, (size_t)size * size * 3);
+		for (uint32_t i = 0; i < count; i++)
+			if (sprites[i].page == (uint32_t)p) sprite_blit(&sprites[i], page, size, padding);
+
+		snprintf(path, sizeof(path), "%s_%d.%s", output, p, raw ? "ppm" : "pkm");
+		int result;
+		if (raw)
+		{
+			result = write_ppm(path, page, size);
+			stored += (uint64_t)size * size * 3;
+		}
+		else
+		{
+			etc1_encode_image(page, size, size, 3, blocks);
+			result = etc1_write_pkm(path, size, size, blocks);
+			stored += etc1_image_bytes(size, size);
+		}
+		if (result != 0)
+		{
+			fprintf(stderr, "%s: write failed\n", path);
+			return 1;
+		}
+		fprintf(manifest, "page %s_%d.%s %u %u\n", base, p, raw ? "ppm" : "pkm", size, size);
+	}
+
+	// Sprites are grouped by page, so drawing them in manifest order binds each page once
+	for (int p = 0; p < pages; p++)
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const SPRITE_T *sprite = &sprites[i];
+			if (sprite->page != (uint32_t)p) continue;
+			fprintf(manifest, "sprite %s %u %u %u %u %u\n", sprite->name, sprite->page, sprite->x, sprite->y, sprite->width, sprite->height);
+		}
+	if (fclose(manifest) != 0)
+	{
+		fprintf(stderr, "%s.atlas: write failed\n", output);
+		return 1;
+	}
+
+	printf("%s.atlas: %u sprites on %d %ux%u pages, %llu KB of texture (%llu KB as RGBA8)\n", output, count, pages, size, size,
+		(unsigned long long)(stored / 1024), (unsigned long long)pages * size * size * 4 / 1024);
+
+	for (uint32_t i = 0; i < count; i++) free(sprites[i].pixels);
+	free(sprites);
+	free(scratch.pixels);
+	free(page);
+	free(blocks);
+	return 0;
+}
@@ -0,0 +1,355 @@
+/***********************************************************
+ * File: batch.c
+ *
+ * Description:
+ *   Pseudo-instanced batch renderer. See batch.h.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "check.h"
+#include "shader.h"
+#include "batch.h"
+
+#define BATCH_RESERVED_UNIFORM_VECTORS 4 // Left for view and anything the driver adds itself
+
+static const GLchar *batch_vertex_source =
+	"uniform vec4 instances[INSTANCES * 2];                                   \n"
+	"uniform vec2 view;                                                       \n"
+	"attribute vec2 position;                                                 \n"
+	"attribute float instance;                                                \n"
+	"varying lowp vec4 color;                                                 \n"
+	"void main()                                                              \n"
+	"{                                                                        \n"
+	"    int i = int(instance + 0.5) * 2;                                     \n"
+	"    vec4 xform = instances[i];                                           \n"
+	"    vec2 p = vec2(position.x * xform.z - position.y * xform.w,           \n"
+	"                  position.x * xform.w + position.y * xform.z) + xform.xy;\n"
+	"    color = instances[i + 1];                                            \n"
+	"    gl_Position = vec4(p * view, 0.0, 1.0);                              \n"
+	"}                                                                        \n";
+
+static const GLchar *batch_fragment_source =
+	"varying lowp vec4 color;                       \n"
+	"void main()                                    \n"
+	"{                                              \n"
+	"    gl_FragColor = color;                      \n"
+	"}                                              \n";
+
+static void batch_program_ready(GLuint program, void *user)
+{
+	BATCH_T *batch = (BATCH_T *)user;
+	if (uniform_cache_init(&batch->uniforms, batch->cache, program) != 0)
+	{
+		fprintf(stderr, "Failed to allocate the batch program's uniform cache\n");
+		batch->program = 0;
+		return;
+	}
+	batch->program = program;
+	vertex_format_bind(&batch->format, program);
+	batch->uniform_instances = uniform_cache_find(&batch->uniforms, "instances");
+	batch->uniform_view = uniform_cache_find(&batch->uniforms, "view");
+
+	vertex_format_pipeline(&batch->format, program, &batch->pipeline);
+}
+
+// Per-instance constants: translation and rotation/scale, then colour. Returns whether
+// any of the primitives needs blending.
+static int batch_fill_instances(GLfloat *data, const BATCH_PRIMITIVE_T *primitives, uint32_t n)
+{
+	int translucent = 0;
+	for (uint32_t i = 0; i < n; i++, data += 8)
+	{
+		const BATCH_PRIMITIVE_T *p = &primitives[i];
+		data[0] = p->x;
+		data[1] = p->y;
+		data[2] = p->scale * cosf(p->rotation);
+		data[3] = p->scale * sinf(p->rotation);
+		memcpy(&data[4], p->color, 4 * sizeof(GLfloat));
+		if (p->color[3] < 1.0f) translucent = 1;
+	}
+	return translucent;
+}
+
+/***********************************************************
+ * Name: batch_init
+ *
+ * Arguments:
+ *   BATCH_T *batch = batch to initialise
+ *   GL_CACHE_T *cache = state cache used for every bind and attribute change
+ *   SHADER_MANAGER_T *shaders = shader manager that builds the batch program
+ *   const VERTEX_FORMAT_T *format = vertex layout with a 2-component "position" and a
+ *     1-component, non-normalized "instance" attribute, in that order
+ *   const BATCH_SHAPE_T *shapes = shapes that primitives refer to, must outlive the batch
+ *   uint32_t shape_count = number of shapes
+ *   uint32_t max_primitives = largest primitive count passed to batch_draw()
+ *   const GLchar *fragment_source = fragment shader reading the "color" varying, NULL
+ *     for the batch's own
+ *
+ * Description:
+ *   Sizes the per-draw instance count from the driver's vertex uniform limit, builds the
+ *   instancing shader for that size and allocates the packing buffers. The program is
+ *   deferred, so batch_draw() draws nothing until the shader manager has built it.
+ *
+ * Returns:
+ *   int = 0 on success, -1 on allocation failure
+ *
+ ***********************************************************/
+int batch_init(BATCH_T *batch, GL_CACHE_T *cache, SHADER_MANAGER_T *shaders, const VERTEX_FORMAT_T *format, const BATCH_SHAPE_T *shapes, uint32_t shape_count, uint32_t max_primitives, const GLchar *fragment_source)
+{
+	GLint max_vectors = 0;
+	uint32_t max_shape_vertices = 0;
+
+	memset(batch, 0, sizeof(*batch));
+	batch->cache = cache;
+	batch->shaders = shaders;
+	batch->shader = -1;
+	batch->format = *format;
+	batch->shapes = shapes;
+	batch->shape_count = shape_count;
+	batch->max_primitives = max_primitives;
+
+	// Two vec4s per instance, within what the driver guarantees for vertex uniforms
+	glGetIntegerv(GL_MAX_VERTEX_UNIFORM_VECTORS, &max_vectors);
+	batch->instances_per_draw = (max_vectors - BATCH_RESERVED_UNIFORM_VECTORS) / 2;
+	if (max_vectors < BATCH_RESERVED_UNIFORM_VECTORS + 2) batch->instances_per_draw = 1;
+	if (batch->instances_per_draw > BATCH_MAX_INSTANCES_PER_DRAW) batch->instances_per_draw = BATCH_MAX_INSTANCES_PER_DRAW;
+
+	for (uint32_t i = 0; i < shape_count; i++)
+		if (shapes[i].vertex_count > max_shape_vertices) max_shape_vertices = shapes[i].vertex_count;
+
+	uint32_t max_draws = (max_primitives + batch->instances_per_draw - 1) / batch->instances_per_draw;
+	batch->packed_shapes = malloc(max_primitives * sizeof(uint32_t));
+	batch->draw_first = malloc(max_draws * sizeof(uint32_t));
+	batch->draw_count = malloc(max_draws * sizeof(uint32_t));
+	batch->staging = malloc((size_t)max_primitives * max_shape_vertices * format->stride);
+	batch->slots = malloc(max_shape_vertices * sizeof(GLfloat));
+	batch->instance_data = malloc(batch->instances_per_draw * 8 * sizeof(GLfloat));
+	if (!batch->packed_shapes || !batch->draw_first || !batch->draw_count || !batch->staging || !batch->slots || !batch->instance_data)
+	{
+		batch_destroy(batch);
+		return -1;
+	}
+
+	glGenBuffers(1, &batch->vbo);
+	check();
+
+	snprintf(batch->vertex_source, sizeof(batch->vertex_source), "#define INSTANCES %u\n%s", batch->instances_per_draw, batch_vertex_source);
+	if (!fragment_source) fragment_source = batch_fragment_source;
+	batch->shader = shader_request(shaders, batch->vertex_source, fragment_source, SHADER_DEFERRED, batch_program_ready, batch);
+	return batch->shader < 0 ? -1 : 0;
+}
+
+/***********************************************************
+ * Name: batch_pack
+ *
+ * Arguments:
+ *   BATCH_T *batch = batch to repack
+ *   const BATCH_PRIMITIVE_T *primitives = primitives in draw order
+ *   uint32_t count = number of primitives
+ *
+ * Description:
+ *   Duplicates each primitive's shape vertices into the interleaved VBO, tagging every
+ *   vertex with the primitive's slot in its draw call, and records the vertex range of
+ *   each draw call. Vertices are encoded in the batch's vertex format.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void batch_pack(BATCH_T *batch, const BATCH_PRIMITIVE_T *primitives, uint32_t count)
+{
+	uint8_t *out = batch->staging;
+	uint32_t vertices = 0;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t slot = i % batch->instances_per_draw;
+		uint32_t draw = i / batch->instances_per_draw;
+		const BATCH_SHAPE_T *shape = &batch->shapes[primitives[i].shape];
+
+		if (slot == 0)
+		{
+			batch->draw_first[draw] = vertices;
+			batch->draw_count[draw] = 0;
+		}
+
+		const GLfloat *sources[2] = { shape->vertices, batch->slots };
+		for (uint32_t v = 0; v < shape->vertex_count; v++) batch->slots[v] = (GLfloat)slot;
+		vertex_format_encode(&batch->format, sources, shape->vertex_count, out);
+		out += shape->vertex_count * batch->format.stride;
+		batch->draw_count[draw] += shape->vertex_count;
+		vertices += shape->vertex_count;
+		batch->packed_shapes[i] = primitives[i].shape;
+	}
+	batch->packed_count = count;
+
+	// Always respecify rather than glBufferSubData: the old storage may still be in use by
+	// the previous frame's binning pass, and orphaning it avoids waiting for that
+	gl_cache_bind_buffer(batch->cache, GL_ARRAY_BUFFER, batch->vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices * batch->format.stride, batch->staging, GL_DYNAMIC_DRAW);
+	check();
+	batch->repacks++;
+}
+
+static int batch_shapes_changed(const BATCH_T *batch, const BATCH_PRIMITIVE_T *primitives, uint32_t count)
+{
+	if (count != batch->packed_count) return 1;
+	for (uint32_t i = 0; i < count; i++)
+		if (primitives[i].shape != batch->packed_shapes[i]) return 1;
+	return 0;
+}
+
+/***********************************************************
+ * Name: batch_draw
+ *
+ * Arguments:
+ *   BATCH_T *batch = batch to draw with
+ *   const BATCH_PRIMITIVE_T *primitives = primitives in draw order
+ *   uint32_t count = number of primitives, clamped to the batch's max_primitives
+ *   GLfloat aspect = viewport width / height
+ *
+ * Description:
+ *   Draws all primitives with one glDrawArrays per instances_per_draw primitives.
+ *   Geometry is only re-uploaded when the sequence of shapes changes. Draw calls with
+ *   a translucent primitive are alpha blended and the rest are not, so with the opaque
+ *   primitives ordered first blending is switched on once per frame.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void batch_draw(BATCH_T *batch, const BATCH_PRIMITIVE_T *primitives, uint32_t count, GLfloat aspect)
+{
+	if (!batch->program) return;
+	if (count > batch->max_primitives) count = batch->max_primitives;
+	if (batch_shapes_changed(batch, primitives, count)) batch_pack(batch, primitives, count);
+
+	gl_cache_use_program(batch->cache, batch->program);
+	uniform_cache_2f(&batch->uniforms, batch->uniform_view, 1.0f / aspect, 1.0f);
+	gl_cache_bind_buffer(batch->cache, GL_ARRAY_BUFFER, batch->vbo);
+	vertex_format_apply(&batch->format, batch->cache, 0);
+
+	batch->draw_calls = 0;
+	batch->blend_changes = 0;
+	int blending = -1;
+	for (uint32_t first = 0; first < count; first += batch->instances_per_draw)
+	{
+		uint32_t n = count - first < batch->instances_per_draw ? count - first : batch->instances_per_draw;
+		int translucent = batch_fill_instances(batch->instance_data, &primitives[first], n);
+		if (translucent != blending) batch->blend_changes++;
+		blending = translucent;
+		gl_cache_blend(batch->cache, translucent ? GL_TRUE : GL_FALSE);
+		if (translucent) gl_cache_blend_func(batch->cache, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		uint32_t draw = first / batch->instances_per_draw;
+		uniform_cache_4fv(&batch->uniforms, batch->uniform_instances, n * 2, batch->instance_data);
+		glDrawArrays(GL_TRIANGLES, batch->draw_first[draw], batch->draw_count[draw]);
+		batch->draw_calls++;
+	}
+}
+
+/***********************************************************
+ * Name: batch_prepare
+ *
+ * Arguments:
+ *   BATCH_T *batch = batch to draw with
+ *   const BATCH_PRIMITIVE_T *primitives = primitives in draw order
+ *   uint32_t count = number of primitives, clamped to the batch's max_primitives
+ *   GLfloat aspect = viewport width / height
+ *
+ * Description:
+ *   GL-thread half of recorded drawing: repacks the VBO if the shape sequence changed
+ *   and sets the per-frame view uniform. Draws [0, returned count) can then be split
+ *   between threads with batch_record() and replayed with cmd_submit().
+ *
+ * Returns:
+ *   uint32_t = number of draw calls needed, 0 while the program is not built
+ *
+ ***********************************************************/
+uint32_t batch_prepare(BATCH_T *batch, const BATCH_PRIMITIVE_T *primitives, uint32_t count, GLfloat aspect)
+{
+	if (!batch->program) return 0;
+	if (count > batch->max_primitives) count = batch->max_primitives;
+	if (batch_shapes_changed(batch, primitives, count)) batch_pack(batch, primitives, count);
+
+	gl_cache_use_program(batch->cache, batch->program);
+	uniform_cache_2f(&batch->uniforms, batch->uniform_view, 1.0f / aspect, 1.0f);
+	uniform_cache_forget(&batch->uniforms, batch->uniform_instances); // Replayed commands set it directly
+	batch->draw_calls = (count + batch->instances_per_draw - 1) / batch->instances_per_draw;
+	return batch->draw_calls;
+}
+
+/***********************************************************
+ * Name: batch_record
+ *
+ * Arguments:
+ *   const BATCH_T *batch = batch prepared for this frame with batch_prepare()
+ *   CMD_LIST_T *list = list owned by the calling thread
+ *   const BATCH_PRIMITIVE_T *primitives = the same primitives passed to batch_prepare()
+ *   uint32_t count = the same count passed to batch_prepare()
+ *   uint32_t first_draw, uint32_t end_draw = range of draw calls to record
+ *
+ * Description:
+ *   Computes the per-instance uniforms for a range of draw calls and records them as
+ *   commands, translucent where any primitive is. The sort keeps scene order within
+ *   the translucent commands, so they blend in painter's order.
+ *   Touches no GL state, so ranges can be recorded on any thread in parallel.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void batch_record(const BATCH_T *batch, CMD_LIST_T *list, const BATCH_PRIMITIVE_T *primitives, uint32_t count, uint32_t first_draw, uint32_t end_draw)
+{
+	if (count > batch->max_primitives) count = batch->max_primitives;
+
+	for (uint32_t draw = first_draw; draw < end_draw; draw++)
+	{
+		uint32_t first = draw * batch->instances_per_draw;
+		if (first >= count) break;
+		uint32_t n = count - first < batch->instances_per_draw ? count - first : batch->instances_per_draw;
+
+		CMD_DRAW_T *cmd = cmd_draw(list, &batch->pipeline, 0, batch->vbo, draw, n * 2);
+		if (!cmd) return;
+		cmd->first = batch->draw_first[draw];
+		cmd->count = batch->draw_count[draw];
+		cmd->uniform_location = uniform_cache_location(&batch->uniforms, batch->uniform_instances);
+		cmd->translucent = (uint8_t)batch_fill_instances(cmd_uniforms(cmd), &primitives[first], n);
+	}
+}
+
+/***********************************************************
+ * Name: batch_destroy
+ *
+ * Arguments:
+ *   BATCH_T *batch = batch created with batch_init()
+ *
+ * Description:
+ *   Releases the program, buffer and packing memory
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void batch_destroy(BATCH_T *batch)
+{
+	if (batch->program) gl_cache_forget_program(batch->cache, batch->program);
+	if (batch->shaders) shader_release(batch->shaders, batch->shader);
+	if (batch->vbo)
+	{
+		gl_cache_forget_buffer(batch->cache, batch->vbo);
+		glDeleteBuffers(1, &batch->vbo);
+	}
+	free(batch->packed_shapes);
+	free(batch->draw_first);
+	free(batch->draw_count);
+	free(batch->staging);
+	free(batch->slots);
+	free(batch->instance_data);
+	uniform_cache_destroy(&batch->uniforms);
+	memset(batch, 0, sizeof(*batch));
+}
@@ -0,0 +1,85 @@
+/***********************************************************
+ * File: batch.h
+ *
+ * Description:
+ *   Batched renderer for large numbers of small primitives. GLES2 has no instancing, so
+ *   primitives are pseudo-instanced: each primitive's shape vertices are duplicated into
+ *   one large interleaved VBO and tagged with an instance index, and the per-primitive
+ *   transform and colour are uploaded as a uniform array that the vertex shader indexes.
+ *   One draw call covers as many primitives as the uniform array can hold.
+ *
+ ***********************************************************/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include "GLES2/gl2.h"
+#include "gl_cache.h"
+#include "shader.h"
+#include "cmdbuf.h"
+#include "vertex_format.h"
+#include "uniform_cache.h"
+
+#define BATCH_MAX_INSTANCES_PER_DRAW 64 // Upper bound, the driver's uniform limit may lower it
+
+typedef struct
+{
+	const GLfloat *vertices; // x,y pairs in model space, drawn as GL_TRIANGLES
+	uint32_t vertex_count; // Multiple of 3
+} BATCH_SHAPE_T;
+
+typedef struct
+{
+	uint32_t shape; // Index into the batch's shape list
+	GLfloat x, y; // Translation in view space
+	GLfloat scale; // Uniform scale
+	GLfloat rotation; // Counter-clockwise rotation in radians
+	GLfloat color[4]; // RGBA
+} BATCH_PRIMITIVE_T;
+
+typedef struct
+{
+	GL_CACHE_T *cache; // All state changes go through the shared state cache
+	SHADER_MANAGER_T *shaders; // Owner of the program
+
+	// Shader program and its inputs, filled in once the shader manager has built it
+	char vertex_source[2048]; // Generated for this driver's instance count
+	int shader; // Shader manager handle
+	GLuint program; // 0 until built
+	VERTEX_FORMAT_T format; // "position" (model space) then "instance" (slot within the draw call)
+	UNIFORM_CACHE_T uniforms;
+	GLint uniform_instances; // Slot of the vec4 pairs: translation + rotation/scale, then colour
+	GLint uniform_view; // Slot of the aspect correction from view space to clip space
+	CMD_PIPELINE_T pipeline; // Program and vertex layout for recorded draws
+
+	// Shapes available to primitives
+	const BATCH_SHAPE_T *shapes;
+	uint32_t shape_count;
+
+	// Packed geometry. Only the shape sequence is baked into the VBO, so primitives that
+	// merely move, spin or change colour never cause a re-upload.
+	GLuint vbo;
+	uint32_t max_primitives;
+	uint32_t instances_per_draw;
+	uint32_t *packed_shapes; // Shape index of each packed primitive
+	uint32_t packed_count; // Primitives currently packed in the VBO
+	uint32_t *draw_first; // First vertex of each draw call
+	uint32_t *draw_count; // Vertex count of each draw call
+	uint8_t *staging; // CPU copy used while packing, in the batch's vertex format
+	GLfloat *slots; // Per-vertex instance slot source used while packing
+	GLfloat *instance_data; // Uniform staging for one draw call
+
+	// Statistics for the most recent batch_draw() or batch_prepare()
+	uint32_t draw_calls;
+	uint32_t blend_changes; // Switches between blended and unblended draw calls, batch_draw() only
+	uint32_t repacks;
+} BATCH_T;
+
+int batch_init(BATCH_T *batch, GL_CACHE_T *cache, SHADER_MANAGER_T *shaders, const VERTEX_FORMAT_T *format, const BATCH_SHAPE_T *shapes, uint32_t shape_count, uint32_t max_primitives, const GLchar *fragment_source);
+void batch_draw(BATCH_T *batch, const BATCH_PRIMITIVE_T *primitives, uint32_t count, GLfloat aspect);
+uint32_t batch_prepare(BATCH_T *batch, const BATCH_PRIMITIVE_T *primitives, uint32_t count, GLfloat aspect);
+void batch_record(const BATCH_T *batch, CMD_LIST_T *list, const BATCH_PRIMITIVE_T *primitives, uint32_t count, uint32_t first_draw, uint32_t end_draw);
+void batch_destroy(BATCH_T *batch);
+
+#endif
@@ -0,0 +1,87 @@
+/***********************************************************
+ * File: bench.c
+ *
+ * Description:
+ *   JSON results writer for benchmark mode. See bench.h.
+ *
+ ***********************************************************/
+
+#include "bcm_host.h"
+#include "GLES2/gl2.h"
+#include "bench.h"
+
+static void write_json_string(FILE *out, const char *text)
+{
+	fputc('"', out);
+	for (const unsigned char *c = (const unsigned char *)(text ? text : ""); *c; c++)
+	{
+		if (*c == '"' || *c == '\\') fprintf(out, "\\%c", *c);
+		else if (*c == '\n') fputs("\\n", out);
+		else if (*c < 0x20) fprintf(out, "\\u%04x", *c);
+		else fputc(*c, out);
+	}
+	fputc('"', out);
+}
+
+static void write_json_distribution(FILE *out, const char *name, const HISTOGRAM_T *hist, int last)
+{
+	fprintf(out, "  \"%s\": { \"mean\": %.4f, \"median\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"min\": %.4f, \"max\": %.4f }%s\n",
+		name,
+		histogram_mean(hist) / 1000.0,
+		histogram_percentile(hist, 50.0) / 1000.0,
+		histogram_percentile(hist, 95.0) / 1000.0,
+		histogram_percentile(hist, 99.0) / 1000.0,
+		hist->count ? hist->min / 1000.0 : 0.0,
+		hist->max / 1000.0,
+		last ? "" : ",");
+}
+
+/***********************************************************
+ * Name: bench_write_json
+ *
+ * Arguments:
+ *   const BENCH_CONFIG_T *config = benchmark settings, including the output path
+ *   const FRAME_CLOCK_T *clock = frame clock whose histograms cover only the measured frames
+ *   uint32_t width, height = render target size in pixels
+ *
+ * Description:
+ *   Writes the benchmark results. Driver strings and the VideoCore firmware version are
+ *   included so results can be grouped per firmware/driver release. All times are in
+ *   milliseconds.
+ *
+ * Returns:
+ *   int = 0 on success, -1 if the output file could not be written
+ *
+ ***********************************************************/
+int bench_write_json(const BENCH_CONFIG_T *config, const FRAME_CLOCK_T *clock, uint32_t width, uint32_t height)
+{
+	FILE *out = config->output_path ? fopen(config->output_path, "w") : stdout;
+	if (!out) return -1;
+
+	char firmware[256] = "";
+	if (vc_gencmd(firmware, sizeof(firmware), "version") != 0) firmware[0] = 0;
+
+	fprintf(out, "{\n");
+	fprintf(out, "  \"renderer\": "); write_json_string(out, (const char *)glGetString(GL_RENDERER)); fprintf(out, ",\n");
+	fprintf(out, "  \"gl_version\": "); write_json_string(out, (const char *)glGetString(GL_VERSION)); fprintf(out, ",\n");
+	fprintf(out, "  \"firmware\": "); write_json_string(out, firmware); fprintf(out, ",\n");
+	fprintf(out, "  \"width\": %u,\n", width);
+	fprintf(out, "  \"height\": %u,\n", height);
+	fprintf(out, "  \"swap_interval\": %d,\n", config->swap_interval);
+	fprintf(out, "  \"present\": \"%s\",\n", config->offscreen ? "offscreen" : "window");
+	fprintf(out, "  \"render_pass\": \"%s\",\n", config->render_pass ? config->render_pass : "tiled");
+	fprintf(out, "  \"depth_bits\": %d,\n", config->depth_bits);
+	fprintf(out, "  \"stencil_bits\": %d,\n", config->stencil_bits);
+	fprintf(out, "  \"warmup_frames\": %u,\n", config->warmup_frames);
+	fprintf(out, "  \"frames\": %u,\n", clock->frame_hist.count);
+	fprintf(out, "  \"fps\": %.3f,\n", clock->frame_hist.sum ? 1e6 * clock->frame_hist.count / (double)clock->frame_hist.sum : 0.0);
+	write_json_distribution(out, "frame_ms", &clock->frame_hist, 0);
+	write_json_distribution(out, "submit_ms", &clock->submit_hist, 0);
+	write_json_distribution(out, "swap_ms", &clock->swap_hist, 1);
+	fprintf(out, "}\n");
+
+	int failed = ferror(out);
+	if (out != stdout) failed |= fclose(out);
+	else fflush(out);
+	return failed ? -1 : 0;
+}
@@ -0,0 +1,35 @@
+/***********************************************************
+ * File: bench.h
+ *
+ * Description:
+ *   Benchmark mode: a fixed number of warm-up frames followed by a fixed number of
+ *   measured frames, summarised as a single JSON document for regression tracking.
+ *
+ ***********************************************************/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "frame_clock.h"
+
+#define BENCH_DEFAULT_WARMUP_FRAMES 120
+
+typedef struct
+{
+	uint32_t warmup_frames; // Frames rendered before measurement starts
+	uint32_t measured_frames; // Frames included in the results, 0 when not benchmarking
+	const char *output_path; // Where the JSON goes, NULL for stdout
+
+	// Run description copied into the results
+	int swap_interval; // eglSwapInterval value, -1 for the EGL default
+	int offscreen; // Frames went to an FBO and were never presented
+	const char *render_pass; // Load/store actions, "tiled" or "legacy"
+	int depth_bits; // Depth and stencil buffers of the render target
+	int stencil_bits;
+} BENCH_CONFIG_T;
+
+int bench_write_json(const BENCH_CONFIG_T *config, const FRAME_CLOCK_T *clock, uint32_t width, uint32_t height);
+
+#endif
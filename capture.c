@@ -0,0 +1,736 @@
+/***********************************************************
+ * File: capture.c
+ *
+ * Description:
+ *   Link-time GL call wrappers and the trace writer. See capture.h. Every wrapper
+ *   forwards to the driver through its __real_ symbol, also when nothing is being
+ *   captured, so a normal run pays one extra call per GL entry point. GL is only
+ *   called from the render thread, so none of this is locked.
+ *
+ *   A GL entry point new to the tree has to be added to CAPTURE_CALLS in the makefile
+ *   and wrapped here, otherwise replays silently lack it. Compiled only with
+ *   make CAPTURE=1, which also adds the --wrap link flags.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "GLES2/gl2.h"
+#include "GLES2/gl2ext.h"
+#include "EGL/egl.h"
+#include "capture.h"
+
+#ifdef GL_CAPTURE
+
+typedef struct
+{
+	FILE *out; // Open while capturing
+	char *buffer; // stdio buffer of out
+	CAPTURE_HEADER_T header;
+	uint64_t bytes; // Written so far, header included
+	int failed; // A write failed, the trace is incomplete
+
+	// State the wrappers need to size data, tracked whether capturing or not
+	GLuint array_buffer;
+	GLuint element_buffer;
+	GLint unpack_alignment;
+	PFNGLDISCARDFRAMEBUFFEREXTPROC discard; // Driver entry point behind capture_discard_framebuffer()
+} CAPTURE_T;
+static CAPTURE_T _capture = { .unpack_alignment = 4 }, *capture=&_capture;
+
+// Appends one record. Errors are remembered and reported by capture_stop().
+static void capture_record(uint16_t op, const uint32_t *args, uint16_t arg_count, const void *data, uint32_t data_bytes)
+{
+	static const uint8_t pad[3];
+	CAPTURE_RECORD_T record = { op, arg_count, data_bytes };
+	uint32_t padding = (4 - data_bytes % 4) % 4;
+
+	if (fwrite(&record, sizeof(record), 1, capture->out) != 1 ||
+		(arg_count && fwrite(args, sizeof(uint32_t), arg_count, capture->out) != arg_count) ||
+		(data_bytes && fwrite(data, 1, data_bytes, capture->out) != data_bytes) ||
+		(padding && fwrite(pad, 1, padding, capture->out) != padding))
+		capture->failed = 1;
+	capture->header.record_count++;
+	capture->bytes += sizeof(record) + arg_count * sizeof(uint32_t) + data_bytes + padding;
+}
+
+// Records op with the 32-bit arguments that follow, only while capturing
+#define CAPTURE_ARGS(op, ...) do { \
+		if (capture->out) { const uint32_t args_[] = { __VA_ARGS__ }; capture_record(op, args_, sizeof(args_) / sizeof(args_[0]), NULL, 0); } \
+	} while (0)
+
+static uint32_t capture_float(GLfloat f)
+{
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return bits;
+}
+
+// Bytes glTexImage2D() reads: rows padded to GL_UNPACK_ALIGNMENT, except the last
+static uint32_t capture_image_bytes(GLsizei width, GLsizei height, GLenum format, GLenum type)
+{
+	uint32_t pixel = 1;
+	if (width <= 0 || height <= 0) return 0;
+	if (type != GL_UNSIGNED_BYTE) pixel = 2; // 565, 4444 and 5551
+	else if (format == GL_RGBA) pixel = 4;
+	else if (format == GL_RGB) pixel = 3;
+	else if (format == GL_LUMINANCE_ALPHA) pixel = 2;
+
+	uint32_t alignment = capture->unpack_alignment > 0 ? (uint32_t)capture->unpack_alignment : 1;
+	uint32_t row = (uint32_t)width * pixel;
+	uint32_t stride = (row + alignment - 1) / alignment * alignment;
+	return stride * (uint32_t)(height - 1) + row;
+}
+
+static void capture_names(uint16_t op, GLsizei n, const GLuint *names)
+{
+	if (capture->out && n > 0) capture_record(op, NULL, 0, names, (uint32_t)n * sizeof(GLuint));
+}
+
+/***********************************************************
+ * Name: capture_start
+ *
+ * Arguments:
+ *   const char *path = trace file to create
+ *
+ * Description:
+ *   Starts recording every GL call. Call before the context is created so the trace
+ *   holds the complete GL state, and before shader_manager_init() so program binaries
+ *   are not used. The header is rewritten with the final counts by capture_stop().
+ *
+ * Returns:
+ *   int = 0 on success, -1 if the file could not be created
+ *
+ ***********************************************************/
+int capture_start(const char *path)
+{
+	if (capture->out) return -1;
+	capture->out = fopen(path, "wb");
+	if (!capture->out) return -1;
+	capture->buffer = malloc(CAPTURE_BUFFER_BYTES);
+	if (capture->buffer) setvbuf(capture->out, capture->buffer, _IOFBF, CAPTURE_BUFFER_BYTES);
+
+	memset(&capture->header, 0, sizeof(capture->header));
+	capture->header.magic = CAPTURE_MAGIC;
+	capture->header.version = CAPTURE_VERSION;
+	capture->header.header_bytes = sizeof(CAPTURE_HEADER_T);
+	capture->failed = fwrite(&capture->header, sizeof(capture->header), 1, capture->out) != 1;
+	capture->bytes = sizeof(capture->header);
+	return 0;
+}
+
+// Window surface and run description for replay.bin, once it is known
+void capture_set_surface(uint32_t width, uint32_t height, uint32_t depth_bits, uint32_t stencil_bits, uint32_t flags)
+{
+	capture->header.width = width;
+	capture->header.height = height;
+	capture->header.depth_bits = depth_bits;
+	capture->header.stencil_bits = stencil_bits;
+	capture->header.flags |= flags;
+}
+
+// Separates scene setup from the frames, so replays can time them apart
+void capture_setup_done(void)
+{
+	if (capture->out) capture_record(CAPTURE_OP_SETUP_DONE, NULL, 0, NULL, 0);
+}
+
+// Marks the end of a frame, after its swap or its glFinish()
+void capture_frame(int presented)
+{
+	if (!capture->out) return;
+	CAPTURE_ARGS(CAPTURE_OP_FRAME, presented ? 1u : 0u);
+	capture->header.frame_count++;
+}
+
+/***********************************************************
+ * Name: capture_stop
+ *
+ * Arguments:
+ *   void
+ *
+ * Description:
+ *   Ends the capture and completes the header. GL calls keep being forwarded.
+ *
+ * Returns:
+ *   int = 0 on success or when nothing was captured, -1 if the trace is incomplete
+ *
+ ***********************************************************/
+int capture_stop(void)
+{
+	if (!capture->out) return 0;
+	if (fflush(capture->out) != 0 || fseek(capture->out, 0, SEEK_SET) != 0 ||
+		fwrite(&capture->header, sizeof(capture->header), 1, capture->out) != 1)
+		capture->failed = 1;
+	if (fclose(capture->out) != 0) capture->failed = 1;
+	capture->out = NULL;
+	free(capture->buffer);
+	capture->buffer = NULL;
+	return capture->failed ? -1 : 0;
+}
+
+uint32_t capture_frames(void)
+{
+	return capture->header.frame_count;
+}
+
+uint64_t capture_bytes(void)
+{
+	return capture->bytes;
+}
+
+/*
+ * Wrappers. Those creating objects record the names the driver returned, replay.bin
+ * maps them to its own.
+ */
+
+void __real_glActiveTexture(GLenum texture);
+void __wrap_glActiveTexture(GLenum texture)
+{
+	CAPTURE_ARGS(CAPTURE_OP_ACTIVE_TEXTURE, texture);
+	__real_glActiveTexture(texture);
+}
+
+void __real_glAttachShader(GLuint program, GLuint shader);
+void __wrap_glAttachShader(GLuint program, GLuint shader)
+{
+	CAPTURE_ARGS(CAPTURE_OP_ATTACH_SHADER, program, shader);
+	__real_glAttachShader(program, shader);
+}
+
+void __real_glBindBuffer(GLenum target, GLuint buffer);
+void __wrap_glBindBuffer(GLenum target, GLuint buffer)
+{
+	if (target == GL_ARRAY_BUFFER) capture->array_buffer = buffer;
+	else if (target == GL_ELEMENT_ARRAY_BUFFER) capture->element_buffer = buffer;
+	CAPTURE_ARGS(CAPTURE_OP_BIND_BUFFER, target, buffer);
+	__real_glBindBuffer(target, buffer);
+}
+
+void __real_glBindFramebuffer(GLenum target, GLuint framebuffer);
+void __wrap_glBindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	CAPTURE_ARGS(CAPTURE_OP_BIND_FRAMEBUFFER, target, framebuffer);
+	__real_glBindFramebuffer(target, framebuffer);
+}
+
+void __real_glBindRenderbuffer(GLenum target, GLuint renderbuffer);
+void __wrap_glBindRenderbuffer(GLenum target, GLuint renderbuffer)
+{
+	CAPTURE_ARGS(CAPTURE_OP_BIND_RENDERBUFFER, target, renderbuffer);
+	__real_glBindRenderbuffer(target, renderbuffer);
+}
+
+void __real_glBindTexture(GLenum target, GLuint texture);
+void __wrap_glBindTexture(GLenum target, GLuint texture)
+{
+	CAPTURE_ARGS(CAPTURE_OP_BIND_TEXTURE, target, texture);
+	__real_glBindTexture(target, texture);
+}
+
+void __real_glBlendFunc(GLenum sfactor, GLenum dfactor);
+void __wrap_glBlendFunc(GLenum sfactor, GLenum dfactor)
+{
+	CAPTURE_ARGS(CAPTURE_OP_BLEND_FUNC, sfactor, dfactor);
+	__real_glBlendFunc(sfactor, dfactor);
+}
+
+void __real_glBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage);
+void __wrap_glBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage)
+{
+	if (capture->out)
+	{
+		const uint32_t args[] = { target, (uint32_t)size, usage, data != NULL };
+		capture_record(CAPTURE_OP_BUFFER_DATA, args, 4, data, data ? (uint32_t)size : 0);
+	}
+	__real_glBufferData(target, size, data, usage);
+}
+
+void __real_glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data);
+void __wrap_glBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data)
+{
+	if (capture->out)
+	{
+		const uint32_t args[] = { target, (uint32_t)offset, (uint32_t)size };
+		capture_record(CAPTURE_OP_BUFFER_SUB_DATA, args, 3, data, (uint32_t)size);
+	}
+	__real_glBufferSubData(target, offset, size, data);
+}
+
+void __real_glClear(GLbitfield mask);
+void __wrap_glClear(GLbitfield mask)
+{
+	CAPTURE_ARGS(CAPTURE_OP_CLEAR, mask);
+	__real_glClear(mask);
+}
+
+void __real_glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+void __wrap_glClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+	CAPTURE_ARGS(CAPTURE_OP_CLEAR_COLOR, capture_float(red), capture_float(green), capture_float(blue), capture_float(alpha));
+	__real_glClearColor(red, green, blue, alpha);
+}
+
+void __real_glCompileShader(GLuint shader);
+void __wrap_glCompileShader(GLuint shader)
+{
+	CAPTURE_ARGS(CAPTURE_OP_COMPILE_SHADER, shader);
+	__real_glCompileShader(shader);
+}
+
+void __real_glCompressedTexImage2D(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height,
+	GLint border, GLsizei imageSize, const void *data);
+void __wrap_glCompressedTexImage2D(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height,
+	GLint border, GLsizei imageSize, const void *data)
+{
+	if (capture->out)
+	{
+		const uint32_t args[] = { target, (uint32_t)level, internalformat, (uint32_t)width, (uint32_t)height, (uint32_t)border };
+		capture_record(CAPTURE_OP_COMPRESSED_TEX_IMAGE_2D, args, 6, data, data ? (uint32_t)imageSize : 0);
+	}
+	__real_glCompressedTexImage2D(target, level, internalformat, width, height, border, imageSize, data);
+}
+
+GLuint __real_glCreateProgram(void);
+GLuint __wrap_glCreateProgram(void)
+{
+	GLuint program = __real_glCreateProgram();
+	CAPTURE_ARGS(CAPTURE_OP_CREATE_PROGRAM, program);
+	return program;
+}
+
+GLuint __real_glCreateShader(GLenum type);
+GLuint __wrap_glCreateShader(GLenum type)
+{
+	GLuint shader = __real_glCreateShader(type);
+	CAPTURE_ARGS(CAPTURE_OP_CREATE_SHADER, type, shader);
+	return shader;
+}
+
+void __real_glDeleteBuffers(GLsizei n, const GLuint *buffers);
+void __wrap_glDeleteBuffers(GLsizei n, const GLuint *buffers)
+{
+	for (GLsizei i = 0; i < n; i++)
+	{
+		if (buffers[i] == capture->array_buffer) capture->array_buffer = 0;
+		if (buffers[i] == capture->element_buffer) capture->element_buffer = 0;
+	}
+	capture_names(CAPTURE_OP_DELETE_BUFFERS, n, buffers);
+	__real_glDeleteBuffers(n, buffers);
+}
+
+void __real_glDeleteFramebuffers(GLsizei n, const GLuint *framebuffers);
+void __wrap_glDeleteFramebuffers(GLsizei n, const GLuint *framebuffers)
+{
+	capture_names(CAPTURE_OP_DELETE_FRAMEBUFFERS, n, framebuffers);
+	__real_glDeleteFramebuffers(n, framebuffers);
+}
+
+void __real_glDeleteProgram(GLuint program);
+void __wrap_glDeleteProgram(GLuint program)
+{
+	CAPTURE_ARGS(CAPTURE_OP_DELETE_PROGRAM, program);
+	__real_glDeleteProgram(program);
+}
+
+void __real_glDeleteRenderbuffers(GLsizei n, const GLuint *renderbuffers);
+void __wrap_glDeleteRenderbuffers(GLsizei n, const GLuint *renderbuffers)
+{
+	capture_names(CAPTURE_OP_DELETE_RENDERBUFFERS, n, renderbuffers);
+	__real_glDeleteRenderbuffers(n, renderbuffers);
+}
+
+void __real_glDeleteShader(GLuint shader);
+void __wrap_glDeleteShader(GLuint shader)
+{
+	CAPTURE_ARGS(CAPTURE_OP_DELETE_SHADER, shader);
+	__real_glDeleteShader(shader);
+}
+
+void __real_glDeleteTextures(GLsizei n, const GLuint *textures);
+void __wrap_glDeleteTextures(GLsizei n, const GLuint *textures)
+{
+	capture_names(CAPTURE_OP_DELETE_TEXTURES, n, textures);
+	__real_glDeleteTextures(n, textures);
+}
+
+void __real_glDisable(GLenum cap);
+void __wrap_glDisable(GLenum cap)
+{
+	CAPTURE_ARGS(CAPTURE_OP_DISABLE, cap);
+	__real_glDisable(cap);
+}
+
+void __real_glDisableVertexAttribArray(GLuint index);
+void __wrap_glDisableVertexAttribArray(GLuint index)
+{
+	CAPTURE_ARGS(CAPTURE_OP_DISABLE_VERTEX_ATTRIB_ARRAY, index);
+	__real_glDisableVertexAttribArray(index);
+}
+
+void __real_glDrawArrays(GLenum mode, GLint first, GLsizei count);
+void __wrap_glDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	CAPTURE_ARGS(CAPTURE_OP_DRAW_ARRAYS, mode, (uint32_t)first, (uint32_t)count);
+	__real_glDrawArrays(mode, first, count);
+}
+
+void __real_glDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices);
+void __wrap_glDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices)
+{
+	if (capture->out)
+	{
+		// Without an element buffer the indices are client memory and go into the trace
+		int client = !capture->element_buffer && indices;
+		uint32_t index_bytes = type == GL_UNSIGNED_BYTE ? 1 : 2;
+		const uint32_t args[] = { mode, (uint32_t)count, type, client ? 0 : (uint32_t)(uintptr_t)indices };
+		capture_record(CAPTURE_OP_DRAW_ELEMENTS, args, 4, client ? indices : NULL, client ? (uint32_t)count * index_bytes : 0);
+	}
+	__real_glDrawElements(mode, count, type, indices);
+}
+
+void __real_glEnable(GLenum cap);
+void __wrap_glEnable(GLenum cap)
+{
+	CAPTURE_ARGS(CAPTURE_OP_ENABLE, cap);
+	__real_glEnable(cap);
+}
+
+void __real_glEnableVertexAttribArray(GLuint index);
+void __wrap_glEnableVertexAttribArray(GLuint index)
+{
+	CAPTURE_ARGS(CAPTURE_OP_ENABLE_VERTEX_ATTRIB_ARRAY, index);
+	__real_glEnableVertexAttribArray(index);
+}
+
+void __real_glFinish(void);
+void __wrap_glFinish(void)
+{
+	if (capture->out) capture_record(CAPTURE_OP_FINISH, NULL, 0, NULL, 0);
+	__real_glFinish();
+}
+
+void __real_glFlush(void);
+void __wrap_glFlush(void)
+{
+	if (capture->out) capture_record(CAPTURE_OP_FLUSH, NULL, 0, NULL, 0);
+	__real_glFlush();
+}
+
+void __real_glFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer);
+void __wrap_glFramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbuffertarget, GLuint renderbuffer)
+{
+	CAPTURE_ARGS(CAPTURE_OP_FRAMEBUFFER_RENDERBUFFER, target, attachment, renderbuffertarget, renderbuffer);
+	__real_glFramebufferRenderbuffer(target, attachment, renderbuffertarget, renderbuffer);
+}
+
+void __real_glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level);
+void __wrap_glFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget, GLuint texture, GLint level)
+{
+	CAPTURE_ARGS(CAPTURE_OP_FRAMEBUFFER_TEXTURE_2D, target, attachment, textarget, texture, (uint32_t)level);
+	__real_glFramebufferTexture2D(target, attachment, textarget, texture, level);
+}
+
+void __real_glGenBuffers(GLsizei n, GLuint *buffers);
+void __wrap_glGenBuffers(GLsizei n, GLuint *buffers)
+{
+	__real_glGenBuffers(n, buffers);
+	capture_names(CAPTURE_OP_GEN_BUFFERS, n, buffers);
+}
+
+void __real_glGenFramebuffers(GLsizei n, GLuint *framebuffers);
+void __wrap_glGenFramebuffers(GLsizei n, GLuint *framebuffers)
+{
+	__real_glGenFramebuffers(n, framebuffers);
+	capture_names(CAPTURE_OP_GEN_FRAMEBUFFERS, n, framebuffers);
+}
+
+void __real_glGenRenderbuffers(GLsizei n, GLuint *renderbuffers);
+void __wrap_glGenRenderbuffers(GLsizei n, GLuint *renderbuffers)
+{
+	__real_glGenRenderbuffers(n, renderbuffers);
+	capture_names(CAPTURE_OP_GEN_RENDERBUFFERS, n, renderbuffers);
+}
+
+void __real_glGenTextures(GLsizei n, GLuint *textures);
+void __wrap_glGenTextures(GLsizei n, GLuint *textures)
+{
+	__real_glGenTextures(n, textures);
+	capture_names(CAPTURE_OP_GEN_TEXTURES, n, textures);
+}
+
+// Appends one link entry to a growing buffer, returns -1 on allocation failure
+static int capture_link_entry(uint8_t **data, uint32_t *bytes, uint32_t *capacity, uint32_t kind, GLint location, const char *name)
+{
+	CAPTURE_LINK_ENTRY_T entry = { kind, location, (uint32_t)strlen(name) + 1 };
+	uint32_t padded = (entry.name_bytes + 3) & ~3u;
+	uint32_t needed = *bytes + sizeof(entry) + padded;
+	if (needed > *capacity)
+	{
+		uint32_t grown = *capacity ? *capacity * 2 : 1024;
+		while (grown < needed) grown *= 2;
+		uint8_t *p = realloc(*data, grown);
+		if (!p) return -1;
+		*data = p;
+		*capacity = grown;
+	}
+	memcpy(*data + *bytes, &entry, sizeof(entry));
+	memset(*data + *bytes + sizeof(entry), 0, padded);
+	memcpy(*data + *bytes + sizeof(entry), name, entry.name_bytes);
+	*bytes = needed;
+	return 0;
+}
+
+/***********************************************************
+ * Name: __wrap_glLinkProgram
+ *
+ * Arguments:
+ *   GLuint program = as for glLinkProgram
+ *
+ * Description:
+ *   Links, then records the link together with where the driver put every active
+ *   attribute and uniform. replay.bin binds the attributes to the same locations before
+ *   linking and looks the uniforms up by name after, so locations baked into the
+ *   recorded calls stay valid on a different driver.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void __real_glLinkProgram(GLuint program);
+void __wrap_glLinkProgram(GLuint program)
+{
+	GLint status = GL_FALSE, attribs = 0, uniforms = 0, max_length = 0, length;
+	uint8_t *data = NULL;
+	uint32_t bytes = 0, capacity = 0;
+
+	__real_glLinkProgram(program);
+	if (!capture->out) return;
+
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+	if (status)
+	{
+		glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &attribs);
+		glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniforms);
+		glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_length);
+		glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &length);
+		if (length > max_length) max_length = length;
+	}
+
+	char *name = malloc(max_length > 0 ? max_length : 1);
+	if (!name) attribs = uniforms = 0;
+	for (GLint i = 0; i < attribs; i++)
+	{
+		GLint size;
+		GLenum type;
+		glGetActiveAttrib(program, i, max_length, NULL, &size, &type, name);
+		if (capture_link_entry(&data, &bytes, &capacity, CAPTURE_LINK_ATTRIB, glGetAttribLocation(program, name), name) != 0) capture->failed = 1;
+	}
+	for (GLint i = 0; i < uniforms; i++)
+	{
+		GLint size;
+		GLenum type;
+		glGetActiveUniform(program, i, max_length, NULL, &size, &type, name);
+		if (capture_link_entry(&data, &bytes, &capacity, CAPTURE_LINK_UNIFORM, glGetUniformLocation(program, name), name) != 0) capture->failed = 1;
+	}
+
+	const uint32_t args[] = { program };
+	capture_record(CAPTURE_OP_LINK_PROGRAM, args, 1, data, bytes);
+	free(name);
+	free(data);
+}
+
+void __real_glPixelStorei(GLenum pname, GLint param);
+void __wrap_glPixelStorei(GLenum pname, GLint param)
+{
+	if (pname == GL_UNPACK_ALIGNMENT) capture->unpack_alignment = param;
+	CAPTURE_ARGS(CAPTURE_OP_PIXEL_STOREI, pname, (uint32_t)param);
+	__real_glPixelStorei(pname, param);
+}
+
+void __real_glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels);
+void __wrap_glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void *pixels)
+{
+	CAPTURE_ARGS(CAPTURE_OP_READ_PIXELS, (uint32_t)x, (uint32_t)y, (uint32_t)width, (uint32_t)height, format, type);
+	__real_glReadPixels(x, y, width, height, format, type, pixels);
+}
+
+void __real_glRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height);
+void __wrap_glRenderbufferStorage(GLenum target, GLenum internalformat, GLsizei width, GLsizei height)
+{
+	CAPTURE_ARGS(CAPTURE_OP_RENDERBUFFER_STORAGE, target, internalformat, (uint32_t)width, (uint32_t)height);
+	__real_glRenderbufferStorage(target, internalformat, width, height);
+}
+
+void __real_glScissor(GLint x, GLint y, GLsizei width, GLsizei height);
+void __wrap_glScissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	CAPTURE_ARGS(CAPTURE_OP_SCISSOR, (uint32_t)x, (uint32_t)y, (uint32_t)width, (uint32_t)height);
+	__real_glScissor(x, y, width, height);
+}
+
+void __real_glShaderSource(GLuint shader, GLsizei count, const GLchar *const *string, const GLint *length);
+void __wrap_glShaderSource(GLuint shader, GLsizei count, const GLchar *const *string, const GLint *length)
+{
+	if (capture->out)
+	{
+		// Concatenated into one string, which compiles the same
+		uint32_t bytes = 0;
+		for (GLsizei i = 0; i < count; i++) bytes += length && length[i] >= 0 ? (uint32_t)length[i] : strlen(string[i]);
+		char *source = malloc(bytes ? bytes : 1);
+		if (source)
+		{
+			uint32_t at = 0;
+			for (GLsizei i = 0; i < count; i++)
+			{
+				uint32_t n = length && length[i] >= 0 ? (uint32_t)length[i] : strlen(string[i]);
+				memcpy(source + at, string[i], n);
+				at += n;
+			}
+			const uint32_t args[] = { shader };
+			capture_record(CAPTURE_OP_SHADER_SOURCE, args, 1, source, bytes);
+			free(source);
+		}
+		else capture->failed = 1;
+	}
+	__real_glShaderSource(shader, count, string, length);
+}
+
+void __real_glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border,
+	GLenum format, GLenum type, const void *pixels);
+void __wrap_glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border,
+	GLenum format, GLenum type, const void *pixels)
+{
+	if (capture->out)
+	{
+		const uint32_t args[] = { target, (uint32_t)level, (uint32_t)internalformat, (uint32_t)width, (uint32_t)height,
+			(uint32_t)border, format, type, pixels != NULL };
+		capture_record(CAPTURE_OP_TEX_IMAGE_2D, args, 9, pixels, pixels ? capture_image_bytes(width, height, format, type) : 0);
+	}
+	__real_glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels);
+}
+
+void __real_glTexParameteri(GLenum target, GLenum pname, GLint param);
+void __wrap_glTexParameteri(GLenum target, GLenum pname, GLint param)
+{
+	CAPTURE_ARGS(CAPTURE_OP_TEX_PARAMETERI, target, pname, (uint32_t)param);
+	__real_glTexParameteri(target, pname, param);
+}
+
+void __real_glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+	GLenum format, GLenum type, const void *pixels);
+void __wrap_glTexSubImage2D(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+	GLenum format, GLenum type, const void *pixels)
+{
+	if (capture->out)
+	{
+		const uint32_t args[] = { target, (uint32_t)level, (uint32_t)xoffset, (uint32_t)yoffset, (uint32_t)width,
+			(uint32_t)height, format, type };
+		capture_record(CAPTURE_OP_TEX_SUB_IMAGE_2D, args, 8, pixels, pixels ? capture_image_bytes(width, height, format, type) : 0);
+	}
+	__real_glTexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels);
+}
+
+void __real_glUniform1f(GLint location, GLfloat x);
+void __wrap_glUniform1f(GLint location, GLfloat x)
+{
+	CAPTURE_ARGS(CAPTURE_OP_UNIFORM_1F, (uint32_t)location, capture_float(x));
+	__real_glUniform1f(location, x);
+}
+
+void __real_glUniform1i(GLint location, GLint x);
+void __wrap_glUniform1i(GLint location, GLint x)
+{
+	CAPTURE_ARGS(CAPTURE_OP_UNIFORM_1I, (uint32_t)location, (uint32_t)x);
+	__real_glUniform1i(location, x);
+}
+
+void __real_glUniform2fv(GLint location, GLsizei count, const GLfloat *v);
+void __wrap_glUniform2fv(GLint location, GLsizei count, const GLfloat *v)
+{
+	if (capture->out)
+	{
+		const uint32_t args[] = { (uint32_t)location, (uint32_t)count };
+		capture_record(CAPTURE_OP_UNIFORM_2FV, args, 2, v, (uint32_t)count * 2 * sizeof(GLfloat));
+	}
+	__real_glUniform2fv(location, count, v);
+}
+
+void __real_glUniform4fv(GLint location, GLsizei count, const GLfloat *v);
+void __wrap_glUniform4fv(GLint location, GLsizei count, const GLfloat *v)
+{
+	if (capture->out)
+	{
+		const uint32_t args[] = { (uint32_t)location, (uint32_t)count };
+		capture_record(CAPTURE_OP_UNIFORM_4FV, args, 2, v, (uint32_t)count * 4 * sizeof(GLfloat));
+	}
+	__real_glUniform4fv(location, count, v);
+}
+
+void __real_glUseProgram(GLuint program);
+void __wrap_glUseProgram(GLuint program)
+{
+	CAPTURE_ARGS(CAPTURE_OP_USE_PROGRAM, program);
+	__real_glUseProgram(program);
+}
+
+void __real_glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer);
+void __wrap_glVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer)
+{
+	if (capture->out && !capture->array_buffer && !(capture->header.flags & CAPTURE_FLAG_CLIENT_ARRAYS))
+	{
+		fprintf(stderr, "Capture: client-side vertex arrays are not recorded, the trace will not replay\n");
+		capture->header.flags |= CAPTURE_FLAG_CLIENT_ARRAYS;
+	}
+	CAPTURE_ARGS(CAPTURE_OP_VERTEX_ATTRIB_POINTER, index, (uint32_t)size, type, normalized, (uint32_t)stride, (uint32_t)(uintptr_t)pointer);
+	__real_glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+void __real_glViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+void __wrap_glViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	CAPTURE_ARGS(CAPTURE_OP_VIEWPORT, (uint32_t)x, (uint32_t)y, (uint32_t)width, (uint32_t)height);
+	__real_glViewport(x, y, width, height);
+}
+
+static void GL_APIENTRY capture_discard_framebuffer(GLenum target, GLsizei count, const GLenum *attachments)
+{
+	if (capture->out)
+	{
+		const uint32_t args[] = { target };
+		capture_record(CAPTURE_OP_DISCARD_FRAMEBUFFER, args, 1, attachments, (uint32_t)count * sizeof(GLenum));
+	}
+	capture->discard(target, count, attachments);
+}
+
+/***********************************************************
+ * Name: __wrap_eglGetProcAddress
+ *
+ * Arguments:
+ *   const char *procname = as for eglGetProcAddress
+ *
+ * Description:
+ *   Extension entry points bypass the link-time wrappers, so the ones that issue GL work
+ *   are handed out wrapped. Program binaries are driver specific and would leave the
+ *   trace without shader source, so they are reported missing while capturing.
+ *
+ * Returns:
+ *   __eglMustCastToProperFunctionPointerType = entry point, or NULL
+ *
+ ***********************************************************/
+__eglMustCastToProperFunctionPointerType __real_eglGetProcAddress(const char *procname);
+__eglMustCastToProperFunctionPointerType __wrap_eglGetProcAddress(const char *procname)
+{
+	if (capture->out && (strcmp(procname, "glProgramBinaryOES") == 0 || strcmp(procname, "glGetProgramBinaryOES") == 0)) return NULL;
+
+	__eglMustCastToProperFunctionPointerType proc = __real_eglGetProcAddress(procname);
+	if (proc && strcmp(procname, "glDiscardFramebufferEXT") == 0)
+	{
+		capture->discard = (PFNGLDISCARDFRAMEBUFFEREXTPROC)proc;
+		return (__eglMustCastToProperFunctionPointerType)capture_discard_framebuffer;
+	}
+	return proc;
+}
+
+#endif
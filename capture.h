@@ -0,0 +1,158 @@
+/***********************************************************
+ * File: capture.h
+ *
+ * Description:
+ *   GL command capture for offline replay. With make CAPTURE=1 triangle.bin is linked
+ *   with -Wl,--wrap for every GL entry point the tree calls, so each call lands in a
+ *   __wrap_ function here that forwards it to the driver and, while a capture is
+ *   running, appends it with its arguments and any memory it reads (buffer and texture
+ *   data, shader source, client indices) to a binary trace. No module needs to know
+ *   it is being captured. Functions reached through eglGetProcAddress() are wrapped by
+ *   wrapping that too; program binary entry points are hidden while capturing so every
+ *   program is built from recorded source and the trace replays on any driver.
+ *
+ *   Other builds call the driver directly and the capture_* hooks compile to nothing,
+ *   so production binaries pay nothing for the feature.
+ *
+ *   replay.bin plays a trace back at full speed, see replay.c. Object names and uniform
+ *   locations are remapped on replay, and attribute locations are bound to the captured
+ *   ones before each link, so a trace taken on one driver replays on another.
+ *
+ *   All fields are little-endian. Layout, version 1:
+ *     0             CAPTURE_HEADER_T
+ *     header_bytes  records, each a CAPTURE_RECORD_T, arg_count 32-bit arguments (floats
+ *                   by bit pattern), then data_bytes of data padded to 4 bytes
+ *
+ ***********************************************************/
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+
+#define CAPTURE_MAGIC 0x52544c47 // "GLTR"
+#define CAPTURE_VERSION 1
+#define CAPTURE_BUFFER_BYTES (1 << 20) // stdio buffer, the trace is written from the render thread
+
+// Header flags
+#define CAPTURE_FLAG_OFFSCREEN (1u << 0) // Frames went to an FBO, CAPTURE_OP_FRAME without a swap
+#define CAPTURE_FLAG_CLIENT_ARRAYS (1u << 1) // Client-side vertex arrays were used, their data is missing
+#define CAPTURE_FLAG_PRESERVED (1u << 2) // EGL_BUFFER_PRESERVED swaps, frames may only redraw damaged regions
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_bytes; // Records start here
+	uint32_t flags;
+	uint32_t width; // Window surface of the captured run
+	uint32_t height;
+	uint32_t depth_bits;
+	uint32_t stencil_bits;
+	uint32_t frame_count; // Filled in when the capture stops, 0 if it never did
+	uint32_t record_count;
+	uint32_t reserved[2];
+} CAPTURE_HEADER_T;
+
+typedef struct
+{
+	uint16_t op; // CAPTURE_OP_T
+	uint16_t arg_count;
+	uint32_t data_bytes; // Unpadded
+} CAPTURE_RECORD_T;
+
+// Arguments in GL order unless noted. "names" data is an array of uint32_t object names.
+typedef enum
+{
+	CAPTURE_OP_FRAME = 1, // presented; end of frame, a swap unless the frame was offscreen
+	CAPTURE_OP_SETUP_DONE, // Scene setup ends, the frames follow
+	CAPTURE_OP_ACTIVE_TEXTURE,
+	CAPTURE_OP_ATTACH_SHADER,
+	CAPTURE_OP_BIND_BUFFER,
+	CAPTURE_OP_BIND_FRAMEBUFFER,
+	CAPTURE_OP_BIND_RENDERBUFFER,
+	CAPTURE_OP_BIND_TEXTURE,
+	CAPTURE_OP_BLEND_FUNC,
+	CAPTURE_OP_BUFFER_DATA, // target, size, usage, has_data; data
+	CAPTURE_OP_BUFFER_SUB_DATA, // target, offset, size; data
+	CAPTURE_OP_CLEAR,
+	CAPTURE_OP_CLEAR_COLOR,
+	CAPTURE_OP_COMPILE_SHADER,
+	CAPTURE_OP_COMPRESSED_TEX_IMAGE_2D, // target, level, internalformat, width, height, border; data
+	CAPTURE_OP_CREATE_PROGRAM, // program
+	CAPTURE_OP_CREATE_SHADER, // type, shader
+	CAPTURE_OP_DELETE_BUFFERS, // names
+	CAPTURE_OP_DELETE_FRAMEBUFFERS,
+	CAPTURE_OP_DELETE_PROGRAM,
+	CAPTURE_OP_DELETE_RENDERBUFFERS,
+	CAPTURE_OP_DELETE_SHADER,
+	CAPTURE_OP_DELETE_TEXTURES,
+	CAPTURE_OP_DISABLE,
+	CAPTURE_OP_DISABLE_VERTEX_ATTRIB_ARRAY,
+	CAPTURE_OP_DISCARD_FRAMEBUFFER, // target; attachments as uint32_t
+	CAPTURE_OP_DRAW_ARRAYS,
+	CAPTURE_OP_DRAW_ELEMENTS, // mode, count, type, offset; client indices as data, if any
+	CAPTURE_OP_ENABLE,
+	CAPTURE_OP_ENABLE_VERTEX_ATTRIB_ARRAY,
+	CAPTURE_OP_FINISH,
+	CAPTURE_OP_FLUSH,
+	CAPTURE_OP_FRAMEBUFFER_RENDERBUFFER,
+	CAPTURE_OP_FRAMEBUFFER_TEXTURE_2D,
+	CAPTURE_OP_GEN_BUFFERS, // names
+	CAPTURE_OP_GEN_FRAMEBUFFERS,
+	CAPTURE_OP_GEN_RENDERBUFFERS,
+	CAPTURE_OP_GEN_TEXTURES,
+	CAPTURE_OP_LINK_PROGRAM, // program; CAPTURE_LINK_ENTRY_T list of active attributes and uniforms
+	CAPTURE_OP_PIXEL_STOREI,
+	CAPTURE_OP_READ_PIXELS, // x, y, width, height, format, type; pixels are not recorded
+	CAPTURE_OP_RENDERBUFFER_STORAGE,
+	CAPTURE_OP_SCISSOR,
+	CAPTURE_OP_SHADER_SOURCE, // shader; the strings concatenated
+	CAPTURE_OP_TEX_IMAGE_2D, // target, level, internalformat, width, height, border, format, type, has_data; data
+	CAPTURE_OP_TEX_PARAMETERI,
+	CAPTURE_OP_TEX_SUB_IMAGE_2D, // target, level, x, y, width, height, format, type; data
+	CAPTURE_OP_UNIFORM_1F,
+	CAPTURE_OP_UNIFORM_1I,
+	CAPTURE_OP_UNIFORM_2FV, // location, count; values
+	CAPTURE_OP_UNIFORM_4FV, // location, count; values
+	CAPTURE_OP_USE_PROGRAM,
+	CAPTURE_OP_VERTEX_ATTRIB_POINTER, // index, size, type, normalized, stride, offset into GL_ARRAY_BUFFER
+	CAPTURE_OP_VIEWPORT,
+	CAPTURE_OP_COUNT
+} CAPTURE_OP_T;
+
+// Link record data: one entry per active attribute and uniform, name_bytes of zero
+// terminated name follow each entry, padded to 4 bytes
+#define CAPTURE_LINK_ATTRIB 0
+#define CAPTURE_LINK_UNIFORM 1
+
+typedef struct
+{
+	uint32_t kind; // CAPTURE_LINK_ATTRIB or CAPTURE_LINK_UNIFORM
+	int32_t location; // As captured
+	uint32_t name_bytes; // Including the terminator, before padding
+} CAPTURE_LINK_ENTRY_T;
+
+#ifdef GL_CAPTURE
+#define CAPTURE_AVAILABLE 1
+
+int capture_start(const char *path);
+void capture_set_surface(uint32_t width, uint32_t height, uint32_t depth_bits, uint32_t stencil_bits, uint32_t flags);
+void capture_setup_done(void);
+void capture_frame(int presented);
+int capture_stop(void);
+uint32_t capture_frames(void);
+uint64_t capture_bytes(void);
+#else
+#define CAPTURE_AVAILABLE 0
+
+static inline int capture_start(const char *path) { return -1; }
+static inline void capture_set_surface(uint32_t width, uint32_t height, uint32_t depth_bits, uint32_t stencil_bits, uint32_t flags) {}
+static inline void capture_setup_done(void) {}
+static inline void capture_frame(int presented) {}
+static inline int capture_stop(void) { return 0; }
+static inline uint32_t capture_frames(void) { return 0; }
+static inline uint64_t capture_bytes(void) { return 0; }
+#endif
+
+#endif
@@ -0,0 +1,80 @@
+/***********************************************************
+ * File: check.c
+ *
+ * Description:
+ *   GL error reporting for the check()/check_frame() macros. See check.h.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "check.h"
+
+int gl_check_mode = GL_CHECK_MODE;
+unsigned gl_check_errors = 0;
+
+static const char *gl_error_name(GLenum error)
+{
+	switch (error)
+	{
+		case GL_INVALID_ENUM: return "GL_INVALID_ENUM";
+		case GL_INVALID_VALUE: return "GL_INVALID_VALUE";
+		case GL_INVALID_OPERATION: return "GL_INVALID_OPERATION";
+		case GL_INVALID_FRAMEBUFFER_OPERATION: return "GL_INVALID_FRAMEBUFFER_OPERATION";
+		case GL_OUT_OF_MEMORY: return "GL_OUT_OF_MEMORY";
+		default: return "unknown";
+	}
+}
+
+/***********************************************************
+ * Name: gl_check_set_mode
+ *
+ * Arguments:
+ *   int mode = GL_CHECK_OFF, GL_CHECK_SAMPLED or GL_CHECK_STRICT
+ *
+ * Description:
+ *   Selects the runtime checking mode, clamped to what this build compiled in
+ *
+ * Returns:
+ *   int = the mode actually in effect
+ *
+ ***********************************************************/
+int gl_check_set_mode(int mode)
+{
+	if (mode < GL_CHECK_OFF) mode = GL_CHECK_OFF;
+	if (mode > GL_CHECK_MODE) mode = GL_CHECK_MODE;
+	gl_check_mode = mode;
+	return mode;
+}
+
+/***********************************************************
+ * Name: gl_check_report
+ *
+ * Arguments:
+ *   const char *file = source file of the check
+ *   int line = source line of the check
+ *
+ * Description:
+ *   Drains every pending GL error flag and reports each one. In strict mode the first
+ *   error is fatal, matching the old assert() in debug builds; in sampled mode errors
+ *   are only reported, since the failing call could be anywhere in the frame.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void gl_check_report(const char *file, int line)
+{
+	GLenum error;
+	int found = 0;
+
+	// Bounded, because a lost context can keep returning errors
+	for (int i = 0; i < 16 && (error = glGetError()) != GL_NO_ERROR; i++)
+	{
+		fprintf(stderr, "%s:%d: GL error 0x%04x (%s)%s\n", file, line, error, gl_error_name(error),
+			gl_check_mode == GL_CHECK_STRICT ? "" : " since the previous frame check");
+		gl_check_errors++;
+		found = 1;
+	}
+	if (found && gl_check_mode == GL_CHECK_STRICT) abort();
+}
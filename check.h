@@ -0,0 +1,49 @@
+/***********************************************************
+ * File: check.h
+ *
+ * Description:
+ *   GL error checking shared by every module that issues GL calls. glGetError() is a
+ *   driver round-trip on the Pi, so there are three modes:
+ *
+ *     GL_CHECK_OFF      No glGetError() at all, check() compiles to nothing
+ *     GL_CHECK_SAMPLED  check_frame() polls once per frame and reports what it finds
+ *     GL_CHECK_STRICT   check() polls after every call site, reports file/line and aborts
+ *
+ *   GL_CHECK_MODE is the build-time ceiling (make release / make / make debug) and
+ *   gl_check_mode selects a mode at runtime within it. Unlike the old assert() the
+ *   behaviour does not depend on NDEBUG.
+ *
+ ***********************************************************/
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include "GLES2/gl2.h"
+
+#define GL_CHECK_OFF 0
+#define GL_CHECK_SAMPLED 1
+#define GL_CHECK_STRICT 2
+
+#ifndef GL_CHECK_MODE
+#define GL_CHECK_MODE GL_CHECK_SAMPLED
+#endif
+
+extern int gl_check_mode; // Runtime mode, never above GL_CHECK_MODE
+extern unsigned gl_check_errors; // GL errors seen so far
+
+int gl_check_set_mode(int mode);
+void gl_check_report(const char *file, int line);
+
+#if GL_CHECK_MODE == GL_CHECK_STRICT
+#define check() do { if (gl_check_mode == GL_CHECK_STRICT) gl_check_report(__FILE__, __LINE__); } while (0)
+#else
+#define check() ((void)0)
+#endif
+
+#if GL_CHECK_MODE != GL_CHECK_OFF
+#define check_frame() do { if (gl_check_mode != GL_CHECK_OFF) gl_check_report(__FILE__, __LINE__); } while (0)
+#else
+#define check_frame() ((void)0)
+#endif
+
+#endif
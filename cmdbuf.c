@@ -0,0 +1,224 @@
+/***********************************************************
+ * File: cmdbuf.c
+ *
+ * Description:
+ *   Per-thread command recording and sorted replay. See cmdbuf.h.
+ *
+ ***********************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "cmdbuf.h"
+
+#define CMD_KEY_BITS 21
+#define CMD_KEY_MASK ((1u << CMD_KEY_BITS) - 1)
+
+#define CMD_DRAW_SIZE ((sizeof(CMD_DRAW_T) + CMD_ALIGNMENT - 1) & ~(size_t)(CMD_ALIGNMENT - 1))
+
+/***********************************************************
+ * Name: cmd_sort_key
+ *
+ * Arguments:
+ *   GLuint program, GLuint texture, GLuint buffer = state the draw needs
+ *
+ * Description:
+ *   Packs the state into one integer whose order groups draws by program first, then
+ *   by texture, then by buffer, matching how expensive each change is on VideoCore.
+ *   GL names are small integers handed out in order, so 21 bits each is plenty.
+ *
+ * Returns:
+ *   uint64_t = sort key
+ *
+ ***********************************************************/
+uint64_t cmd_sort_key(GLuint program, GLuint texture, GLuint buffer)
+{
+	return ((uint64_t)(program & CMD_KEY_MASK) << (2 * CMD_KEY_BITS)) |
+		((uint64_t)(texture & CMD_KEY_MASK) << CMD_KEY_BITS) |
+		(uint64_t)(buffer & CMD_KEY_MASK);
+}
+
+/***********************************************************
+ * Name: cmd_list_begin
+ *
+ * Arguments:
+ *   CMD_LIST_T *list = list to start recording into
+ *   void *base = CMD_ALIGNMENT-aligned storage, NULL records nothing
+ *   uint32_t capacity = bytes at base
+ *
+ * Description:
+ *   Empties the list and points it at fresh storage. Recording never allocates, a
+ *   full list drops commands and counts them in overflow.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void cmd_list_begin(CMD_LIST_T *list, void *base, uint32_t capacity)
+{
+	list->base = base;
+	list->capacity = base ? capacity : 0;
+	list->used = 0;
+	list->count = 0;
+	list->overflow = 0;
+}
+
+/***********************************************************
+ * Name: cmd_draw
+ *
+ * Arguments:
+ *   CMD_LIST_T *list = list to record into
+ *   const CMD_PIPELINE_T *pipeline = program and vertex layout
+ *   GLuint texture = texture bound to unit 0, or 0
+ *   GLuint buffer = vertex buffer the layout's offsets refer to
+ *   uint32_t sequence = position of the draw in scene order, breaks ties between equal keys
+ *   GLsizei uniform_vectors = vec4s of per-draw uniform data to reserve, or 0
+ *
+ * Description:
+ *   Appends an opaque draw command. The caller fills in mode, first, count and, if
+ *   reserved, uniform_location and the data at cmd_uniforms(), and translucent when
+ *   it applies. Safe to call from any thread that owns the list.
+ *
+ * Returns:
+ *   CMD_DRAW_T * = the new command, or NULL if the arena is full
+ *
+ ***********************************************************/
+CMD_DRAW_T *cmd_draw(CMD_LIST_T *list, const CMD_PIPELINE_T *pipeline, GLuint texture, GLuint buffer, uint32_t sequence, GLsizei uniform_vectors)
+{
+	uint32_t size = CMD_DRAW_SIZE + uniform_vectors * 4 * sizeof(GLfloat);
+	if (size > list->capacity - list->used)
+	{
+		list->overflow++;
+		return NULL;
+	}
+
+	CMD_DRAW_T *draw = (CMD_DRAW_T *)(list->base + list->used);
+	list->used += size;
+	list->count++;
+
+	draw->key = cmd_sort_key(pipeline->program, texture, buffer);
+	draw->sequence = sequence;
+	draw->size = size;
+	draw->pipeline = pipeline;
+	draw->texture = texture;
+	draw->buffer = buffer;
+	draw->mode = GL_TRIANGLES;
+	draw->first = 0;
+	draw->count = 0;
+	draw->uniform_location = -1;
+	draw->uniform_vectors = uniform_vectors;
+	draw->translucent = 0;
+	return draw;
+}
+
+GLfloat *cmd_uniforms(CMD_DRAW_T *draw)
+{
+	return (GLfloat *)((uint8_t *)draw + CMD_DRAW_SIZE);
+}
+
+void cmd_queue_init(CMD_QUEUE_T *queue)
+{
+	memset(queue, 0, sizeof(*queue));
+}
+
+// Opaque by state then recording order, then translucent in recording order alone
+static int cmd_compare(const void *a, const void *b)
+{
+	const CMD_DRAW_T *x = *(const CMD_DRAW_T * const *)a;
+	const CMD_DRAW_T *y = *(const CMD_DRAW_T * const *)b;
+	if (x->translucent != y->translucent) return x->translucent ? 1 : -1;
+	if (!x->translucent && x->key != y->key) return x->key < y->key ? -1 : 1;
+	if (x->sequence != y->sequence) return x->sequence < y->sequence ? -1 : 1;
+	return 0;
+}
+
+/***********************************************************
+ * Name: cmd_submit
+ *
+ * Arguments:
+ *   CMD_QUEUE_T *queue = sort scratch and statistics
+ *   GL_CACHE_T *cache = state cache every bind goes through
+ *   CMD_LIST_T *lists = recorded lists, all recording must have finished
+ *   uint32_t list_count = number of lists
+ *
+ * Description:
+ *   Gathers the draws from every list, sorts them opaque first by state key and
+ *   recording order, then translucent in recording order, and issues them. Blending is
+ *   set through the cache on every draw, so it only reaches the driver where the sorted
+ *   order crosses into translucent draws. Must be called on the thread that owns the GL
+ *   context. The lists are left untouched; reset them before recording the next frame.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void cmd_submit(CMD_QUEUE_T *queue, GL_CACHE_T *cache, CMD_LIST_T *lists, uint32_t list_count)
+{
+	uint32_t total = 0, n = 0;
+	for (uint32_t l = 0; l < list_count; l++) total += lists[l].count;
+
+	queue->draws = 0;
+	queue->program_changes = 0;
+	queue->texture_changes = 0;
+	queue->buffer_changes = 0;
+	queue->blend_changes = 0;
+	if (!total) return;
+
+	if (total > queue->capacity)
+	{
+		CMD_DRAW_T **sorted = realloc(queue->sorted, total * sizeof(CMD_DRAW_T *));
+		if (!sorted) return;
+		queue->sorted = sorted;
+		queue->capacity = total;
+	}
+
+	for (uint32_t l = 0; l < list_count; l++)
+	{
+		uint8_t *p = lists[l].base;
+		for (uint32_t i = 0; i < lists[l].count; i++)
+		{
+			queue->sorted[n++] = (CMD_DRAW_T *)p;
+			p += ((CMD_DRAW_T *)p)->size;
+		}
+	}
+	qsort(queue->sorted, n, sizeof(CMD_DRAW_T *), cmd_compare);
+
+	const CMD_DRAW_T *previous = NULL;
+	for (uint32_t i = 0; i < n; i++)
+	{
+		CMD_DRAW_T *draw = queue->sorted[i];
+		const CMD_PIPELINE_T *pipeline = draw->pipeline;
+
+		if (!previous || previous->pipeline->program != pipeline->program) queue->program_changes++;
+		if (!previous || previous->texture != draw->texture) queue->texture_changes++;
+		if (!previous || previous->buffer != draw->buffer) queue->buffer_changes++;
+		if (!previous || previous->translucent != draw->translucent) queue->blend_changes++;
+
+		// The cache drops everything that matches the previous draw
+		uint32_t enabled = 0;
+		gl_cache_use_program(cache, pipeline->program);
+		gl_cache_bind_texture(cache, draw->texture);
+		gl_cache_bind_buffer(cache, GL_ARRAY_BUFFER, draw->buffer);
+		for (uint32_t a = 0; a < pipeline->attrib_count; a++)
+		{
+			const CMD_ATTRIB_T *attrib = &pipeline->attribs[a];
+			gl_cache_vertex_attrib_pointer(cache, attrib->location, attrib->size, attrib->type, attrib->normalized, attrib->stride, (const void *)(uintptr_t)attrib->offset);
+			enabled |= GL_CACHE_ATTRIB_BIT(attrib->location);
+		}
+		gl_cache_enable_attribs(cache, enabled);
+		gl_cache_blend(cache, draw->translucent ? GL_TRUE : GL_FALSE);
+		if (draw->translucent) gl_cache_blend_func(cache, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+		if (draw->uniform_vectors && draw->uniform_location >= 0) glUniform4fv(draw->uniform_location, draw->uniform_vectors, cmd_uniforms(draw));
+		glDrawArrays(draw->mode, draw->first, draw->count);
+		previous = draw;
+	}
+	queue->draws = n;
+	check();
+}
+
+void cmd_queue_destroy(CMD_QUEUE_T *queue)
+{
+	free(queue->sorted);
+	memset(queue, 0, sizeof(*queue));
+}
@@ -0,0 +1,98 @@
+/***********************************************************
+ * File: cmdbuf.h
+ *
+ * Description:
+ *   Deferred draw commands. GLES2 contexts are single-threaded, so scene traversal on
+ *   worker threads records self-contained draw commands into per-thread linear arenas
+ *   (CMD_LIST_T) without touching GL. The GL thread then gathers every list, sorts the
+ *   draws by program, then texture, then buffer, and replays them through the state
+ *   cache so each state change is issued once per run of matching draws.
+ *
+ *   Opaque draws go first, sorted by state. Translucent draws follow in recording
+ *   order, which callers make back to front, with blending enabled once at the
+ *   boundary rather than per draw.
+ *
+ *   A list must only be written by one thread at a time, and lists must not be written
+ *   while cmd_submit() reads them.
+ *
+ ***********************************************************/
+
+#ifndef CMDBUF_H
+#define CMDBUF_H
+
+#include <stdint.h>
+#include "GLES2/gl2.h"
+#include "gl_cache.h"
+
+#define CMD_MAX_PIPELINE_ATTRIBS 4
+#define CMD_ALIGNMENT 8 // Commands and their uniform payloads start on this boundary
+
+typedef struct
+{
+	GLint location; // Negative locations are skipped
+	GLint size;
+	GLenum type;
+	GLboolean normalized;
+	GLsizei stride;
+	uint32_t offset; // Byte offset into the draw's buffer
+} CMD_ATTRIB_T;
+
+// Program plus vertex layout shared by many draws. Owned by the recorder and must stay
+// unchanged until the commands that reference it have been submitted.
+typedef struct
+{
+	GLuint program;
+	uint32_t attrib_count;
+	CMD_ATTRIB_T attribs[CMD_MAX_PIPELINE_ATTRIBS];
+} CMD_PIPELINE_T;
+
+typedef struct
+{
+	uint64_t key; // State sort key, see cmd_sort_key()
+	uint32_t sequence; // Recording order among draws with the same key
+	uint32_t size; // Bytes from this command to the next in its list
+	const CMD_PIPELINE_T *pipeline;
+	GLuint texture; // 0 for untextured draws
+	GLuint buffer; // GL_ARRAY_BUFFER the pipeline's attribute offsets refer to
+	GLenum mode;
+	GLint first;
+	GLsizei count;
+	GLint uniform_location; // vec4 array uploaded before the draw, -1 for none
+	GLsizei uniform_vectors; // Number of vec4s stored after the command
+	uint8_t translucent; // Drawn after every opaque draw, with alpha blending
+} CMD_DRAW_T;
+
+// Storage is borrowed, normally from the frame arena, and must outlive cmd_submit()
+typedef struct
+{
+	uint8_t *base;
+	uint32_t capacity; // Bytes
+	uint32_t used;
+	uint32_t count; // Commands recorded since the last reset
+	uint32_t overflow; // Commands dropped because the arena was full
+} CMD_LIST_T;
+
+typedef struct
+{
+	CMD_DRAW_T **sorted; // Gather and sort scratch, grown as needed
+	uint32_t capacity;
+
+	// Statistics for the most recent cmd_submit()
+	uint32_t draws;
+	uint32_t program_changes;
+	uint32_t texture_changes;
+	uint32_t buffer_changes;
+	uint32_t blend_changes;
+} CMD_QUEUE_T;
+
+uint64_t cmd_sort_key(GLuint program, GLuint texture, GLuint buffer);
+
+void cmd_list_begin(CMD_LIST_T *list, void *base, uint32_t capacity);
+CMD_DRAW_T *cmd_draw(CMD_LIST_T *list, const CMD_PIPELINE_T *pipeline, GLuint texture, GLuint buffer, uint32_t sequence, GLsizei uniform_vectors);
+GLfloat *cmd_uniforms(CMD_DRAW_T *draw);
+
+void cmd_queue_init(CMD_QUEUE_T *queue);
+void cmd_submit(CMD_QUEUE_T *queue, GL_CACHE_T *cache, CMD_LIST_T *lists, uint32_t list_count);
+void cmd_queue_destroy(CMD_QUEUE_T *queue);
+
+#endif
@@ -0,0 +1,150 @@
+/***********************************************************
+ * File: damage.c
+ *
+ * Description:
+ *   Damage bounding box and scissored partial frames. See damage.h.
+ *
+ ***********************************************************/
+
+#include <math.h>
+#include "damage.h"
+
+/***********************************************************
+ * Name: damage_init
+ *
+ * Arguments:
+ *   DAMAGE_T *damage = tracker to initialise
+ *   uint32_t width, uint32_t height = surface size in pixels
+ *   int preserved = the surface keeps its contents across swaps
+ *
+ * Description:
+ *   Starts with the whole surface damaged, so the first frame is always drawn
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void damage_init(DAMAGE_T *damage, uint32_t width, uint32_t height, int preserved)
+{
+	damage->width = width;
+	damage->height = height;
+	damage->preserved = preserved;
+	damage->full = 1;
+	damage->x0 = damage->y0 = damage->x1 = damage->y1 = 0;
+	damage->mode = DAMAGE_NONE;
+	damage->full_frames = damage->partial_frames = damage->skipped = 0;
+}
+
+void damage_all(DAMAGE_T *damage)
+{
+	damage->full = 1;
+}
+
+// The drawn area changed size, e.g. a new render scale, so nothing on screen can be kept
+void damage_resize(DAMAGE_T *damage, uint32_t width, uint32_t height)
+{
+	damage->width = width;
+	damage->height = height;
+	damage->full = 1;
+	damage->x0 = damage->y0 = damage->x1 = damage->y1 = 0;
+}
+
+/***********************************************************
+ * Name: damage_add
+ *
+ * Arguments:
+ *   DAMAGE_T *damage = tracker to update
+ *   int32_t x, int32_t y, int32_t width, int32_t height = changed rectangle in GL
+ *     window coordinates, clipped to the surface
+ *
+ * Description:
+ *   Grows the damage bounding box to include the rectangle
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void damage_add(DAMAGE_T *damage, int32_t x, int32_t y, int32_t width, int32_t height)
+{
+	int32_t x0 = x < 0 ? 0 : x, y0 = y < 0 ? 0 : y;
+	int32_t x1 = x + width > (int32_t)damage->width ? (int32_t)damage->width : x + width;
+	int32_t y1 = y + height > (int32_t)damage->height ? (int32_t)damage->height : y + height;
+	if (x0 >= x1 || y0 >= y1) return;
+
+	if (damage->x0 >= damage->x1)
+	{
+		damage->x0 = x0;
+		damage->y0 = y0;
+		damage->x1 = x1;
+		damage->y1 = y1;
+		return;
+	}
+	if (x0 < damage->x0) damage->x0 = x0;
+	if (y0 < damage->y0) damage->y0 = y0;
+	if (x1 > damage->x1) damage->x1 = x1;
+	if (y1 > damage->y1) damage->y1 = y1;
+}
+
+// Clip-space rectangle, grown by a pixel so edge pixels touched by filtering are included
+void damage_add_clip(DAMAGE_T *damage, GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1)
+{
+	int32_t left = (int32_t)floorf((x0 * 0.5f + 0.5f) * damage->width) - 1;
+	int32_t bottom = (int32_t)floorf((y0 * 0.5f + 0.5f) * damage->height) - 1;
+	int32_t right = (int32_t)ceilf((x1 * 0.5f + 0.5f) * damage->width) + 1;
+	int32_t top = (int32_t)ceilf((y1 * 0.5f + 0.5f) * damage->height) + 1;
+	damage_add(damage, left, bottom, right - left, top - bottom);
+}
+
+int damage_pending(const DAMAGE_T *damage)
+{
+	return damage->full || damage->x0 < damage->x1;
+}
+
+/***********************************************************
+ * Name: damage_begin_frame
+ *
+ * Arguments:
+ *   DAMAGE_T *damage = tracker holding the damage since the last frame
+ *
+ * Description:
+ *   Decides how the next frame is drawn and consumes the damage. For a partial frame
+ *   the scissor test is enabled around the damage, so the clear and every draw only
+ *   touch the pixels that change; damage_end_frame() disables it again before the swap.
+ *
+ * Returns:
+ *   DAMAGE_MODE_T = DAMAGE_NONE to skip the frame, otherwise how it is drawn
+ *
+ ***********************************************************/
+DAMAGE_MODE_T damage_begin_frame(DAMAGE_T *damage)
+{
+	if (!damage_pending(damage))
+	{
+		damage->skipped++;
+		return damage->mode = DAMAGE_NONE;
+	}
+
+	uint64_t area = (uint64_t)(damage->x1 - damage->x0) * (damage->y1 - damage->y0);
+	int partial = !damage->full && damage->preserved &&
+		area * 100 <= (uint64_t)damage->width * damage->height * DAMAGE_FULL_PERCENT;
+	if (partial)
+	{
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(damage->x0, damage->y0, damage->x1 - damage->x0, damage->y1 - damage->y0);
+		damage->partial_frames++;
+		damage->mode = DAMAGE_PARTIAL;
+	}
+	else
+	{
+		damage->full_frames++;
+		damage->mode = DAMAGE_FULL;
+	}
+
+	damage->full = 0;
+	damage->x0 = damage->y0 = damage->x1 = damage->y1 = 0;
+	return damage->mode;
+}
+
+void damage_end_frame(DAMAGE_T *damage)
+{
+	if (damage->mode == DAMAGE_PARTIAL) glDisable(GL_SCISSOR_TEST);
+}
@@ -0,0 +1,59 @@
+/***********************************************************
+ * File: damage.h
+ *
+ * Description:
+ *   Damage tracking for mostly static screens. Scenes report the parts of the surface
+ *   they changed, and the render loop only starts a frame when something is damaged.
+ *   Frames with small damage are drawn under a scissor covering the bounding rectangle
+ *   of the changes, which needs the back buffer to survive the swap
+ *   (EGL_BUFFER_PRESERVED); without that every damaged frame is a full redraw.
+ *
+ *   GLES2 has a single scissor rectangle, so damage is kept as one bounding box rather
+ *   than a list of regions.
+ *
+ ***********************************************************/
+
+#ifndef DAMAGE_H
+#define DAMAGE_H
+
+#include <stdint.h>
+#include "GLES2/gl2.h"
+
+#define DAMAGE_IDLE_US 4000 // Sleep between checks while nothing is damaged
+#define DAMAGE_FULL_PERCENT 75 // Partial damage above this share of the surface is drawn in full
+
+typedef enum
+{
+	DAMAGE_NONE, // Nothing changed, skip the frame
+	DAMAGE_PARTIAL, // Draw under the scissor set by damage_begin_frame()
+	DAMAGE_FULL // Redraw everything
+} DAMAGE_MODE_T;
+
+typedef struct
+{
+	uint32_t width; // Surface size in pixels
+	uint32_t height;
+	int preserved; // Back buffer contents survive the swap, so partial frames are possible
+
+	// Damage since the last frame, in GL window coordinates (origin bottom-left)
+	int full;
+	int32_t x0, y0, x1, y1; // Bounding box, empty when x0 >= x1
+
+	DAMAGE_MODE_T mode; // Of the frame in progress
+
+	// Statistics
+	uint32_t full_frames;
+	uint32_t partial_frames;
+	uint32_t skipped; // Idle checks that found nothing to draw
+} DAMAGE_T;
+
+void damage_init(DAMAGE_T *damage, uint32_t width, uint32_t height, int preserved);
+void damage_all(DAMAGE_T *damage);
+void damage_resize(DAMAGE_T *damage, uint32_t width, uint32_t height);
+void damage_add(DAMAGE_T *damage, int32_t x, int32_t y, int32_t width, int32_t height);
+void damage_add_clip(DAMAGE_T *damage, GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1);
+int damage_pending(const DAMAGE_T *damage);
+DAMAGE_MODE_T damage_begin_frame(DAMAGE_T *damage);
+void damage_end_frame(DAMAGE_T *damage);
+
+#endif
@@ -0,0 +1,275 @@
+/***********************************************************
+ * File: etc1.c
+ *
+ * Description:
+ *   ETC1 block encoder and PKM writer. See etc1.h.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "etc1.h"
+
+const uint8_t etc1_ktx_identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+// Intensity modifiers, indexed by table then by the 2-bit pixel index (msb, lsb)
+static const int etc1_modifiers[8][4] = {
+	{ 2, 8, -2, -8 },
+	{ 5, 17, -5, -17 },
+	{ 9, 29, -9, -29 },
+	{ 13, 42, -13, -42 },
+	{ 18, 60, -18, -60 },
+	{ 24, 80, -24, -80 },
+	{ 33, 106, -33, -106 },
+	{ 47, 183, -47, -183 }
+};
+
+typedef struct
+{
+	uint32_t error; // Sum of squared channel differences
+	int base[2][3]; // Quantised base colours as stored, 4 or 5 bits
+	uint32_t table[2];
+	uint8_t index[16]; // Pixel indices in block order y * 4 + x
+	int differential;
+	int flip;
+} ETC1_FIT_T;
+
+static int clamp_byte(int value)
+{
+	return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+uint32_t etc1_image_bytes(uint32_t width, uint32_t height)
+{
+	return ((width + 3) / 4) * ((height + 3) / 4) * ETC1_BLOCK_BYTES;
+}
+
+/***********************************************************
+ * Name: etc1_fit_subblock
+ *
+ * Arguments:
+ *   const uint8_t block[16][3] = block pixels, y * 4 + x
+ *   const uint8_t members[8] = the sub-block's pixel positions in block
+ *   const int base[3] = 8-bit base colour
+ *   uint32_t *table = receives the best modifier table
+ *   uint8_t index[16] = receives the members' pixel indices
+ *
+ * Description:
+ *   Tries every modifier table against the base colour, picking the closest modifier
+ *   for each pixel
+ *
+ * Returns:
+ *   uint32_t = squared error of the best table
+ *
+ ***********************************************************/
+static uint32_t etc1_fit_subblock(const uint8_t block[16][3], const uint8_t members[8], const int base[3], uint32_t *table, uint8_t index[16])
+{
+	uint32_t best = UINT32_MAX;
+	for (uint32_t t = 0; t < 8; t++)
+	{
+		uint32_t error = 0;
+		uint8_t chosen[8];
+		for (int p = 0; p < 8 && error < best; p++)
+		{
+			const uint8_t *pixel = block[members[p]];
+			uint32_t pixel_best = UINT32_MAX;
+			for (int m = 0; m < 4; m++)
+			{
+				uint32_t e = 0;
+				for (int c = 0; c < 3; c++)
+				{
+					int d = clamp_byte(base[c] + etc1_modifiers[t][m]) - pixel[c];
+					e += d * d;
+				}
+				if (e < pixel_best)
+				{
+					pixel_best = e;
+					chosen[p] = m;
+				}
+			}
+			error += pixel_best;
+		}
+		if (error < best)
+		{
+			best = error;
+			*table = t;
+			for (int p = 0; p < 8; p++) index[members[p]] = chosen[p];
+		}
+	}
+	return best;
+}
+
+static void etc1_try(const uint8_t block[16][3], const uint8_t members[2][8], const int base[2][3], int bits, int flip, ETC1_FIT_T *best)
+{
+	ETC1_FIT_T fit;
+	fit.error = 0;
+	fit.differential = bits == 5;
+	fit.flip = flip;
+	for (int s = 0; s < 2; s++)
+	{
+		int expanded[3];
+		for (int c = 0; c < 3; c++)
+		{
+			fit.base[s][c] = base[s][c];
+			expanded[c] = bits == 5 ? (base[s][c] << 3) | (base[s][c] >> 2) : (base[s][c] << 4) | base[s][c];
+		}
+		fit.error += etc1_fit_subblock(block, members[s], expanded, &fit.table[s], fit.index);
+	}
+	if (fit.error < best->error) *best = fit;
+}
+
+/***********************************************************
+ * Name: etc1_encode_block
+ *
+ * Arguments:
+ *   const uint8_t block[16][3] = RGB pixels, y * 4 + x
+ *   uint8_t *out = receives ETC1_BLOCK_BYTES
+ *
+ * Description:
+ *   Splits the block into two 2x4 or two 4x2 halves and gives each half the average
+ *   of its pixels as base colour, in the individual (4-bit) mode and, when the two
+ *   averages are close enough, in the differential (5-bit plus delta) mode. The
+ *   combination with the smallest error is stored.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void etc1_encode_block(const uint8_t block[16][3], uint8_t *out)
+{
+	ETC1_FIT_T best;
+	best.error = UINT32_MAX;
+
+	for (int flip = 0; flip < 2; flip++)
+	{
+		// Without flip the halves are the left and right columns, with flip the top and bottom rows
+		uint8_t members[2][8];
+		int counts[2] = { 0, 0 };
+		for (int y = 0; y < 4; y++)
+			for (int x = 0; x < 4; x++)
+			{
+				int s = flip ? y >= 2 : x >= 2;
+				members[s][counts[s]++] = y * 4 + x;
+			}
+
+		int sum[2][3] = { { 0, 0, 0 }, { 0, 0, 0 } };
+		for (int s = 0; s < 2; s++)
+			for (int p = 0; p < 8; p++)
+				for (int c = 0; c < 3; c++) sum[s][c] += block[members[s][p]][c];
+
+		int individual[2][3], differential[2][3];
+		int fits = 1;
+		for (int s = 0; s < 2; s++)
+			for (int c = 0; c < 3; c++)
+			{
+				individual[s][c] = (sum[s][c] * 15 + 8 * 255 / 2) / (8 * 255);
+				differential[s][c] = (sum[s][c] * 31 + 8 * 255 / 2) / (8 * 255);
+			}
+		for (int c = 0; c < 3; c++)
+		{
+			int delta = differential[1][c] - differential[0][c];
+			if (delta < -4 || delta > 3) fits = 0;
+		}
+
+		etc1_try(block, members, individual, 4, flip, &best);
+		if (fits) etc1_try(block, members, differential, 5, flip, &best);
+	}
+
+	// Base colours, then tables and mode bits, then the index planes
+	for (int c = 0; c < 3; c++)
+	{
+		if (best.differential) out[c] = (uint8_t)((best.base[0][c] << 3) | ((best.base[1][c] - best.base[0][c]) & 7));
+		else out[c] = (uint8_t)((best.base[0][c] << 4) | best.base[1][c]);
+	}
+	out[3] = (uint8_t)((best.table[0] << 5) | (best.table[1] << 2) | (best.differential << 1) | best.flip);
+
+	// Index bits are stored column-major, x * 4 + y, msb plane above the lsb plane
+	uint32_t planes = 0;
+	for (int y = 0; y < 4; y++)
+		for (int x = 0; x < 4; x++)
+		{
+			uint32_t i = x * 4 + y, value = best.index[y * 4 + x];
+			planes |= ((value >> 1) << (16 + i)) | ((value & 1) << i);
+		}
+	out[4] = (uint8_t)(planes >> 24);
+	out[5] = (uint8_t)(planes >> 16);
+	out[6] = (uint8_t)(planes >> 8);
+	out[7] = (uint8_t)planes;
+}
+
+/***********************************************************
+ * Name: etc1_encode_image
+ *
+ * Arguments:
+ *   const uint8_t *pixels = tightly packed rows, top row first
+ *   uint32_t width, uint32_t height = image size, need not be multiples of 4
+ *   uint32_t pixel_bytes = 1 (luminance), 3 (RGB) or 4 (RGBA, alpha is dropped)
+ *   uint8_t *blocks = receives etc1_image_bytes(width, height) bytes
+ *
+ * Description:
+ *   Compresses an image block by block in row order, as glCompressedTexImage2D expects.
+ *   Partial edge blocks repeat the last row and column.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void etc1_encode_image(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t pixel_bytes, uint8_t *blocks)
+{
+	uint8_t block[16][3];
+	for (uint32_t by = 0; by < height; by += 4)
+		for (uint32_t bx = 0; bx < width; bx += 4)
+		{
+			for (uint32_t y = 0; y < 4; y++)
+				for (uint32_t x = 0; x < 4; x++)
+				{
+					uint32_t px = bx + x < width ? bx + x : width - 1;
+					uint32_t py = by + y < height ? by + y : height - 1;
+					const uint8_t *p = pixels + ((size_t)py * width + px) * pixel_bytes;
+					for (int c = 0; c < 3; c++) block[y * 4 + x][c] = pixel_bytes < 3 ? p[0] : p[c];
+				}
+			etc1_encode_block((const uint8_t (*)[3])block, blocks);
+			blocks += ETC1_BLOCK_BYTES;
+		}
+}
+
+static void put_be16(uint8_t *out, uint32_t value)
+{
+	out[0] = (uint8_t)(value >> 8);
+	out[1] = (uint8_t)value;
+}
+
+/***********************************************************
+ * Name: etc1_write_pkm
+ *
+ * Arguments:
+ *   const char *path = file to create
+ *   uint32_t width, uint32_t height = original image size, at most 65535
+ *   const uint8_t *blocks = output of etc1_encode_image()
+ *
+ * Description:
+ *   Writes a version 1.0 PKM file, the container produced by the Android etc1tool
+ *
+ * Returns:
+ *   int = 0 on success, -1 on error
+ *
+ ***********************************************************/
+int etc1_write_pkm(const char *path, uint32_t width, uint32_t height, const uint8_t *blocks)
+{
+	if (!width || !height || width > 65535 || height > 65535) return -1;
+
+	uint8_t header[ETC1_PKM_HEADER_BYTES];
+	memcpy(header, "PKM 10", 6);
+	put_be16(header + 6, ETC1_PKM_TYPE_RGB);
+	put_be16(header + 8, (width + 3) & ~3u);
+	put_be16(header + 10, (height + 3) & ~3u);
+	put_be16(header + 12, width);
+	put_be16(header + 14, height);
+
+	FILE *file = fopen(path, "wb");
+	if (!file) return -1;
+	uint32_t bytes = etc1_image_bytes(width, height);
+	int ok = fwrite(header, 1, sizeof(header), file) == sizeof(header) && fwrite(blocks, 1, bytes, file) == bytes;
+	if (fclose(file) != 0) ok = 0;
+	return ok ? 0 : -1;
+}
@@ -0,0 +1,42 @@
+/***********************************************************
+ * File: etc1.h
+ *
+ * Description:
+ *   ETC1 (GL_OES_compressed_ETC1_RGB8_texture) block compression and the PKM and KTX
+ *   container layouts. ETC1 stores every 4x4 block of RGB pixels in 8 bytes, half a
+ *   byte per pixel, against 3 for RGB8 and 4 for RGBA8, and the VideoCore IV samples
+ *   it directly. There is no alpha channel.
+ *
+ *   The encoder is a straightforward exhaustive search of both block flips, both base
+ *   colour modes and all eight modifier tables. It is meant for offline tools such as
+ *   atlaspack.bin, not for use at run time.
+ *
+ ***********************************************************/
+
+#ifndef ETC1_H
+#define ETC1_H
+
+#include <stdint.h>
+
+#ifndef GL_ETC1_RGB8_OES
+#define GL_ETC1_RGB8_OES 0x8D64
+#endif
+
+#define ETC1_BLOCK_BYTES 8 // One 4x4 pixel block
+
+// PKM: 16-byte big-endian header followed by the blocks of a single level
+#define ETC1_PKM_HEADER_BYTES 16
+#define ETC1_PKM_TYPE_RGB 0 // ETC1_RGB_NO_MIPMAPS
+
+// KTX 1.1: identifier, 13 uint32 header fields, key/value data, then per level a
+// uint32 image size and the level's data
+#define ETC1_KTX_HEADER_BYTES 64
+#define ETC1_KTX_ENDIANNESS 0x04030201
+
+extern const uint8_t etc1_ktx_identifier[12];
+
+uint32_t etc1_image_bytes(uint32_t width, uint32_t height);
+void etc1_encode_image(const uint8_t *pixels, uint32_t width, uint32_t height, uint32_t pixel_bytes, uint8_t *blocks);
+int etc1_write_pkm(const char *path, uint32_t width, uint32_t height, const uint8_t *blocks);
+
+#endif
@@ -0,0 +1,189 @@
+/***********************************************************
+ * File: frame_clock.c
+ *
+ * Description:
+ *   Monotonic frame clock and log-bucketed histogram. See frame_clock.h.
+ *
+ ***********************************************************/
+
+#include <string.h>
+#include <time.h>
+#include "frame_clock.h"
+
+static uint32_t bucket_index(uint32_t value)
+{
+	if (value < HISTOGRAM_SUB_COUNT) return value;
+
+	uint32_t exponent = 31 - __builtin_clz(value);
+	uint32_t sub = (value >> (exponent - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_COUNT - 1);
+	return (exponent - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT + sub;
+}
+
+static uint32_t bucket_value(uint32_t index)
+{
+	// Middle of the range of values that map to this bucket
+	if (index < HISTOGRAM_SUB_COUNT) return index;
+
+	uint32_t exponent = index / HISTOGRAM_SUB_COUNT + HISTOGRAM_SUB_BITS - 1;
+	uint32_t sub = index % HISTOGRAM_SUB_COUNT;
+	uint32_t shift = exponent - HISTOGRAM_SUB_BITS;
+	uint32_t lowest = (HISTOGRAM_SUB_COUNT + sub) << shift;
+	return lowest + (((1u << shift) - 1) >> 1);
+}
+
+void histogram_reset(HISTOGRAM_T *hist)
+{
+	memset(hist, 0, sizeof(*hist));
+	hist->min = UINT32_MAX;
+}
+
+void histogram_record(HISTOGRAM_T *hist, uint32_t value)
+{
+	hist->buckets[bucket_index(value)]++;
+	hist->count++;
+	hist->sum += value;
+	if (value < hist->min) hist->min = value;
+	if (value > hist->max) hist->max = value;
+}
+
+void histogram_merge(HISTOGRAM_T *dst, const HISTOGRAM_T *src)
+{
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) dst->buckets[i] += src->buckets[i];
+	dst->count += src->count;
+	dst->sum += src->sum;
+	if (src->min < dst->min) dst->min = src->min;
+	if (src->max > dst->max) dst->max = src->max;
+}
+
+/***********************************************************
+ * Name: histogram_percentile
+ *
+ * Arguments:
+ *   const HISTOGRAM_T *hist = histogram to query
+ *   double percentile = 0 to 100
+ *
+ * Description:
+ *   Nearest-rank percentile, resolved to the representative value of the bucket
+ *   holding that rank and clamped to the exact recorded min/max
+ *
+ * Returns:
+ *   uint32_t = value at the requested percentile, 0 if the histogram is empty
+ *
+ ***********************************************************/
+uint32_t histogram_percentile(const HISTOGRAM_T *hist, double percentile)
+{
+	if (hist->count == 0) return 0;
+
+	uint64_t rank = (uint64_t)(percentile / 100.0 * hist->count + 0.999999);
+	if (rank < 1) rank = 1;
+	if (rank >= hist->count) return hist->max;
+
+	uint64_t seen = 0;
+	for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++)
+	{
+		seen += hist->buckets[i];
+		if (seen >= rank)
+		{
+			uint32_t value = bucket_value(i);
+			if (value < hist->min) value = hist->min;
+			if (value > hist->max) value = hist->max;
+			return value;
+		}
+	}
+	return hist->max;
+}
+
+double histogram_mean(const HISTOGRAM_T *hist)
+{
+	return hist->count ? (double)hist->sum / hist->count : 0.0;
+}
+
+/***********************************************************
+ * Name: frame_clock_now
+ *
+ * Arguments:
+ *   void
+ *
+ * Description:
+ *   Reads CLOCK_MONOTONIC_RAW, which is immune to wall clock steps and NTP slewing
+ *
+ * Returns:
+ *   uint64_t = nanoseconds since an arbitrary fixed point
+ *
+ ***********************************************************/
+uint64_t frame_clock_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/***********************************************************
+ * Name: frame_clock_init
+ *
+ * Arguments:
+ *   FRAME_CLOCK_T *clock = clock to initialise
+ *
+ * Description:
+ *   Clears the histograms and primes the previous-frame timestamp so that the very
+ *   first frame measures a real interval rather than garbage
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void frame_clock_init(FRAME_CLOCK_T *clock)
+{
+	memset(clock, 0, sizeof(*clock));
+	frame_clock_reset_histograms(clock);
+	clock->last_start = frame_clock_now();
+}
+
+/***********************************************************
+ * Name: frame_clock_reset_histograms
+ *
+ * Arguments:
+ *   FRAME_CLOCK_T *clock = clock to clear
+ *
+ * Description:
+ *   Discards the recorded distributions without disturbing the running timestamps,
+ *   e.g. at the end of a benchmark warm-up
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void frame_clock_reset_histograms(FRAME_CLOCK_T *clock)
+{
+	histogram_reset(&clock->frame_hist);
+	histogram_reset(&clock->submit_hist);
+	histogram_reset(&clock->swap_hist);
+}
+
+static uint32_t elapsed_us(uint64_t from, uint64_t to)
+{
+	uint64_t us = (to - from) / 1000;
+	return us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+void frame_clock_begin(FRAME_CLOCK_T *clock)
+{
+	clock->frame_start = frame_clock_now();
+	clock->frame_us = elapsed_us(clock->last_start, clock->frame_start);
+	clock->last_start = clock->frame_start;
+}
+
+void frame_clock_submitted(FRAME_CLOCK_T *clock)
+{
+	clock->submit_end = frame_clock_now();
+	clock->submit_us = elapsed_us(clock->frame_start, clock->submit_end);
+}
+
+void frame_clock_swapped(FRAME_CLOCK_T *clock)
+{
+	clock->swap_us = elapsed_us(clock->submit_end, frame_clock_now());
+
+	histogram_record(&clock->frame_hist, clock->frame_us);
+	histogram_record(&clock->submit_hist, clock->submit_us);
+	histogram_record(&clock->swap_hist, clock->swap_us);
+}
@@ -0,0 +1,62 @@
+/***********************************************************
+ * File: frame_clock.h
+ *
+ * Description:
+ *   Monotonic high-resolution frame clock built on CLOCK_MONOTONIC_RAW, plus a
+ *   log-bucketed (HDR-style) histogram used to keep frame, CPU-submit and swap-wait
+ *   distributions with bounded memory and O(1) recording.
+ *
+ ***********************************************************/
+
+#ifndef FRAME_CLOCK_H
+#define FRAME_CLOCK_H
+
+#include <stdint.h>
+
+// Each power-of-two range is split into 2^HISTOGRAM_SUB_BITS linear sub-buckets,
+// so any recorded value is within about 6% of its bucket's representative value
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS ((32 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT)
+
+typedef struct
+{
+	uint32_t buckets[HISTOGRAM_BUCKETS];
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t sum;
+} HISTOGRAM_T;
+
+void histogram_reset(HISTOGRAM_T *hist);
+void histogram_record(HISTOGRAM_T *hist, uint32_t value);
+void histogram_merge(HISTOGRAM_T *dst, const HISTOGRAM_T *src);
+uint32_t histogram_percentile(const HISTOGRAM_T *hist, double percentile);
+double histogram_mean(const HISTOGRAM_T *hist);
+
+typedef struct
+{
+	// Raw timestamps in nanoseconds
+	uint64_t frame_start; // Top of the current frame
+	uint64_t submit_end; // All GL commands for the frame have been issued
+	uint64_t last_start; // Top of the previous frame
+
+	// Intervals for the most recent frame in microseconds
+	uint32_t frame_us; // Start-to-start time, i.e. the frame period
+	uint32_t submit_us; // CPU time spent issuing GL commands
+	uint32_t swap_us; // Time blocked in eglSwapBuffers waiting for the GPU or display
+
+	// Distributions over the lifetime of the clock
+	HISTOGRAM_T frame_hist;
+	HISTOGRAM_T submit_hist;
+	HISTOGRAM_T swap_hist;
+} FRAME_CLOCK_T;
+
+uint64_t frame_clock_now(void);
+void frame_clock_init(FRAME_CLOCK_T *clock);
+void frame_clock_reset_histograms(FRAME_CLOCK_T *clock);
+void frame_clock_begin(FRAME_CLOCK_T *clock);
+void frame_clock_submitted(FRAME_CLOCK_T *clock);
+void frame_clock_swapped(FRAME_CLOCK_T *clock);
+
+#endif
@@ -0,0 +1,263 @@
+/***********************************************************
+ * File: gl_cache.c
+ *
+ * Description:
+ *   Redundant GL state call elimination. See gl_cache.h.
+ *
+ ***********************************************************/
+
+#include <string.h>
+#include "gl_cache.h"
+
+// Which cached values are known to match the driver
+#define VALID_PROGRAM        (1u << 0)
+#define VALID_ARRAY_BUFFER   (1u << 1)
+#define VALID_ELEMENT_BUFFER (1u << 2)
+#define VALID_ENABLED        (1u << 3)
+#define VALID_BLEND          (1u << 4)
+#define VALID_BLEND_FUNC     (1u << 5)
+#define VALID_VIEWPORT       (1u << 6)
+#define VALID_TEXTURE        (1u << 7)
+#define VALID_ATTRIB(n)      (1u << (8 + (n)))
+
+static int cache_hit(GL_CACHE_T *cache, uint32_t bit, int same)
+{
+	if ((cache->valid & bit) && same)
+	{
+		cache->elided++;
+		return 1;
+	}
+	cache->valid |= bit;
+	cache->issued++;
+	return 0;
+}
+
+/***********************************************************
+ * Name: gl_cache_invalidate
+ *
+ * Arguments:
+ *   GL_CACHE_T *cache = cache to clear
+ *
+ * Description:
+ *   Marks every cached value unknown, e.g. after a new context is made current or after
+ *   code outside the cache has changed state. Counters are preserved.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void gl_cache_invalidate(GL_CACHE_T *cache)
+{
+	cache->valid = 0;
+}
+
+void gl_cache_use_program(GL_CACHE_T *cache, GLuint program)
+{
+	if (cache_hit(cache, VALID_PROGRAM, cache->program == program)) return;
+	cache->program = program;
+	glUseProgram(program);
+}
+
+void gl_cache_bind_buffer(GL_CACHE_T *cache, GLenum target, GLuint buffer)
+{
+	if (target == GL_ELEMENT_ARRAY_BUFFER)
+	{
+		if (cache_hit(cache, VALID_ELEMENT_BUFFER, cache->element_buffer == buffer)) return;
+		cache->element_buffer = buffer;
+	}
+	else
+	{
+		if (cache_hit(cache, VALID_ARRAY_BUFFER, cache->array_buffer == buffer)) return;
+		cache->array_buffer = buffer;
+	}
+	glBindBuffer(target, buffer);
+}
+
+// Only texture unit 0 is used, so the active unit is never changed
+void gl_cache_bind_texture(GL_CACHE_T *cache, GLuint texture)
+{
+	if (cache_hit(cache, VALID_TEXTURE, cache->texture == texture)) return;
+	cache->texture = texture;
+	glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+/***********************************************************
+ * Name: gl_cache_forget_buffer
+ *
+ * Arguments:
+ *   GL_CACHE_T *cache = cache to update
+ *   GLuint buffer = buffer about to be deleted
+ *
+ * Description:
+ *   Deleting a buffer silently unbinds it, so any cached binding or attribute pointer
+ *   that refers to it has to be dropped. Call before glDeleteBuffers.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void gl_cache_forget_buffer(GL_CACHE_T *cache, GLuint buffer)
+{
+	if (cache->array_buffer == buffer) cache->valid &= ~VALID_ARRAY_BUFFER;
+	if (cache->element_buffer == buffer) cache->valid &= ~VALID_ELEMENT_BUFFER;
+	for (int i = 0; i < GL_CACHE_MAX_ATTRIBS; i++)
+		if (cache->attribs[i].buffer == buffer) cache->valid &= ~VALID_ATTRIB(i);
+}
+
+void gl_cache_forget_program(GL_CACHE_T *cache, GLuint program)
+{
+	if (cache->program == program) cache->valid &= ~VALID_PROGRAM;
+}
+
+void gl_cache_forget_texture(GL_CACHE_T *cache, GLuint texture)
+{
+	if (cache->texture == texture) cache->valid &= ~VALID_TEXTURE;
+}
+
+/***********************************************************
+ * Name: gl_cache_vertex_attrib_pointer
+ *
+ * Arguments:
+ *   GL_CACHE_T *cache = cache to update
+ *   GLint index = attribute location, negative locations are ignored
+ *   GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer =
+ *     as for glVertexAttribPointer, sourced from the currently cached GL_ARRAY_BUFFER
+ *
+ * Description:
+ *   The attribute's source buffer is part of the compared state, so the same offsets in
+ *   a different buffer are still re-specified
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void gl_cache_vertex_attrib_pointer(GL_CACHE_T *cache, GLint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer)
+{
+	if (index < 0) return;
+	if (index >= GL_CACHE_MAX_ATTRIBS)
+	{
+		cache->issued++;
+		glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+		return;
+	}
+
+	GL_CACHE_ATTRIB_T *a = &cache->attribs[index];
+	int same = (cache->valid & VALID_ARRAY_BUFFER) && a->buffer == cache->array_buffer && a->size == size &&
+		a->type == type && a->normalized == normalized && a->stride == stride && a->pointer == pointer;
+	if (cache_hit(cache, VALID_ATTRIB(index), same)) return;
+
+	a->buffer = cache->array_buffer;
+	a->size = size;
+	a->type = type;
+	a->normalized = normalized;
+	a->stride = stride;
+	a->pointer = pointer;
+	glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+
+	// Without a known buffer binding the captured source is unknown too
+	if (!(cache->valid & VALID_ARRAY_BUFFER)) cache->valid &= ~VALID_ATTRIB(index);
+}
+
+/***********************************************************
+ * Name: gl_cache_enable_attribs
+ *
+ * Arguments:
+ *   GL_CACHE_T *cache = cache to update
+ *   uint32_t mask = bit n set for every attribute array n that should be enabled
+ *
+ * Description:
+ *   Enables exactly the attribute arrays in mask and disables the rest, touching only
+ *   the ones whose state differs
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void gl_cache_enable_attribs(GL_CACHE_T *cache, uint32_t mask)
+{
+	uint32_t current = (cache->valid & VALID_ENABLED) ? cache->enabled_attribs : ~mask;
+	uint32_t changed = (current ^ mask) & ((1u << GL_CACHE_MAX_ATTRIBS) - 1);
+
+	for (int i = 0; i < GL_CACHE_MAX_ATTRIBS; i++)
+	{
+		if (!(changed & (1u << i)))
+		{
+			if (mask & (1u << i)) cache->elided++;
+			continue;
+		}
+		if (mask & (1u << i)) glEnableVertexAttribArray(i);
+		else glDisableVertexAttribArray(i);
+		cache->issued++;
+	}
+	cache->enabled_attribs = mask;
+	cache->valid |= VALID_ENABLED;
+}
+
+void gl_cache_blend(GL_CACHE_T *cache, GLboolean enable)
+{
+	if (cache->blend_locked) return;
+	if (cache_hit(cache, VALID_BLEND, cache->blend == enable)) return;
+	cache->blend = enable;
+	if (enable) glEnable(GL_BLEND);
+	else glDisable(GL_BLEND);
+}
+
+void gl_cache_blend_func(GL_CACHE_T *cache, GLenum src, GLenum dst)
+{
+	if (cache->blend_locked) return;
+	if (cache_hit(cache, VALID_BLEND_FUNC, cache->blend_src == src && cache->blend_dst == dst)) return;
+	cache->blend_src = src;
+	cache->blend_dst = dst;
+	glBlendFunc(src, dst);
+}
+
+/***********************************************************
+ * Name: gl_cache_lock_blend
+ *
+ * Arguments:
+ *   GL_CACHE_T *cache = cache to update
+ *   GLboolean locked = GL_TRUE to ignore gl_cache_blend() and gl_cache_blend_func()
+ *
+ * Description:
+ *   Pins the current blend state, so an analysis pass can force its own blending on
+ *   draws that set theirs. Locked calls are neither issued nor counted.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void gl_cache_lock_blend(GL_CACHE_T *cache, GLboolean locked)
+{
+	cache->blend_locked = locked;
+}
+
+void gl_cache_viewport(GL_CACHE_T *cache, GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	GLint viewport[4] = { x, y, width, height };
+	if (cache_hit(cache, VALID_VIEWPORT, memcmp(cache->viewport, viewport, sizeof(viewport)) == 0)) return;
+	memcpy(cache->viewport, viewport, sizeof(viewport));
+	glViewport(x, y, width, height);
+}
+
+/***********************************************************
+ * Name: gl_cache_end_frame
+ *
+ * Arguments:
+ *   GL_CACHE_T *cache = cache to sample
+ *   uint32_t *issued = receives the number of state calls passed to the driver
+ *   uint32_t *elided = receives the number of redundant state calls skipped
+ *
+ * Description:
+ *   Reads and resets the per-frame counters
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void gl_cache_end_frame(GL_CACHE_T *cache, uint32_t *issued, uint32_t *elided)
+{
+	*issued = cache->issued;
+	*elided = cache->elided;
+	cache->issued = 0;
+	cache->elided = 0;
+}
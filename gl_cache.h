@@ -0,0 +1,69 @@
+/***********************************************************
+ * File: gl_cache.h
+ *
+ * Description:
+ *   Shadow copy of the GL state the renderer touches per frame. Each setter compares
+ *   against the cached value and only calls into the driver when something actually
+ *   changes, which skips the Broadcom driver's validation path for redundant calls.
+ *   Counters record how many calls were issued and how many were elided.
+ *
+ *   All GL state covered here must be changed through the cache, otherwise the shadow
+ *   copy goes stale. gl_cache_invalidate() forces every value to be re-sent.
+ *
+ ***********************************************************/
+
+#ifndef GL_CACHE_H
+#define GL_CACHE_H
+
+#include <stdint.h>
+#include "GLES2/gl2.h"
+
+#define GL_CACHE_MAX_ATTRIBS 8
+#define GL_CACHE_ATTRIB_BIT(location) ((location) >= 0 && (location) < GL_CACHE_MAX_ATTRIBS ? 1u << (location) : 0)
+
+typedef struct
+{
+	GLuint buffer; // GL_ARRAY_BUFFER binding captured by glVertexAttribPointer
+	GLint size;
+	GLenum type;
+	GLboolean normalized;
+	GLsizei stride;
+	const void *pointer;
+} GL_CACHE_ATTRIB_T;
+
+typedef struct
+{
+	GLuint program;
+	GLuint array_buffer;
+	GLuint element_buffer;
+	GLuint texture; // GL_TEXTURE_2D on texture unit 0
+	uint32_t enabled_attribs; // Bit n set when attribute array n is enabled
+	GL_CACHE_ATTRIB_T attribs[GL_CACHE_MAX_ATTRIBS];
+	GLboolean blend;
+	GLenum blend_src;
+	GLenum blend_dst;
+	GLboolean blend_locked; // Blend calls are ignored, see gl_cache_lock_blend()
+	GLint viewport[4];
+	uint32_t valid; // Bits for the values above that are known, see gl_cache.c
+
+	// Counters since the last gl_cache_end_frame()
+	uint32_t issued;
+	uint32_t elided;
+} GL_CACHE_T;
+
+void gl_cache_invalidate(GL_CACHE_T *cache);
+void gl_cache_use_program(GL_CACHE_T *cache, GLuint program);
+void gl_cache_bind_buffer(GL_CACHE_T *cache, GLenum target, GLuint buffer);
+void gl_cache_bind_texture(GL_CACHE_T *cache, GLuint texture);
+void gl_cache_forget_buffer(GL_CACHE_T *cache, GLuint buffer);
+void gl_cache_forget_program(GL_CACHE_T *cache, GLuint program);
+void gl_cache_forget_texture(GL_CACHE_T *cache, GLuint texture);
+void gl_cache_vertex_attrib_pointer(GL_CACHE_T *cache, GLint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void *pointer);
+void gl_cache_enable_attribs(GL_CACHE_T *cache, uint32_t mask);
+void gl_cache_blend(GL_CACHE_T *cache, GLboolean enable);
+void gl_cache_blend_func(GL_CACHE_T *cache, GLenum src, GLenum dst);
+void gl_cache_lock_blend(GL_CACHE_T *cache, GLboolean locked);
+void gl_cache_viewport(GL_CACHE_T *cache, GLint x, GLint y, GLsizei width, GLsizei height);
+void gl_cache_end_frame(GL_CACHE_T *cache, uint32_t *issued, uint32_t *elided);
+
+#endif
@@ -0,0 +1,200 @@
+/***********************************************************
+ * File: governor.c
+ *
+ * Description:
+ *   vc_gencmd() sampler thread and quality level decisions. See governor.h.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "bcm_host.h"
+#include "governor.h"
+
+#define GOVERNOR_DOWN_SAMPLES 3 // Samples between step-downs, the temperature lags a change
+#define GOVERNOR_LOOKAHEAD_SAMPLES (GOVERNOR_LOOKAHEAD_S * 1000 / GOVERNOR_SAMPLE_MS)
+
+static void governor_query_clock(const char *command, uint32_t *mhz)
+{
+	char response[64];
+	int id;
+	unsigned hz;
+	if (vc_gencmd(response, sizeof(response), "%s", command) == 0 && sscanf(response, "frequency(%d)=%u", &id, &hz) == 2)
+		*mhz = hz / 1000000;
+}
+
+// One set of readings, each a mailbox round trip. Values that fail to read keep their previous value.
+static void governor_read(GOVERNOR_SAMPLE_T *sample)
+{
+	char response[64];
+	float temp;
+	unsigned throttled;
+
+	if (vc_gencmd(response, sizeof(response), "measure_temp") == 0 && sscanf(response, "temp=%f", &temp) == 1)
+		sample->temp_mc = (int32_t)(temp * 1000.0f);
+	if (vc_gencmd(response, sizeof(response), "get_throttled") == 0 && sscanf(response, "throttled=%x", &throttled) == 1)
+		sample->throttled = throttled;
+	governor_query_clock("measure_clock arm", &sample->arm_mhz);
+	governor_query_clock("measure_clock core", &sample->core_mhz);
+}
+
+static void *governor_sampler(void *arg)
+{
+	GOVERNOR_T *governor = (GOVERNOR_T *)arg;
+	GOVERNOR_SAMPLE_T sample;
+	struct timespec next;
+
+	memset(&sample, 0, sizeof(sample));
+	clock_gettime(CLOCK_REALTIME, &next);
+	pthread_mutex_lock(&governor->lock);
+	while (governor->running)
+	{
+		pthread_mutex_unlock(&governor->lock);
+		governor_read(&sample);
+		pthread_mutex_lock(&governor->lock);
+		sample.sequence = governor->latest.sequence + 1;
+		governor->latest = sample;
+
+		next.tv_sec += GOVERNOR_SAMPLE_MS / 1000;
+		next.tv_nsec += (GOVERNOR_SAMPLE_MS % 1000) * 1000000L;
+		if (next.tv_nsec >= 1000000000L)
+		{
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000L;
+		}
+		while (governor->running && pthread_cond_timedwait(&governor->wake, &governor->lock, &next) == 0);
+	}
+	pthread_mutex_unlock(&governor->lock);
+	return NULL;
+}
+
+/***********************************************************
+ * Name: governor_start
+ *
+ * Arguments:
+ *   GOVERNOR_T *governor = governor to start
+ *   int32_t limit_mc = temperature to step down at, in millidegrees Celsius
+ *   uint32_t target_us = frame time the scene should hold at the current level
+ *
+ * Description:
+ *   Opens the vc_gencmd() channel and starts sampling at full quality. Needs
+ *   bcm_host_init() to have been called.
+ *
+ * Returns:
+ *   int = 0 on success, -1 if the firmware channel or the thread is not available
+ *
+ ***********************************************************/
+int governor_start(GOVERNOR_T *governor, int32_t limit_mc, uint32_t target_us)
+{
+	memset(governor, 0, sizeof(*governor));
+	governor->limit_mc = limit_mc;
+	governor->target_us = target_us ? target_us : GOVERNOR_DEFAULT_FRAME_US;
+	if (vc_gencmd_init() != 0) return -1;
+
+	pthread_mutex_init(&governor->lock, NULL);
+	pthread_cond_init(&governor->wake, NULL);
+	governor->running = 1;
+	if (pthread_create(&governor->thread, NULL, governor_sampler, governor) != 0)
+	{
+		governor->running = 0;
+		pthread_cond_destroy(&governor->wake);
+		pthread_mutex_destroy(&governor->lock);
+		vc_gencmd_stop();
+		return -1;
+	}
+	return 0;
+}
+
+// Applies one new sample, returns 1 if the level changed
+static int governor_decide(GOVERNOR_T *governor, const GOVERNOR_SAMPLE_T *sample)
+{
+	// Smoothed trend, so a single noisy reading does not trigger a step
+	if (governor->sample.sequence)
+		governor->slope_mc = (3 * governor->slope_mc + (sample->temp_mc - governor->sample.temp_mc)) / 4;
+	if (sample->arm_mhz > governor->peak_arm_mhz) governor->peak_arm_mhz = sample->arm_mhz;
+	governor->sample = *sample;
+	governor->held++;
+
+	int32_t projected = sample->temp_mc + (governor->slope_mc > 0 ? governor->slope_mc * GOVERNOR_LOOKAHEAD_SAMPLES : 0);
+	int missed = (uint64_t)governor->frame_mean_us * 10 > (uint64_t)governor->target_us * 11;
+	int clocked_down = sample->arm_mhz && (uint64_t)sample->arm_mhz * 100 < (uint64_t)governor->peak_arm_mhz * 95;
+
+	const char *reason = NULL;
+	if (sample->throttled & (GOVERNOR_THROTTLED | GOVERNOR_FREQ_CAPPED | GOVERNOR_SOFT_TEMP)) reason = "firmware throttling";
+	else if (sample->throttled & GOVERNOR_UNDER_VOLTAGE) reason = "under-voltage";
+	else if (sample->temp_mc >= governor->limit_mc) reason = "temperature limit";
+	else if (projected >= governor->limit_mc) reason = "temperature trend";
+	else if (clocked_down && missed) reason = "clock drop";
+
+	if (reason)
+	{
+		if (governor->level == GOVERNOR_LEVELS - 1 || (governor->steps_down && governor->held < GOVERNOR_DOWN_SAMPLES)) return 0;
+		governor->level++;
+		governor->steps_down++;
+		governor->held = 0;
+		governor->reason = reason;
+		return 1;
+	}
+
+	// Headroom: well below the limit, not heading for it, and every frame on target
+	if (governor->level > 0 && governor->held >= GOVERNOR_HOLD_SAMPLES && !missed &&
+		projected < governor->limit_mc - GOVERNOR_HYSTERESIS_MC)
+	{
+		governor->level--;
+		governor->steps_up++;
+		governor->held = 0;
+		governor->reason = "headroom";
+		return 1;
+	}
+	return 0;
+}
+
+/***********************************************************
+ * Name: governor_update
+ *
+ * Arguments:
+ *   GOVERNOR_T *governor = governor started with governor_start()
+ *   uint32_t frame_us = duration of the frame just finished
+ *
+ * Description:
+ *   Accumulates frame times and evaluates each new sensor sample once, against the
+ *   mean frame time since the previous one. Cheap when there is no new sample, so it is
+ *   called every frame. A caller whose levels change the frame rate updates target_us
+ *   to match, so a frame cap is not mistaken for missed frames.
+ *
+ * Returns:
+ *   int = 1 if governor->level changed, governor->reason then says why
+ *
+ ***********************************************************/
+int governor_update(GOVERNOR_T *governor, uint32_t frame_us)
+{
+	GOVERNOR_SAMPLE_T sample;
+
+	governor->frame_sum_us += frame_us;
+	governor->frames++;
+
+	pthread_mutex_lock(&governor->lock);
+	sample = governor->latest;
+	pthread_mutex_unlock(&governor->lock);
+	if (sample.sequence == governor->seen) return 0;
+	governor->seen = sample.sequence;
+
+	governor->frame_mean_us = (uint32_t)(governor->frame_sum_us / governor->frames);
+	governor->frame_sum_us = 0;
+	governor->frames = 0;
+	return governor_decide(governor, &sample);
+}
+
+void governor_stop(GOVERNOR_T *governor)
+{
+	if (!governor->running) return;
+	pthread_mutex_lock(&governor->lock);
+	governor->running = 0;
+	pthread_cond_signal(&governor->wake);
+	pthread_mutex_unlock(&governor->lock);
+	pthread_join(governor->thread, NULL);
+	pthread_cond_destroy(&governor->wake);
+	pthread_mutex_destroy(&governor->lock);
+	vc_gencmd_stop();
+}
@@ -0,0 +1,81 @@
+/***********************************************************
+ * File: governor.h
+ *
+ * Description:
+ *   Thermal and clock aware quality governor. A sampler thread reads the SoC
+ *   temperature, the ARM and core clocks and the firmware throttle flags through
+ *   vc_gencmd() once a second; each query is a VideoCore mailbox round trip, which is
+ *   too slow for the render thread. The render thread feeds in frame times and, on
+ *   each new sample, the governor decides whether to change the quality level.
+ *
+ *   The level steps down (lower quality) when the temperature projected a few seconds
+ *   ahead reaches the step-down limit, when the firmware reports throttling or a soft
+ *   temperature limit, or when the clocks have dropped and frames miss the target. It
+ *   steps back up after the temperature has stayed clear of the limit with all frames
+ *   on target for a hold period, one level at a time. What each level means is up to
+ *   the caller; level 0 is full quality.
+ *
+ ***********************************************************/
+
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define GOVERNOR_LEVELS 4 // 0 full quality .. GOVERNOR_LEVELS - 1 lowest
+#define GOVERNOR_SAMPLE_MS 1000
+#define GOVERNOR_DEFAULT_LIMIT_MC 75000 // Step down before the firmware's 80 C soft limit
+#define GOVERNOR_HYSTERESIS_MC 5000 // Step up only this far below the limit
+#define GOVERNOR_LOOKAHEAD_S 10 // Temperature trend horizon
+#define GOVERNOR_HOLD_SAMPLES 10 // Samples at a level before stepping up
+#define GOVERNOR_DEFAULT_FRAME_US 16667
+
+// get_throttled bits that are active now, the upper 16 bits only say they happened since boot
+#define GOVERNOR_UNDER_VOLTAGE  (1u << 0)
+#define GOVERNOR_FREQ_CAPPED    (1u << 1)
+#define GOVERNOR_THROTTLED      (1u << 2)
+#define GOVERNOR_SOFT_TEMP      (1u << 3)
+
+typedef struct
+{
+	int32_t temp_mc; // Millidegrees Celsius
+	uint32_t arm_mhz;
+	uint32_t core_mhz;
+	uint32_t throttled; // get_throttled flags
+	uint32_t sequence; // Incremented by the sampler for every sample
+} GOVERNOR_SAMPLE_T;
+
+typedef struct
+{
+	// Sampler thread, publishes into latest under lock
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake; // Signalled to stop the sampler early
+	int running;
+	GOVERNOR_SAMPLE_T latest;
+
+	// Decision state, render thread only
+	int32_t limit_mc; // Step-down temperature
+	uint32_t target_us; // Frame time to hold
+	int level;
+	GOVERNOR_SAMPLE_T sample; // Sample behind the last decision
+	uint32_t seen; // Sequence of the last sample evaluated
+	int32_t slope_mc; // Smoothed temperature change per sample
+	uint32_t peak_arm_mhz; // Highest ARM clock seen, the unthrottled clock
+	uint32_t held; // Samples since the last level change
+	uint64_t frame_sum_us; // Frames since the last sample
+	uint32_t frames;
+	uint32_t frame_mean_us; // Of the frames before the last decision
+	const char *reason; // Why the last change was made, a static string
+
+	// Statistics
+	uint32_t steps_down;
+	uint32_t steps_up;
+} GOVERNOR_T;
+
+int governor_start(GOVERNOR_T *governor, int32_t limit_mc, uint32_t target_us);
+int governor_update(GOVERNOR_T *governor, uint32_t frame_us);
+void governor_stop(GOVERNOR_T *governor);
+
+#endif
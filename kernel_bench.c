@@ -0,0 +1,118 @@
+/***********************************************************
+ * File: kernel_bench.c
+ *
+ * Description:
+ *   Microbenchmark for the geometry kernels: runs each kernel and its scalar reference
+ *   over the same vertex arrays, reports nanoseconds per element and the speed-up, and
+ *   checks that both produce the same output. Needs no display or GL, build with
+ *   "make kernel_bench" and run kernel_bench.bin.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "frame_clock.h"
+#include "kernels.h"
+
+#define BENCH_ELEMENTS 6000 // Vertices in the 2000-particle stream scene
+#define BENCH_ROUNDS 2000
+
+typedef void (*KERNEL_RUN_FN)(int reference);
+
+static float *src, *dst_a, *dst_b;
+static uint32_t *rgba_a, *rgba_b;
+static int16_t *short_a, *short_b;
+static uint16_t *half_a, *half_b;
+static const float matrix[16] = {
+	0.8f, 0.1f, 0.0f, 0.0f,
+	-0.1f, 0.8f, 0.0f, 0.0f,
+	0.0f, 0.0f, 1.0f, 0.0f,
+	0.05f, -0.02f, 0.0f, 1.0f
+};
+
+static void run_vec4(int reference)
+{
+	if (reference) kernel_transform_vec4_scalar(matrix, src, dst_b, BENCH_ELEMENTS);
+	else kernel_transform_vec4(matrix, src, dst_a, BENCH_ELEMENTS);
+}
+
+static void run_vec3(int reference)
+{
+	if (reference) kernel_transform_vec3_scalar(matrix, src, dst_b, BENCH_ELEMENTS);
+	else kernel_transform_vec3(matrix, src, dst_a, BENCH_ELEMENTS);
+}
+
+static void run_rgba8(int reference)
+{
+	if (reference) kernel_pack_rgba8_scalar(src, rgba_b, BENCH_ELEMENTS);
+	else kernel_pack_rgba8(src, rgba_a, BENCH_ELEMENTS);
+}
+
+static void run_short(int reference)
+{
+	if (reference) kernel_quantize_short_scalar(src, short_b, BENCH_ELEMENTS * 4, 32767.0f);
+	else kernel_quantize_short(src, short_a, BENCH_ELEMENTS * 4, 32767.0f);
+}
+
+static void run_half(int reference)
+{
+	if (reference) kernel_float_to_half_scalar(src, half_b, BENCH_ELEMENTS * 4);
+	else kernel_float_to_half(src, half_a, BENCH_ELEMENTS * 4);
+}
+
+static double time_kernel(KERNEL_RUN_FN run, int reference)
+{
+	uint64_t best = UINT64_MAX;
+
+	// Best of several batches, so a single preemption does not skew the result
+	for (int batch = 0; batch < 5; batch++)
+	{
+		uint64_t start = frame_clock_now();
+		for (int i = 0; i < BENCH_ROUNDS / 5; i++) run(reference);
+		uint64_t elapsed = frame_clock_now() - start;
+		if (elapsed < best) best = elapsed;
+	}
+	return (double)best / (BENCH_ROUNDS / 5);
+}
+
+static void report(const char *name, KERNEL_RUN_FN run, uint32_t elements, const void *a, const void *b, size_t bytes)
+{
+	double kernel_ns = time_kernel(run, 0);
+	double scalar_ns = time_kernel(run, 1);
+	int match = memcmp(a, b, bytes) == 0;
+
+	printf("%-18s %8.2f ns/elem %s, %8.2f ns/elem scalar, %5.2fx, output %s\n", name,
+		kernel_ns / elements, kernel_isa, scalar_ns / elements, scalar_ns / kernel_ns, match ? "identical" : "DIFFERS");
+}
+
+int main(int argc, char **argv)
+{
+	src = malloc(BENCH_ELEMENTS * 4 * sizeof(float));
+	dst_a = malloc(BENCH_ELEMENTS * 4 * sizeof(float));
+	dst_b = malloc(BENCH_ELEMENTS * 4 * sizeof(float));
+	rgba_a = malloc(BENCH_ELEMENTS * sizeof(uint32_t));
+	rgba_b = malloc(BENCH_ELEMENTS * sizeof(uint32_t));
+	short_a = malloc(BENCH_ELEMENTS * 4 * sizeof(int16_t));
+	short_b = malloc(BENCH_ELEMENTS * 4 * sizeof(int16_t));
+	half_a = malloc(BENCH_ELEMENTS * 4 * sizeof(uint16_t));
+	half_b = malloc(BENCH_ELEMENTS * 4 * sizeof(uint16_t));
+	if (!src || !dst_a || !dst_b || !rgba_a || !rgba_b || !short_a || !short_b || !half_a || !half_b)
+	{
+		fprintf(stderr, "Unable to allocate benchmark buffers\n");
+		return 1;
+	}
+
+	// Slightly out of [-1, 1] so clamping and saturation are exercised too
+	srand(1);
+	for (uint32_t i = 0; i < BENCH_ELEMENTS * 4; i++) src[i] = 2.2f * rand() / RAND_MAX - 1.1f;
+
+	printf("%u elements, best of 5 x %d rounds\n", BENCH_ELEMENTS, BENCH_ROUNDS / 5);
+	report("transform vec4", run_vec4, BENCH_ELEMENTS, dst_a, dst_b, BENCH_ELEMENTS * 4 * sizeof(float));
+	report("transform vec3", run_vec3, BENCH_ELEMENTS, dst_a, dst_b, BENCH_ELEMENTS * 3 * sizeof(float));
+	report("pack rgba8", run_rgba8, BENCH_ELEMENTS, rgba_a, rgba_b, BENCH_ELEMENTS * sizeof(uint32_t));
+	report("quantize short", run_short, BENCH_ELEMENTS * 4, short_a, short_b, BENCH_ELEMENTS * 4 * sizeof(int16_t));
+	report("float to half", run_half, BENCH_ELEMENTS * 4, half_a, half_b, BENCH_ELEMENTS * 4 * sizeof(uint16_t));
+	return 0;
+}
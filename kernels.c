@@ -0,0 +1,249 @@
+/***********************************************************
+ * File: kernels.c
+ *
+ * Description:
+ *   NEON and scalar geometry kernels. See kernels.h.
+ *
+ *   The NEON paths round exactly like the scalar ones (half away from zero, then
+ *   saturate), so both produce identical packed and quantised output.
+ *
+ ***********************************************************/
+
+#include <string.h>
+#include "kernels.h"
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+// Half-precision conversion needs the VFPv4/NEON-FP16 extension, not present on every NEON part
+#if defined(__ARM_NEON) && defined(__ARM_FP) && (__ARM_FP & 2)
+#define KERNEL_NEON_FP16 1
+#endif
+
+#ifdef __ARM_NEON
+const char *const kernel_isa = "neon";
+#else
+const char *const kernel_isa = "scalar";
+#endif
+
+static inline float clampf(float x, float lo, float hi)
+{
+	return x < lo ? lo : x > hi ? hi : x;
+}
+
+static inline int32_t round_away(float x)
+{
+	return (int32_t)(x + (x < 0.0f ? -0.5f : 0.5f));
+}
+
+/***********************************************************
+ * Scalar kernels
+ ***********************************************************/
+
+// in and out may be the same array
+void kernel_transform_vec4_scalar(const float m[16], const float *in, float *out, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++, in += 4, out += 4)
+	{
+		float x = in[0], y = in[1], z = in[2], w = in[3];
+		out[0] = m[0] * x + m[4] * y + m[8] * z + m[12] * w;
+		out[1] = m[1] * x + m[5] * y + m[9] * z + m[13] * w;
+		out[2] = m[2] * x + m[6] * y + m[10] * z + m[14] * w;
+		out[3] = m[3] * x + m[7] * y + m[11] * z + m[15] * w;
+	}
+}
+
+// Points with an implied w of 1, affine part of m only. in and out may be the same array.
+void kernel_transform_vec3_scalar(const float m[16], const float *in, float *out, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++, in += 3, out += 3)
+	{
+		float x = in[0], y = in[1], z = in[2];
+		out[0] = m[0] * x + m[4] * y + m[8] * z + m[12];
+		out[1] = m[1] * x + m[5] * y + m[9] * z + m[13];
+		out[2] = m[2] * x + m[6] * y + m[10] * z + m[14];
+	}
+}
+
+// Components clamped to [0, 1]; bytes are stored R, G, B, A in memory order
+void kernel_pack_rgba8_scalar(const float *rgba, uint32_t *out, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++, rgba += 4)
+	{
+		uint8_t bytes[4];
+		for (int c = 0; c < 4; c++) bytes[c] = (uint8_t)(clampf(rgba[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+		memcpy(&out[i], bytes, 4);
+	}
+}
+
+// out = in * scale, saturated to [-32767, 32767] so a normalized GL_SHORT reads back in [-1, 1]
+void kernel_quantize_short_scalar(const float *in, int16_t *out, uint32_t count, float scale)
+{
+	for (uint32_t i = 0; i < count; i++)
+		out[i] = (int16_t)round_away(clampf(in[i] * scale, -32767.0f, 32767.0f));
+}
+
+// IEEE binary16 with round to nearest even, overflow to infinity and NaN preserved
+void kernel_float_to_half_scalar(const float *in, uint16_t *out, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t f;
+		memcpy(&f, &in[i], 4);
+		uint32_t sign = (f >> 16) & 0x8000;
+		uint32_t abs = f & 0x7fffffff;
+		uint16_t h;
+
+		if (abs >= 0x7f800000) h = sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0); // Inf or NaN
+		else if (abs >= 0x477ff000) h = sign | 0x7c00; // Rounds past 65504
+		else if (abs < 0x38800000) // Half denormal or zero
+		{
+			if (abs < 0x33000000) h = sign;
+			else
+			{
+				uint32_t mant = (abs & 0x7fffff) | 0x800000;
+				uint32_t shift = 126 - (abs >> 23);
+				uint32_t v = mant >> shift;
+				uint32_t rem = mant & ((1u << shift) - 1);
+				uint32_t half = 1u << (shift - 1);
+				if (rem > half || (rem == half && (v & 1))) v++;
+				h = sign | v;
+			}
+		}
+		else
+		{
+			uint32_t v = abs - 0x38000000; // Rebias exponent from 127 to 15
+			uint32_t rem = v & 0x1fff;
+			v >>= 13;
+			if (rem > 0x1000 || (rem == 0x1000 && (v & 1))) v++;
+			h = sign | v;
+		}
+		out[i] = h;
+	}
+}
+
+/***********************************************************
+ * Dispatch, NEON when available
+ ***********************************************************/
+
+#ifdef __ARM_NEON
+
+void kernel_transform_vec4(const float m[16], const float *in, float *out, uint32_t count)
+{
+	float32x4_t c0 = vld1q_f32(m), c1 = vld1q_f32(m + 4), c2 = vld1q_f32(m + 8), c3 = vld1q_f32(m + 12);
+
+	for (uint32_t i = 0; i < count; i++, in += 4, out += 4)
+	{
+		float32x4_t v = vld1q_f32(in);
+		float32x4_t r = vmulq_lane_f32(c0, vget_low_f32(v), 0);
+		r = vmlaq_lane_f32(r, c1, vget_low_f32(v), 1);
+		r = vmlaq_lane_f32(r, c2, vget_high_f32(v), 0);
+		r = vmlaq_lane_f32(r, c3, vget_high_f32(v), 1);
+		vst1q_f32(out, r);
+	}
+}
+
+void kernel_transform_vec3(const float m[16], const float *in, float *out, uint32_t count)
+{
+	uint32_t i = 0;
+
+	// Four points at a time, de-interleaved so each lane is one point
+	for (; i + 4 <= count; i += 4, in += 12, out += 12)
+	{
+		// Same order of operations as the scalar reference, translation added last
+		float32x4x3_t p = vld3q_f32(in), r;
+		r.val[0] = vaddq_f32(vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(p.val[0], m[0]), p.val[1], m[4]), p.val[2], m[8]), vdupq_n_f32(m[12]));
+		r.val[1] = vaddq_f32(vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(p.val[0], m[1]), p.val[1], m[5]), p.val[2], m[9]), vdupq_n_f32(m[13]));
+		r.val[2] = vaddq_f32(vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(p.val[0], m[2]), p.val[1], m[6]), p.val[2], m[10]), vdupq_n_f32(m[14]));
+		vst3q_f32(out, r);
+	}
+	kernel_transform_vec3_scalar(m, in, out, count - i);
+}
+
+static inline int32x4_t neon_round_away(float32x4_t x)
+{
+	// Add 0.5 carrying the sign of x, then truncate
+	uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(x), vdupq_n_u32(0x80000000));
+	float32x4_t half = vreinterpretq_f32_u32(vorrq_u32(sign, vreinterpretq_u32_f32(vdupq_n_f32(0.5f))));
+	return vcvtq_s32_f32(vaddq_f32(x, half));
+}
+
+void kernel_pack_rgba8(const float *rgba, uint32_t *out, uint32_t count)
+{
+	float32x4_t zero = vdupq_n_f32(0.0f), one = vdupq_n_f32(1.0f), k = vdupq_n_f32(255.0f), half = vdupq_n_f32(0.5f);
+	uint32_t i = 0;
+
+	// Four colours (16 components) per iteration, narrowed 32 -> 16 -> 8 bits in order
+	for (; i + 4 <= count; i += 4, rgba += 16, out += 4)
+	{
+		uint16x4_t q[4];
+		for (int c = 0; c < 4; c++)
+		{
+			float32x4_t v = vminq_f32(vmaxq_f32(vld1q_f32(rgba + c * 4), zero), one);
+			q[c] = vmovn_u32(vcvtq_u32_f32(vmlaq_f32(half, v, k)));
+		}
+		uint8x8_t lo = vmovn_u16(vcombine_u16(q[0], q[1]));
+		uint8x8_t hi = vmovn_u16(vcombine_u16(q[2], q[3]));
+		vst1q_u8((uint8_t *)out, vcombine_u8(lo, hi));
+	}
+	kernel_pack_rgba8_scalar(rgba, out, count - i);
+}
+
+void kernel_quantize_short(const float *in, int16_t *out, uint32_t count, float scale)
+{
+	float32x4_t lo = vdupq_n_f32(-32767.0f), hi = vdupq_n_f32(32767.0f);
+	uint32_t i = 0;
+
+	for (; i + 8 <= count; i += 8, in += 8, out += 8)
+	{
+		float32x4_t a = vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(in), scale), lo), hi);
+		float32x4_t b = vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(in + 4), scale), lo), hi);
+		vst1q_s16(out, vcombine_s16(vqmovn_s32(neon_round_away(a)), vqmovn_s32(neon_round_away(b))));
+	}
+	kernel_quantize_short_scalar(in, out, count - i, scale);
+}
+
+#ifdef KERNEL_NEON_FP16
+void kernel_float_to_half(const float *in, uint16_t *out, uint32_t count)
+{
+	uint32_t i = 0;
+	for (; i + 4 <= count; i += 4, in += 4, out += 4)
+		vst1_u16(out, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in))));
+	kernel_float_to_half_scalar(in, out, count - i);
+}
+#else
+void kernel_float_to_half(const float *in, uint16_t *out, uint32_t count)
+{
+	kernel_float_to_half_scalar(in, out, count);
+}
+#endif
+
+#else
+
+void kernel_transform_vec4(const float m[16], const float *in, float *out, uint32_t count)
+{
+	kernel_transform_vec4_scalar(m, in, out, count);
+}
+
+void kernel_transform_vec3(const float m[16], const float *in, float *out, uint32_t count)
+{
+	kernel_transform_vec3_scalar(m, in, out, count);
+}
+
+void kernel_pack_rgba8(const float *rgba, uint32_t *out, uint32_t count)
+{
+	kernel_pack_rgba8_scalar(rgba, out, count);
+}
+
+void kernel_quantize_short(const float *in, int16_t *out, uint32_t count, float scale)
+{
+	kernel_quantize_short_scalar(in, out, count, scale);
+}
+
+void kernel_float_to_half(const float *in, uint16_t *out, uint32_t count)
+{
+	kernel_float_to_half_scalar(in, out, count);
+}
+
+#endif
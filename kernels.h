@@ -0,0 +1,35 @@
+/***********************************************************
+ * File: kernels.h
+ *
+ * Description:
+ *   Vectorised CPU-side geometry kernels: 4x4 matrix transform of vec3/vec4 arrays,
+ *   colour packing to RGBA8 and position quantisation to normalized shorts or halves.
+ *   ARM NEON versions are used when the compiler targets NEON (-mfpu=neon-vfpv4 on a
+ *   Pi 2/3), otherwise the plain C versions. The _scalar versions are always built so
+ *   results and speed can be compared, see kernel_bench.c.
+ *
+ *   Matrices are column-major, as glUniformMatrix4fv expects. Arrays are tightly packed
+ *   and in/out may alias only where noted.
+ *
+ ***********************************************************/
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdint.h>
+
+extern const char *const kernel_isa; // "neon" or "scalar"
+
+void kernel_transform_vec4(const float m[16], const float *in, float *out, uint32_t count);
+void kernel_transform_vec3(const float m[16], const float *in, float *out, uint32_t count);
+void kernel_pack_rgba8(const float *rgba, uint32_t *out, uint32_t count);
+void kernel_quantize_short(const float *in, int16_t *out, uint32_t count, float scale);
+void kernel_float_to_half(const float *in, uint16_t *out, uint32_t count);
+
+void kernel_transform_vec4_scalar(const float m[16], const float *in, float *out, uint32_t count);
+void kernel_transform_vec3_scalar(const float m[16], const float *in, float *out, uint32_t count);
+void kernel_pack_rgba8_scalar(const float *rgba, uint32_t *out, uint32_t count);
+void kernel_quantize_short_scalar(const float *in, int16_t *out, uint32_t count, float scale);
+void kernel_float_to_half_scalar(const float *in, uint16_t *out, uint32_t count);
+
+#endif
@@ -0,0 +1,154 @@
+/***********************************************************
+ * File: layer.c
+ *
+ * Description:
+ *   DispmanX elements with their own EGL surfaces. See layer.h.
+ *
+ ***********************************************************/
+
+#include <string.h>
+#include "layer.h"
+
+// vc_dispmanx_element_change_attributes() flag, not exported by every firmware header
+#ifndef ELEMENT_CHANGE_SRC_RECT
+#define ELEMENT_CHANGE_SRC_RECT (1<<3)
+#endif
+
+int layer_display_size(uint32_t display_id, uint32_t *width, uint32_t *height)
+{
+	return graphics_get_display_size((uint16_t)display_id, width, height) < 0 ? -1 : 0;
+}
+
+/***********************************************************
+ * Name: layer_create
+ *
+ * Arguments:
+ *   LAYER_T *layer = layer to create
+ *   EGLDisplay egl_display = initialised EGL display
+ *   EGLConfig config = config of the shared context, with alpha when blending
+ *   uint32_t display_id = DispmanX display, e.g. LAYER_DISPLAY_MAIN
+ *   int32_t layer_number = stacking order, higher is in front
+ *   const VC_RECT_T *dst = destination on the display
+ *   uint32_t width, uint32_t height = surface size, scaled by the HVS to fill dst
+ *   int blend = blend with the layers below using the surface's alpha, otherwise opaque
+ *
+ * Description:
+ *   Adds a DispmanX element and creates a window surface for it. The layer starts due,
+ *   so the first call to layer_due() draws it.
+ *
+ * Returns:
+ *   int = 0 on success, -1 if the display cannot be opened or the surface created
+ *
+ ***********************************************************/
+int layer_create(LAYER_T *layer, EGLDisplay egl_display, EGLConfig config, uint32_t display_id, int32_t layer_number,
+	const VC_RECT_T *dst, uint32_t width, uint32_t height, int blend)
+{
+	VC_DISPMANX_ALPHA_T alpha = { DISPMANX_FLAGS_ALPHA_FROM_SOURCE, 255, 0 };
+	DISPMANX_UPDATE_HANDLE_T dispman_update;
+	VC_RECT_T src_rect;
+
+	memset(layer, 0, sizeof(*layer));
+	layer->display_id = display_id;
+	layer->layer = layer_number;
+	layer->width = width;
+	layer->height = height;
+	layer->dst = *dst;
+	layer->surface = EGL_NO_SURFACE;
+
+	layer->display = vc_dispmanx_display_open(display_id);
+	if (!layer->display) return -1;
+
+	src_rect.x = 0;
+	src_rect.y = 0;
+	src_rect.width = width << 16;
+	src_rect.height = height << 16;
+
+	dispman_update = vc_dispmanx_update_start(0);
+	layer->element = vc_dispmanx_element_add(dispman_update, layer->display, layer_number, &layer->dst, 0 /*src*/,
+		&src_rect, DISPMANX_PROTECTION_NONE, blend ? &alpha : 0, 0 /*clamp*/, 0 /*transform*/);
+	vc_dispmanx_update_submit_sync(dispman_update);
+
+	layer->window.element = layer->element;
+	layer->window.width = width;
+	layer->window.height = height;
+	layer->surface = eglCreateWindowSurface(egl_display, config, &layer->window, NULL);
+	if (layer->surface == EGL_NO_SURFACE)
+	{
+		layer_destroy(layer, egl_display);
+		return -1;
+	}
+	return 0;
+}
+
+/***********************************************************
+ * Name: layer_set_source
+ *
+ * Arguments:
+ *   LAYER_T *layer = layer to change
+ *   uint32_t x, uint32_t y, uint32_t width, uint32_t height = part of the surface shown,
+ *     in DispmanX coordinates (origin top-left)
+ *
+ * Description:
+ *   Scales a part of the surface to the layer's destination. The update is submitted
+ *   without waiting, so the change lands on the next vblank without stalling the caller.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void layer_set_source(LAYER_T *layer, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+	VC_RECT_T src_rect;
+	DISPMANX_UPDATE_HANDLE_T dispman_update;
+
+	src_rect.x = x << 16;
+	src_rect.y = y << 16;
+	src_rect.width = width << 16;
+	src_rect.height = height << 16;
+
+	dispman_update = vc_dispmanx_update_start(0);
+	vc_dispmanx_element_change_attributes(dispman_update, layer->element, ELEMENT_CHANGE_SRC_RECT,
+		0 /*layer*/, 0 /*opacity*/, &layer->dst, &src_rect, 0 /*mask*/, 0 /*transform*/);
+	vc_dispmanx_update_submit(dispman_update, NULL, NULL);
+}
+
+// True once per interval; a late layer is redrawn once, not once per missed interval
+int layer_due(LAYER_T *layer, uint64_t now_ns)
+{
+	if (now_ns < layer->next_ns) return 0;
+	layer->next_ns += layer->interval_ns;
+	if (layer->next_ns <= now_ns) layer->next_ns = now_ns + layer->interval_ns;
+	layer->updates++;
+	return 1;
+}
+
+/***********************************************************
+ * Name: layer_destroy
+ *
+ * Arguments:
+ *   LAYER_T *layer = layer to remove
+ *   EGLDisplay egl_display = display the surface was created on
+ *
+ * Description:
+ *   Destroys the surface, which must not be current, and removes the element
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void layer_destroy(LAYER_T *layer, EGLDisplay egl_display)
+{
+	DISPMANX_UPDATE_HANDLE_T dispman_update;
+
+	if (layer->surface != EGL_NO_SURFACE) eglDestroySurface(egl_display, layer->surface);
+	layer->surface = EGL_NO_SURFACE;
+	if (layer->element)
+	{
+		dispman_update = vc_dispmanx_update_start(0);
+		vc_dispmanx_element_remove(dispman_update, layer->element);
+		vc_dispmanx_update_submit_sync(dispman_update);
+		layer->element = 0;
+	}
+	if (layer->display) vc_dispmanx_display_close(layer->display);
+	layer->display = 0;
+}
@@ -0,0 +1,51 @@
+/***********************************************************
+ * File: layer.h
+ *
+ * Description:
+ *   DispmanX output layers. Each layer is a DispmanX element on a display with its own
+ *   EGL window surface, so it is drawn and swapped on its own schedule. The display
+ *   compositor (HVS) blends the layers in hardware while scanning out, so a layer that
+ *   did not change costs the GPU nothing: a UI overlay that updates a few times a
+ *   second sits on top of video-rate content without forcing it to be redrawn.
+ *
+ *   All layers share one EGL context; drawing to a layer makes its surface current.
+ *
+ ***********************************************************/
+
+#ifndef LAYER_H
+#define LAYER_H
+
+#include <stdint.h>
+#include "bcm_host.h"
+#include "EGL/egl.h"
+
+#define LAYER_DISPLAY_MAIN 0 // DispmanX display numbers: the primary LCD/HDMI output
+#define LAYER_DISPLAY_HDMI 2 // Secondary outputs, where the firmware drives more than one
+#define LAYER_DISPLAY_SDTV 3
+
+typedef struct
+{
+	uint32_t display_id; // DispmanX display number
+	int32_t layer; // Stacking order on the display, higher is in front
+	DISPMANX_DISPLAY_HANDLE_T display;
+	DISPMANX_ELEMENT_HANDLE_T element;
+	EGL_DISPMANX_WINDOW_T window; // Has to outlive the surface
+	EGLSurface surface;
+	uint32_t width; // Surface size in pixels
+	uint32_t height;
+	VC_RECT_T dst; // Where the surface is shown, in display pixels
+
+	// Update rate
+	uint64_t interval_ns; // Time between redraws, 0 to redraw every frame
+	uint64_t next_ns; // frame_clock_now() time the next redraw is due
+	uint32_t updates;
+} LAYER_T;
+
+int layer_display_size(uint32_t display_id, uint32_t *width, uint32_t *height);
+int layer_create(LAYER_T *layer, EGLDisplay egl_display, EGLConfig config, uint32_t display_id, int32_t layer_number,
+	const VC_RECT_T *dst, uint32_t width, uint32_t height, int blend);
+void layer_set_source(LAYER_T *layer, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+int layer_due(LAYER_T *layer, uint64_t now_ns);
+void layer_destroy(LAYER_T *layer, EGLDisplay egl_display);
+
+#endif
@@ -0,0 +1,237 @@
+/***********************************************************
+ * File: mesh.c
+ *
+ * Description:
+ *   Indexed mesh buffers, loading and drawing. See mesh.h and mesh_file.h. Building and
+ *   optimising the index lists is in mesh_build.c.
+ *
+ ***********************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "check.h"
+#include "mesh.h"
+#include "mesh_file.h"
+
+/***********************************************************
+ * Name: mesh_add_part
+ *
+ * Arguments:
+ *   MESH_T *mesh = mesh to extend, format already set
+ *   const void *vertices = vertex_count vertices in the mesh's format
+ *   uint32_t vertex_count = at most MESH_MAX_PART_VERTICES
+ *   const GLushort *indices = triangle list into vertices
+ *   uint32_t index_count = number of indices
+ *
+ * Description:
+ *   Uploads one part into new static buffers. The data is copied by glBufferData, so
+ *   it may point into a mapping that is released straight afterwards.
+ *
+ * Returns:
+ *   int = 0 on success, -1 on allocation failure
+ *
+ ***********************************************************/
+int mesh_add_part(MESH_T *mesh, const void *vertices, uint32_t vertex_count, const GLushort *indices, uint32_t index_count)
+{
+	MESH_PART_T *parts = realloc(mesh->parts, (mesh->part_count + 1) * sizeof(MESH_PART_T));
+	if (!parts) return -1;
+	mesh->parts = parts;
+
+	MESH_PART_T *part = &parts[mesh->part_count++];
+	part->vertex_count = vertex_count;
+	part->index_count = index_count;
+	glGenBuffers(1, &part->vbo);
+	glGenBuffers(1, &part->ibo);
+	gl_cache_bind_buffer(mesh->cache, GL_ARRAY_BUFFER, part->vbo);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertex_count * mesh->format.stride, vertices, GL_STATIC_DRAW);
+	gl_cache_bind_buffer(mesh->cache, GL_ELEMENT_ARRAY_BUFFER, part->ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count * sizeof(GLushort), indices, GL_STATIC_DRAW);
+	check();
+
+	mesh->vertex_count += vertex_count;
+	mesh->index_count += index_count;
+	return 0;
+}
+
+static int mesh_emit_part(void *user, const void *vertices, uint32_t vertex_count, const GLushort *indices, uint32_t index_count)
+{
+	return mesh_add_part((MESH_T *)user, vertices, vertex_count, indices, index_count);
+}
+
+/***********************************************************
+ * Name: mesh_init
+ *
+ * Arguments:
+ *   MESH_T *mesh = mesh to create
+ *   GL_CACHE_T *cache = state cache used for buffer bindings
+ *   const VERTEX_FORMAT_T *format = layout of vertices, copied
+ *   const void *vertices = vertex_count vertices already encoded in format
+ *   uint32_t vertex_count = number of vertices
+ *   const uint32_t *indices = triangle list with 32-bit indices
+ *   uint32_t index_count = number of indices, a multiple of 3
+ *   uint32_t flags = MESH_OPTIMIZE to reorder triangles for the vertex cache
+ *
+ * Description:
+ *   Optimises and splits the mesh with mesh_build() and uploads every part
+ *
+ * Returns:
+ *   int = 0 on success, -1 on allocation failure or an index out of range
+ *
+ ***********************************************************/
+int mesh_init(MESH_T *mesh, GL_CACHE_T *cache, const VERTEX_FORMAT_T *format, const void *vertices, uint32_t vertex_count, const uint32_t *indices, uint32_t index_count, uint32_t flags)
+{
+	memset(mesh, 0, sizeof(*mesh));
+	mesh->cache = cache;
+	mesh->format = *format;
+
+	if (mesh_build(format, vertices, vertex_count, indices, index_count, flags, mesh_emit_part, mesh, &mesh->acmr_before, &mesh->acmr_after) != 0)
+	{
+		mesh_destroy(mesh);
+		return -1;
+	}
+	return 0;
+}
+
+static int section_valid(uint64_t offset, uint64_t bytes, uint64_t file_bytes)
+{
+	return offset % MESH_FILE_ALIGNMENT == 0 && offset <= file_bytes && bytes <= file_bytes - offset;
+}
+
+// Whole triangles only, every index inside the part, so glDrawElements cannot read past the VBO
+static int indices_valid(const GLushort *indices, uint32_t index_count, uint32_t vertex_count)
+{
+	if (index_count % 3 != 0) return 0;
+	for (uint32_t i = 0; i < index_count; i++)
+		if (indices[i] >= vertex_count) return 0;
+	return 1;
+}
+
+/***********************************************************
+ * Name: mesh_load
+ *
+ * Arguments:
+ *   MESH_T *mesh = mesh to create
+ *   GL_CACHE_T *cache = state cache used for buffer bindings
+ *   const char *path = file written by mesh_file_write()
+ *
+ * Description:
+ *   Maps the file read-only, validates the header and part table against the file size
+ *   and every index against its part's vertex count, and hands every blob straight from
+ *   the mapping to glBufferData. The mapping is released once the driver has its copy.
+ *   Call mesh_bind_program() afterwards as for a mesh built with mesh_init().
+ *
+ * Returns:
+ *   int = 0 on success, -1 if the file cannot be read or is not a valid mesh of
+ *   MESH_FILE_VERSION
+ *
+ ***********************************************************/
+int mesh_load(MESH_T *mesh, GL_CACHE_T *cache, const char *path)
+{
+	struct stat st;
+	int result = -1;
+
+	memset(mesh, 0, sizeof(*mesh));
+	mesh->cache = cache;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return -1;
+	if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(MESH_FILE_HEADER_T))
+	{
+		close(fd);
+		return -1;
+	}
+	uint64_t file_bytes = (uint64_t)st.st_size;
+	uint8_t *map = mmap(NULL, file_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return -1;
+
+	// Read ahead: every byte is about to be uploaded in order
+	madvise(map, file_bytes, MADV_SEQUENTIAL);
+	madvise(map, file_bytes, MADV_WILLNEED);
+
+	const MESH_FILE_HEADER_T *header = (const MESH_FILE_HEADER_T *)map;
+	if (header->magic != MESH_FILE_MAGIC || header->version != MESH_FILE_VERSION || header->header_bytes != sizeof(MESH_FILE_HEADER_T) ||
+		header->attrib_count > VERTEX_FORMAT_MAX_ATTRIBS || header->stride == 0 ||
+		(uint64_t)header->part_count * sizeof(MESH_FILE_PART_T) > file_bytes - sizeof(MESH_FILE_HEADER_T)) goto done;
+
+	// Rebuild the descriptor with the names copied out of the mapping
+	vertex_format_init(&mesh->format, header->alignment);
+	for (uint32_t i = 0; i < header->attrib_count; i++)
+	{
+		const MESH_FILE_ATTRIB_T *a = &header->attribs[i];
+		memcpy(mesh->attrib_names[i], a->name, MESH_NAME_LENGTH);
+		mesh->attrib_names[i][MESH_NAME_LENGTH - 1] = 0;
+		if (vertex_format_add(&mesh->format, mesh->attrib_names[i], a->size, a->type, a->normalized) < 0 || mesh->format.attribs[i].offset != a->offset) goto done;
+	}
+	if (mesh->format.stride != header->stride) goto done;
+
+	const MESH_FILE_PART_T *parts = (const MESH_FILE_PART_T *)(map + header->header_bytes);
+	for (uint32_t i = 0; i < header->part_count; i++)
+	{
+		const MESH_FILE_PART_T *part = &parts[i];
+		uint64_t vertex_bytes = (uint64_t)part->vertex_count * header->stride;
+		uint64_t index_bytes = (uint64_t)part->index_count * sizeof(GLushort);
+		if (part->vertex_count > MESH_MAX_PART_VERTICES || !section_valid(part->vertex_offset, vertex_bytes, file_bytes) ||
+			!section_valid(part->index_offset, index_bytes, file_bytes)) goto done;
+		const GLushort *indices = (const GLushort *)(map + part->index_offset);
+		if (!indices_valid(indices, part->index_count, part->vertex_count)) goto done;
+		if (mesh_add_part(mesh, map + part->vertex_offset, part->vertex_count, indices, part->index_count) != 0) goto done;
+	}
+	mesh->acmr_before = header->acmr;
+	mesh->acmr_after = header->acmr;
+	result = 0;
+
+done:
+	munmap(map, file_bytes);
+	if (result != 0) mesh_destroy(mesh);
+	return result;
+}
+
+// Resolves the format's attribute locations for the program that will draw the mesh
+void mesh_bind_program(MESH_T *mesh, GLuint program)
+{
+	vertex_format_bind(&mesh->format, program);
+}
+
+/***********************************************************
+ * Name: mesh_draw
+ *
+ * Arguments:
+ *   MESH_T *mesh = mesh to draw
+ *
+ * Description:
+ *   Draws every part with glDrawElements. The program passed to mesh_bind_program()
+ *   must be current and its uniforms set.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void mesh_draw(MESH_T *mesh)
+{
+	for (uint32_t i = 0; i < mesh->part_count; i++)
+	{
+		MESH_PART_T *part = &mesh->parts[i];
+		gl_cache_bind_buffer(mesh->cache, GL_ARRAY_BUFFER, part->vbo);
+		vertex_format_apply(&mesh->format, mesh->cache, 0);
+		gl_cache_bind_buffer(mesh->cache, GL_ELEMENT_ARRAY_BUFFER, part->ibo);
+		glDrawElements(GL_TRIANGLES, part->index_count, GL_UNSIGNED_SHORT, 0);
+	}
+}
+
+void mesh_destroy(MESH_T *mesh)
+{
+	for (uint32_t i = 0; i < mesh->part_count; i++)
+	{
+		gl_cache_forget_buffer(mesh->cache, mesh->parts[i].vbo);
+		gl_cache_forget_buffer(mesh->cache, mesh->parts[i].ibo);
+		glDeleteBuffers(1, &mesh->parts[i].vbo);
+		glDeleteBuffers(1, &mesh->parts[i].ibo);
+	}
+	free(mesh->parts);
+	memset(mesh, 0, sizeof(*mesh));
+}
@@ -0,0 +1,65 @@
+/***********************************************************
+ * File: mesh.h
+ *
+ * Description:
+ *   Indexed triangle meshes. Vertices shared between triangles are stored once in a
+ *   VBO and referenced from a GL_UNSIGNED_SHORT index buffer, which cuts both upload
+ *   size and vertex shader work. At load time triangles are reordered for the
+ *   post-transform vertex cache (Tom Forsyth's linear-speed algorithm) and vertices
+ *   are renumbered in first-use order. Meshes with more vertices than 16-bit indices
+ *   can address are split into parts automatically, each with its own buffers.
+ *
+ ***********************************************************/
+
+#ifndef MESH_H
+#define MESH_H
+
+#include <stdint.h>
+#include "GLES2/gl2.h"
+#include "gl_cache.h"
+#include "vertex_format.h"
+
+#define MESH_MAX_PART_VERTICES 65535 // Vertices addressable by one GL_UNSIGNED_SHORT index buffer
+#define MESH_CACHE_SIZE 32 // Post-transform cache size the optimiser models
+
+#define MESH_OPTIMIZE 1 // mesh_init() flag: reorder triangles for the vertex cache
+#define MESH_NAME_LENGTH 32 // Longest attribute name of a loaded mesh, including the terminator
+
+typedef struct
+{
+	GLuint vbo;
+	GLuint ibo;
+	uint32_t vertex_count;
+	uint32_t index_count;
+} MESH_PART_T;
+
+typedef struct
+{
+	GL_CACHE_T *cache; // Buffer bindings go through the shared state cache
+	VERTEX_FORMAT_T format; // Layout of every part's VBO
+	char attrib_names[VERTEX_FORMAT_MAX_ATTRIBS][MESH_NAME_LENGTH]; // Name storage for formats read from files
+	MESH_PART_T *parts;
+	uint32_t part_count;
+
+	// Statistics from mesh_init()
+	uint32_t vertex_count; // Vertices uploaded, including those duplicated across parts
+	uint32_t index_count;
+	float acmr_before; // Average cache misses per triangle of the source order
+	float acmr_after; // Same for the uploaded order
+} MESH_T;
+
+// Receives each finished part from mesh_build(), returns non-zero to abort
+typedef int (*MESH_PART_FN)(void *user, const void *vertices, uint32_t vertex_count, const GLushort *indices, uint32_t index_count);
+
+int mesh_build(const VERTEX_FORMAT_T *format, const void *vertices, uint32_t vertex_count, const uint32_t *indices, uint32_t index_count, uint32_t flags,
+	MESH_PART_FN emit, void *user, float *acmr_before, float *acmr_after);
+int mesh_init(MESH_T *mesh, GL_CACHE_T *cache, const VERTEX_FORMAT_T *format, const void *vertices, uint32_t vertex_count, const uint32_t *indices, uint32_t index_count, uint32_t flags);
+int mesh_add_part(MESH_T *mesh, const void *vertices, uint32_t vertex_count, const GLushort *indices, uint32_t index_count);
+void mesh_bind_program(MESH_T *mesh, GLuint program);
+void mesh_draw(MESH_T *mesh);
+void mesh_destroy(MESH_T *mesh);
+
+int mesh_optimize_indices(uint32_t *indices, uint32_t index_count, uint32_t vertex_count);
+float mesh_acmr(const uint32_t *indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size);
+
+#endif
@@ -0,0 +1,345 @@
+/***********************************************************
+ * File: mesh_build.c
+ *
+ * Description:
+ *   Vertex cache optimisation, ACMR and 16-bit splitting of indexed meshes. See
+ *   mesh.h. Makes no GL calls, so offline tools link it without the GL libraries.
+ *
+ ***********************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "mesh.h"
+
+// Forsyth's published tuning: strongly prefer the last triangle's vertices, then decay
+// with cache position, and boost vertices with few triangles left so none are stranded
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRI_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+#define UNASSIGNED UINT32_MAX
+
+static float forsyth_vertex_score(int cache_position, uint32_t remaining)
+{
+	float score = 0.0f;
+	if (remaining == 0) return -1.0f;
+
+	if (cache_position >= 0)
+	{
+		if (cache_position < 3) score = FORSYTH_LAST_TRI_SCORE;
+		else
+		{
+			float scaler = 1.0f / (MESH_CACHE_SIZE - 3);
+			score = powf(1.0f - (cache_position - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+		}
+	}
+	return score + FORSYTH_VALENCE_BOOST_SCALE * powf((float)remaining, -FORSYTH_VALENCE_BOOST_POWER);
+}
+
+/***********************************************************
+ * Name: mesh_optimize_indices
+ *
+ * Arguments:
+ *   uint32_t *indices = triangle list, reordered in place
+ *   uint32_t index_count = number of indices, a multiple of 3
+ *   uint32_t vertex_count = number of vertices the indices refer to
+ *
+ * Description:
+ *   Greedy post-transform cache optimisation after Tom Forsyth, "Linear-Speed Vertex
+ *   Cache Optimisation". Each step emits the highest-scoring triangle, where vertices
+ *   score by their LRU cache position and by how few unemitted triangles still use
+ *   them. Only the triangles touching the modelled cache are rescored per step.
+ *
+ * Returns:
+ *   int = 0 on success, -1 on allocation failure (indices are then left unchanged)
+ *
+ ***********************************************************/
+int mesh_optimize_indices(uint32_t *indices, uint32_t index_count, uint32_t vertex_count)
+{
+	uint32_t tri_count = index_count / 3;
+	if (tri_count < 2) return 0;
+
+	uint32_t *valence = calloc(vertex_count, sizeof(uint32_t)); // Unemitted triangles per vertex
+	uint32_t *adjacency_start = malloc((vertex_count + 1) * sizeof(uint32_t));
+	uint32_t *adjacency = malloc(index_count * sizeof(uint32_t)); // Triangles of each vertex, unemitted first
+	int *cache_position = malloc(vertex_count * sizeof(int));
+	float *vertex_score = malloc(vertex_count * sizeof(float));
+	float *tri_score = malloc(tri_count * sizeof(float));
+	uint8_t *tri_emitted = calloc(tri_count, 1);
+	uint32_t *out = malloc(index_count * sizeof(uint32_t));
+	int result = -1;
+
+	if (!valence || !adjacency_start || !adjacency || !cache_position || !vertex_score || !tri_score || !tri_emitted || !out) goto done;
+
+	// Per-vertex triangle lists
+	for (uint32_t i = 0; i < tri_count * 3; i++) valence[indices[i]]++;
+	adjacency_start[0] = 0;
+	for (uint32_t v = 0; v < vertex_count; v++) adjacency_start[v + 1] = adjacency_start[v] + valence[v];
+	memset(valence, 0, vertex_count * sizeof(uint32_t));
+	for (uint32_t t = 0; t < tri_count; t++)
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = indices[t * 3 + k];
+			adjacency[adjacency_start[v] + valence[v]++] = t;
+		}
+
+	for (uint32_t v = 0; v < vertex_count; v++)
+	{
+		cache_position[v] = -1;
+		vertex_score[v] = forsyth_vertex_score(-1, valence[v]);
+	}
+
+	int64_t best = -1;
+	float best_score = -1.0f;
+	for (uint32_t t = 0; t < tri_count; t++)
+	{
+		tri_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] + vertex_score[indices[t * 3 + 2]];
+		if (tri_score[t] > best_score)
+		{
+			best_score = tri_score[t];
+			best = t;
+		}
+	}
+
+	uint32_t cache[MESH_CACHE_SIZE + 3];
+	uint32_t cache_count = 0;
+	uint32_t scan = 0; // Fallback search resumes here, everything before it is emitted
+
+	for (uint32_t emitted = 0; emitted < tri_count; emitted++)
+	{
+		// Nothing in the cache has triangles left: take the best remaining triangle
+		if (best < 0)
+		{
+			best_score = -1.0f;
+			while (tri_emitted[scan]) scan++;
+			for (uint32_t t = scan; t < tri_count; t++)
+				if (!tri_emitted[t] && tri_score[t] > best_score)
+				{
+					best_score = tri_score[t];
+					best = t;
+				}
+		}
+
+		uint32_t t = (uint32_t)best;
+		const uint32_t *tri = &indices[t * 3];
+		memcpy(&out[emitted * 3], tri, 3 * sizeof(uint32_t));
+		tri_emitted[t] = 1;
+
+		// Drop the triangle from its vertices' lists
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = tri[k];
+			uint32_t *list = &adjacency[adjacency_start[v]];
+			for (uint32_t i = 0; i < valence[v]; i++)
+				if (list[i] == t)
+				{
+					list[i] = list[--valence[v]];
+					break;
+				}
+		}
+
+		// The triangle's vertices move to the front of the LRU cache
+		uint32_t next[MESH_CACHE_SIZE + 3];
+		uint32_t next_count = 0;
+		for (int k = 0; k < 3; k++) next[next_count++] = tri[k];
+		for (uint32_t i = 0; i < cache_count; i++)
+		{
+			uint32_t v = cache[i];
+			if (v == tri[0] || v == tri[1] || v == tri[2]) continue;
+			if (next_count < MESH_CACHE_SIZE + 3) next[next_count++] = v;
+		}
+		for (uint32_t i = 0; i < cache_count; i++) cache_position[cache[i]] = -1;
+
+		for (uint32_t i = 0; i < next_count; i++)
+		{
+			uint32_t v = next[i];
+			cache_position[v] = i < MESH_CACHE_SIZE ? (int)i : -1;
+			vertex_score[v] = forsyth_vertex_score(cache_position[v], valence[v]);
+		}
+		// Vertices that fell out of the cache also lose their cache score
+		for (uint32_t i = 0; i < cache_count; i++)
+		{
+			uint32_t v = cache[i];
+			if (cache_position[v] < 0) vertex_score[v] = forsyth_vertex_score(-1, valence[v]);
+		}
+
+		// Rescore the triangles touching the cache and pick the best of them
+		best = -1;
+		best_score = -1.0f;
+		for (uint32_t i = 0; i < next_count; i++)
+		{
+			uint32_t v = next[i];
+			const uint32_t *list = &adjacency[adjacency_start[v]];
+			for (uint32_t j = 0; j < valence[v]; j++)
+			{
+				uint32_t u = list[j];
+				const uint32_t *ut = &indices[u * 3];
+				tri_score[u] = vertex_score[ut[0]] + vertex_score[ut[1]] + vertex_score[ut[2]];
+				if (tri_score[u] > best_score)
+				{
+					best_score = tri_score[u];
+					best = u;
+				}
+			}
+		}
+
+		memcpy(cache, next, next_count * sizeof(uint32_t));
+		cache_count = next_count < MESH_CACHE_SIZE ? next_count : MESH_CACHE_SIZE;
+	}
+
+	memcpy(indices, out, tri_count * 3 * sizeof(uint32_t));
+	result = 0;
+
+done:
+	free(valence);
+	free(adjacency_start);
+	free(adjacency);
+	free(cache_position);
+	free(vertex_score);
+	free(tri_score);
+	free(tri_emitted);
+	free(out);
+	return result;
+}
+
+/***********************************************************
+ * Name: mesh_acmr
+ *
+ * Arguments:
+ *   const uint32_t *indices = triangle list
+ *   uint32_t index_count = number of indices
+ *   uint32_t vertex_count = number of vertices the indices refer to
+ *   uint32_t cache_size = FIFO entries to simulate
+ *
+ * Description:
+ *   Average cache miss ratio: vertex shader runs per triangle with a FIFO
+ *   post-transform cache, 3.0 worst case, about 0.5 is ideal for a regular grid
+ *
+ * Returns:
+ *   float = misses per triangle, or 0 if there are no triangles or memory
+ *
+ ***********************************************************/
+float mesh_acmr(const uint32_t *indices, uint32_t index_count, uint32_t vertex_count, uint32_t cache_size)
+{
+	uint32_t tri_count = index_count / 3;
+	uint32_t *inserted = calloc(vertex_count, sizeof(uint32_t)); // Value of misses after v was last loaded, 0 if never
+	uint32_t misses = 0;
+
+	if (!tri_count || !inserted)
+	{
+		free(inserted);
+		return 0.0f;
+	}
+	for (uint32_t i = 0; i < tri_count * 3; i++)
+	{
+		uint32_t v = indices[i];
+		if (inserted[v] && misses - inserted[v] < cache_size) continue; // Hit, fewer than cache_size loads since v's
+		inserted[v] = ++misses;
+	}
+	free(inserted);
+	return (float)misses / tri_count;
+}
+
+// Known answer for mesh_acmr(): with 3 entries, vertex 0 is still cached when the second
+// triangle reuses it, so only vertex 3 misses there, 4 misses over 2 triangles
+static void mesh_acmr_check(void)
+{
+	static const uint32_t strip[6] = { 0, 1, 2, 0, 2, 3 };
+	float acmr = mesh_acmr(strip, 6, 4, 3);
+	assert(acmr == 0.0f || acmr == 2.0f); // 0 only when out of memory
+}
+
+/***********************************************************
+ * Name: mesh_build
+ *
+ * Arguments:
+ *   const VERTEX_FORMAT_T *format = layout of vertices
+ *   const void *vertices = vertex_count vertices already encoded in format
+ *   uint32_t vertex_count = number of vertices
+ *   const uint32_t *indices = triangle list with 32-bit indices
+ *   uint32_t index_count = number of indices, a multiple of 3
+ *   uint32_t flags = MESH_OPTIMIZE to reorder triangles for the vertex cache
+ *   MESH_PART_FN emit = called with each finished part
+ *   void *user = passed to emit
+ *   float *acmr_before, float *acmr_after = receive the cache miss ratios, may be NULL
+ *
+ * Description:
+ *   Optionally reorders the triangles, then walks them in order and assigns vertices
+ *   to the current part in first-use order, starting a new part whenever a triangle
+ *   would push it past MESH_MAX_PART_VERTICES. Vertices used by triangles of several
+ *   parts are duplicated into each. Makes no GL calls, so offline tools can use it.
+ *
+ * Returns:
+ *   int = 0 on success, -1 on allocation failure, an index out of range or an error
+ *     returned by emit
+ *
+ ***********************************************************/
+int mesh_build(const VERTEX_FORMAT_T *format, const void *vertices, uint32_t vertex_count, const uint32_t *indices, uint32_t index_count, uint32_t flags,
+	MESH_PART_FN emit, void *user, float *acmr_before, float *acmr_after)
+{
+	uint32_t stride = format->stride;
+	uint32_t part_limit = vertex_count < MESH_MAX_PART_VERTICES ? vertex_count : MESH_MAX_PART_VERTICES;
+	int result = -1;
+
+	mesh_acmr_check();
+	index_count -= index_count % 3;
+	for (uint32_t i = 0; i < index_count; i++)
+		if (indices[i] >= vertex_count) return -1;
+
+	uint32_t *order = malloc(index_count * sizeof(uint32_t));
+	uint32_t *remap = malloc(vertex_count * sizeof(uint32_t)); // Source vertex to index in the current part
+	uint32_t *part_vertices = malloc(part_limit * sizeof(uint32_t)); // Source vertex of each part vertex
+	uint8_t *part_data = malloc((size_t)part_limit * stride);
+	GLushort *part_indices = malloc(index_count * sizeof(GLushort));
+	if (!order || !remap || !part_vertices || !part_data || !part_indices) goto done;
+
+	memcpy(order, indices, index_count * sizeof(uint32_t));
+	if (acmr_before) *acmr_before = mesh_acmr(order, index_count, vertex_count, MESH_CACHE_SIZE);
+	if (flags & MESH_OPTIMIZE) mesh_optimize_indices(order, index_count, vertex_count);
+	if (acmr_after) *acmr_after = mesh_acmr(order, index_count, vertex_count, MESH_CACHE_SIZE);
+
+	for (uint32_t v = 0; v < vertex_count; v++) remap[v] = UNASSIGNED;
+
+	uint32_t local_vertices = 0, local_indices = 0;
+	for (uint32_t t = 0; t <= index_count; t += 3)
+	{
+		uint32_t fresh = 0;
+		if (t < index_count)
+			for (int k = 0; k < 3; k++)
+				if (remap[order[t + k]] == UNASSIGNED) fresh++;
+
+		// Close the part before the triangle that would overflow it, and after the last one
+		if (local_indices && (t == index_count || local_vertices + fresh > part_limit))
+		{
+			for (uint32_t i = 0; i < local_vertices; i++) memcpy(part_data + (size_t)i * stride, (const uint8_t *)vertices + (size_t)part_vertices[i] * stride, stride);
+			if (emit(user, part_data, local_vertices, part_indices, local_indices) != 0) goto done;
+			for (uint32_t i = 0; i < local_vertices; i++) remap[part_vertices[i]] = UNASSIGNED;
+			local_vertices = 0;
+			local_indices = 0;
+		}
+		if (t == index_count) break;
+
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = order[t + k];
+			if (remap[v] == UNASSIGNED)
+			{
+				remap[v] = local_vertices;
+				part_vertices[local_vertices++] = v;
+			}
+			part_indices[local_indices++] = (GLushort)remap[v];
+		}
+	}
+	result = 0;
+
+done:
+	free(order);
+	free(remap);
+	free(part_vertices);
+	free(part_data);
+	free(part_indices);
+	return result;
+}
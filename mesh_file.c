@@ -0,0 +1,141 @@
+/***********************************************************
+ * File: mesh_file.c
+ *
+ * Description:
+ *   Mesh asset writing. See mesh_file.h. Makes no GL calls, so offline tools link it
+ *   without the GL libraries; mesh_load() is in mesh.c with the other buffer code.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "mesh_file.h"
+
+static uint64_t align_file(uint64_t offset)
+{
+	return (offset + MESH_FILE_ALIGNMENT - 1) & ~(uint64_t)(MESH_FILE_ALIGNMENT - 1);
+}
+
+typedef struct
+{
+	FILE *f;
+	MESH_FILE_PART_T *parts;
+	uint32_t part_count;
+	uint32_t stride;
+	uint64_t offset; // Where the next blob goes
+} MESH_FILE_WRITER_T;
+
+static int write_section(MESH_FILE_WRITER_T *writer, const void *data, uint64_t bytes, uint64_t *offset)
+{
+	static const uint8_t zero[64];
+
+	// Pad up to the next page boundary
+	uint64_t aligned = align_file(writer->offset);
+	for (uint64_t pad = aligned - writer->offset; pad; )
+	{
+		size_t n = pad < sizeof(zero) ? (size_t)pad : sizeof(zero);
+		if (fwrite(zero, 1, n, writer->f) != n) return -1;
+		pad -= n;
+	}
+	if (bytes && fwrite(data, 1, bytes, writer->f) != bytes) return -1;
+	*offset = aligned;
+	writer->offset = aligned + bytes;
+	return 0;
+}
+
+static int write_part(void *user, const void *vertices, uint32_t vertex_count, const GLushort *indices, uint32_t index_count)
+{
+	MESH_FILE_WRITER_T *writer = (MESH_FILE_WRITER_T *)user;
+	MESH_FILE_PART_T *parts = realloc(writer->parts, (writer->part_count + 1) * sizeof(MESH_FILE_PART_T));
+	if (!parts) return -1;
+	writer->parts = parts;
+
+	MESH_FILE_PART_T *part = &parts[writer->part_count++];
+	memset(part, 0, sizeof(*part));
+	part->vertex_count = vertex_count;
+	part->index_count = index_count;
+	if (write_section(writer, vertices, (uint64_t)vertex_count * writer->stride, &part->vertex_offset) != 0) return -1;
+	return write_section(writer, indices, (uint64_t)index_count * sizeof(GLushort), &part->index_offset);
+}
+
+/***********************************************************
+ * Name: mesh_file_write
+ *
+ * Arguments:
+ *   const char *path = file to create
+ *   const VERTEX_FORMAT_T *format = layout of vertices, names up to MESH_NAME_LENGTH - 1
+ *   const void *vertices = vertex_count vertices already encoded in format
+ *   uint32_t vertex_count = number of vertices
+ *   const uint32_t *indices = triangle list with 32-bit indices
+ *   uint32_t index_count = number of indices
+ *   uint32_t flags = passed to mesh_build(), normally MESH_OPTIMIZE
+ *
+ * Description:
+ *   Optimises and splits the mesh exactly as mesh_init() would and writes the result.
+ *   Blobs are streamed out as parts are produced, then the header and part table are
+ *   written into the first page. The file is written next to path and renamed into
+ *   place, so a reader never sees a partial file.
+ *
+ * Returns:
+ *   int = 0 on success, -1 on failure
+ *
+ ***********************************************************/
+int mesh_file_write(const char *path, const VERTEX_FORMAT_T *format, const void *vertices, uint32_t vertex_count, const uint32_t *indices, uint32_t index_count, uint32_t flags)
+{
+	MESH_FILE_HEADER_T header;
+	MESH_FILE_WRITER_T writer;
+	char temp[1024];
+	int result = -1;
+
+	if (snprintf(temp, sizeof(temp), "%s.tmp", path) >= (int)sizeof(temp)) return -1;
+	memset(&writer, 0, sizeof(writer));
+	writer.stride = format->stride;
+	writer.f = fopen(temp, "wb");
+	if (!writer.f) return -1;
+
+	memset(&header, 0, sizeof(header));
+	header.magic = MESH_FILE_MAGIC;
+	header.version = MESH_FILE_VERSION;
+	header.header_bytes = sizeof(header);
+	header.stride = format->stride;
+	header.alignment = format->alignment;
+	header.attrib_count = format->attrib_count;
+	header.flags = flags;
+	for (uint32_t i = 0; i < format->attrib_count; i++)
+	{
+		const VERTEX_ATTRIB_T *a = &format->attribs[i];
+		if (strlen(a->name) >= MESH_NAME_LENGTH) goto done;
+		strcpy(header.attribs[i].name, a->name);
+		header.attribs[i].size = a->size;
+		header.attribs[i].type = a->type;
+		header.attribs[i].normalized = a->normalized;
+		header.attribs[i].offset = a->offset;
+	}
+
+	// The part table size is not known until the mesh is split, so the header and table
+	// get the whole first page and are filled in last. A mesh needing more fails.
+	writer.offset = MESH_FILE_ALIGNMENT;
+	if (fseek(writer.f, MESH_FILE_ALIGNMENT, SEEK_SET) != 0) goto done;
+
+	if (mesh_build(format, vertices, vertex_count, indices, index_count, flags, write_part, &writer, NULL, &header.acmr) != 0) goto done;
+	if (sizeof(header) + writer.part_count * sizeof(MESH_FILE_PART_T) > MESH_FILE_ALIGNMENT) goto done;
+
+	header.part_count = writer.part_count;
+	for (uint32_t i = 0; i < writer.part_count; i++)
+	{
+		header.vertex_count += writer.parts[i].vertex_count;
+		header.index_count += writer.parts[i].index_count;
+	}
+	if (fseek(writer.f, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, writer.f) != 1) goto done;
+	if (writer.part_count && fwrite(writer.parts, sizeof(MESH_FILE_PART_T), writer.part_count, writer.f) != writer.part_count) goto done;
+	result = 0;
+
+done:
+	if (fclose(writer.f) != 0) result = -1;
+	free(writer.parts);
+	if (result == 0 && rename(temp, path) != 0) result = -1;
+	if (result != 0) unlink(temp);
+	return result;
+}
@@ -0,0 +1,69 @@
+/***********************************************************
+ * File: mesh_file.h
+ *
+ * Description:
+ *   Binary mesh asset format for zero-copy loading. A file holds a header with the
+ *   vertex format descriptor and a part table, followed by the vertex and index blob of
+ *   every part. Each blob starts on a 4 KB boundary and is stored exactly as
+ *   glBufferData wants it: vertices already encoded in the format, 16-bit indices
+ *   already optimised and split by mesh_build(). Loading is mmap() plus one
+ *   glBufferData per blob, with no parsing or intermediate copies.
+ *
+ *   All fields are little-endian. Files are written by meshconv.bin, see meshconv.c.
+ *
+ *   Layout, version 2:
+ *     0                 MESH_FILE_HEADER_T
+ *     header_bytes      MESH_FILE_PART_T[part_count]
+ *     4096 * n          vertex blob of part 0, index blob of part 0, vertex blob of part 1, ...
+ *
+ ***********************************************************/
+
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <stdint.h>
+#include "mesh.h"
+
+#define MESH_FILE_MAGIC 0x4853454d // "MESH"
+#define MESH_FILE_VERSION 2 // 2: attributes start on at least the format's alignment, version 1 files are rejected
+#define MESH_FILE_ALIGNMENT 4096 // Section alignment, one page
+
+typedef struct
+{
+	char name[MESH_NAME_LENGTH]; // Zero-terminated shader attribute name
+	uint32_t size;
+	uint32_t type; // GL type enum
+	uint32_t normalized;
+	uint32_t offset;
+} MESH_FILE_ATTRIB_T;
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t header_bytes; // sizeof(MESH_FILE_HEADER_T), the part table starts here
+	uint32_t part_count;
+	uint32_t stride; // Vertex format
+	uint32_t alignment;
+	uint32_t attrib_count;
+	uint32_t reserved;
+	MESH_FILE_ATTRIB_T attribs[VERTEX_FORMAT_MAX_ATTRIBS];
+	uint32_t vertex_count; // Totals over all parts
+	uint32_t index_count;
+	float acmr; // Vertex cache misses per triangle of the stored order
+	uint32_t flags; // mesh_build() flags the file was written with
+} MESH_FILE_HEADER_T;
+
+typedef struct
+{
+	uint64_t vertex_offset; // File offset of the vertex blob, MESH_FILE_ALIGNMENT aligned
+	uint64_t index_offset; // File offset of the GL_UNSIGNED_SHORT index blob, aligned likewise
+	uint32_t vertex_count;
+	uint32_t index_count;
+	uint32_t reserved[2];
+} MESH_FILE_PART_T;
+
+int mesh_load(MESH_T *mesh, GL_CACHE_T *cache, const char *path);
+int mesh_file_write(const char *path, const VERTEX_FORMAT_T *format, const void *vertices, uint32_t vertex_count, const uint32_t *indices, uint32_t index_count, uint32_t flags);
+
+#endif
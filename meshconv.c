@@ -0,0 +1,256 @@
+/***********************************************************
+ * File: meshconv.c
+ *
+ * Description:
+ *   Offline converter from Wavefront OBJ to the binary mesh format in mesh_file.h, so
+ *   the kiosk never parses text or optimises meshes at boot. Reads "v x y z [r g b]"
+ *   positions with optional vertex colours and "f" faces (polygons are fanned into
+ *   triangles, v/vt/vn references use only the position). Positions are centred and
+ *   scaled into [-1, 1]; vertices without colours are coloured by position.
+ *
+ *   Usage: meshconv.bin [--format float|short|packed] [--no-optimize] input.obj output.mesh
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "mesh_file.h"
+
+#define MESHCONV_MAX_FACE 64 // Longest polygon accepted
+
+typedef struct
+{
+	GLfloat *positions; // xyz
+	GLfloat *colors; // rgba
+	uint32_t vertex_count;
+	uint32_t vertex_capacity;
+	uint32_t *indices;
+	uint32_t index_count;
+	uint32_t index_capacity;
+	int has_colors;
+} OBJ_T;
+
+static int obj_reserve(void **p, uint32_t *capacity, uint32_t needed, size_t element)
+{
+	if (needed <= *capacity) return 0;
+	uint32_t grown = *capacity ? *capacity * 2 : 1024;
+	while (grown < needed) grown *= 2;
+	void *q = realloc(*p, grown * element);
+	if (!q) return -1;
+	*p = q;
+	*capacity = grown;
+	return 0;
+}
+
+static int obj_add_vertex(OBJ_T *obj, const GLfloat *xyz, const GLfloat *rgb)
+{
+	uint32_t capacity = obj->vertex_capacity;
+	if (obj_reserve((void **)&obj->positions, &capacity, obj->vertex_count + 1, 3 * sizeof(GLfloat)) != 0) return -1;
+	capacity = obj->vertex_capacity;
+	if (obj_reserve((void **)&obj->colors, &capacity, obj->vertex_count + 1, 4 * sizeof(GLfloat)) != 0) return -1;
+	obj->vertex_capacity = capacity;
+
+	memcpy(&obj->positions[obj->vertex_count * 3], xyz, 3 * sizeof(GLfloat));
+	GLfloat *c = &obj->colors[obj->vertex_count * 4];
+	c[0] = rgb ? rgb[0] : -1.0f; // Negative marks "no colour given"
+	c[1] = rgb ? rgb[1] : 0.0f;
+	c[2] = rgb ? rgb[2] : 0.0f;
+	c[3] = 1.0f;
+	obj->vertex_count++;
+	return 0;
+}
+
+static int obj_add_index(OBJ_T *obj, uint32_t index)
+{
+	if (obj_reserve((void **)&obj->indices, &obj->index_capacity, obj->index_count + 1, sizeof(uint32_t)) != 0) return -1;
+	obj->indices[obj->index_count++] = index;
+	return 0;
+}
+
+/***********************************************************
+ * Name: obj_read
+ *
+ * Arguments:
+ *   OBJ_T *obj = receives the vertices and triangle list
+ *   FILE *f = OBJ text
+ *
+ * Description:
+ *   Minimal OBJ reader for positions, vertex colours and faces. Everything else
+ *   (normals, texture coordinates, groups, materials) is skipped.
+ *
+ * Returns:
+ *   int = 0 on success, -1 on a malformed face or allocation failure
+ *
+ ***********************************************************/
+static int obj_read(OBJ_T *obj, FILE *f)
+{
+	char line[4096];
+	unsigned line_number = 0;
+
+	while (fgets(line, sizeof(line), f))
+	{
+		line_number++;
+		if (line[0] == 'v' && line[1] == ' ')
+		{
+			GLfloat v[6];
+			int n = sscanf(line + 2, "%f %f %f %f %f %f", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]);
+			if (n < 3)
+			{
+				fprintf(stderr, "line %u: bad vertex\n", line_number);
+				return -1;
+			}
+			if (n == 6) obj->has_colors = 1;
+			if (obj_add_vertex(obj, v, n == 6 ? &v[3] : NULL) != 0) return -1;
+		}
+		else if (line[0] == 'f' && line[1] == ' ')
+		{
+			uint32_t face[MESHCONV_MAX_FACE];
+			int count = 0;
+			for (char *token = strtok(line + 2, " \t\r\n"); token; token = strtok(NULL, " \t\r\n"))
+			{
+				long index = strtol(token, NULL, 10); // Stops at any "/vt/vn"
+				if (index < 0) index += obj->vertex_count + 1; // Relative to the end
+				if (index < 1 || index > (long)obj->vertex_count || count == MESHCONV_MAX_FACE)
+				{
+					fprintf(stderr, "line %u: bad face\n", line_number);
+					return -1;
+				}
+				face[count++] = (uint32_t)(index - 1);
+			}
+			for (int i = 2; i < count; i++)
+				if (obj_add_index(obj, face[0]) != 0 || obj_add_index(obj, face[i - 1]) != 0 || obj_add_index(obj, face[i]) != 0) return -1;
+		}
+	}
+	return 0;
+}
+
+// Centre on the bounding box and scale the largest extent to [-1, 1]
+static void obj_normalize(OBJ_T *obj)
+{
+	GLfloat lo[3] = { 1e30f, 1e30f, 1e30f }, hi[3] = { -1e30f, -1e30f, -1e30f };
+	for (uint32_t v = 0; v < obj->vertex_count; v++)
+		for (int k = 0; k < 3; k++)
+		{
+			GLfloat x = obj->positions[v * 3 + k];
+			if (x < lo[k]) lo[k] = x;
+			if (x > hi[k]) hi[k] = x;
+		}
+
+	GLfloat extent = 0.0f, centre[3];
+	for (int k = 0; k < 3; k++)
+	{
+		centre[k] = 0.5f * (lo[k] + hi[k]);
+		if (hi[k] - lo[k] > extent) extent = hi[k] - lo[k];
+	}
+	GLfloat scale = extent > 0.0f ? 2.0f / extent : 1.0f;
+
+	for (uint32_t v = 0; v < obj->vertex_count; v++)
+	{
+		GLfloat *p = &obj->positions[v * 3];
+		GLfloat *c = &obj->colors[v * 4];
+		for (int k = 0; k < 3; k++) p[k] = (p[k] - centre[k]) * scale;
+		if (c[0] < 0.0f)
+		{
+			c[0] = 0.5f + 0.5f * p[0];
+			c[1] = 0.5f + 0.5f * p[1];
+			c[2] = 0.5f + 0.5f * p[2];
+		}
+	}
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [options] input.obj output.mesh\n", argv0);
+	fprintf(stderr, "  -f, --format NAME   Vertex format: float, short (default) or packed\n");
+	fprintf(stderr, "  -n, --no-optimize   Keep the source triangle order\n");
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option long_options[] =
+	{
+		{ "format",      required_argument, NULL, 'f' },
+		{ "no-optimize", no_argument,       NULL, 'n' },
+		{ NULL, 0, NULL, 0 }
+	};
+	const char *format_name = "short";
+	uint32_t flags = MESH_OPTIMIZE;
+	int opt;
+
+	while ((opt = getopt_long(argc, argv, "f:n", long_options, NULL)) != -1)
+	{
+		switch (opt)
+		{
+			case 'f': format_name = optarg; break;
+			case 'n': flags &= ~MESH_OPTIMIZE; break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+	if (argc - optind != 2)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	// Same layouts as the renderer's --vertex-format
+	VERTEX_FORMAT_T format;
+	if (strcmp(format_name, "float") == 0)
+	{
+		vertex_format_init(&format, 4);
+		vertex_format_add(&format, "position", 3, GL_FLOAT, GL_FALSE);
+	}
+	else if (strcmp(format_name, "short") == 0 || strcmp(format_name, "packed") == 0)
+	{
+		// short keeps the colour on a 4-byte boundary, 12-byte vertices; packed is 10 bytes
+		vertex_format_init(&format, format_name[0] == 'p' ? 2 : 4);
+		vertex_format_add(&format, "position", 3, GL_SHORT, GL_TRUE);
+	}
+	else
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	vertex_format_add(&format, "color", 4, GL_UNSIGNED_BYTE, GL_TRUE);
+
+	OBJ_T obj;
+	memset(&obj, 0, sizeof(obj));
+	FILE *in = fopen(argv[optind], "r");
+	if (!in)
+	{
+		perror(argv[optind]);
+		return 1;
+	}
+	int result = obj_read(&obj, in);
+	fclose(in);
+	if (result != 0 || !obj.index_count)
+	{
+		fprintf(stderr, "%s: no triangles read\n", argv[optind]);
+		return 1;
+	}
+	obj_normalize(&obj);
+
+	void *encoded = malloc((size_t)obj.vertex_count * format.stride);
+	if (!encoded)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	const GLfloat *sources[2] = { obj.positions, obj.colors };
+	vertex_format_encode(&format, sources, obj.vertex_count, encoded);
+
+	if (mesh_file_write(argv[optind + 1], &format, encoded, obj.vertex_count, obj.indices, obj.index_count, flags) != 0)
+	{
+		fprintf(stderr, "%s: write failed\n", argv[optind + 1]);
+		return 1;
+	}
+	printf("%s: %u vertices, %u triangles, %u-byte %s vertices%s\n", argv[optind + 1], obj.vertex_count, obj.index_count / 3,
+		format.stride, format_name, obj.has_colors ? ", with colours" : "");
+
+	free(encoded);
+	free(obj.positions);
+	free(obj.colors);
+	free(obj.indices);
+	return 0;
+}
@@ -0,0 +1,252 @@
+/***********************************************************
+ * File: overdraw.c
+ *
+ * Description:
+ *   Fragment counting and heatmap display. See overdraw.h.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "overdraw.h"
+
+// Exactly OVERDRAW_STEP / 255, so every fragment adds the same integer step
+const GLchar *overdraw_fragment_source =
+	"precision mediump float;                       \n"
+	"void main()                                    \n"
+	"{                                              \n"
+	"    gl_FragColor = vec4(16.0 / 255.0);         \n"
+	"}                                              \n";
+
+static const GLchar *overdraw_vertex_source =
+	"uniform vec2 extent;                           \n"
+	"attribute vec2 corner;                         \n"
+	"varying mediump vec2 uv;                       \n"
+	"void main()                                    \n"
+	"{                                              \n"
+	"    uv = corner * extent;                      \n"
+	"    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);\n"
+	"}                                              \n";
+
+// 1 fragment blue, 2 green, 3 yellow, 5 red, 8 and over white
+static const GLchar *overdraw_heat_source =
+	"precision mediump float;                       \n"
+	"uniform sampler2D counts;                      \n"
+	"varying mediump vec2 uv;                       \n"
+	"void main()                                    \n"
+	"{                                              \n"
+	"    float n = texture2D(counts, uv).r * (255.0 / 16.0);\n"
+	"    vec3 c = mix(vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 0.0), clamp(n - 1.0, 0.0, 1.0));\n"
+	"    c = mix(c, vec3(1.0, 1.0, 0.0), clamp(n - 2.0, 0.0, 1.0));\n"
+	"    c = mix(c, vec3(1.0, 0.0, 0.0), clamp((n - 3.0) * 0.5, 0.0, 1.0));\n"
+	"    c = mix(c, vec3(1.0), clamp((n - 5.0) / 3.0, 0.0, 1.0));\n"
+	"    gl_FragColor = vec4(c * step(0.5, n), 1.0);\n"
+	"}                                              \n";
+
+static void overdraw_program_ready(GLuint program, void *user)
+{
+	OVERDRAW_T *od = (OVERDRAW_T *)user;
+	if (uniform_cache_init(&od->uniforms, od->cache, program) != 0)
+	{
+		fprintf(stderr, "Failed to allocate the overdraw program's uniform cache\n");
+		od->program = 0;
+		return;
+	}
+	od->program = program;
+	od->attr_corner = glGetAttribLocation(program, "corner");
+	od->uniform_extent = uniform_cache_find(&od->uniforms, "extent");
+}
+
+/***********************************************************
+ * Name: overdraw_init
+ *
+ * Arguments:
+ *   OVERDRAW_T *od = overdraw pass to initialise
+ *   GL_CACHE_T *cache = state cache used for every bind and blend change
+ *   SHADER_MANAGER_T *shaders = shader manager that builds the heatmap program
+ *   uint32_t width, uint32_t height = surface size in pixels
+ *   GLuint target = framebuffer the frame is drawn into, 0 for the window surface
+ *
+ * Description:
+ *   Creates the counting texture and its framebuffer, and requests the heatmap program.
+ *   The texture is not a power of two, so it is clamped and never mipmapped.
+ *
+ * Returns:
+ *   int = 0 on success, -1 if the counting framebuffer is not supported
+ *
+ ***********************************************************/
+int overdraw_init(OVERDRAW_T *od, GL_CACHE_T *cache, SHADER_MANAGER_T *shaders, uint32_t width, uint32_t height, GLuint target)
+{
+	static const GLfloat corners[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+
+	memset(od, 0, sizeof(*od));
+	od->cache = cache;
+	od->shaders = shaders;
+	od->width = width;
+	od->height = height;
+	od->target = target;
+	od->shader = -1;
+
+	glGenTextures(1, &od->texture);
+	gl_cache_bind_texture(cache, od->texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+	glGenFramebuffers(1, &od->framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, od->framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, od->texture, 0);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+	check();
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		overdraw_destroy(od);
+		return -1;
+	}
+
+	glGenBuffers(1, &od->vbo);
+	gl_cache_bind_buffer(cache, GL_ARRAY_BUFFER, od->vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	check();
+
+	od->shader = shader_request(shaders, overdraw_vertex_source, overdraw_heat_source, SHADER_DEFERRED, overdraw_program_ready, od);
+	return od->shader < 0 ? -1 : 0;
+}
+
+/***********************************************************
+ * Name: overdraw_begin
+ *
+ * Arguments:
+ *   OVERDRAW_T *od = overdraw pass
+ *
+ * Description:
+ *   Redirects drawing to the counting target, clears it, and locks blending to
+ *   GL_ONE, GL_ONE so draws that set their own blend state still accumulate. A scissor
+ *   set for a partial frame applies to the clear as it does to the window surface.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void overdraw_begin(OVERDRAW_T *od)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, od->framebuffer);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	gl_cache_lock_blend(od->cache, GL_FALSE);
+	gl_cache_blend(od->cache, GL_TRUE);
+	gl_cache_blend_func(od->cache, GL_ONE, GL_ONE);
+	gl_cache_lock_blend(od->cache, GL_TRUE);
+}
+
+/***********************************************************
+ * Name: overdraw_end
+ *
+ * Arguments:
+ *   OVERDRAW_T *od = overdraw pass
+ *   uint32_t viewport_width, uint32_t viewport_height = part of the target drawn this frame
+ *
+ * Description:
+ *   Unlocks blending, switches back to the frame's target and covers the viewport with
+ *   the heatmap of the counts. Draws nothing but the switch until the heatmap program
+ *   has been built.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void overdraw_end(OVERDRAW_T *od, uint32_t viewport_width, uint32_t viewport_height)
+{
+	gl_cache_lock_blend(od->cache, GL_FALSE);
+	gl_cache_blend(od->cache, GL_FALSE);
+	glBindFramebuffer(GL_FRAMEBUFFER, od->target);
+	if (!od->program) return;
+
+	gl_cache_use_program(od->cache, od->program);
+	uniform_cache_2f(&od->uniforms, od->uniform_extent, (GLfloat)viewport_width / od->width, (GLfloat)viewport_height / od->height);
+	gl_cache_bind_texture(od->cache, od->texture);
+	gl_cache_bind_buffer(od->cache, GL_ARRAY_BUFFER, od->vbo);
+	gl_cache_vertex_attrib_pointer(od->cache, od->attr_corner, 2, GL_FLOAT, GL_FALSE, 0, 0);
+	gl_cache_enable_attribs(od->cache, GL_CACHE_ATTRIB_BIT(od->attr_corner));
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	check();
+}
+
+/***********************************************************
+ * Name: overdraw_measure
+ *
+ * Arguments:
+ *   OVERDRAW_T *od = overdraw pass with at least one frame counted
+ *   uint32_t viewport_width, uint32_t viewport_height = part of the target drawn
+ *
+ * Description:
+ *   Reads the counts of the last frame back and fills in the statistics. Stalls until
+ *   the GPU is idle, so it is meant for the end of a run, not for every frame.
+ *
+ * Returns:
+ *   int = 0 on success, -1 on allocation failure
+ *
+ ***********************************************************/
+int overdraw_measure(OVERDRAW_T *od, uint32_t viewport_width, uint32_t viewport_height)
+{
+	uint32_t pixels = viewport_width * viewport_height;
+	GLubyte *rgba = malloc((size_t)pixels * 4);
+	if (!rgba) return -1;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, od->framebuffer);
+	glReadPixels(0, 0, viewport_width, viewport_height, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+	glBindFramebuffer(GL_FRAMEBUFFER, od->target);
+	check();
+
+	od->fragments = 0;
+	od->pixels = pixels;
+	od->covered = 0;
+	od->max = 0;
+	for (uint32_t i = 0; i < pixels; i++)
+	{
+		uint32_t count = (rgba[i * 4] + OVERDRAW_STEP / 2) / OVERDRAW_STEP;
+		if (count > OVERDRAW_MAX_COUNT) count = OVERDRAW_MAX_COUNT;
+		od->fragments += count;
+		if (count) od->covered++;
+		if (count > od->max) od->max = count;
+	}
+	free(rgba);
+	return 0;
+}
+
+/***********************************************************
+ * Name: overdraw_destroy
+ *
+ * Arguments:
+ *   OVERDRAW_T *od = overdraw pass created with overdraw_init()
+ *
+ * Description:
+ *   Releases the program, the counting target and the quad
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void overdraw_destroy(OVERDRAW_T *od)
+{
+	if (od->program) gl_cache_forget_program(od->cache, od->program);
+	if (od->shaders && od->shader >= 0) shader_release(od->shaders, od->shader);
+	uniform_cache_destroy(&od->uniforms);
+	if (od->vbo)
+	{
+		gl_cache_forget_buffer(od->cache, od->vbo);
+		glDeleteBuffers(1, &od->vbo);
+	}
+	if (od->framebuffer) glDeleteFramebuffers(1, &od->framebuffer);
+	if (od->texture)
+	{
+		gl_cache_forget_texture(od->cache, od->texture);
+		glDeleteTextures(1, &od->texture);
+	}
+	memset(od, 0, sizeof(*od));
+}
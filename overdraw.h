@@ -0,0 +1,60 @@
+/***********************************************************
+ * File: overdraw.h
+ *
+ * Description:
+ *   Overdraw visualisation. Scenes are built with a fragment shader that writes a
+ *   constant, and draw into an offscreen colour texture with additive blending forced
+ *   on, so each pixel ends up holding the number of fragments shaded for it. A final
+ *   full-screen pass maps that count to a heat palette: black for untouched pixels,
+ *   then blue, green, yellow and red, reaching white at 8 or more layers.
+ *
+ *   Counts are kept in 8-bit colour, so they saturate at OVERDRAW_MAX_COUNT fragments.
+ *
+ ***********************************************************/
+
+#ifndef OVERDRAW_H
+#define OVERDRAW_H
+
+#include <stdint.h>
+#include "GLES2/gl2.h"
+#include "gl_cache.h"
+#include "shader.h"
+#include "uniform_cache.h"
+
+#define OVERDRAW_STEP 16 // 8-bit colour increment per fragment
+#define OVERDRAW_MAX_COUNT (255 / OVERDRAW_STEP)
+
+// Fragment shader scenes use in place of their own while counting
+extern const GLchar *overdraw_fragment_source;
+
+typedef struct
+{
+	GL_CACHE_T *cache;
+	SHADER_MANAGER_T *shaders;
+	uint32_t width; // Size of the counting target, the surface size
+	uint32_t height;
+	GLuint target; // Framebuffer the heatmap is drawn into, 0 for the window surface
+
+	GLuint framebuffer; // Counting target
+	GLuint texture; // Its colour attachment
+	GLuint vbo; // Full-screen quad
+	int shader; // Shader manager handle of the heatmap program
+	GLuint program; // 0 until built
+	GLint attr_corner;
+	UNIFORM_CACHE_T uniforms;
+	GLint uniform_extent; // Uniform cache slot
+
+	// Statistics from the last overdraw_measure()
+	uint64_t fragments; // Sum of the counts
+	uint32_t pixels; // Pixels read back
+	uint32_t covered; // Pixels with at least one fragment
+	uint32_t max; // Highest count, OVERDRAW_MAX_COUNT when saturated
+} OVERDRAW_T;
+
+int overdraw_init(OVERDRAW_T *od, GL_CACHE_T *cache, SHADER_MANAGER_T *shaders, uint32_t width, uint32_t height, GLuint target);
+void overdraw_begin(OVERDRAW_T *od);
+void overdraw_end(OVERDRAW_T *od, uint32_t viewport_width, uint32_t viewport_height);
+int overdraw_measure(OVERDRAW_T *od, uint32_t viewport_width, uint32_t viewport_height);
+void overdraw_destroy(OVERDRAW_T *od);
+
+#endif
@@ -0,0 +1,195 @@
+/***********************************************************
+ * File: pacing.c
+ *
+ * Description:
+ *   Late frame start and frames-in-flight bound. See pacing.h.
+ *
+ ***********************************************************/
+
+#include <string.h>
+#include <time.h>
+#include "GLES2/gl2.h"
+#include "frame_clock.h"
+#include "pacing.h"
+
+// Records a vblank. Runs on a DispmanX thread, so it only takes the lock and returns.
+static void record_vsync(PACING_T *pacing, uint64_t now)
+{
+	pthread_mutex_lock(&pacing->lock);
+	if (pacing->vsync_ns)
+	{
+		// Single periods only, a missed vblank would skew the estimate
+		uint64_t delta = now - pacing->vsync_ns;
+		if (delta < pacing->period_ns * 3 / 2 && delta > pacing->period_ns / 2)
+			pacing->period_ns = (pacing->period_ns * 15 + delta) / 16;
+	}
+	pacing->vsync_ns = now;
+	pacing->vsyncs++;
+	pthread_mutex_unlock(&pacing->lock);
+}
+
+static void on_vsync(DISPMANX_UPDATE_HANDLE_T update, void *arg)
+{
+	record_vsync((PACING_T *)arg, frame_clock_now());
+}
+
+/***********************************************************
+ * Name: pacing_init
+ *
+ * Arguments:
+ *   PACING_T *pacing = pacer to initialise
+ *   EGLDisplay egl_display = display the frames are swapped on, with a current context
+ *   DISPMANX_DISPLAY_HANDLE_T display = DispmanX display whose vblanks are followed
+ *   int late_start = sleep before each frame so it starts as late as possible
+ *   uint32_t max_in_flight = unfinished frames allowed after a swap, 0 for no limit
+ *   uint32_t margin_us = slack kept before the vblank by the late start
+ *
+ * Description:
+ *   Registers the vsync callback when late start is on and looks up the fence
+ *   functions when frames in flight are bounded
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void pacing_init(PACING_T *pacing, EGLDisplay egl_display, DISPMANX_DISPLAY_HANDLE_T display,
+	int late_start, uint32_t max_in_flight, uint32_t margin_us)
+{
+	memset(pacing, 0, sizeof(*pacing));
+	pthread_mutex_init(&pacing->lock, NULL);
+	pacing->period_ns = PACING_DEFAULT_PERIOD_NS;
+	pacing->display = display;
+	pacing->late_start = late_start;
+	pacing->margin_ns = (uint64_t)margin_us * 1000;
+	pacing->max_in_flight = max_in_flight > PACING_MAX_IN_FLIGHT ? PACING_MAX_IN_FLIGHT : max_in_flight;
+	pacing->egl_display = egl_display;
+	for (int i = 0; i < PACING_MAX_IN_FLIGHT; i++) pacing->fences[i] = EGL_NO_SYNC_KHR;
+
+	if (late_start) pacing->callback = vc_dispmanx_vsync_callback(display, on_vsync, pacing) == 0;
+
+	const char *extensions = eglQueryString(egl_display, EGL_EXTENSIONS);
+	if (pacing->max_in_flight && extensions && strstr(extensions, "EGL_KHR_fence_sync"))
+	{
+		pacing->create_sync = (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+		pacing->client_wait_sync = (PFNEGLCLIENTWAITSYNCKHRPROC)eglGetProcAddress("eglClientWaitSyncKHR");
+		pacing->destroy_sync = (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+		if (!pacing->create_sync || !pacing->client_wait_sync || !pacing->destroy_sync)
+			pacing->create_sync = NULL;
+	}
+}
+
+/***********************************************************
+ * Name: pacing_wait_for_start
+ *
+ * Arguments:
+ *   PACING_T *pacing = pacer
+ *
+ * Description:
+ *   With late start, sleeps until the frame's measured busy time plus the margin
+ *   before the first vblank it can still make, so input read by the frame is as fresh
+ *   as possible when the frame is shown. Call it right before the frame reads input.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void pacing_wait_for_start(PACING_T *pacing)
+{
+	uint64_t now = frame_clock_now();
+
+	pthread_mutex_lock(&pacing->lock);
+	uint64_t vsync = pacing->vsync_ns, period = pacing->period_ns;
+	pthread_mutex_unlock(&pacing->lock);
+
+	if (pacing->late_start && vsync)
+	{
+		uint64_t lead = pacing->busy_ns + pacing->margin_ns;
+		uint64_t target = vsync + period;
+		while (target < now + lead) target += period;
+		if (target - lead > now)
+		{
+			uint64_t sleep_ns = target - lead - now;
+			struct timespec delay = { (time_t)(sleep_ns / 1000000000ull), (long)(sleep_ns % 1000000000ull) };
+			nanosleep(&delay, NULL);
+			pacing->slept_ns += sleep_ns;
+			now = frame_clock_now();
+		}
+	}
+	pacing->start_ns = now;
+	pacing->frames++;
+}
+
+// Peak hold with a slow decay, so one quick frame does not make the next one start too late
+static void record_busy(PACING_T *pacing, uint64_t busy_ns)
+{
+	if (busy_ns >= pacing->busy_ns) pacing->busy_ns = busy_ns;
+	else pacing->busy_ns -= (pacing->busy_ns - busy_ns) / 16;
+}
+
+/***********************************************************
+ * Name: pacing_frame_swapped
+ *
+ * Arguments:
+ *   PACING_T *pacing = pacer
+ *
+ * Description:
+ *   Call right after eglSwapBuffers(). Fences the frame and waits for the oldest
+ *   frames until at most max_in_flight are unfinished, then measures how long a frame
+ *   takes from start to GPU completion. The wait for a single frame in flight is exact;
+ *   with more, the oldest frame may have finished before the wait, so the measurement
+ *   is an upper bound. Without fences a single frame in flight is glFinish().
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void pacing_frame_swapped(PACING_T *pacing)
+{
+	uint64_t swapped = frame_clock_now();
+
+	// Without the callback, a blocking swap returning is the best vblank estimate there is
+	if (pacing->late_start && !pacing->callback) record_vsync(pacing, swapped);
+
+	if (!pacing->max_in_flight)
+	{
+		record_busy(pacing, swapped - pacing->start_ns);
+		return;
+	}
+	if (!pacing->create_sync)
+	{
+		if (pacing->max_in_flight == 1) glFinish();
+		uint64_t done = frame_clock_now();
+		pacing->waited_ns += done - swapped;
+		record_busy(pacing, done - pacing->start_ns);
+		return;
+	}
+
+	uint32_t slot = pacing->fence_next;
+	pacing->fences[slot] = pacing->create_sync(pacing->egl_display, EGL_SYNC_FENCE_KHR, NULL);
+	pacing->fence_start_ns[slot] = pacing->start_ns;
+	pacing->fence_next = (slot + 1) % pacing->max_in_flight;
+
+	// The slot reused next frame holds the oldest fence. Waiting for it leaves at most
+	// max_in_flight - 1 frames unfinished, so with the next frame being recorded no more
+	// than max_in_flight are ever in flight.
+	uint32_t oldest = pacing->fence_next;
+	if (pacing->fences[oldest] == EGL_NO_SYNC_KHR) return;
+	pacing->client_wait_sync(pacing->egl_display, pacing->fences[oldest], EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, EGL_FOREVER_KHR);
+	uint64_t done = frame_clock_now();
+	pacing->destroy_sync(pacing->egl_display, pacing->fences[oldest]);
+	pacing->fences[oldest] = EGL_NO_SYNC_KHR;
+	pacing->waited_ns += done - swapped;
+	record_busy(pacing, done - pacing->fence_start_ns[oldest]);
+}
+
+void pacing_destroy(PACING_T *pacing)
+{
+	if (pacing->callback) vc_dispmanx_vsync_callback(pacing->display, NULL, NULL);
+	pacing->callback = 0;
+	for (int i = 0; i < PACING_MAX_IN_FLIGHT; i++)
+	{
+		if (pacing->fences[i] != EGL_NO_SYNC_KHR) pacing->destroy_sync(pacing->egl_display, pacing->fences[i]);
+		pacing->fences[i] = EGL_NO_SYNC_KHR;
+	}
+	pthread_mutex_destroy(&pacing->lock);
+}
@@ -0,0 +1,71 @@
+/***********************************************************
+ * File: pacing.h
+ *
+ * Description:
+ *   Frame pacing for low input-to-photon latency. Left alone, the render loop runs as
+ *   fast as eglSwapBuffers() lets it and the CPU queues frames ahead of the GPU, so
+ *   whatever input a frame reads is shown several vblanks later.
+ *
+ *   Two controls, usable separately:
+ *   - Late start: vblank times come from vc_dispmanx_vsync_callback() (or swap returns
+ *     where that is unavailable), and the render thread sleeps until the latest moment
+ *     a frame can start and still finish before the next vblank. The time a frame
+ *     needs is measured from its start to GPU completion and held at its recent peak.
+ *   - Frames in flight: after each swap the loop waits until no more than the chosen
+ *     number of frames are unfinished on the GPU, with EGL_KHR_fence_sync fences, or
+ *     glFinish() for a single frame where fences are unavailable.
+ *
+ ***********************************************************/
+
+#ifndef PACING_H
+#define PACING_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "bcm_host.h"
+#include "EGL/egl.h"
+#include "EGL/eglext.h"
+
+#define PACING_MAX_IN_FLIGHT 3
+#define PACING_DEFAULT_PERIOD_NS 16666667ull // Until the vsync callback has measured it
+#define PACING_DEFAULT_MARGIN_US 1000 // Slack left before the vblank for scheduling jitter
+
+typedef struct
+{
+	// Vblank timing, written by the DispmanX callback thread
+	pthread_mutex_t lock;
+	uint64_t vsync_ns; // frame_clock_now() time of the latest vblank, 0 until the first
+	uint64_t period_ns; // Smoothed refresh period
+	uint32_t vsyncs;
+	DISPMANX_DISPLAY_HANDLE_T display; // Display whose vblanks are followed
+	int callback; // The vsync callback is registered, otherwise swap returns stand in
+
+	// Late start
+	int late_start;
+	uint64_t margin_ns;
+	uint64_t busy_ns; // Peak-held time from frame start to GPU completion
+	uint64_t start_ns; // Start of the current frame
+
+	// Frames in flight
+	uint32_t max_in_flight; // 0 leaves queueing to EGL
+	EGLDisplay egl_display;
+	EGLSyncKHR fences[PACING_MAX_IN_FLIGHT]; // Ring of unfinished frames, EGL_NO_SYNC_KHR when empty
+	uint64_t fence_start_ns[PACING_MAX_IN_FLIGHT];
+	uint32_t fence_next;
+	PFNEGLCREATESYNCKHRPROC create_sync; // NULL without EGL_KHR_fence_sync
+	PFNEGLCLIENTWAITSYNCKHRPROC client_wait_sync;
+	PFNEGLDESTROYSYNCKHRPROC destroy_sync;
+
+	// Statistics
+	uint32_t frames;
+	uint64_t slept_ns;
+	uint64_t waited_ns; // Spent blocked on the frames-in-flight bound
+} PACING_T;
+
+void pacing_init(PACING_T *pacing, EGLDisplay egl_display, DISPMANX_DISPLAY_HANDLE_T display,
+	int late_start, uint32_t max_in_flight, uint32_t margin_us);
+void pacing_wait_for_start(PACING_T *pacing);
+void pacing_frame_swapped(PACING_T *pacing);
+void pacing_destroy(PACING_T *pacing);
+
+#endif
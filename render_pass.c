@@ -0,0 +1,102 @@
+/***********************************************************
+ * File: render_pass.c
+ *
+ * Description:
+ *   Render pass load/store actions. See render_pass.h.
+ *
+ ***********************************************************/
+
+#include <string.h>
+#include "EGL/egl.h"
+#include "render_pass.h"
+
+/***********************************************************
+ * Name: render_pass_init
+ *
+ * Arguments:
+ *   RENDER_PASS_T *pass = pass to initialise
+ *   GLuint framebuffer = framebuffer object drawn to, 0 for the window surface
+ *   GLbitfield buffers = buffers it has, e.g. from the EGL config's depth and stencil sizes
+ *
+ * Description:
+ *   Looks up glDiscardFramebufferEXT. Needs a current context. The actions start as
+ *   the most conservative ones: nothing cleared, everything loaded and stored.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void render_pass_init(RENDER_PASS_T *pass, GLuint framebuffer, GLbitfield buffers)
+{
+	const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+
+	memset(pass, 0, sizeof(*pass));
+	pass->framebuffer = framebuffer;
+	pass->buffers = buffers & RENDER_PASS_BUFFERS;
+	if (extensions && strstr(extensions, "GL_EXT_discard_framebuffer"))
+		pass->discard = (PFNGLDISCARDFRAMEBUFFEREXTPROC)eglGetProcAddress("glDiscardFramebufferEXT");
+}
+
+// Masks are limited to the buffers that exist, and a cleared buffer is never also discarded first
+void render_pass_set_actions(RENDER_PASS_T *pass, GLbitfield load_clear, GLbitfield load_dont_care, GLbitfield store_discard)
+{
+	pass->load_clear = load_clear & pass->buffers;
+	pass->load_dont_care = load_dont_care & pass->buffers & ~pass->load_clear;
+	pass->store_discard = store_discard & pass->buffers;
+}
+
+// Attachment names differ between the window surface and framebuffer objects
+static void discard_buffers(RENDER_PASS_T *pass, GLbitfield buffers)
+{
+	GLenum attachments[3];
+	GLsizei count = 0;
+
+	if (!buffers || !pass->discard) return;
+	if (buffers & GL_COLOR_BUFFER_BIT) attachments[count++] = pass->framebuffer ? GL_COLOR_ATTACHMENT0 : GL_COLOR_EXT;
+	if (buffers & GL_DEPTH_BUFFER_BIT) attachments[count++] = pass->framebuffer ? GL_DEPTH_ATTACHMENT : GL_DEPTH_EXT;
+	if (buffers & GL_STENCIL_BUFFER_BIT) attachments[count++] = pass->framebuffer ? GL_STENCIL_ATTACHMENT : GL_STENCIL_EXT;
+	pass->discard(GL_FRAMEBUFFER, count, attachments);
+	pass->discards++;
+}
+
+/***********************************************************
+ * Name: render_pass_begin
+ *
+ * Arguments:
+ *   RENDER_PASS_T *pass = pass to start, its framebuffer bound
+ *
+ * Description:
+ *   Discards the don't-care buffers and clears the cleared ones in one glClear(), so
+ *   no tile has to be loaded for them. The clear honours the scissor and write masks:
+ *   under a scissor the driver has to load the tiles to keep the pixels outside it,
+ *   which is the price of a partial update.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void render_pass_begin(RENDER_PASS_T *pass)
+{
+	discard_buffers(pass, pass->load_dont_care);
+	if (pass->load_clear) glClear(pass->load_clear);
+	pass->passes++;
+}
+
+/***********************************************************
+ * Name: render_pass_end
+ *
+ * Arguments:
+ *   RENDER_PASS_T *pass = pass to finish
+ *
+ * Description:
+ *   Discards the buffers not needed after the pass. Call it after the last draw and
+ *   before eglSwapBuffers(), which is where the tiles are written out.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void render_pass_end(RENDER_PASS_T *pass)
+{
+	discard_buffers(pass, pass->store_discard);
+}
@@ -0,0 +1,51 @@
+/***********************************************************
+ * File: render_pass.h
+ *
+ * Description:
+ *   Explicit load and store actions for a frame. VideoCore IV renders one tile at a
+ *   time in on-chip memory, and every buffer whose old contents might be needed is
+ *   loaded from main memory into each tile before drawing, and every buffer that
+ *   might be read later is stored back after. A pass says up front which buffers are
+ *   cleared (no load), which are don't-care (discarded before drawing, no load) and
+ *   which are discarded at the end (no store), so the driver can skip that traffic.
+ *
+ *   Clears of all attached buffers are issued as a single glClear() at the start of
+ *   the pass, which the driver turns into a tile clear rather than a draw. Discards
+ *   use GL_EXT_discard_framebuffer where available and are skipped otherwise.
+ *
+ ***********************************************************/
+
+#ifndef RENDER_PASS_H
+#define RENDER_PASS_H
+
+#include <stdint.h>
+#include "GLES2/gl2.h"
+#include "GLES2/gl2ext.h"
+
+#define RENDER_PASS_BUFFERS (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT)
+
+typedef struct
+{
+	GLuint framebuffer; // Framebuffer the caller keeps bound, 0 for the window surface
+	GLbitfield buffers; // Buffers the framebuffer has, GL_*_BUFFER_BIT
+
+	// Load actions, buffers in neither mask are loaded
+	GLbitfield load_clear; // Cleared at the start to the current glClearColor/Depthf/Stencil values
+	GLbitfield load_dont_care; // Contents undefined at the start, discarded before drawing
+
+	// Store actions, buffers not in the mask are stored
+	GLbitfield store_discard; // Not needed after the pass
+
+	PFNGLDISCARDFRAMEBUFFEREXTPROC discard; // NULL without GL_EXT_discard_framebuffer
+
+	// Statistics
+	uint32_t passes;
+	uint32_t discards; // glDiscardFramebufferEXT() calls issued
+} RENDER_PASS_T;
+
+void render_pass_init(RENDER_PASS_T *pass, GLuint framebuffer, GLbitfield buffers);
+void render_pass_set_actions(RENDER_PASS_T *pass, GLbitfield load_clear, GLbitfield load_dont_care, GLbitfield store_discard);
+void render_pass_begin(RENDER_PASS_T *pass);
+void render_pass_end(RENDER_PASS_T *pass);
+
+#endif
@@ -0,0 +1,89 @@
+/***********************************************************
+ * File: render_scale.c
+ *
+ * Description:
+ *   Frame-time driven render scale controller. See render_scale.h.
+ *
+ ***********************************************************/
+
+#include "render_scale.h"
+
+/***********************************************************
+ * Name: render_scale_init
+ *
+ * Arguments:
+ *   RENDER_SCALE_T *rs = controller to initialise
+ *   float max_scale = highest scale, usually the static --render-scale
+ *   uint32_t target_us = frame time to hold, e.g. 16667 for 60 Hz
+ *
+ * Description:
+ *   Starts at the highest scale
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void render_scale_init(RENDER_SCALE_T *rs, float max_scale, uint32_t target_us)
+{
+	rs->max_scale = max_scale;
+	rs->min_scale = max_scale < RENDER_SCALE_MIN ? max_scale : RENDER_SCALE_MIN;
+	rs->scale = max_scale;
+	rs->target_us = target_us;
+	rs->frames = 0;
+	rs->sum_us = 0;
+	rs->wait = RENDER_SCALE_PROBE_WINDOWS;
+	rs->backoff = RENDER_SCALE_PROBE_WINDOWS;
+	rs->raised = 0;
+}
+
+/***********************************************************
+ * Name: render_scale_update
+ *
+ * Arguments:
+ *   RENDER_SCALE_T *rs = controller
+ *   uint32_t frame_us = duration of the frame just finished
+ *
+ * Description:
+ *   Accumulates frame times and, once per window, lowers the scale by a step if the
+ *   mean is more than 10% over the target, or raises it by a step after enough windows
+ *   within 2% of it. With vsync on, frames that fit are quantised to the refresh period,
+ *   so a raise is the only way to find out whether there is headroom.
+ *
+ * Returns:
+ *   int = 1 if rs->scale changed
+ *
+ ***********************************************************/
+int render_scale_update(RENDER_SCALE_T *rs, uint32_t frame_us)
+{
+	rs->sum_us += frame_us;
+	if (++rs->frames < RENDER_SCALE_WINDOW) return 0;
+
+	uint64_t mean_us = rs->sum_us / rs->frames;
+	rs->frames = 0;
+	rs->sum_us = 0;
+	float old = rs->scale;
+
+	if (mean_us * 10 > (uint64_t)rs->target_us * 11)
+	{
+		// Missed: step down now, and if this undoes a probe, probe less often
+		rs->scale -= RENDER_SCALE_STEP;
+		if (rs->scale < rs->min_scale) rs->scale = rs->min_scale;
+		if (rs->raised && rs->backoff < RENDER_SCALE_MAX_BACKOFF) rs->backoff *= 2;
+		rs->wait = rs->backoff;
+		rs->raised = 0;
+	}
+	else if (mean_us * 100 <= (uint64_t)rs->target_us * 102)
+	{
+		// Holding the target: after enough good windows, try one step up
+		rs->raised = 0;
+		if (rs->wait && --rs->wait) return 0;
+		if (rs->scale < rs->max_scale)
+		{
+			rs->scale += RENDER_SCALE_STEP;
+			if (rs->scale > rs->max_scale) rs->scale = rs->max_scale;
+			rs->raised = 1;
+		}
+		rs->wait = rs->backoff;
+	}
+	return rs->scale != old;
+}
@@ -0,0 +1,43 @@
+/***********************************************************
+ * File: render_scale.h
+ *
+ * Description:
+ *   Dynamic resolution controller. The frame is rendered into a smaller viewport of the
+ *   EGL surface and DispmanX scales that region up to the display in hardware, so fill
+ *   rate scales with the square of the render scale at no GPU cost for the upscale.
+ *   The controller watches the frame time and lowers the scale quickly when frames miss
+ *   the target, then probes back up slowly. A raise that immediately misses doubles the
+ *   wait before the next probe, so the scale settles instead of oscillating.
+ *
+ ***********************************************************/
+
+#ifndef RENDER_SCALE_H
+#define RENDER_SCALE_H
+
+#include <stdint.h>
+
+#define RENDER_SCALE_MIN 0.5f // Lowest dynamic scale
+#define RENDER_SCALE_MIN_SIZE 16 // Smallest surface or viewport side in pixels
+#define RENDER_SCALE_STEP 0.05f
+#define RENDER_SCALE_WINDOW 30 // Frames averaged per decision
+#define RENDER_SCALE_PROBE_WINDOWS 2 // Good windows needed before the first raise
+#define RENDER_SCALE_MAX_BACKOFF 64 // Longest wait between raises, in windows
+
+typedef struct
+{
+	float scale; // Current fraction of the surface size
+	float min_scale;
+	float max_scale;
+	uint32_t target_us; // Frame time to hold
+
+	uint32_t frames; // In the current window
+	uint64_t sum_us;
+	uint32_t wait; // Good windows still needed before the next raise
+	uint32_t backoff; // Wait applied after the next raise
+	int raised; // The previous decision was a raise
+} RENDER_SCALE_T;
+
+void render_scale_init(RENDER_SCALE_T *rs, float max_scale, uint32_t target_us);
+int render_scale_update(RENDER_SCALE_T *rs, uint32_t frame_us);
+
+#endif
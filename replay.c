@@ -0,0 +1,620 @@
+/***********************************************************
+ * File: replay.c
+ *
+ * Description:
+ *   Plays back a GL trace written by triangle.bin --capture, see capture.h, as fast as
+ *   the GPU allows and reports frame timings, so field captures become deterministic
+ *   benchmarks for comparing drivers and optimisations. The trace is mapped and its
+ *   records issued straight from the mapping. Setup before the first frame is timed
+ *   separately; each frame is timed from the end of the previous one to the end of its
+ *   swap, or of its glFinish() for offscreen captures.
+ *
+ *   Object names are remapped to the ones this run's driver returns, attribute locations
+ *   are bound to the captured ones before every link and uniform locations are looked up
+ *   by name after it.
+ *
+ *   Usage: replay.bin [options] trace
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "bcm_host.h"
+#include "GLES2/gl2.h"
+#include "GLES2/gl2ext.h"
+#include "EGL/egl.h"
+#include "capture.h"
+#include "frame_clock.h"
+#include "layer.h"
+#include "bench.h"
+
+#define REPLAY_MAX_UNIFORMS 64 // Per program
+#define REPLAY_NAMES_CHUNK 64 // Names generated per glGen call
+
+typedef enum
+{
+	REPLAY_BUFFERS,
+	REPLAY_TEXTURES,
+	REPLAY_FRAMEBUFFERS,
+	REPLAY_RENDERBUFFERS,
+	REPLAY_SHADERS,
+	REPLAY_PROGRAMS,
+	REPLAY_KINDS
+} REPLAY_KIND_T;
+
+typedef struct
+{
+	GLuint *names; // Indexed by captured name
+	uint32_t capacity;
+} REPLAY_NAMES_T;
+
+typedef struct
+{
+	uint32_t count;
+	int32_t captured[REPLAY_MAX_UNIFORMS];
+	GLint location[REPLAY_MAX_UNIFORMS];
+} REPLAY_UNIFORMS_T;
+
+typedef struct
+{
+	// Display
+	EGLDisplay display;
+	EGLContext context;
+	LAYER_T layer;
+
+	// Mapped trace
+	const uint8_t *trace;
+	size_t size;
+	const CAPTURE_HEADER_T *header;
+
+	// Captured to replayed translation
+	REPLAY_NAMES_T names[REPLAY_KINDS];
+	REPLAY_UNIFORMS_T *uniforms; // Indexed by captured program name
+	uint32_t uniform_capacity;
+	uint32_t program; // Captured name of the program in use
+
+	PFNGLDISCARDFRAMEBUFFEREXTPROC discard;
+	void *pixels; // glReadPixels() destination
+	size_t pixel_bytes;
+	uint32_t unknown; // Records of an op this build does not know
+} REPLAY_T;
+static REPLAY_T _replay, *replay=&_replay;
+
+// Grows a zero-filled array to hold index, returns -1 on allocation failure
+static int replay_reserve(void **array, uint32_t *capacity, uint32_t index, size_t element)
+{
+	if (index < *capacity) return 0;
+	uint32_t grown = *capacity ? *capacity : 256;
+	while (grown <= index) grown *= 2;
+	uint8_t *p = realloc(*array, grown * element);
+	if (!p) return -1;
+	memset(p + *capacity * element, 0, (grown - *capacity) * element);
+	*array = p;
+	*capacity = grown;
+	return 0;
+}
+
+static GLuint replay_name(REPLAY_KIND_T kind, uint32_t captured)
+{
+	const REPLAY_NAMES_T *names = &replay->names[kind];
+	return captured < names->capacity ? names->names[captured] : 0;
+}
+
+static int replay_set_name(REPLAY_KIND_T kind, uint32_t captured, GLuint name)
+{
+	REPLAY_NAMES_T *names = &replay->names[kind];
+	if (replay_reserve((void **)&names->names, &names->capacity, captured, sizeof(GLuint)) != 0) return -1;
+	names->names[captured] = name;
+	return 0;
+}
+
+static GLint replay_uniform(int32_t captured)
+{
+	if (captured < 0 || replay->program >= replay->uniform_capacity) return -1;
+	const REPLAY_UNIFORMS_T *uniforms = &replay->uniforms[replay->program];
+	for (uint32_t i = 0; i < uniforms->count; i++)
+		if (uniforms->captured[i] == captured) return uniforms->location[i];
+	return -1;
+}
+
+// Creates objects for the captured names of a glGen* record
+static int replay_gen(REPLAY_KIND_T kind, const uint32_t *captured, uint32_t n)
+{
+	GLuint names[REPLAY_NAMES_CHUNK];
+	for (uint32_t i = 0; i < n; i += REPLAY_NAMES_CHUNK)
+	{
+		uint32_t count = n - i < REPLAY_NAMES_CHUNK ? n - i : REPLAY_NAMES_CHUNK;
+		switch (kind)
+		{
+			case REPLAY_BUFFERS: glGenBuffers(count, names); break;
+			case REPLAY_TEXTURES: glGenTextures(count, names); break;
+			case REPLAY_FRAMEBUFFERS: glGenFramebuffers(count, names); break;
+			default: glGenRenderbuffers(count, names); break;
+		}
+		for (uint32_t k = 0; k < count; k++)
+			if (replay_set_name(kind, captured[i + k], names[k]) != 0) return -1;
+	}
+	return 0;
+}
+
+static void replay_delete(REPLAY_KIND_T kind, const uint32_t *captured, uint32_t n)
+{
+	for (uint32_t i = 0; i < n; i++)
+	{
+		GLuint name = replay_name(kind, captured[i]);
+		if (!name) continue;
+		switch (kind)
+		{
+			case REPLAY_BUFFERS: glDeleteBuffers(1, &name); break;
+			case REPLAY_TEXTURES: glDeleteTextures(1, &name); break;
+			case REPLAY_FRAMEBUFFERS: glDeleteFramebuffers(1, &name); break;
+			default: glDeleteRenderbuffers(1, &name); break;
+		}
+		replay_set_name(kind, captured[i], 0);
+	}
+}
+
+/***********************************************************
+ * Name: replay_link
+ *
+ * Arguments:
+ *   uint32_t captured = program name in the trace
+ *   const uint8_t *data, uint32_t bytes = CAPTURE_LINK_ENTRY_T list of the record
+ *
+ * Description:
+ *   Binds every captured attribute location, links, then builds the program's uniform
+ *   location table from the captured names
+ *
+ * Returns:
+ *   int = 0 on success, -1 for a malformed entry list
+ *
+ ***********************************************************/
+static int replay_link(uint32_t captured, const uint8_t *data, uint32_t bytes)
+{
+	GLuint program = replay_name(REPLAY_PROGRAMS, captured);
+	if (replay_reserve((void **)&replay->uniforms, &replay->uniform_capacity, captured, sizeof(REPLAY_UNIFORMS_T)) != 0) return -1;
+	REPLAY_UNIFORMS_T *uniforms = &replay->uniforms[captured];
+	uniforms->count = 0;
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		if (pass == 1) glLinkProgram(program);
+		for (uint32_t at = 0; at < bytes; )
+		{
+			CAPTURE_LINK_ENTRY_T entry;
+			if (bytes - at < sizeof(entry)) return -1;
+			memcpy(&entry, data + at, sizeof(entry));
+			const char *name = (const char *)data + at + sizeof(entry);
+			uint32_t padded = (entry.name_bytes + 3) & ~3u;
+			if (!entry.name_bytes || padded > bytes - at - sizeof(entry) || name[entry.name_bytes - 1]) return -1;
+			at += sizeof(entry) + padded;
+
+			if (pass == 0 && entry.kind == CAPTURE_LINK_ATTRIB && entry.location >= 0)
+				glBindAttribLocation(program, (GLuint)entry.location, name);
+			else if (pass == 1 && entry.kind == CAPTURE_LINK_UNIFORM && entry.location >= 0 && uniforms->count < REPLAY_MAX_UNIFORMS)
+			{
+				uniforms->captured[uniforms->count] = entry.location;
+				uniforms->location[uniforms->count++] = glGetUniformLocation(program, name);
+			}
+		}
+	}
+	return 0;
+}
+
+// Issues one record other than the frame markers, returns -1 if it cannot be replayed
+static int replay_record(uint16_t op, const uint32_t *a, uint16_t arg_count, const uint8_t *data, uint32_t data_bytes)
+{
+	static const uint8_t arg_counts[CAPTURE_OP_COUNT] =
+	{
+		[CAPTURE_OP_ACTIVE_TEXTURE] = 1, [CAPTURE_OP_ATTACH_SHADER] = 2, [CAPTURE_OP_BIND_BUFFER] = 2,
+		[CAPTURE_OP_BIND_FRAMEBUFFER] = 2, [CAPTURE_OP_BIND_RENDERBUFFER] = 2, [CAPTURE_OP_BIND_TEXTURE] = 2,
+		[CAPTURE_OP_BLEND_FUNC] = 2, [CAPTURE_OP_BUFFER_DATA] = 4, [CAPTURE_OP_BUFFER_SUB_DATA] = 3,
+		[CAPTURE_OP_CLEAR] = 1, [CAPTURE_OP_CLEAR_COLOR] = 4, [CAPTURE_OP_COMPILE_SHADER] = 1,
+		[CAPTURE_OP_COMPRESSED_TEX_IMAGE_2D] = 6, [CAPTURE_OP_CREATE_PROGRAM] = 1, [CAPTURE_OP_CREATE_SHADER] = 2,
+		[CAPTURE_OP_DELETE_PROGRAM] = 1, [CAPTURE_OP_DELETE_SHADER] = 1, [CAPTURE_OP_DISABLE] = 1,
+		[CAPTURE_OP_DISABLE_VERTEX_ATTRIB_ARRAY] = 1, [CAPTURE_OP_DISCARD_FRAMEBUFFER] = 1, [CAPTURE_OP_DRAW_ARRAYS] = 3,
+		[CAPTURE_OP_DRAW_ELEMENTS] = 4, [CAPTURE_OP_ENABLE] = 1, [CAPTURE_OP_ENABLE_VERTEX_ATTRIB_ARRAY] = 1,
+		[CAPTURE_OP_FRAMEBUFFER_RENDERBUFFER] = 4, [CAPTURE_OP_FRAMEBUFFER_TEXTURE_2D] = 5, [CAPTURE_OP_LINK_PROGRAM] = 1,
+		[CAPTURE_OP_PIXEL_STOREI] = 2, [CAPTURE_OP_READ_PIXELS] = 6, [CAPTURE_OP_RENDERBUFFER_STORAGE] = 4,
+		[CAPTURE_OP_SCISSOR] = 4, [CAPTURE_OP_SHADER_SOURCE] = 1, [CAPTURE_OP_TEX_IMAGE_2D] = 9,
+		[CAPTURE_OP_TEX_PARAMETERI] = 3, [CAPTURE_OP_TEX_SUB_IMAGE_2D] = 8, [CAPTURE_OP_UNIFORM_1F] = 2,
+		[CAPTURE_OP_UNIFORM_1I] = 2, [CAPTURE_OP_UNIFORM_2FV] = 2, [CAPTURE_OP_UNIFORM_4FV] = 2,
+		[CAPTURE_OP_USE_PROGRAM] = 1, [CAPTURE_OP_VERTEX_ATTRIB_POINTER] = 6, [CAPTURE_OP_VIEWPORT] = 4,
+	};
+	GLfloat f[4];
+
+	if (op >= CAPTURE_OP_COUNT)
+	{
+		replay->unknown++;
+		return 0;
+	}
+	if (arg_count < arg_counts[op]) return -1;
+
+	switch (op)
+	{
+		case CAPTURE_OP_ACTIVE_TEXTURE: glActiveTexture(a[0]); break;
+		case CAPTURE_OP_ATTACH_SHADER: glAttachShader(replay_name(REPLAY_PROGRAMS, a[0]), replay_name(REPLAY_SHADERS, a[1])); break;
+		case CAPTURE_OP_BIND_BUFFER: glBindBuffer(a[0], replay_name(REPLAY_BUFFERS, a[1])); break;
+		case CAPTURE_OP_BIND_FRAMEBUFFER: glBindFramebuffer(a[0], replay_name(REPLAY_FRAMEBUFFERS, a[1])); break;
+		case CAPTURE_OP_BIND_RENDERBUFFER: glBindRenderbuffer(a[0], replay_name(REPLAY_RENDERBUFFERS, a[1])); break;
+		case CAPTURE_OP_BIND_TEXTURE: glBindTexture(a[0], replay_name(REPLAY_TEXTURES, a[1])); break;
+		case CAPTURE_OP_BLEND_FUNC: glBlendFunc(a[0], a[1]); break;
+		case CAPTURE_OP_BUFFER_DATA:
+			if (a[3] && data_bytes < a[1]) return -1;
+			glBufferData(a[0], a[1], a[3] ? data : NULL, a[2]);
+			break;
+		case CAPTURE_OP_BUFFER_SUB_DATA:
+			if (data_bytes < a[2]) return -1;
+			glBufferSubData(a[0], a[1], a[2], data);
+			break;
+		case CAPTURE_OP_CLEAR: glClear(a[0]); break;
+		case CAPTURE_OP_CLEAR_COLOR:
+			memcpy(f, a, sizeof(f));
+			glClearColor(f[0], f[1], f[2], f[3]);
+			break;
+		case CAPTURE_OP_COMPILE_SHADER: glCompileShader(replay_name(REPLAY_SHADERS, a[0])); break;
+		case CAPTURE_OP_COMPRESSED_TEX_IMAGE_2D:
+			glCompressedTexImage2D(a[0], a[1], a[2], a[3], a[4], a[5], data_bytes, data_bytes ? data : NULL);
+			break;
+		case CAPTURE_OP_CREATE_PROGRAM: return replay_set_name(REPLAY_PROGRAMS, a[0], glCreateProgram());
+		case CAPTURE_OP_CREATE_SHADER: return replay_set_name(REPLAY_SHADERS, a[1], glCreateShader(a[0]));
+		case CAPTURE_OP_DELETE_BUFFERS: replay_delete(REPLAY_BUFFERS, (const uint32_t *)data, data_bytes / 4); break;
+		case CAPTURE_OP_DELETE_FRAMEBUFFERS: replay_delete(REPLAY_FRAMEBUFFERS, (const uint32_t *)data, data_bytes / 4); break;
+		case CAPTURE_OP_DELETE_PROGRAM:
+			glDeleteProgram(replay_name(REPLAY_PROGRAMS, a[0]));
+			if (a[0] < replay->uniform_capacity) replay->uniforms[a[0]].count = 0;
+			return replay_set_name(REPLAY_PROGRAMS, a[0], 0);
+		case CAPTURE_OP_DELETE_RENDERBUFFERS: replay_delete(REPLAY_RENDERBUFFERS, (const uint32_t *)data, data_bytes / 4); break;
+		case CAPTURE_OP_DELETE_SHADER:
+			glDeleteShader(replay_name(REPLAY_SHADERS, a[0]));
+			return replay_set_name(REPLAY_SHADERS, a[0], 0);
+		case CAPTURE_OP_DELETE_TEXTURES: replay_delete(REPLAY_TEXTURES, (const uint32_t *)data, data_bytes / 4); break;
+		case CAPTURE_OP_DISABLE: glDisable(a[0]); break;
+		case CAPTURE_OP_DISABLE_VERTEX_ATTRIB_ARRAY: glDisableVertexAttribArray(a[0]); break;
+		case CAPTURE_OP_DISCARD_FRAMEBUFFER:
+			if (replay->discard) replay->discard(a[0], data_bytes / 4, (const GLenum *)data);
+			break;
+		case CAPTURE_OP_DRAW_ARRAYS: glDrawArrays(a[0], a[1], a[2]); break;
+		case CAPTURE_OP_DRAW_ELEMENTS:
+			glDrawElements(a[0], a[1], a[2], data_bytes ? (const void *)data : (const void *)(uintptr_t)a[3]);
+			break;
+		case CAPTURE_OP_ENABLE: glEnable(a[0]); break;
+		case CAPTURE_OP_ENABLE_VERTEX_ATTRIB_ARRAY: glEnableVertexAttribArray(a[0]); break;
+		case CAPTURE_OP_FINISH: glFinish(); break;
+		case CAPTURE_OP_FLUSH: glFlush(); break;
+		case CAPTURE_OP_FRAMEBUFFER_RENDERBUFFER:
+			glFramebufferRenderbuffer(a[0], a[1], a[2], replay_name(REPLAY_RENDERBUFFERS, a[3]));
+			break;
+		case CAPTURE_OP_FRAMEBUFFER_TEXTURE_2D:
+			glFramebufferTexture2D(a[0], a[1], a[2], replay_name(REPLAY_TEXTURES, a[3]), a[4]);
+			break;
+		case CAPTURE_OP_GEN_BUFFERS: return replay_gen(REPLAY_BUFFERS, (const uint32_t *)data, data_bytes / 4);
+		case CAPTURE_OP_GEN_FRAMEBUFFERS: return replay_gen(REPLAY_FRAMEBUFFERS, (const uint32_t *)data, data_bytes / 4);
+		case CAPTURE_OP_GEN_RENDERBUFFERS: return replay_gen(REPLAY_RENDERBUFFERS, (const uint32_t *)data, data_bytes / 4);
+		case CAPTURE_OP_GEN_TEXTURES: return replay_gen(REPLAY_TEXTURES, (const uint32_t *)data, data_bytes / 4);
+		case CAPTURE_OP_LINK_PROGRAM: return replay_link(a[0], data, data_bytes);
+		case CAPTURE_OP_PIXEL_STOREI: glPixelStorei(a[0], a[1]); break;
+		case CAPTURE_OP_READ_PIXELS:
+		{
+			// Only the synchronisation matters, RGBA is the largest format GLES2 reads
+			size_t bytes = (size_t)a[2] * a[3] * 4;
+			if (bytes > replay->pixel_bytes)
+			{
+				void *p = realloc(replay->pixels, bytes);
+				if (!p) return -1;
+				replay->pixels = p;
+				replay->pixel_bytes = bytes;
+			}
+			glReadPixels(a[0], a[1], a[2], a[3], a[4], a[5], replay->pixels);
+			break;
+		}
+		case CAPTURE_OP_RENDERBUFFER_STORAGE: glRenderbufferStorage(a[0], a[1], a[2], a[3]); break;
+		case CAPTURE_OP_SCISSOR: glScissor(a[0], a[1], a[2], a[3]); break;
+		case CAPTURE_OP_SHADER_SOURCE:
+		{
+			const GLchar *source = (const GLchar *)data;
+			GLint length = (GLint)data_bytes;
+			glShaderSource(replay_name(REPLAY_SHADERS, a[0]), 1, &source, &length);
+			break;
+		}
+		case CAPTURE_OP_TEX_IMAGE_2D:
+			glTexImage2D(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8] && data_bytes ? data : NULL);
+			break;
+		case CAPTURE_OP_TEX_PARAMETERI: glTexParameteri(a[0], a[1], a[2]); break;
+		case CAPTURE_OP_TEX_SUB_IMAGE_2D:
+			if (data_bytes) glTexSubImage2D(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], data);
+			break;
+		case CAPTURE_OP_UNIFORM_1F:
+			memcpy(f, &a[1], sizeof(GLfloat));
+			glUniform1f(replay_uniform((int32_t)a[0]), f[0]);
+			break;
+		case CAPTURE_OP_UNIFORM_1I: glUniform1i(replay_uniform((int32_t)a[0]), a[1]); break;
+		case CAPTURE_OP_UNIFORM_2FV:
+			if (data_bytes < a[1] * 2 * sizeof(GLfloat)) return -1;
+			glUniform2fv(replay_uniform((int32_t)a[0]), a[1], (const GLfloat *)data);
+			break;
+		case CAPTURE_OP_UNIFORM_4FV:
+			if (data_bytes < a[1] * 4 * sizeof(GLfloat)) return -1;
+			glUniform4fv(replay_uniform((int32_t)a[0]), a[1], (const GLfloat *)data);
+			break;
+		case CAPTURE_OP_USE_PROGRAM:
+			replay->program = a[0];
+			glUseProgram(replay_name(REPLAY_PROGRAMS, a[0]));
+			break;
+		case CAPTURE_OP_VERTEX_ATTRIB_POINTER:
+			glVertexAttribPointer(a[0], a[1], a[2], (GLboolean)a[3], a[4], (const void *)(uintptr_t)a[5]);
+			break;
+		case CAPTURE_OP_VIEWPORT: glViewport(a[0], a[1], a[2], a[3]); break;
+		default: replay->unknown++; break;
+	}
+	return 0;
+}
+
+/***********************************************************
+ * Name: replay_init_display
+ *
+ * Arguments:
+ *   uint32_t width, uint32_t height = surface size, 0 for the display size
+ *   uint32_t depth_bits, uint32_t stencil_bits = buffers the capture had
+ *   EGLint swap_interval = 0 to replay as fast as possible
+ *   int preserved = keep the back buffer across swaps, as the captured surface did
+ *
+ * Description:
+ *   Full-screen layer on the main display with a current context, as triangle.bin
+ *   sets up. A smaller surface is scaled up by DispmanX like a reduced render scale.
+ *   Damage-tracked captures only redraw what changed, so they need preserved swaps
+ *   to replay the same work.
+ *
+ * Returns:
+ *   int = 0 on success, -1 on any EGL or DispmanX failure, including preserved swaps
+ *     being unavailable
+ *
+ ***********************************************************/
+static int replay_init_display(uint32_t width, uint32_t height, uint32_t depth_bits, uint32_t stencil_bits, EGLint swap_interval, int preserved)
+{
+	const EGLint attribute_list[] =
+	{
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_DEPTH_SIZE, (EGLint)depth_bits,
+		EGL_STENCIL_SIZE, (EGLint)stencil_bits,
+		EGL_SURFACE_TYPE, EGL_WINDOW_BIT | (preserved ? EGL_SWAP_BEHAVIOR_PRESERVED_BIT : 0),
+		EGL_NONE
+	};
+	static const EGLint context_attributes[] =
+	{
+		EGL_CONTEXT_CLIENT_VERSION, 2,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint num_config = 0;
+	uint32_t display_width, display_height;
+	VC_RECT_T dst_rect;
+
+	bcm_host_init();
+	replay->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (replay->display == EGL_NO_DISPLAY || !eglInitialize(replay->display, NULL, NULL)) return -1;
+	if (!eglChooseConfig(replay->display, attribute_list, &config, 1, &num_config) || !num_config) return -1;
+	if (!eglBindAPI(EGL_OPENGL_ES_API)) return -1;
+	replay->context = eglCreateContext(replay->display, config, EGL_NO_CONTEXT, context_attributes);
+	if (replay->context == EGL_NO_CONTEXT) return -1;
+
+	if (layer_display_size(LAYER_DISPLAY_MAIN, &display_width, &display_height) < 0) return -1;
+	if (!width || width > display_width) width = display_width;
+	if (!height || height > display_height) height = display_height;
+	dst_rect.x = 0;
+	dst_rect.y = 0;
+	dst_rect.width = display_width;
+	dst_rect.height = display_height;
+	if (layer_create(&replay->layer, replay->display, config, LAYER_DISPLAY_MAIN, 0, &dst_rect, width, height, 0) != 0) return -1;
+	if (!eglMakeCurrent(replay->display, replay->layer.surface, replay->layer.surface, replay->context)) return -1;
+	eglSwapInterval(replay->display, swap_interval);
+	if (preserved)
+	{
+		EGLint behavior = EGL_BUFFER_DESTROYED;
+		if (eglSurfaceAttrib(replay->display, replay->layer.surface, EGL_SWAP_BEHAVIOR, EGL_BUFFER_PRESERVED))
+			eglQuerySurface(replay->display, replay->layer.surface, EGL_SWAP_BEHAVIOR, &behavior);
+		if (behavior != EGL_BUFFER_PRESERVED) return -1;
+	}
+
+	replay->discard = (PFNGLDISCARDFRAMEBUFFEREXTPROC)eglGetProcAddress("glDiscardFramebufferEXT");
+	return 0;
+}
+
+static void replay_exit_display(void)
+{
+	eglMakeCurrent(replay->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	layer_destroy(&replay->layer, replay->display);
+	eglDestroyContext(replay->display, replay->context);
+	eglTerminate(replay->display);
+}
+
+// Maps the trace and validates its header
+static int replay_open(const char *path)
+{
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return -1;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CAPTURE_HEADER_T))
+	{
+		close(fd);
+		return -1;
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return -1;
+
+	replay->trace = map;
+	replay->size = st.st_size;
+	replay->header = map;
+	if (replay->header->magic != CAPTURE_MAGIC || replay->header->version != CAPTURE_VERSION ||
+		replay->header->header_bytes < sizeof(CAPTURE_HEADER_T) || replay->header->header_bytes > replay->size)
+	{
+		munmap(map, st.st_size);
+		return -1;
+	}
+	return 0;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "Usage: %s [options] trace\n", argv0);
+	fprintf(stderr, "  -w, --warmup N         Leave the first N frames out of the results (default 0)\n");
+	fprintf(stderr, "  -s, --swap-interval N  eglSwapInterval for presented frames (default 0, full speed)\n");
+	fprintf(stderr, "  -o, --output FILE      Also write the results as benchmark JSON to FILE\n");
+	fprintf(stderr, "  -f, --per-frame        Print the timings of every frame\n");
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option long_options[] =
+	{
+		{ "warmup",        required_argument, NULL, 'w' },
+		{ "swap-interval", required_argument, NULL, 's' },
+		{ "output",        required_argument, NULL, 'o' },
+		{ "per-frame",     no_argument,       NULL, 'f' },
+		{ NULL, 0, NULL, 0 }
+	};
+	static FRAME_CLOCK_T _clock, *clock=&_clock;
+	uint32_t warmup = 0;
+	EGLint swap_interval = 0;
+	const char *output_path = NULL;
+	int per_frame = 0, opt, status = 0;
+
+	while ((opt = getopt_long(argc, argv, "w:s:o:f", long_options, NULL)) != -1)
+	{
+		switch (opt)
+		{
+			case 'w': warmup = (uint32_t)strtoul(optarg, NULL, 10); break;
+			case 's': swap_interval = (EGLint)strtol(optarg, NULL, 10); break;
+			case 'o': output_path = optarg; break;
+			case 'f': per_frame = 1; break;
+			default: usage(argv[0]); return 1;
+		}
+	}
+	if (argc - optind != 1)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	if (replay_open(argv[optind]) != 0)
+	{
+		fprintf(stderr, "%s: not a version %d GL trace\n", argv[optind], CAPTURE_VERSION);
+		return 1;
+	}
+	const CAPTURE_HEADER_T *header = replay->header;
+	if (header->flags & CAPTURE_FLAG_CLIENT_ARRAYS)
+	{
+		fprintf(stderr, "%s: captured with client-side vertex arrays, which the trace does not hold\n", argv[optind]);
+		return 1;
+	}
+	int preserved = (header->flags & CAPTURE_FLAG_PRESERVED) != 0;
+	if (replay_init_display(header->width, header->height, header->depth_bits, header->stencil_bits, swap_interval, preserved) != 0)
+	{
+		fprintf(stderr, "Unable to create a %ux%u window surface%s\n", header->width, header->height, preserved ? " with preserved swaps" : "");
+		return 1;
+	}
+
+	// Records are issued straight from the mapping, they are 4-byte aligned in it
+	uint64_t setup_start = frame_clock_now(), setup_ns = 0;
+	uint32_t frames = 0, records = 0;
+	int in_setup = 1;
+	size_t at = header->header_bytes;
+	frame_clock_init(clock);
+	frame_clock_begin(clock);
+	while (at < replay->size)
+	{
+		CAPTURE_RECORD_T record;
+		if (replay->size - at < sizeof(record)) break;
+		memcpy(&record, replay->trace + at, sizeof(record));
+		size_t args_bytes = record.arg_count * sizeof(uint32_t);
+		size_t padded = ((size_t)record.data_bytes + 3) & ~(size_t)3;
+		if (replay->size - at - sizeof(record) < args_bytes + padded) break;
+		const uint32_t *args = (const uint32_t *)(replay->trace + at + sizeof(record));
+		const uint8_t *data = replay->trace + at + sizeof(record) + args_bytes;
+		at += sizeof(record) + args_bytes + padded;
+		records++;
+
+		// Setup ends at its marker, or at the first frame in a trace without one
+		if (in_setup && (record.op == CAPTURE_OP_SETUP_DONE || record.op == CAPTURE_OP_FRAME))
+		{
+			glFinish();
+			setup_ns = frame_clock_now() - setup_start;
+			in_setup = 0;
+			frame_clock_init(clock);
+			frame_clock_begin(clock);
+			if (record.op == CAPTURE_OP_SETUP_DONE) continue;
+		}
+		if (record.op == CAPTURE_OP_SETUP_DONE) continue;
+
+		if (record.op == CAPTURE_OP_FRAME)
+		{
+			frame_clock_submitted(clock);
+			if (record.arg_count && args[0]) eglSwapBuffers(replay->display, replay->layer.surface);
+			else glFinish();
+
+			// The next frame starts now, which also makes frame_us the period of this one
+			frame_clock_begin(clock);
+			frame_clock_swapped(clock);
+			if (per_frame)
+				printf("frame %u: submit %.3f ms, swap %.3f ms, frame %.3f ms\n", frames,
+					clock->submit_us / 1000.0, clock->swap_us / 1000.0, clock->frame_us / 1000.0);
+			if (++frames == warmup) frame_clock_reset_histograms(clock);
+			continue;
+		}
+
+		if (replay_record(record.op, args, record.arg_count, data, record.data_bytes) != 0)
+		{
+			fprintf(stderr, "%s: malformed record %u (op %u)\n", argv[optind], records, record.op);
+			status = 1;
+			break;
+		}
+	}
+	if (at < replay->size && !status)
+	{
+		fprintf(stderr, "%s: truncated after %u records\n", argv[optind], records);
+		status = 1;
+	}
+
+	const HISTOGRAM_T *frame = &clock->frame_hist;
+	printf("%u frames, %u records, setup %.1f ms", frames, records, setup_ns / 1e6);
+	if (frame->count)
+		printf(", frame ms min %.3f avg %.3f p99 %.3f max %.3f, submit ms avg %.3f, swap ms avg %.3f, %.2f fps",
+			frame->min / 1000.0, histogram_mean(frame) / 1000.0, histogram_percentile(frame, 99.0) / 1000.0, frame->max / 1000.0,
+			histogram_mean(&clock->submit_hist) / 1000.0, histogram_mean(&clock->swap_hist) / 1000.0,
+			frame->sum ? 1e6 * frame->count / (double)frame->sum : 0.0);
+	if (replay->unknown) printf(", %u unknown records skipped", replay->unknown);
+	printf("\n");
+
+	if (output_path)
+	{
+		BENCH_CONFIG_T bench =
+		{
+			.warmup_frames = warmup,
+			.measured_frames = frame->count,
+			.output_path = output_path,
+			.swap_interval = swap_interval,
+			.offscreen = (header->flags & CAPTURE_FLAG_OFFSCREEN) != 0,
+			.render_pass = "replay",
+			.depth_bits = (int)header->depth_bits,
+			.stencil_bits = (int)header->stencil_bits
+		};
+		if (bench_write_json(&bench, clock, replay->layer.width, replay->layer.height) != 0)
+		{
+			fprintf(stderr, "Unable to write %s\n", output_path);
+			status = 1;
+		}
+	}
+
+	replay_exit_display();
+	munmap((void *)replay->trace, replay->size);
+	return status;
+}
@@ -0,0 +1,286 @@
+/***********************************************************
+ * File: scene_graph.c
+ *
+ * Description:
+ *   Structure-of-arrays scene nodes, uniform grid index and viewport culling. See
+ *   scene_graph.h.
+ *
+ ***********************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "scene_graph.h"
+
+#define SCENE_GRAPH_CELLS_PER_NODE 4 // The grid is coarsened beyond this many cells per node
+
+/***********************************************************
+ * Name: scene_graph_init
+ *
+ * Arguments:
+ *   SCENE_GRAPH_T *graph = scene graph to initialise
+ *   uint32_t capacity = most nodes it will hold
+ *   GLfloat cell_size = side of a grid cell in world units, a fraction of the view
+ *     size works well
+ *
+ * Description:
+ *   Allocates every node column up front, so adding nodes never reallocates
+ *
+ * Returns:
+ *   int = 0 on success, -1 on allocation failure
+ *
+ ***********************************************************/
+int scene_graph_init(SCENE_GRAPH_T *graph, uint32_t capacity, GLfloat cell_size)
+{
+	memset(graph, 0, sizeof(*graph));
+	graph->capacity = capacity;
+	graph->cell_size = cell_size > 0.0f ? cell_size : 1.0f;
+	graph->index_stale = 1;
+
+	graph->x = malloc(capacity * sizeof(GLfloat));
+	graph->y = malloc(capacity * sizeof(GLfloat));
+	graph->radius = malloc(capacity * sizeof(GLfloat));
+	graph->scale = malloc(capacity * sizeof(GLfloat));
+	graph->rotation = malloc(capacity * sizeof(GLfloat));
+	graph->spin = malloc(capacity * sizeof(GLfloat));
+	graph->shape = malloc(capacity * sizeof(uint32_t));
+	graph->color = malloc(capacity * sizeof(graph->color[0]));
+	graph->cell_nodes = malloc(capacity * sizeof(uint32_t));
+	graph->visible_bits = malloc((capacity + 31) / 32 * sizeof(uint32_t));
+	graph->visible = malloc(capacity * sizeof(uint32_t));
+	if (!graph->x || !graph->y || !graph->radius || !graph->scale || !graph->rotation || !graph->spin ||
+		!graph->shape || !graph->color || !graph->cell_nodes || !graph->visible_bits || !graph->visible)
+	{
+		scene_graph_destroy(graph);
+		return -1;
+	}
+	return 0;
+}
+
+/***********************************************************
+ * Name: scene_graph_add
+ *
+ * Arguments:
+ *   SCENE_GRAPH_T *graph = scene graph
+ *   const BATCH_PRIMITIVE_T *primitive = shape, world position, scale, initial rotation
+ *     and colour of the node
+ *   GLfloat radius = bounding circle around the position, covering the rotated shape
+ *   GLfloat spin = angular velocity in radians per second
+ *
+ * Description:
+ *   Appends a node. The index is rebuilt by the next cull.
+ *
+ * Returns:
+ *   int = node id, or -1 when the graph is full
+ *
+ ***********************************************************/
+int scene_graph_add(SCENE_GRAPH_T *graph, const BATCH_PRIMITIVE_T *primitive, GLfloat radius, GLfloat spin)
+{
+	if (graph->count == graph->capacity) return -1;
+
+	uint32_t node = graph->count++;
+	graph->x[node] = primitive->x;
+	graph->y[node] = primitive->y;
+	graph->radius[node] = radius;
+	graph->scale[node] = primitive->scale;
+	graph->rotation[node] = primitive->rotation;
+	graph->spin[node] = spin;
+	graph->shape[node] = primitive->shape;
+	memcpy(graph->color[node], primitive->color, sizeof(graph->color[node]));
+	graph->index_stale = 1;
+	return (int)node;
+}
+
+void scene_graph_move(SCENE_GRAPH_T *graph, uint32_t node, GLfloat x, GLfloat y)
+{
+	if (node >= graph->count) return;
+	graph->x[node] = x;
+	graph->y[node] = y;
+	graph->index_stale = 1;
+}
+
+static uint32_t scene_graph_cell(const SCENE_GRAPH_T *graph, GLfloat x, GLfloat y)
+{
+	uint32_t column = (uint32_t)((x - graph->min_x) / graph->cell_size);
+	uint32_t row = (uint32_t)((y - graph->min_y) / graph->cell_size);
+	if (column >= graph->columns) column = graph->columns - 1;
+	if (row >= graph->rows) row = graph->rows - 1;
+	return row * graph->columns + column;
+}
+
+/***********************************************************
+ * Name: scene_graph_build_index
+ *
+ * Arguments:
+ *   SCENE_GRAPH_T *graph = scene graph
+ *
+ * Description:
+ *   Sizes the grid to the bounds of the node centres and files every node under the
+ *   cell holding its centre, with a counting sort so each cell's ids stay ascending.
+ *   Sparse scenes get larger cells, the grid never has more than
+ *   SCENE_GRAPH_CELLS_PER_NODE cells per node.
+ *
+ * Returns:
+ *   int = 0 on success, -1 on allocation failure
+ *
+ ***********************************************************/
+int scene_graph_build_index(SCENE_GRAPH_T *graph)
+{
+	uint32_t n = graph->count;
+	GLfloat min_x = 0.0f, min_y = 0.0f, max_x = 0.0f, max_y = 0.0f;
+
+	graph->max_radius = 0.0f;
+	for (uint32_t i = 0; i < n; i++)
+	{
+		if (i == 0 || graph->x[i] < min_x) min_x = graph->x[i];
+		if (i == 0 || graph->y[i] < min_y) min_y = graph->y[i];
+		if (i == 0 || graph->x[i] > max_x) max_x = graph->x[i];
+		if (i == 0 || graph->y[i] > max_y) max_y = graph->y[i];
+		if (graph->radius[i] > graph->max_radius) graph->max_radius = graph->radius[i];
+	}
+
+	GLfloat cell_size = graph->cell_size;
+	uint64_t max_cells = (uint64_t)n * SCENE_GRAPH_CELLS_PER_NODE + 1;
+	for (;;)
+	{
+		graph->columns = (uint32_t)((max_x - min_x) / cell_size) + 1;
+		graph->rows = (uint32_t)((max_y - min_y) / cell_size) + 1;
+		if ((uint64_t)graph->columns * graph->rows <= max_cells) break;
+		cell_size *= 2.0f;
+	}
+	graph->cell_size = cell_size;
+	graph->min_x = min_x;
+	graph->min_y = min_y;
+
+	uint32_t cells = graph->columns * graph->rows;
+	uint32_t *cell_first = realloc(graph->cell_first, (cells + 1) * sizeof(uint32_t));
+	if (!cell_first) return -1;
+	graph->cell_first = cell_first;
+
+	// Count, prefix sum to cell starts, scatter, then shift the advanced starts back
+	memset(cell_first, 0, (cells + 1) * sizeof(uint32_t));
+	for (uint32_t i = 0; i < n; i++) cell_first[scene_graph_cell(graph, graph->x[i], graph->y[i]) + 1]++;
+	for (uint32_t c = 0; c < cells; c++) cell_first[c + 1] += cell_first[c];
+	for (uint32_t i = 0; i < n; i++) graph->cell_nodes[cell_first[scene_graph_cell(graph, graph->x[i], graph->y[i])]++] = i;
+	for (uint32_t c = cells; c > 0; c--) cell_first[c] = cell_first[c - 1];
+	cell_first[0] = 0;
+
+	graph->index_stale = 0;
+	graph->index_builds++;
+	return 0;
+}
+
+/***********************************************************
+ * Name: scene_graph_cull
+ *
+ * Arguments:
+ *   SCENE_GRAPH_T *graph = scene graph
+ *   GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1 = view rectangle in world space
+ *
+ * Description:
+ *   Finds the nodes whose bounding circle overlaps the view, rebuilding the index first
+ *   if it is stale. Candidates are marked in a bitmap, which is then scanned so the
+ *   visible list comes out in node order whatever order the cells were visited in.
+ *
+ * Returns:
+ *   uint32_t = number of visible nodes, also in visible_count
+ *
+ ***********************************************************/
+uint32_t scene_graph_cull(SCENE_GRAPH_T *graph, GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1)
+{
+	graph->visible_count = 0;
+	graph->cells_visited = 0;
+	graph->nodes_tested = 0;
+	if (graph->index_stale && scene_graph_build_index(graph) != 0) return 0;
+	if (!graph->count) return 0;
+
+	// Cells that can hold the centre of a node reaching into the view
+	GLfloat r = graph->max_radius;
+	int32_t column0 = (int32_t)floorf((x0 - r - graph->min_x) / graph->cell_size);
+	int32_t row0 = (int32_t)floorf((y0 - r - graph->min_y) / graph->cell_size);
+	int32_t column1 = (int32_t)floorf((x1 + r - graph->min_x) / graph->cell_size);
+	int32_t row1 = (int32_t)floorf((y1 + r - graph->min_y) / graph->cell_size);
+	if (column1 < 0 || row1 < 0 || column0 >= (int32_t)graph->columns || row0 >= (int32_t)graph->rows) return 0;
+	if (column0 < 0) column0 = 0;
+	if (row0 < 0) row0 = 0;
+	if (column1 >= (int32_t)graph->columns) column1 = graph->columns - 1;
+	if (row1 >= (int32_t)graph->rows) row1 = graph->rows - 1;
+
+	uint32_t words = (graph->count + 31) / 32;
+	memset(graph->visible_bits, 0, words * sizeof(uint32_t));
+	for (int32_t row = row0; row <= row1; row++)
+	{
+		for (int32_t column = column0; column <= column1; column++)
+		{
+			uint32_t cell = row * graph->columns + column;
+			graph->cells_visited++;
+			for (uint32_t k = graph->cell_first[cell]; k < graph->cell_first[cell + 1]; k++)
+			{
+				// Distance from the centre to the nearest point of the view
+				uint32_t node = graph->cell_nodes[k];
+				GLfloat x = graph->x[node], y = graph->y[node], radius = graph->radius[node];
+				GLfloat dx = x < x0 ? x0 - x : x > x1 ? x - x1 : 0.0f;
+				GLfloat dy = y < y0 ? y0 - y : y > y1 ? y - y1 : 0.0f;
+				graph->nodes_tested++;
+				if (dx * dx + dy * dy <= radius * radius) graph->visible_bits[node / 32] |= 1u << (node % 32);
+			}
+		}
+	}
+
+	for (uint32_t w = 0; w < words; w++)
+	{
+		for (uint32_t bits = graph->visible_bits[w]; bits; bits &= bits - 1)
+			graph->visible[graph->visible_count++] = w * 32 + __builtin_ctz(bits);
+	}
+	return graph->visible_count;
+}
+
+/***********************************************************
+ * Name: scene_graph_gather
+ *
+ * Arguments:
+ *   const SCENE_GRAPH_T *graph = scene graph after scene_graph_cull()
+ *   BATCH_PRIMITIVE_T *out = receives visible_count primitives
+ *   GLfloat origin_x, GLfloat origin_y = world position that maps to the view centre
+ *   GLfloat seconds = scene time the rotations are evaluated at
+ *
+ * Description:
+ *   Converts the visible nodes into batch primitives relative to the view, ready for
+ *   batch_draw() or batch_prepare()
+ *
+ * Returns:
+ *   uint32_t = number of primitives written
+ *
+ ***********************************************************/
+uint32_t scene_graph_gather(const SCENE_GRAPH_T *graph, BATCH_PRIMITIVE_T *out, GLfloat origin_x, GLfloat origin_y, GLfloat seconds)
+{
+	for (uint32_t i = 0; i < graph->visible_count; i++)
+	{
+		uint32_t node = graph->visible[i];
+		BATCH_PRIMITIVE_T *p = &out[i];
+		p->shape = graph->shape[node];
+		p->x = graph->x[node] - origin_x;
+		p->y = graph->y[node] - origin_y;
+		p->scale = graph->scale[node];
+		p->rotation = fmodf(graph->rotation[node] + graph->spin[node] * seconds, 6.2831853f);
+		memcpy(p->color, graph->color[node], sizeof(p->color));
+	}
+	return graph->visible_count;
+}
+
+void scene_graph_destroy(SCENE_GRAPH_T *graph)
+{
+	free(graph->x);
+	free(graph->y);
+	free(graph->radius);
+	free(graph->scale);
+	free(graph->rotation);
+	free(graph->spin);
+	free(graph->shape);
+	free(graph->color);
+	free(graph->cell_first);
+	free(graph->cell_nodes);
+	free(graph->visible_bits);
+	free(graph->visible);
+	memset(graph, 0, sizeof(*graph));
+}
@@ -0,0 +1,73 @@
+/***********************************************************
+ * File: scene_graph.h
+ *
+ * Description:
+ *   Retained-mode scene layer for large 2D scenes. Nodes live in a flat structure of
+ *   arrays, one column per attribute, so culling only streams through the positions
+ *   and radii it tests and never touches colours or shapes of nodes it rejects.
+ *
+ *   A uniform grid indexes the nodes by centre, stored as one array of node ids sorted
+ *   by cell plus the first id of each cell. Culling visits only the cells overlapping
+ *   the view, grown by the largest node radius, and tests each node's bounding circle
+ *   against the view rectangle. Visible nodes are then gathered, in node order, into
+ *   batch primitives for the batch renderer. Moving a node marks the index stale and
+ *   the next cull rebuilds it.
+ *
+ *   Rotation is animated from a per-node spin rate and the scene time at gather, so
+ *   invisible nodes cost nothing per frame.
+ *
+ ***********************************************************/
+
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <stdint.h>
+#include "GLES2/gl2.h"
+#include "batch.h"
+
+typedef struct
+{
+	uint32_t capacity;
+	uint32_t count;
+
+	// Node columns, indexed by node id
+	GLfloat *x; // Centre in world space
+	GLfloat *y;
+	GLfloat *radius; // Bounding circle
+	GLfloat *scale;
+	GLfloat *rotation; // At scene time 0
+	GLfloat *spin; // Radians per second
+	uint32_t *shape; // Batch shape index
+	GLfloat (*color)[4];
+
+	// Uniform grid over the bounds of the node centres
+	GLfloat cell_size;
+	GLfloat min_x; // World position of cell 0, 0
+	GLfloat min_y;
+	uint32_t columns;
+	uint32_t rows;
+	uint32_t *cell_first; // columns * rows + 1 offsets into cell_nodes
+	uint32_t *cell_nodes; // Node ids sorted by cell, ascending within a cell
+	GLfloat max_radius;
+	int index_stale; // Nodes were added or moved since the index was built
+
+	// Result of the last scene_graph_cull()
+	uint32_t *visible_bits; // One bit per node
+	uint32_t *visible; // Visible node ids in ascending order
+	uint32_t visible_count;
+
+	// Statistics of the last scene_graph_cull()
+	uint32_t cells_visited;
+	uint32_t nodes_tested;
+	uint32_t index_builds;
+} SCENE_GRAPH_T;
+
+int scene_graph_init(SCENE_GRAPH_T *graph, uint32_t capacity, GLfloat cell_size);
+int scene_graph_add(SCENE_GRAPH_T *graph, const BATCH_PRIMITIVE_T *primitive, GLfloat radius, GLfloat spin);
+void scene_graph_move(SCENE_GRAPH_T *graph, uint32_t node, GLfloat x, GLfloat y);
+int scene_graph_build_index(SCENE_GRAPH_T *graph);
+uint32_t scene_graph_cull(SCENE_GRAPH_T *graph, GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1);
+uint32_t scene_graph_gather(const SCENE_GRAPH_T *graph, BATCH_PRIMITIVE_T *out, GLfloat origin_x, GLfloat origin_y, GLfloat seconds);
+void scene_graph_destroy(SCENE_GRAPH_T *graph);
+
+#endif
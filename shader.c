@@ -0,0 +1,390 @@
+/***********************************************************
+ * File: shader.c
+ *
+ * Description:
+ *   Shader compilation and program linking helpers. See shader.h.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "EGL/egl.h"
+#include "check.h"
+#include "shader.h"
+
+#define SHADER_CACHE_MAGIC 0x31485354 // "TSH1"
+
+typedef struct
+{
+	uint32_t magic;
+	uint32_t format; // Driver binary format from glGetProgramBinaryOES
+	uint32_t length; // Bytes of binary data following the header
+	uint32_t reserved;
+	uint64_t hash; // Must match the requesting entry
+} SHADER_CACHE_HEADER_T;
+
+static void showlog(GLint shader)
+{
+	// Prints the compile log for a shader
+	char log[1024];
+	glGetShaderInfoLog(shader,sizeof log,NULL,log);
+	printf("%d:shader:\n%s\n", shader, log);
+}
+
+static void showprogramlog(GLint shader)
+{
+	// Prints the information log for a program object
+	char log[1024];
+	glGetProgramInfoLog(shader,sizeof log,NULL,log);
+	printf("%d:program:\n%s\n", shader, log);
+}
+
+static GLuint compile_shader(GLenum type, const GLchar *source, GLuint verbose)
+{
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, 0);
+	glCompileShader(shader);
+	check();
+	if (verbose) showlog(shader);
+	return shader;
+}
+
+/***********************************************************
+ * Name: shader_build_program
+ *
+ * Arguments:
+ *   const GLchar *vertex_source = GLSL ES vertex shader source
+ *   const GLchar *fragment_source = GLSL ES fragment shader source
+ *   GLuint verbose = print the compile and link logs
+ *
+ * Description:
+ *   Compiles both shaders and links them into a program. The shader objects are
+ *   released straight away because only the linked program is needed afterwards.
+ *
+ * Returns:
+ *   GLuint = linked program object
+ *
+ ***********************************************************/
+GLuint shader_build_program(const GLchar *vertex_source, const GLchar *fragment_source, GLuint verbose)
+{
+	// Vertex and fragment shaders
+	GLuint vshader = compile_shader(GL_VERTEX_SHADER, vertex_source, verbose);
+	GLuint fshader = compile_shader(GL_FRAGMENT_SHADER, fragment_source, verbose);
+
+	// Linked shader program
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vshader);
+	glAttachShader(program, fshader);
+	glLinkProgram(program);
+	check();
+	if (verbose) showprogramlog(program);
+
+	// Shader resources are no longer needed after compiling and linking
+	glDeleteShader(vshader);
+	glDeleteShader(fshader);
+	return program;
+}
+
+static uint64_t fnv1a(uint64_t hash, const char *text)
+{
+	// The terminating zero is hashed too, so concatenated strings cannot collide by shifting
+	do
+	{
+		hash ^= (unsigned char)*text;
+		hash *= 0x100000001b3ull;
+	} while (*text++);
+	return hash;
+}
+
+static void cache_path(const SHADER_MANAGER_T *shaders, const SHADER_ENTRY_T *entry, char *path, size_t size)
+{
+	snprintf(path, size, "%s/%016llx.bin", shaders->cache_dir, (unsigned long long)entry->hash);
+}
+
+/***********************************************************
+ * Name: load_binary
+ *
+ * Arguments:
+ *   const SHADER_MANAGER_T *shaders = manager holding the cache settings
+ *   const SHADER_ENTRY_T *entry = program to look up
+ *
+ * Description:
+ *   Reads a cached program binary and hands it to the driver. A stale or corrupt file
+ *   simply fails to link, and the caller falls back to compiling from source. A length
+ *   that does not match the rest of the file is rejected before anything is allocated.
+ *
+ * Returns:
+ *   GLuint = linked program, or 0 if there was no usable cached binary
+ *
+ ***********************************************************/
+static GLuint load_binary(const SHADER_MANAGER_T *shaders, const SHADER_ENTRY_T *entry)
+{
+	SHADER_CACHE_HEADER_T header;
+	char path[512];
+	GLuint program = 0;
+	GLint linked = GL_FALSE;
+
+	if (!shaders->program_binary || !shaders->cache_dir) return 0;
+
+	cache_path(shaders, entry, path, sizeof(path));
+	FILE *file = fopen(path, "rb");
+	if (!file) return 0;
+
+	struct stat st;
+	void *binary = NULL;
+	if (fstat(fileno(file), &st) == 0 && st.st_size > (off_t)sizeof(header) &&
+		fread(&header, sizeof(header), 1, file) == 1 && header.magic == SHADER_CACHE_MAGIC &&
+		header.hash == entry->hash && header.length == (uint64_t)(st.st_size - sizeof(header)) &&
+		(binary = malloc(header.length)) != NULL &&
+		fread(binary, 1, header.length, file) == header.length)
+	{
+		program = glCreateProgram();
+		shaders->program_binary(program, header.format, binary, header.length);
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (!linked)
+		{
+			glDeleteProgram(program);
+			program = 0;
+		}
+		glGetError(); // A rejected binary is expected after a driver update, not an error
+	}
+
+	free(binary);
+	fclose(file);
+	return program;
+}
+
+/***********************************************************
+ * Name: save_binary
+ *
+ * Arguments:
+ *   const SHADER_MANAGER_T *shaders = manager holding the cache settings
+ *   const SHADER_ENTRY_T *entry = freshly linked program to store
+ *
+ * Description:
+ *   Writes the program binary to a temporary file and renames it into place, so a
+ *   power cut mid-write never leaves a truncated cache entry behind
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void save_binary(const SHADER_MANAGER_T *shaders, const SHADER_ENTRY_T *entry)
+{
+	SHADER_CACHE_HEADER_T header;
+	char path[512], temp[520];
+	GLint length = 0;
+	GLenum format = 0;
+
+	if (!shaders->get_program_binary || !shaders->cache_dir) return;
+
+	glGetProgramiv(entry->program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+	if (length <= 0) return;
+	void *binary = malloc(length);
+	if (!binary) return;
+	shaders->get_program_binary(entry->program, length, &length, &format, binary);
+
+	header.magic = SHADER_CACHE_MAGIC;
+	header.format = format;
+	header.length = length;
+	header.reserved = 0;
+	header.hash = entry->hash;
+
+	cache_path(shaders, entry, path, sizeof(path));
+	snprintf(temp, sizeof(temp), "%s.tmp", path);
+	FILE *file = fopen(temp, "wb");
+	if (file)
+	{
+		int ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary, 1, length, file) == (size_t)length;
+		ok &= fclose(file) == 0;
+		if (!ok || rename(temp, path) != 0) remove(temp);
+	}
+	free(binary);
+}
+
+/***********************************************************
+ * Name: build_entry
+ *
+ * Arguments:
+ *   SHADER_MANAGER_T *shaders = owning manager
+ *   SHADER_ENTRY_T *entry = program to build
+ *   int allow_compile = compile from source if there is no cached binary
+ *
+ * Description:
+ *   Loads the program from the binary cache, or compiles, links and caches it, then
+ *   notifies the owner so it can look up attribute and uniform locations
+ *
+ * Returns:
+ *   int = 1 if the program is now available
+ *
+ ***********************************************************/
+static int build_entry(SHADER_MANAGER_T *shaders, SHADER_ENTRY_T *entry, int allow_compile)
+{
+	entry->program = load_binary(shaders, entry);
+	if (entry->program)
+	{
+		shaders->binary_hits++;
+	}
+	else
+	{
+		if (!allow_compile) return 0;
+
+		GLint linked = GL_FALSE;
+		entry->program = shader_build_program(entry->vertex_source, entry->fragment_source, shaders->verbose);
+		glGetProgramiv(entry->program, GL_LINK_STATUS, &linked);
+		shaders->compiled++;
+		if (linked) save_binary(shaders, entry);
+		else fprintf(stderr, "Shader program %016llx failed to link\n", (unsigned long long)entry->hash);
+	}
+
+	if (entry->ready) entry->ready(entry->program, entry->user);
+	return 1;
+}
+
+/***********************************************************
+ * Name: shader_manager_init
+ *
+ * Arguments:
+ *   SHADER_MANAGER_T *shaders = manager to initialise
+ *   const char *cache_dir = directory for program binaries, NULL to disable caching
+ *   GLuint verbose = print compile and link logs
+ *
+ * Description:
+ *   Detects GL_OES_get_program_binary and fingerprints the driver. Needs a current context.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void shader_manager_init(SHADER_MANAGER_T *shaders, const char *cache_dir, GLuint verbose)
+{
+	const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+	const char *renderer = (const char *)glGetString(GL_RENDERER);
+	const char *version = (const char *)glGetString(GL_VERSION);
+	GLint formats = 0;
+
+	memset(shaders, 0, sizeof(*shaders));
+	shaders->cache_dir = cache_dir;
+	shaders->verbose = verbose;
+	shaders->driver_hash = fnv1a(fnv1a(0xcbf29ce484222325ull, renderer ? renderer : ""), version ? version : "");
+
+	if (extensions && strstr(extensions, "GL_OES_get_program_binary"))
+	{
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats);
+		if (formats > 0)
+		{
+			shaders->get_program_binary = (PFNGLGETPROGRAMBINARYOESPROC)eglGetProcAddress("glGetProgramBinaryOES");
+			shaders->program_binary = (PFNGLPROGRAMBINARYOESPROC)eglGetProcAddress("glProgramBinaryOES");
+			if (!shaders->get_program_binary || !shaders->program_binary)
+			{
+				shaders->get_program_binary = NULL;
+				shaders->program_binary = NULL;
+			}
+		}
+	}
+	if (verbose) printf("shader cache: %s, program binaries %s\n", cache_dir ? cache_dir : "disabled", shaders->program_binary ? "supported" : "not supported");
+}
+
+/***********************************************************
+ * Name: shader_request
+ *
+ * Arguments:
+ *   SHADER_MANAGER_T *shaders = manager to register with
+ *   const GLchar *vertex_source, *fragment_source = GLSL ES sources, kept by reference
+ *   int flags = SHADER_IMMEDIATE or SHADER_DEFERRED
+ *   SHADER_READY_FN ready = called with the program once it is linked, may be NULL
+ *   void *user = passed to ready
+ *
+ * Description:
+ *   Registers a program. A cached binary is always loaded straight away because that is
+ *   cheap. Without one, immediate programs are compiled now and deferred programs wait
+ *   for shader_pump(), so callers must cope with shader_program() returning 0.
+ *
+ * Returns:
+ *   int = handle for shader_program()/shader_release(), -1 if the table is full
+ *
+ ***********************************************************/
+int shader_request(SHADER_MANAGER_T *shaders, const GLchar *vertex_source, const GLchar *fragment_source, int flags, SHADER_READY_FN ready, void *user)
+{
+	if (shaders->count == SHADER_MAX_PROGRAMS) return -1;
+
+	int handle = shaders->count++;
+	SHADER_ENTRY_T *entry = &shaders->entries[handle];
+	entry->vertex_source = vertex_source;
+	entry->fragment_source = fragment_source;
+	entry->hash = fnv1a(fnv1a(shaders->driver_hash, vertex_source), fragment_source);
+	entry->program = 0;
+	entry->ready = ready;
+	entry->user = user;
+
+	build_entry(shaders, entry, !(flags & SHADER_DEFERRED));
+	return handle;
+}
+
+GLuint shader_program(const SHADER_MANAGER_T *shaders, int handle)
+{
+	if (handle < 0 || (uint32_t)handle >= shaders->count) return 0;
+	return shaders->entries[handle].program;
+}
+
+/***********************************************************
+ * Name: shader_pump
+ *
+ * Arguments:
+ *   SHADER_MANAGER_T *shaders = manager with deferred programs
+ *   uint32_t budget = maximum number of programs to compile in this call
+ *
+ * Description:
+ *   Background compilation pass, called once per frame after the swap so that compiles
+ *   are spread out and never delay the first frame
+ *
+ * Returns:
+ *   uint32_t = number of programs still waiting to be compiled
+ *
+ ***********************************************************/
+uint32_t shader_pump(SHADER_MANAGER_T *shaders, uint32_t budget)
+{
+	uint32_t pending = 0;
+
+	for (uint32_t i = shaders->next_pending; i < shaders->count; i++)
+	{
+		SHADER_ENTRY_T *entry = &shaders->entries[i];
+		if (entry->program || !entry->vertex_source) continue;
+
+		if (budget)
+		{
+			build_entry(shaders, entry, 1);
+			shaders->deferred++;
+			budget--;
+		}
+		else
+		{
+			pending++;
+		}
+	}
+
+	// Everything before the first unbuilt entry is done and never needs scanning again
+	while (shaders->next_pending < shaders->count &&
+		(shaders->entries[shaders->next_pending].program || !shaders->entries[shaders->next_pending].vertex_source))
+		shaders->next_pending++;
+	return pending;
+}
+
+void shader_release(SHADER_MANAGER_T *shaders, int handle)
+{
+	if (handle < 0 || (uint32_t)handle >= shaders->count) return;
+
+	SHADER_ENTRY_T *entry = &shaders->entries[handle];
+	if (entry->program) glDeleteProgram(entry->program);
+	entry->program = 0;
+	entry->vertex_source = NULL; // Never built again by shader_pump()
+	entry->ready = NULL;
+}
+
+void shader_manager_destroy(SHADER_MANAGER_T *shaders)
+{
+	for (uint32_t i = 0; i < shaders->count; i++) shader_release(shaders, i);
+	shaders->count = 0;
+}
@@ -0,0 +1,65 @@
+/***********************************************************
+ * File: shader.h
+ *
+ * Description:
+ *   Shader compilation helpers and a shader manager that keeps the compiler off the
+ *   path to the first frame. Programs are keyed by a hash of their source and the
+ *   driver identity. Where the driver exposes GL_OES_get_program_binary, linked
+ *   binaries are saved to a cache directory and reloaded on later launches. Otherwise
+ *   programs that are not needed immediately are compiled on a background pass, one
+ *   per frame, after the first frame has been presented.
+ *
+ ***********************************************************/
+
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <stdint.h>
+#include "GLES2/gl2.h"
+#include "GLES2/gl2ext.h"
+
+#define SHADER_MAX_PROGRAMS 32
+
+// shader_request() flags
+#define SHADER_IMMEDIATE 0 // Build before shader_request() returns
+#define SHADER_DEFERRED 1 // May be built later by shader_pump() if no cached binary exists
+
+typedef void (*SHADER_READY_FN)(GLuint program, void *user);
+
+typedef struct
+{
+	const GLchar *vertex_source; // Must stay valid until the program is built
+	const GLchar *fragment_source;
+	uint64_t hash; // Source and driver hash, names the cache file
+	GLuint program; // 0 until built
+	SHADER_READY_FN ready; // Called once the program is linked, to look up locations
+	void *user;
+} SHADER_ENTRY_T;
+
+typedef struct
+{
+	SHADER_ENTRY_T entries[SHADER_MAX_PROGRAMS];
+	uint32_t count;
+	uint32_t next_pending; // First entry shader_pump() has not looked at yet
+	const char *cache_dir; // Binary cache location, NULL to disable
+	uint64_t driver_hash; // Hash of GL_RENDERER and GL_VERSION, binaries are driver specific
+	PFNGLGETPROGRAMBINARYOESPROC get_program_binary; // NULL when the extension is missing
+	PFNGLPROGRAMBINARYOESPROC program_binary;
+	GLuint verbose;
+
+	// Statistics
+	uint32_t binary_hits; // Programs loaded from the binary cache
+	uint32_t compiled; // Programs compiled from source
+	uint32_t deferred; // Programs compiled by shader_pump()
+} SHADER_MANAGER_T;
+
+GLuint shader_build_program(const GLchar *vertex_source, const GLchar *fragment_source, GLuint verbose);
+
+void shader_manager_init(SHADER_MANAGER_T *shaders, const char *cache_dir, GLuint verbose);
+int shader_request(SHADER_MANAGER_T *shaders, const GLchar *vertex_source, const GLchar *fragment_source, int flags, SHADER_READY_FN ready, void *user);
+GLuint shader_program(const SHADER_MANAGER_T *shaders, int handle);
+uint32_t shader_pump(SHADER_MANAGER_T *shaders, uint32_t budget);
+void shader_release(SHADER_MANAGER_T *shaders, int handle);
+void shader_manager_destroy(SHADER_MANAGER_T *shaders);
+
+#endif
@@ -0,0 +1,235 @@
+/***********************************************************
+ * File: startup.c
+ *
+ * Description:
+ *   Startup phase timing and background asset prefetch. See startup.h.
+ *
+ ***********************************************************/
+
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "frame_clock.h"
+#include "startup.h"
+
+/***********************************************************
+ * Name: startup_init
+ *
+ * Arguments:
+ *   STARTUP_T *startup = profiler to initialise
+ *
+ * Description:
+ *   Starts the clock. Call first thing in main(), everything after is attributed to a
+ *   phase.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void startup_init(STARTUP_T *startup)
+{
+	memset(startup, 0, sizeof(*startup));
+	pthread_mutex_init(&startup->lock, NULL);
+	startup->origin_ns = frame_clock_now();
+	startup->current = -1;
+	startup->boot_seconds = -1.0;
+}
+
+// Appends a phase starting now, or returns -1 when the table is full
+static int startup_add(STARTUP_T *startup, const char *name, int background)
+{
+	int phase = -1;
+	pthread_mutex_lock(&startup->lock);
+	if (startup->count < STARTUP_MAX_PHASES)
+	{
+		phase = (int)startup->count++;
+		startup->phases[phase].name = name;
+		startup->phases[phase].start_ns = frame_clock_now();
+		startup->phases[phase].end_ns = 0;
+		startup->phases[phase].background = background;
+	}
+	pthread_mutex_unlock(&startup->lock);
+	return phase;
+}
+
+/***********************************************************
+ * Name: startup_phase
+ *
+ * Arguments:
+ *   STARTUP_T *startup = profiler
+ *   const char *name = phase starting now, NULL to only end the current one
+ *
+ * Description:
+ *   Ends the main thread phase in progress and begins the next. Main thread phases
+ *   never overlap, so their durations add up to the time to first frame.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void startup_phase(STARTUP_T *startup, const char *name)
+{
+	if (startup->current >= 0) startup_end_background(startup, startup->current);
+	startup->current = name ? startup_add(startup, name, 0) : -1;
+}
+
+// A span on another thread, or one the main thread only sees finish later. Thread safe.
+int startup_begin_background(STARTUP_T *startup, const char *name)
+{
+	return startup_add(startup, name, 1);
+}
+
+void startup_end_background(STARTUP_T *startup, int phase)
+{
+	if (phase < 0) return;
+	pthread_mutex_lock(&startup->lock);
+	if (!startup->phases[phase].end_ns) startup->phases[phase].end_ns = frame_clock_now();
+	pthread_mutex_unlock(&startup->lock);
+}
+
+/***********************************************************
+ * Name: startup_first_frame
+ *
+ * Arguments:
+ *   STARTUP_T *startup = profiler
+ *
+ * Description:
+ *   Records that the first frame has been presented, once. Also samples the time since
+ *   boot, which is what a kiosk that reboots nightly actually waits for.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void startup_first_frame(STARTUP_T *startup)
+{
+	struct timespec boot;
+	if (startup->first_frame_ns) return;
+	startup->first_frame_ns = frame_clock_now();
+	if (clock_gettime(CLOCK_BOOTTIME, &boot) == 0) startup->boot_seconds = boot.tv_sec + boot.tv_nsec / 1e9;
+}
+
+void startup_prefetch_add(STARTUP_T *startup, const char *path)
+{
+	if (path && startup->path_count < STARTUP_MAX_PREFETCH) startup->paths[startup->path_count++] = path;
+}
+
+// Faults every page of a file into the page cache, then drops the mapping
+static void startup_prefetch_file(STARTUP_T *startup, const char *path)
+{
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+	{
+		void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+		if (map != MAP_FAILED)
+		{
+			munmap(map, st.st_size);
+			startup->prefetched_files++;
+			startup->prefetched_bytes += st.st_size;
+		}
+	}
+	close(fd);
+}
+
+static void *startup_prefetch_thread(void *arg)
+{
+	STARTUP_T *startup = (STARTUP_T *)arg;
+	int phase = startup_begin_background(startup, "asset prefetch");
+
+	for (uint32_t i = 0; i < startup->path_count; i++)
+	{
+		DIR *dir = opendir(startup->paths[i]);
+		if (!dir)
+		{
+			startup_prefetch_file(startup, startup->paths[i]);
+			continue;
+		}
+		struct dirent *entry;
+		while ((entry = readdir(dir)) != NULL)
+		{
+			char path[1024];
+			if (entry->d_name[0] == '.') continue;
+			if (snprintf(path, sizeof(path), "%s/%s", startup->paths[i], entry->d_name) >= (int)sizeof(path)) continue;
+			startup_prefetch_file(startup, path);
+		}
+		closedir(dir);
+	}
+	startup_end_background(startup, phase);
+	return NULL;
+}
+
+/***********************************************************
+ * Name: startup_prefetch_start
+ *
+ * Arguments:
+ *   STARTUP_T *startup = profiler holding the paths from startup_prefetch_add()
+ *
+ * Description:
+ *   Starts the prefetch thread. Missing paths are skipped. prefetched_files and
+ *   prefetched_bytes belong to the thread until startup_destroy() has joined it.
+ *
+ * Returns:
+ *   int = 0 on success or when there is nothing to prefetch, -1 if the thread could not start
+ *
+ ***********************************************************/
+int startup_prefetch_start(STARTUP_T *startup)
+{
+	if (!startup->path_count) return 0;
+	if (pthread_create(&startup->thread, NULL, startup_prefetch_thread, startup) != 0) return -1;
+	startup->started = 1;
+	return 0;
+}
+
+/***********************************************************
+ * Name: startup_report
+ *
+ * Arguments:
+ *   STARTUP_T *startup = profiler, after startup_first_frame()
+ *   FILE *out = where to print
+ *
+ * Description:
+ *   Prints every phase with its start and duration relative to startup_init(), and the
+ *   share of the time to first frame taken by main thread phases. Background spans
+ *   still running are shown as such.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void startup_report(STARTUP_T *startup, FILE *out)
+{
+	uint64_t total_ns = (startup->first_frame_ns ? startup->first_frame_ns : frame_clock_now()) - startup->origin_ns;
+
+	pthread_mutex_lock(&startup->lock);
+	fprintf(out, "Startup: first frame after %.1f ms", total_ns / 1e6);
+	if (startup->boot_seconds >= 0.0) fprintf(out, ", %.2f s after boot", startup->boot_seconds);
+	fprintf(out, "\n");
+	for (uint32_t i = 0; i < startup->count; i++)
+	{
+		const STARTUP_PHASE_T *phase = &startup->phases[i];
+		double start_ms = (phase->start_ns - startup->origin_ns) / 1e6;
+		if (!phase->end_ns)
+		{
+			fprintf(out, "  %-20s at %8.1f ms  still running\n", phase->name, start_ms);
+			continue;
+		}
+		uint64_t duration_ns = phase->end_ns - phase->start_ns;
+		fprintf(out, "  %-20s at %8.1f ms  %8.1f ms", phase->name, start_ms, duration_ns / 1e6);
+		if (phase->background) fprintf(out, "  (background)\n");
+		else fprintf(out, "  %5.1f%%\n", total_ns ? 100.0 * duration_ns / total_ns : 0.0);
+	}
+	pthread_mutex_unlock(&startup->lock);
+}
+
+void startup_destroy(STARTUP_T *startup)
+{
+	if (startup->started) pthread_join(startup->thread, NULL);
+	startup->started = 0;
+	pthread_mutex_destroy(&startup->lock);
+}
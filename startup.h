@@ -0,0 +1,65 @@
+/***********************************************************
+ * File: startup.h
+ *
+ * Description:
+ *   Startup profiler and asset prefetch. The main thread marks the start of each
+ *   startup phase, background jobs record their own spans, and once the first frame is
+ *   on screen startup_report() prints when each phase began and how long it took,
+ *   along with the time since boot.
+ *
+ *   Asset files and directories (mesh, shader binary cache) are memory mapped with
+ *   MAP_POPULATE on a background thread, so their first read comes from the page cache
+ *   instead of the SD card. Started before bcm_host_init(), this overlaps the file I/O
+ *   with EGL and DispmanX initialisation.
+ *
+ ***********************************************************/
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define STARTUP_MAX_PHASES 32
+#define STARTUP_MAX_PREFETCH 8
+
+typedef struct
+{
+	const char *name; // Must outlive the profiler, normally a string literal
+	uint64_t start_ns; // frame_clock_now() time
+	uint64_t end_ns; // 0 while running
+	int background; // Ran off the main thread, overlapping main thread phases
+} STARTUP_PHASE_T;
+
+typedef struct
+{
+	uint64_t origin_ns; // startup_init() time, phases are reported relative to it
+	uint64_t first_frame_ns; // startup_first_frame() time, 0 until then
+	double boot_seconds; // CLOCK_BOOTTIME at the first frame, < 0 if unavailable
+
+	STARTUP_PHASE_T phases[STARTUP_MAX_PHASES];
+	uint32_t count;
+	int current; // Main thread phase in progress, -1 for none
+	pthread_mutex_t lock; // Guards phases and count
+
+	// Background prefetch
+	const char *paths[STARTUP_MAX_PREFETCH]; // Files, or directories whose files are all read
+	uint32_t path_count;
+	pthread_t thread;
+	int started;
+	uint32_t prefetched_files;
+	uint64_t prefetched_bytes;
+} STARTUP_T;
+
+void startup_init(STARTUP_T *startup);
+void startup_phase(STARTUP_T *startup, const char *name);
+int startup_begin_background(STARTUP_T *startup, const char *name);
+void startup_end_background(STARTUP_T *startup, int phase);
+void startup_first_frame(STARTUP_T *startup);
+void startup_prefetch_add(STARTUP_T *startup, const char *path);
+int startup_prefetch_start(STARTUP_T *startup);
+void startup_report(STARTUP_T *startup, FILE *out);
+void startup_destroy(STARTUP_T *startup);
+
+#endif
@@ -0,0 +1,253 @@
+/***********************************************************
+ * File: stats.c
+ *
+ * Description:
+ *   Lock-free frame statistics ring and background reporter thread. See stats.h.
+ *
+ ***********************************************************/
+
+#include <string.h>
+#include <time.h>
+#include "stats.h"
+
+#define STATS_DRAIN_MS 10 // Reporter wake-up period, short enough that the ring never fills at sane frame rates
+
+typedef struct
+{
+	// Distributions for the current interval only, the frame clock keeps lifetime totals
+	HISTOGRAM_T frame;
+	HISTOGRAM_T submit;
+	HISTOGRAM_T swap;
+	uint64_t state_issued;
+	uint64_t state_elided;
+	uint32_t arena_peak; // Largest frame arena request total in the interval
+	uint32_t upload_peak; // Largest per-frame texture upload in the interval
+} STATS_WINDOW_T;
+
+// One line per governor level change, written as soon as it is drained
+static void stats_log_governor(STATS_T *stats, const STATS_SAMPLE_T *sample)
+{
+	fprintf(stats->out, "Governor: level %d -> %d (%s), temp %.1f C, arm %u MHz, core %u MHz, throttled 0x%x, frame avg %.3f ms\n",
+		sample->governor_from, sample->governor_to, sample->governor_reason,
+		sample->governor_temp_mc / 1000.0, sample->governor_arm_mhz, sample->governor_core_mhz,
+		sample->governor_throttled, sample->governor_frame_us / 1000.0);
+}
+
+static void window_reset(STATS_WINDOW_T *window)
+{
+	histogram_reset(&window->frame);
+	histogram_reset(&window->submit);
+	histogram_reset(&window->swap);
+	window->state_issued = 0;
+	window->state_elided = 0;
+	window->arena_peak = 0;
+	window->upload_peak = 0;
+}
+
+/***********************************************************
+ * Name: stats_drain
+ *
+ * Arguments:
+ *   STATS_T *stats = ring to consume from
+ *   STATS_WINDOW_T *window = interval accumulator to append samples to
+ *
+ * Description:
+ *   Moves every sample currently in the ring into the reporter's private window
+ *   histograms, logging governor decisions on the way. Runs on the reporter thread only.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void stats_drain(STATS_T *stats, STATS_WINDOW_T *window)
+{
+	unsigned tail = atomic_load_explicit(&stats->tail, memory_order_relaxed);
+	unsigned head = atomic_load_explicit(&stats->head, memory_order_acquire);
+
+	while (tail != head)
+	{
+		const STATS_SAMPLE_T *sample = &stats->ring[tail & (STATS_RING_SIZE - 1)];
+		histogram_record(&window->frame, sample->frame_us);
+		histogram_record(&window->submit, sample->submit_us);
+		histogram_record(&window->swap, sample->swap_us);
+		window->state_issued += sample->state_issued;
+		window->state_elided += sample->state_elided;
+		if (sample->arena_bytes > window->arena_peak) window->arena_peak = sample->arena_bytes;
+		if (sample->upload_bytes > window->upload_peak) window->upload_peak = sample->upload_bytes;
+		if (sample->governor_reason) stats_log_governor(stats, sample);
+		tail++;
+	}
+
+	// Hand the consumed slots back to the producer
+	atomic_store_explicit(&stats->tail, tail, memory_order_release);
+}
+
+/***********************************************************
+ * Name: stats_report
+ *
+ * Arguments:
+ *   STATS_T *stats = owning stats object, for output stream and drop counter
+ *   STATS_WINDOW_T *window = samples collected since the last report
+ *
+ * Description:
+ *   Writes one summary line of frame time min/avg/p99/max, followed by the split between
+ *   CPU submission and swap wait, then empties the window. When most of the frame is
+ *   spent waiting in eglSwapBuffers the GPU (or vsync) is the limit, otherwise the CPU is.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void stats_report(STATS_T *stats, STATS_WINDOW_T *window)
+{
+	const HISTOGRAM_T *frame = &window->frame;
+	if (frame->count == 0) return;
+
+	unsigned dropped = atomic_exchange_explicit(&stats->dropped, 0, memory_order_relaxed);
+	double submit_mean = histogram_mean(&window->submit);
+	double swap_mean = histogram_mean(&window->swap);
+
+	fprintf(stats->out, "%u frames, %.2f fps, frame ms min %.3f avg %.3f p99 %.3f max %.3f"
+		", submit ms avg %.3f p99 %.3f, swap ms avg %.3f p99 %.3f, %s-bound"
+		", state calls/frame %.1f issued %.1f elided",
+		frame->count,
+		frame->sum ? 1e6 * frame->count / (double)frame->sum : 0.0,
+		frame->min / 1000.0,
+		histogram_mean(frame) / 1000.0,
+		histogram_percentile(frame, 99.0) / 1000.0,
+		frame->max / 1000.0,
+		submit_mean / 1000.0,
+		histogram_percentile(&window->submit, 99.0) / 1000.0,
+		swap_mean / 1000.0,
+		histogram_percentile(&window->swap, 99.0) / 1000.0,
+		swap_mean > submit_mean ? "gpu" : "cpu",
+		(double)window->state_issued / frame->count,
+		(double)window->state_elided / frame->count);
+	if (window->arena_peak) fprintf(stats->out, ", arena peak %.1f KB", window->arena_peak / 1024.0);
+	if (window->upload_peak) fprintf(stats->out, ", texture upload peak %.1f KB", window->upload_peak / 1024.0);
+	if (dropped) fprintf(stats->out, ", %u dropped", dropped);
+	fputc('\n', stats->out);
+	fflush(stats->out);
+
+	window_reset(window);
+}
+
+static void timespec_add_ms(struct timespec *t, uint32_t ms)
+{
+	t->tv_sec += ms / 1000;
+	t->tv_nsec += (ms % 1000) * 1000000L;
+	if (t->tv_nsec >= 1000000000L)
+	{
+		t->tv_sec++;
+		t->tv_nsec -= 1000000000L;
+	}
+}
+
+static void *stats_reporter(void *arg)
+{
+	STATS_T *stats = (STATS_T *)arg;
+	STATS_WINDOW_T window;
+	const struct timespec drain_period = { 0, STATS_DRAIN_MS * 1000000L };
+	struct timespec now, next;
+
+	window_reset(&window);
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	timespec_add_ms(&next, stats->interval_ms);
+
+	while (atomic_load_explicit(&stats->running, memory_order_acquire))
+	{
+		nanosleep(&drain_period, NULL);
+		stats_drain(stats, &window);
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (now.tv_sec > next.tv_sec || (now.tv_sec == next.tv_sec && now.tv_nsec >= next.tv_nsec))
+		{
+			stats_report(stats, &window);
+			timespec_add_ms(&next, stats->interval_ms);
+		}
+	}
+
+	// Flush whatever arrived after the last full interval
+	stats_drain(stats, &window);
+	stats_report(stats, &window);
+	return NULL;
+}
+
+/***********************************************************
+ * Name: stats_start
+ *
+ * Arguments:
+ *   STATS_T *stats = stats object to initialise
+ *   uint32_t interval_ms = milliseconds between summary lines
+ *   FILE *out = stream the reporter writes to
+ *
+ * Description:
+ *   Clears the ring and launches the reporter thread
+ *
+ * Returns:
+ *   int = 0 on success, -1 if the reporter thread could not be created
+ *
+ ***********************************************************/
+int stats_start(STATS_T *stats, uint32_t interval_ms, FILE *out)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->interval_ms = interval_ms ? interval_ms : STATS_DEFAULT_INTERVAL_MS;
+	stats->out = out;
+	atomic_store(&stats->running, 1);
+
+	if (pthread_create(&stats->reporter, NULL, stats_reporter, stats) != 0)
+	{
+		atomic_store(&stats->running, 0);
+		return -1;
+	}
+	return 0;
+}
+
+/***********************************************************
+ * Name: stats_push
+ *
+ * Arguments:
+ *   STATS_T *stats = ring to publish into
+ *   const STATS_SAMPLE_T *sample = timings for one frame
+ *
+ * Description:
+ *   Wait-free publish from the render thread. If the reporter has fallen behind and the
+ *   ring is full the sample is counted as dropped rather than blocking the caller.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void stats_push(STATS_T *stats, const STATS_SAMPLE_T *sample)
+{
+	unsigned head = atomic_load_explicit(&stats->head, memory_order_relaxed);
+	unsigned tail = atomic_load_explicit(&stats->tail, memory_order_acquire);
+
+	if (head - tail >= STATS_RING_SIZE)
+	{
+		atomic_fetch_add_explicit(&stats->dropped, 1, memory_order_relaxed);
+		return;
+	}
+
+	stats->ring[head & (STATS_RING_SIZE - 1)] = *sample;
+	atomic_store_explicit(&stats->head, head + 1, memory_order_release);
+}
+
+/***********************************************************
+ * Name: stats_stop
+ *
+ * Arguments:
+ *   STATS_T *stats = stats object started with stats_start()
+ *
+ * Description:
+ *   Stops the reporter thread after it has written a final summary
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void stats_stop(STATS_T *stats)
+{
+	if (!atomic_exchange(&stats->running, 0)) return;
+	pthread_join(stats->reporter, NULL);
+}
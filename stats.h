@@ -0,0 +1,65 @@
+/***********************************************************
+ * File: stats.h
+ *
+ * Description:
+ *   Frame statistics: a lock-free single-producer/single-consumer ring of frame timings
+ *   that the render thread pushes into, and a background reporter thread that drains it
+ *   into histograms and prints min/avg/p99/max once per interval. Samples that carry a
+ *   quality governor decision are also logged as they are drained. The render thread
+ *   never touches stdio.
+ *
+ ***********************************************************/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "frame_clock.h"
+
+#define STATS_RING_SIZE 1024 // Number of samples the ring can hold, must be a power of two
+#define STATS_DEFAULT_INTERVAL_MS 1000 // Default reporting interval
+
+typedef struct
+{
+	uint32_t frame_us; // Microseconds since the previous frame
+	uint32_t submit_us; // Microseconds spent issuing GL commands
+	uint32_t swap_us; // Microseconds blocked in eglSwapBuffers
+	uint32_t state_issued; // GL state calls passed to the driver
+	uint32_t state_elided; // Redundant GL state calls skipped by the state cache
+	uint32_t arena_bytes; // Frame arena bytes requested this frame
+	uint32_t upload_bytes; // Texture bytes uploaded this frame
+
+	// Quality governor decision, only on frames where the level changed
+	const char *governor_reason; // Static string, NULL when there was no decision
+	int8_t governor_from;
+	int8_t governor_to;
+	int32_t governor_temp_mc; // Readings the decision was based on
+	uint16_t governor_arm_mhz;
+	uint16_t governor_core_mhz;
+	uint32_t governor_throttled;
+	uint32_t governor_frame_us; // Mean frame time over the last sample period
+} STATS_SAMPLE_T;
+
+typedef struct
+{
+	// Ring storage, written only by the render thread and read only by the reporter
+	STATS_SAMPLE_T ring[STATS_RING_SIZE];
+	atomic_uint head; // Next slot the producer writes, only advanced by the producer
+	atomic_uint tail; // Next slot the consumer reads, only advanced by the consumer
+	atomic_uint dropped; // Samples discarded because the ring was full
+
+	// Reporter thread
+	pthread_t reporter;
+	atomic_int running;
+	uint32_t interval_ms; // How often a summary line is written
+	FILE *out; // Destination for summary lines
+} STATS_T;
+
+int stats_start(STATS_T *stats, uint32_t interval_ms, FILE *out);
+void stats_push(STATS_T *stats, const STATS_SAMPLE_T *sample);
+void stats_stop(STATS_T *stats);
+
+#endif
@@ -0,0 +1,147 @@
+/***********************************************************
+ * File: stream.c
+ *
+ * Description:
+ *   Round-robin streaming vertex buffer. See stream.h.
+ *
+ ***********************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "stream.h"
+
+/***********************************************************
+ * Name: stream_init
+ *
+ * Arguments:
+ *   STREAM_BUFFER_T *stream = stream to initialise
+ *   GL_CACHE_T *cache = state cache used for buffer bindings
+ *   uint32_t buffer_count = VBOs to rotate through, 1 to orphan a single buffer instead
+ *   uint32_t capacity = bytes of vertex data one frame may write
+ *
+ * Description:
+ *   Allocates the staging area and the GL_STREAM_DRAW buffers at full size up front so
+ *   that no allocation happens in the render loop
+ *
+ * Returns:
+ *   int = 0 on success, -1 on allocation failure
+ *
+ ***********************************************************/
+int stream_init(STREAM_BUFFER_T *stream, GL_CACHE_T *cache, uint32_t buffer_count, uint32_t capacity)
+{
+	memset(stream, 0, sizeof(*stream));
+	stream->cache = cache;
+	if (buffer_count < 1) buffer_count = 1;
+	if (buffer_count > STREAM_MAX_BUFFERS) buffer_count = STREAM_MAX_BUFFERS;
+	stream->buffer_count = buffer_count;
+	stream->capacity = (capacity + STREAM_ALIGNMENT - 1) & ~(STREAM_ALIGNMENT - 1);
+
+	stream->staging = malloc(stream->capacity);
+	if (!stream->staging) return -1;
+
+	glGenBuffers(buffer_count, stream->vbo);
+	for (uint32_t i = 0; i < buffer_count; i++)
+	{
+		gl_cache_bind_buffer(cache, GL_ARRAY_BUFFER, stream->vbo[i]);
+		glBufferData(GL_ARRAY_BUFFER, stream->capacity, NULL, GL_STREAM_DRAW);
+	}
+	check();
+	return 0;
+}
+
+/***********************************************************
+ * Name: stream_begin_frame
+ *
+ * Arguments:
+ *   STREAM_BUFFER_T *stream = stream to advance
+ *
+ * Description:
+ *   Moves on to the next buffer in the rotation and resets the frame's sub-allocator.
+ *   Offsets returned by stream_alloc() after this refer to the new buffer.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void stream_begin_frame(STREAM_BUFFER_T *stream)
+{
+	stream->current = (stream->current + 1) % stream->buffer_count;
+	stream->used = 0;
+}
+
+/***********************************************************
+ * Name: stream_alloc
+ *
+ * Arguments:
+ *   STREAM_BUFFER_T *stream = stream to allocate from
+ *   uint32_t bytes = size of the vertex data to write
+ *   uint32_t *offset = receives the byte offset of the data in the frame's VBO
+ *
+ * Description:
+ *   Bump-allocates space for this frame's vertex data. The memory is plain CPU memory
+ *   and stays writable until stream_upload().
+ *
+ * Returns:
+ *   void * = where to write the vertices, or NULL if the frame's capacity is exhausted
+ *
+ ***********************************************************/
+void *stream_alloc(STREAM_BUFFER_T *stream, uint32_t bytes, uint32_t *offset)
+{
+	uint32_t start = stream->used;
+	uint32_t end = (start + bytes + STREAM_ALIGNMENT - 1) & ~(STREAM_ALIGNMENT - 1);
+	if (end > stream->capacity || end < start)
+	{
+		stream->failed++;
+		return NULL;
+	}
+
+	stream->used = end;
+	if (end > stream->high_water) stream->high_water = end;
+	*offset = start;
+	return stream->staging + start;
+}
+
+/***********************************************************
+ * Name: stream_upload
+ *
+ * Arguments:
+ *   STREAM_BUFFER_T *stream = stream whose frame data is complete
+ *
+ * Description:
+ *   Copies everything written this frame to the current VBO in one call and leaves that
+ *   VBO bound to GL_ARRAY_BUFFER, ready for glVertexAttribPointer with the offsets from
+ *   stream_alloc(). A lone buffer is orphaned first so the upload cannot stall on draws
+ *   from the previous frame.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void stream_upload(STREAM_BUFFER_T *stream)
+{
+	gl_cache_bind_buffer(stream->cache, GL_ARRAY_BUFFER, stream->vbo[stream->current]);
+	if (stream->buffer_count == 1) glBufferData(GL_ARRAY_BUFFER, stream->capacity, NULL, GL_STREAM_DRAW);
+	if (stream->used) glBufferSubData(GL_ARRAY_BUFFER, 0, stream->used, stream->staging);
+}
+
+/***********************************************************
+ * Name: stream_destroy
+ *
+ * Arguments:
+ *   STREAM_BUFFER_T *stream = stream created with stream_init()
+ *
+ * Description:
+ *   Releases the VBOs and staging memory
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void stream_destroy(STREAM_BUFFER_T *stream)
+{
+	for (uint32_t i = 0; i < stream->buffer_count; i++) gl_cache_forget_buffer(stream->cache, stream->vbo[i]);
+	if (stream->buffer_count) glDeleteBuffers(stream->buffer_count, stream->vbo);
+	free(stream->staging);
+	memset(stream, 0, sizeof(*stream));
+}
@@ -0,0 +1,48 @@
+/***********************************************************
+ * File: stream.h
+ *
+ * Description:
+ *   Streaming vertex buffer for geometry that is rewritten every frame. A round-robin
+ *   set of VBOs is cycled so the buffer written in frame N was last drawn from in frame
+ *   N - buffer_count, long after the tile binner has finished with it. Writes go to CPU
+ *   staging memory and reach the GPU with a single upload per frame, so per-frame
+ *   vertex writes never wait on the GPU. With a single buffer the storage is orphaned
+ *   every frame instead, leaving the driver to hand out fresh memory.
+ *
+ ***********************************************************/
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+#include "GLES2/gl2.h"
+#include "gl_cache.h"
+
+#define STREAM_MAX_BUFFERS 4
+#define STREAM_DEFAULT_BUFFERS 3 // Enough for double-buffered swap plus one frame being binned
+#define STREAM_ALIGNMENT 8 // Sub-allocation alignment in bytes
+
+typedef struct
+{
+	GL_CACHE_T *cache; // Buffer bindings go through the shared state cache
+	GLuint vbo[STREAM_MAX_BUFFERS];
+	uint32_t buffer_count; // VBOs in the rotation
+	uint32_t capacity; // Bytes per VBO and in the staging area
+	uint32_t current; // VBO used by the frame being recorded
+
+	// CPU staging for the current frame
+	uint8_t *staging;
+	uint32_t used; // Bytes sub-allocated so far this frame
+
+	// Statistics
+	uint32_t high_water; // Largest number of bytes used in one frame
+	uint32_t failed; // Allocations refused because the frame's capacity was exhausted
+} STREAM_BUFFER_T;
+
+int stream_init(STREAM_BUFFER_T *stream, GL_CACHE_T *cache, uint32_t buffer_count, uint32_t capacity);
+void stream_begin_frame(STREAM_BUFFER_T *stream);
+void *stream_alloc(STREAM_BUFFER_T *stream, uint32_t bytes, uint32_t *offset);
+void stream_upload(STREAM_BUFFER_T *stream);
+void stream_destroy(STREAM_BUFFER_T *stream);
+
+#endif
@@ -0,0 +1,472 @@
+/***********************************************************
+ * File: texture.c
+ *
+ * Description:
+ *   Background texture decoding and budgeted uploads. See texture.h. The built-in
+ *   decoders are in texture_decode.c.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frame_clock.h"
+#include "etc1.h"
+#include "texture.h"
+
+static uint32_t texture_pixel_bytes(GLenum format)
+{
+	switch (format)
+	{
+		case GL_LUMINANCE: return 1;
+		case GL_LUMINANCE_ALPHA: return 2;
+		case GL_RGB: return 3;
+		case GL_RGBA: return 4;
+	}
+	return 0;
+}
+
+static uint32_t texture_levels(const TEXTURE_IMAGE_T *image)
+{
+	return image->format == GL_ETC1_RGB8_OES && image->levels > 1 ? image->levels : 1;
+}
+
+static uint32_t texture_level_size(uint32_t size, uint32_t level)
+{
+	return size >> level ? size >> level : 1;
+}
+
+// Bytes of pixel data in the image, 0 for an unknown format
+static uint64_t texture_image_bytes(const TEXTURE_IMAGE_T *image)
+{
+	if (image->format != GL_ETC1_RGB8_OES) return (uint64_t)image->width * image->height * texture_pixel_bytes(image->format);
+
+	uint64_t bytes = 0;
+	for (uint32_t level = 0; level < texture_levels(image); level++)
+		bytes += etc1_image_bytes(texture_level_size(image->width, level), texture_level_size(image->height, level));
+	return bytes;
+}
+
+/***********************************************************
+ * Name: texture_oldest
+ *
+ * Arguments:
+ *   TEXTURE_MANAGER_T *textures = manager to search, lock held
+ *   TEXTURE_STATE_T state, TEXTURE_STATE_T other = states to look for
+ *
+ * Description:
+ *   Finds the earliest requested slot in either state, so textures become ready in the
+ *   order the scene asked for them
+ *
+ * Returns:
+ *   TEXTURE_SLOT_T * = oldest matching slot, NULL if there is none
+ *
+ ***********************************************************/
+static TEXTURE_SLOT_T *texture_oldest(TEXTURE_MANAGER_T *textures, TEXTURE_STATE_T state, TEXTURE_STATE_T other)
+{
+	TEXTURE_SLOT_T *oldest = NULL;
+	for (int i = 0; i < TEXTURE_MAX; i++)
+	{
+		TEXTURE_SLOT_T *slot = &textures->slots[i];
+		if (slot->state != state && slot->state != other) continue;
+		if (!oldest || (int32_t)(slot->sequence - oldest->sequence) < 0) oldest = slot;
+	}
+	return oldest;
+}
+
+// Returns a slot's staging buffer to the pool, lock held
+static void texture_free_staging(TEXTURE_MANAGER_T *textures, TEXTURE_SLOT_T *slot)
+{
+	if (slot->staging < 0) return;
+	textures->staging_free |= 1u << slot->staging;
+	slot->staging = -1;
+	slot->image.pixels = NULL;
+	pthread_cond_broadcast(&textures->wake);
+}
+
+static void *texture_thread(void *arg)
+{
+	TEXTURE_MANAGER_T *textures = (TEXTURE_MANAGER_T *)arg;
+
+	pthread_mutex_lock(&textures->lock);
+	for (;;)
+	{
+		// Wait for both a request and somewhere to decode it
+		TEXTURE_SLOT_T *slot = NULL;
+		while (!textures->quit)
+		{
+			if (textures->staging_free && (slot = texture_oldest(textures, TEXTURE_QUEUED, TEXTURE_QUEUED))) break;
+			pthread_cond_wait(&textures->wake, &textures->lock);
+		}
+		if (textures->quit) break;
+
+		slot->staging = __builtin_ctz(textures->staging_free);
+		textures->staging_free &= ~(1u << slot->staging);
+		slot->state = TEXTURE_DECODING;
+		memset(&slot->image, 0, sizeof(slot->image));
+		slot->image.pixels = textures->staging[slot->staging];
+		slot->image.capacity = textures->staging_bytes;
+		pthread_mutex_unlock(&textures->lock);
+
+		uint64_t start = frame_clock_now();
+		TEXTURE_IMAGE_T *image = &slot->image;
+		int result = slot->decode(slot->source, slot->user, image);
+		uint64_t image_bytes = texture_image_bytes(image);
+		if (result == 0 && (!image->width || !image->height || !image_bytes || image_bytes > image->capacity)) result = -1;
+
+		pthread_mutex_lock(&textures->lock);
+		slot->decode_ns = frame_clock_now() - start;
+		if (slot->state == TEXTURE_CANCELLED)
+		{
+			texture_free_staging(textures, slot);
+			slot->state = TEXTURE_EMPTY;
+		}
+		else if (result != 0)
+		{
+			texture_free_staging(textures, slot);
+			slot->state = TEXTURE_FAILED;
+			textures->failed++;
+		}
+		else
+		{
+			slot->state = TEXTURE_DECODED;
+			textures->decoded++;
+		}
+	}
+	pthread_mutex_unlock(&textures->lock);
+	return NULL;
+}
+
+/***********************************************************
+ * Name: texture_manager_init
+ *
+ * Arguments:
+ *   TEXTURE_MANAGER_T *textures = manager to initialise
+ *   uint32_t threads = decode threads, clamped to 1..TEXTURE_THREADS_MAX
+ *   uint32_t staging_buffers = staging pool size, clamped to 1..TEXTURE_STAGING_MAX
+ *   uint32_t staging_bytes = size of each staging buffer, the largest decodable image
+ *   GLuint verbose = print the decode time and latency of every texture
+ *
+ * Description:
+ *   Allocates the staging pool up front and starts the decode threads. More staging
+ *   buffers than threads let decoding run ahead while earlier images are uploading.
+ *   Touches no GL, so the manager can be started and fed requests before the context
+ *   exists and decode while EGL initialises; ETC1 support is checked on the first
+ *   texture_pump().
+ *
+ * Returns:
+ *   int = 0 on success, -1 if memory or threads could not be obtained
+ *
+ ***********************************************************/
+int texture_manager_init(TEXTURE_MANAGER_T *textures, uint32_t threads, uint32_t staging_buffers, uint32_t staging_bytes, GLuint verbose)
+{
+	memset(textures, 0, sizeof(*textures));
+	pthread_mutex_init(&textures->lock, NULL);
+	pthread_cond_init(&textures->wake, NULL);
+	textures->verbose = verbose;
+	textures->etc1 = -1;
+	for (int i = 0; i < TEXTURE_MAX; i++) textures->slots[i].staging = -1;
+
+	if (staging_buffers < 1) staging_buffers = 1;
+	if (staging_buffers > TEXTURE_STAGING_MAX) staging_buffers = TEXTURE_STAGING_MAX;
+	textures->staging_bytes = staging_bytes ? staging_bytes : TEXTURE_DEFAULT_STAGING_BYTES;
+	for (uint32_t i = 0; i < staging_buffers; i++)
+	{
+		textures->staging[i] = malloc(textures->staging_bytes);
+		if (!textures->staging[i])
+		{
+			texture_manager_destroy(textures, NULL);
+			return -1;
+		}
+		textures->staging_count++;
+		textures->staging_free |= 1u << i;
+	}
+
+	if (threads < 1) threads = 1;
+	if (threads > TEXTURE_THREADS_MAX) threads = TEXTURE_THREADS_MAX;
+	for (uint32_t i = 0; i < threads; i++)
+	{
+		if (pthread_create(&textures->threads[i], NULL, texture_thread, textures) != 0)
+		{
+			texture_manager_destroy(textures, NULL);
+			return -1;
+		}
+		textures->thread_count++;
+	}
+	return 0;
+}
+
+/***********************************************************
+ * Name: texture_request
+ *
+ * Arguments:
+ *   TEXTURE_MANAGER_T *textures = manager to queue on
+ *   const char *source = passed to decode, e.g. a file name; must stay valid until decoded
+ *   TEXTURE_DECODE_FN decode = decoder, e.g. texture_decode_pnm
+ *   void *user = passed to decode
+ *
+ * Description:
+ *   Queues an image for background decoding and returns immediately
+ *
+ * Returns:
+ *   int = handle for texture_get() and texture_release(), -1 if every handle is in use
+ *
+ ***********************************************************/
+int texture_request(TEXTURE_MANAGER_T *textures, const char *source, TEXTURE_DECODE_FN decode, void *user)
+{
+	int handle = -1;
+	pthread_mutex_lock(&textures->lock);
+	for (int i = 0; i < TEXTURE_MAX; i++)
+	{
+		TEXTURE_SLOT_T *slot = &textures->slots[i];
+		if (slot->state != TEXTURE_EMPTY) continue;
+
+		slot->sequence = textures->next_sequence++;
+		slot->source = source;
+		slot->decode = decode;
+		slot->user = user;
+		slot->rows_uploaded = 0;
+		slot->requested_ns = frame_clock_now();
+		slot->state = TEXTURE_QUEUED;
+		pthread_cond_broadcast(&textures->wake);
+		handle = i;
+		break;
+	}
+	pthread_mutex_unlock(&textures->lock);
+	return handle;
+}
+
+// Requests still waiting for or being decoded. Thread safe.
+uint32_t texture_decodes_pending(TEXTURE_MANAGER_T *textures)
+{
+	uint32_t pending = 0;
+	pthread_mutex_lock(&textures->lock);
+	for (int i = 0; i < TEXTURE_MAX; i++)
+	{
+		TEXTURE_STATE_T state = textures->slots[i].state;
+		if (state == TEXTURE_QUEUED || state == TEXTURE_DECODING) pending++;
+	}
+	pthread_mutex_unlock(&textures->lock);
+	return pending;
+}
+
+GLuint texture_get(const TEXTURE_MANAGER_T *textures, int handle)
+{
+	if (handle < 0 || handle >= TEXTURE_MAX) return 0;
+	return textures->slots[handle].ready;
+}
+
+/***********************************************************
+ * Name: texture_pump
+ *
+ * Arguments:
+ *   TEXTURE_MANAGER_T *textures = manager to service, GL thread only
+ *   GL_CACHE_T *cache = state cache the texture bindings go through
+ *   uint32_t budget_bytes = pixel bytes that may be uploaded this frame
+ *
+ * Description:
+ *   Uploads decoded images oldest first until the budget is spent. An image that fits
+ *   the remaining budget goes up in a single glTexImage2D; a larger one is allocated
+ *   empty and filled with glTexSubImage2D row strips across frames. At least one row is
+ *   uploaded per call while anything is pending, so a tiny budget still makes progress.
+ *   ETC1 images always go up whole, once the remaining budget covers them or as the
+ *   first upload of the call.
+ *   Call once per frame after the swap.
+ *
+ * Returns:
+ *   uint32_t = bytes uploaded
+ *
+ ***********************************************************/
+uint32_t texture_pump(TEXTURE_MANAGER_T *textures, GL_CACHE_T *cache, uint32_t budget_bytes)
+{
+	uint32_t uploaded = 0;
+	int unpack_set = 0;
+
+	if (textures->etc1 < 0)
+	{
+		const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+		textures->etc1 = extensions && strstr(extensions, "GL_OES_compressed_ETC1_RGB8_texture");
+	}
+
+	while (uploaded < budget_bytes)
+	{
+		pthread_mutex_lock(&textures->lock);
+		TEXTURE_SLOT_T *slot = texture_oldest(textures, TEXTURE_UPLOADING, TEXTURE_DECODED);
+		int start = slot && slot->state == TEXTURE_DECODED;
+		if (start) slot->state = TEXTURE_UPLOADING;
+		pthread_mutex_unlock(&textures->lock);
+		if (!slot) break;
+
+		const TEXTURE_IMAGE_T *image = &slot->image;
+		if (image->format == GL_ETC1_RGB8_OES)
+		{
+			uint32_t bytes = (uint32_t)texture_image_bytes(image);
+			if (uploaded && bytes > budget_bytes - uploaded)
+			{
+				// Wait for a frame with enough budget left
+				pthread_mutex_lock(&textures->lock);
+				slot->state = TEXTURE_DECODED;
+				pthread_mutex_unlock(&textures->lock);
+				break;
+			}
+			if (!textures->etc1)
+			{
+				if (textures->verbose) printf("Texture %d: ETC1 is not supported by this driver\n", (int)(slot - textures->slots));
+				pthread_mutex_lock(&textures->lock);
+				texture_free_staging(textures, slot);
+				slot->state = TEXTURE_FAILED;
+				textures->failed++;
+				pthread_mutex_unlock(&textures->lock);
+				continue;
+			}
+
+			glGenTextures(1, &slot->texture);
+			gl_cache_bind_texture(cache, slot->texture);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texture_levels(image) > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			const uint8_t *data = image->pixels;
+			for (uint32_t level = 0; level < texture_levels(image); level++)
+			{
+				uint32_t width = texture_level_size(image->width, level), height = texture_level_size(image->height, level);
+				uint32_t level_bytes = etc1_image_bytes(width, height);
+				glCompressedTexImage2D(GL_TEXTURE_2D, level, GL_ETC1_RGB8_OES, width, height, 0, level_bytes, data);
+				data += level_bytes;
+			}
+			slot->rows_uploaded = image->height;
+			uploaded += bytes;
+		}
+		else
+		{
+			// Staging rows are tightly packed
+			if (!unpack_set)
+			{
+				glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+				unpack_set = 1;
+			}
+
+			uint32_t row_bytes = image->width * texture_pixel_bytes(image->format);
+			uint32_t rows = (budget_bytes - uploaded) / row_bytes;
+			if (rows < 1) rows = 1;
+			if (rows > image->height - slot->rows_uploaded) rows = image->height - slot->rows_uploaded;
+
+			if (start)
+			{
+				glGenTextures(1, &slot->texture);
+				gl_cache_bind_texture(cache, slot->texture);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+				// Whole image in one call when it fits, otherwise just allocate the storage
+				int whole = rows == image->height;
+				glTexImage2D(GL_TEXTURE_2D, 0, image->format, image->width, image->height, 0, image->format, GL_UNSIGNED_BYTE, whole ? image->pixels : NULL);
+				if (whole) slot->rows_uploaded = image->height;
+			}
+			else
+			{
+				gl_cache_bind_texture(cache, slot->texture);
+			}
+
+			if (slot->rows_uploaded < image->height)
+			{
+				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, slot->rows_uploaded, image->width, rows, image->format, GL_UNSIGNED_BYTE,
+					image->pixels + (size_t)slot->rows_uploaded * row_bytes);
+				slot->rows_uploaded += rows;
+			}
+			uploaded += rows * row_bytes;
+		}
+		if (slot->rows_uploaded < image->height) continue;
+
+		// Complete: the staging buffer can take the next decode
+		slot->ready = slot->texture;
+		if (textures->verbose)
+			printf("Texture %d: %ux%u decoded in %.1f ms, ready %.1f ms after request\n", (int)(slot - textures->slots),
+				image->width, image->height, slot->decode_ns / 1e6, (frame_clock_now() - slot->requested_ns) / 1e6);
+		pthread_mutex_lock(&textures->lock);
+		texture_free_staging(textures, slot);
+		slot->state = TEXTURE_READY;
+		pthread_mutex_unlock(&textures->lock);
+	}
+
+	textures->uploaded_bytes += uploaded;
+	return uploaded;
+}
+
+/***********************************************************
+ * Name: texture_release
+ *
+ * Arguments:
+ *   TEXTURE_MANAGER_T *textures = owning manager, GL thread only
+ *   GL_CACHE_T *cache = state cache to drop the binding from
+ *   int handle = handle from texture_request(), negative handles are ignored
+ *
+ * Description:
+ *   Deletes the texture and frees the handle at any stage. A request that is still
+ *   being decoded is cancelled and its handle is reused once the decode thread
+ *   lets go of it.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void texture_release(TEXTURE_MANAGER_T *textures, GL_CACHE_T *cache, int handle)
+{
+	if (handle < 0 || handle >= TEXTURE_MAX) return;
+	TEXTURE_SLOT_T *slot = &textures->slots[handle];
+
+	pthread_mutex_lock(&textures->lock);
+	if (slot->state == TEXTURE_DECODING)
+	{
+		slot->state = TEXTURE_CANCELLED;
+	}
+	else if (slot->state != TEXTURE_CANCELLED)
+	{
+		texture_free_staging(textures, slot);
+		slot->state = TEXTURE_EMPTY;
+	}
+	pthread_mutex_unlock(&textures->lock);
+
+	if (slot->texture)
+	{
+		gl_cache_forget_texture(cache, slot->texture);
+		glDeleteTextures(1, &slot->texture);
+		slot->texture = 0;
+		slot->ready = 0;
+	}
+}
+
+/***********************************************************
+ * Name: texture_manager_destroy
+ *
+ * Arguments:
+ *   TEXTURE_MANAGER_T *textures = manager to tear down
+ *   GL_CACHE_T *cache = state cache, may be NULL if no texture was ever uploaded
+ *
+ * Description:
+ *   Stops the decode threads, letting any decode in progress finish, then deletes
+ *   every remaining texture and frees the staging pool
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void texture_manager_destroy(TEXTURE_MANAGER_T *textures, GL_CACHE_T *cache)
+{
+	pthread_mutex_lock(&textures->lock);
+	textures->quit = 1;
+	pthread_cond_broadcast(&textures->wake);
+	pthread_mutex_unlock(&textures->lock);
+	for (uint32_t i = 0; i < textures->thread_count; i++) pthread_join(textures->threads[i], NULL);
+	textures->thread_count = 0;
+
+	for (int i = 0; i < TEXTURE_MAX; i++)
+		if (textures->slots[i].state != TEXTURE_EMPTY) texture_release(textures, cache, i);
+
+	for (uint32_t i = 0; i < textures->staging_count; i++) free(textures->staging[i]);
+	textures->staging_count = 0;
+	pthread_cond_destroy(&textures->wake);
+	pthread_mutex_destroy(&textures->lock);
+}
@@ -0,0 +1,115 @@
+/***********************************************************
+ * File: texture.h
+ *
+ * Description:
+ *   Asynchronous texture streaming. Image decoding runs on background decode threads
+ *   into a fixed pool of staging buffers, and the GL thread uploads the decoded pixels
+ *   with a per-frame byte budget from texture_pump(), so neither decoding nor large
+ *   uploads stall a frame. Images bigger than the budget are uploaded in row strips
+ *   over several frames. texture_get() returns 0 until a texture is fully uploaded.
+ *
+ *   ETC1 images from PKM or KTX files are passed to glCompressedTexImage2D as they are,
+ *   a whole image per upload since ETC1 has no sub-image updates.
+ *
+ ***********************************************************/
+
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "GLES2/gl2.h"
+#include "gl_cache.h"
+
+#define TEXTURE_MAX 64 // Texture handles in one manager
+#define TEXTURE_THREADS_MAX 4
+#define TEXTURE_STAGING_MAX 8
+#define TEXTURE_DEFAULT_THREADS 2
+#define TEXTURE_DEFAULT_STAGING_BUFFERS 4
+#define TEXTURE_DEFAULT_STAGING_BYTES (1024 * 1024) // Fits a 512x512 RGBA image
+#define TEXTURE_DEFAULT_UPLOAD_BYTES (256 * 1024) // Per-frame glTex(Sub)Image2D budget
+
+typedef struct
+{
+	uint32_t width;
+	uint32_t height;
+	GLenum format; // GL_LUMINANCE, GL_RGB or GL_RGBA, always GL_UNSIGNED_BYTE and tightly packed, or GL_ETC1_RGB8_OES
+	uint32_t levels; // ETC1 only: mip levels stored one after another, 0 is treated as 1, more than 1 a complete chain
+	uint8_t *pixels; // Staging buffer to decode into
+	uint32_t capacity; // Size of pixels in bytes
+} TEXTURE_IMAGE_T;
+
+// Decodes source into image->pixels and sets the size and format. Runs on a decode
+// thread, so it must not touch GL. Returns 0 on success, -1 on failure or if the image
+// does not fit in image->capacity.
+typedef int (*TEXTURE_DECODE_FN)(const char *source, void *user, TEXTURE_IMAGE_T *image);
+
+typedef enum
+{
+	TEXTURE_EMPTY, // Handle is free
+	TEXTURE_QUEUED, // Waiting for a decode thread and a staging buffer
+	TEXTURE_DECODING, // Owned by a decode thread
+	TEXTURE_CANCELLED, // Released while decoding, freed when the decode finishes
+	TEXTURE_DECODED, // Pixels in staging, waiting for upload budget
+	TEXTURE_UPLOADING, // Partly uploaded
+	TEXTURE_READY, // Uploaded, staging buffer returned to the pool
+	TEXTURE_FAILED // Decode failed, texture_get() stays 0
+} TEXTURE_STATE_T;
+
+typedef struct
+{
+	TEXTURE_STATE_T state;
+	uint32_t sequence; // Request order, decodes and uploads are served oldest first
+	const char *source; // Must stay valid until the texture is decoded
+	TEXTURE_DECODE_FN decode;
+	void *user;
+	TEXTURE_IMAGE_T image;
+	int staging; // Staging buffer index while decoded, -1 otherwise
+	uint32_t rows_uploaded;
+	GLuint texture; // Non-zero once uploading has started
+	GLuint ready; // texture once fully uploaded, only read and written by the GL thread
+	uint64_t requested_ns; // For verbose latency reporting
+	uint64_t decode_ns;
+} TEXTURE_SLOT_T;
+
+typedef struct
+{
+	TEXTURE_SLOT_T slots[TEXTURE_MAX];
+	uint32_t next_sequence;
+
+	// Staging pool, a decode only starts when a buffer is free
+	uint8_t *staging[TEXTURE_STAGING_MAX];
+	uint32_t staging_count;
+	uint32_t staging_bytes;
+	uint32_t staging_free; // Bit n set when staging[n] is free
+
+	// Decode threads
+	pthread_t threads[TEXTURE_THREADS_MAX];
+	uint32_t thread_count;
+	pthread_mutex_t lock; // Guards slot states and staging_free
+	pthread_cond_t wake; // Signalled on new requests, freed staging and shutdown
+	int quit;
+
+	GLuint verbose;
+	int etc1; // GL_OES_compressed_ETC1_RGB8_texture is available, -1 until the first texture_pump()
+
+	// Statistics
+	uint32_t decoded; // Images decoded
+	uint32_t failed; // Decodes that failed
+	uint64_t uploaded_bytes; // Total bytes passed to glTex(Sub)Image2D
+} TEXTURE_MANAGER_T;
+
+int texture_manager_init(TEXTURE_MANAGER_T *textures, uint32_t threads, uint32_t staging_buffers, uint32_t staging_bytes, GLuint verbose);
+int texture_request(TEXTURE_MANAGER_T *textures, const char *source, TEXTURE_DECODE_FN decode, void *user);
+GLuint texture_get(const TEXTURE_MANAGER_T *textures, int handle);
+uint32_t texture_decodes_pending(TEXTURE_MANAGER_T *textures);
+uint32_t texture_pump(TEXTURE_MANAGER_T *textures, GL_CACHE_T *cache, uint32_t budget_bytes);
+void texture_release(TEXTURE_MANAGER_T *textures, GL_CACHE_T *cache, int handle);
+void texture_manager_destroy(TEXTURE_MANAGER_T *textures, GL_CACHE_T *cache);
+
+int texture_decode_pnm(const char *source, void *user, TEXTURE_IMAGE_T *image);
+int texture_decode_pkm(const char *source, void *user, TEXTURE_IMAGE_T *image);
+int texture_decode_ktx(const char *source, void *user, TEXTURE_IMAGE_T *image);
+int texture_decode_file(const char *source, void *user, TEXTURE_IMAGE_T *image);
+
+#endif
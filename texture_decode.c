@@ -0,0 +1,222 @@
+/***********************************************************
+ * File: texture_decode.c
+ *
+ * Description:
+ *   Built-in image decoders for the texture manager, see texture.h. They run on the
+ *   decode threads and make no GL calls, so offline tools link them without the GL
+ *   libraries.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include "etc1.h"
+#include "texture.h"
+
+static uint32_t texture_level_size(uint32_t size, uint32_t level)
+{
+	return size >> level ? size >> level : 1;
+}
+
+// GLES2 only samples a mipmapped texture whose sides are powers of two and whose chain
+// reaches 1x1, anything else is incomplete and reads as black
+static int texture_mip_chain_complete(uint32_t width, uint32_t height, uint32_t levels)
+{
+	if ((width & (width - 1)) || (height & (height - 1))) return 0;
+	uint32_t full = 1;
+	for (uint32_t size = width > height ? width : height; size > 1; size >>= 1) full++;
+	return levels == full;
+}
+
+// Reads one decimal header field, skipping whitespace and comments. The single
+// whitespace character that ends the field is consumed.
+static int pnm_field(FILE *file, uint32_t *value)
+{
+	int c = fgetc(file);
+	while (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '#')
+	{
+		if (c == '#') while (c != '\n' && c != EOF) c = fgetc(file);
+		c = fgetc(file);
+	}
+	if (c < '0' || c > '9') return -1;
+
+	*value = 0;
+	while (c >= '0' && c <= '9')
+	{
+		if (*value > 100000) return -1;
+		*value = *value * 10 + (c - '0');
+		c = fgetc(file);
+	}
+	return 0;
+}
+
+/***********************************************************
+ * Name: texture_decode_pnm
+ *
+ * Arguments:
+ *   const char *source = path of a binary PGM (P5) or PPM (P6) file with maxval 255
+ *   void *user = unused
+ *   TEXTURE_IMAGE_T *image = receives the pixels, as GL_LUMINANCE or GL_RGB
+ *
+ * Description:
+ *   Built-in decoder for the netpbm formats, which need no image library. PNG or JPEG
+ *   decoders are plugged in the same way through TEXTURE_DECODE_FN.
+ *
+ * Returns:
+ *   int = 0 on success, -1 on error or if the image exceeds the staging buffer
+ *
+ ***********************************************************/
+int texture_decode_pnm(const char *source, void *user, TEXTURE_IMAGE_T *image)
+{
+	FILE *file = fopen(source, "rb");
+	if (!file) return -1;
+
+	int result = -1;
+	char magic[2];
+	uint32_t width, height, maxval;
+	if (fread(magic, 1, 2, file) == 2 && magic[0] == 'P' && (magic[1] == '5' || magic[1] == '6') &&
+		pnm_field(file, &width) == 0 && pnm_field(file, &height) == 0 && pnm_field(file, &maxval) == 0 && maxval == 255)
+	{
+		GLenum format = magic[1] == '5' ? GL_LUMINANCE : GL_RGB;
+		uint64_t bytes = (uint64_t)width * height * (format == GL_LUMINANCE ? 1 : 3);
+		if (width && height && bytes <= image->capacity && fread(image->pixels, 1, bytes, file) == bytes)
+		{
+			image->width = width;
+			image->height = height;
+			image->format = format;
+			result = 0;
+		}
+	}
+	fclose(file);
+	return result;
+}
+
+static uint32_t get_be16(const uint8_t *in)
+{
+	return ((uint32_t)in[0] << 8) | in[1];
+}
+
+/***********************************************************
+ * Name: texture_decode_pkm
+ *
+ * Arguments:
+ *   const char *source = path of a PKM file, e.g. from etc1tool or atlaspack.bin
+ *   void *user = unused
+ *   TEXTURE_IMAGE_T *image = receives the blocks, as GL_ETC1_RGB8_OES
+ *
+ * Description:
+ *   Reads a single-level ETC1 PKM file. The blocks are kept compressed.
+ *
+ * Returns:
+ *   int = 0 on success, -1 on error or if the data exceeds the staging buffer
+ *
+ ***********************************************************/
+int texture_decode_pkm(const char *source, void *user, TEXTURE_IMAGE_T *image)
+{
+	FILE *file = fopen(source, "rb");
+	if (!file) return -1;
+
+	int result = -1;
+	uint8_t header[ETC1_PKM_HEADER_BYTES];
+	if (fread(header, 1, sizeof(header), file) == sizeof(header) && memcmp(header, "PKM 10", 6) == 0 &&
+		get_be16(header + 6) == ETC1_PKM_TYPE_RGB)
+	{
+		// The padded size is what the blocks cover, the original size is what GL is told
+		uint32_t width = get_be16(header + 12), height = get_be16(header + 14);
+		uint32_t bytes = etc1_image_bytes(width, height);
+		if (width && height && get_be16(header + 8) == ((width + 3) & ~3u) && get_be16(header + 10) == ((height + 3) & ~3u) &&
+			bytes <= image->capacity && fread(image->pixels, 1, bytes, file) == bytes)
+		{
+			image->width = width;
+			image->height = height;
+			image->format = GL_ETC1_RGB8_OES;
+			image->levels = 1;
+			result = 0;
+		}
+	}
+	fclose(file);
+	return result;
+}
+
+/***********************************************************
+ * Name: texture_decode_ktx
+ *
+ * Arguments:
+ *   const char *source = path of a KTX 1.1 file holding a 2D ETC1 texture
+ *   void *user = unused
+ *   TEXTURE_IMAGE_T *image = receives every mip level, as GL_ETC1_RGB8_OES
+ *
+ * Description:
+ *   Reads an ETC1 KTX file with one mip level or a complete power-of-two mip chain.
+ *   Only files in the host's byte order are accepted; arrays, cube maps, uncompressed
+ *   KTX files and partial or non-power-of-two chains are rejected.
+ *
+ * Returns:
+ *   int = 0 on success, -1 on error or if the data exceeds the staging buffer
+ *
+ ***********************************************************/
+int texture_decode_ktx(const char *source, void *user, TEXTURE_IMAGE_T *image)
+{
+	FILE *file = fopen(source, "rb");
+	if (!file) return -1;
+
+	// Identifier, then endianness, glType, glTypeSize, glFormat, glInternalFormat,
+	// glBaseInternalFormat, width, height, depth, array elements, faces, levels, key/value bytes
+	uint8_t identifier[sizeof(etc1_ktx_identifier)];
+	uint32_t fields[13] = { 0 };
+	int ok = fread(identifier, 1, sizeof(identifier), file) == sizeof(identifier) && fread(fields, sizeof(uint32_t), 13, file) == 13 &&
+		memcmp(identifier, etc1_ktx_identifier, sizeof(identifier)) == 0 && fields[0] == ETC1_KTX_ENDIANNESS &&
+		fields[1] == 0 && fields[4] == GL_ETC1_RGB8_OES && fields[6] && fields[7] && fields[8] <= 1 && fields[9] == 0 &&
+		fields[10] == 1 && fields[11] <= 16 && fseek(file, fields[12], SEEK_CUR) == 0;
+
+	image->width = fields[6];
+	image->height = fields[7];
+	image->format = GL_ETC1_RGB8_OES;
+	image->levels = ok && fields[11] ? fields[11] : 1;
+	if (image->levels > 1 && !texture_mip_chain_complete(image->width, image->height, image->levels)) ok = 0;
+
+	// Levels are packed back to back in staging, in the order texture_pump() uploads them
+	uint32_t used = 0;
+	for (uint32_t level = 0; ok && level < image->levels; level++)
+	{
+		uint32_t size;
+		uint32_t bytes = etc1_image_bytes(texture_level_size(image->width, level), texture_level_size(image->height, level));
+		ok = fread(&size, sizeof(size), 1, file) == 1 && size == bytes && bytes <= image->capacity - used &&
+			fread(image->pixels + used, 1, bytes, file) == bytes;
+		used += bytes;
+	}
+	fclose(file);
+
+	if (!ok) image->width = image->height = 0;
+	return ok ? 0 : -1;
+}
+
+/***********************************************************
+ * Name: texture_decode_file
+ *
+ * Arguments:
+ *   const char *source = path of a PGM, PPM, PKM or KTX file
+ *   void *user = unused
+ *   TEXTURE_IMAGE_T *image = receives the image
+ *
+ * Description:
+ *   Picks the decoder from the first bytes of the file
+ *
+ * Returns:
+ *   int = 0 on success, -1 on error or unknown file type
+ *
+ ***********************************************************/
+int texture_decode_file(const char *source, void *user, TEXTURE_IMAGE_T *image)
+{
+	uint8_t magic[4];
+	FILE *file = fopen(source, "rb");
+	if (!file) return -1;
+	size_t got = fread(magic, 1, sizeof(magic), file);
+	fclose(file);
+	if (got < sizeof(magic)) return -1;
+
+	if (memcmp(magic, "PKM ", 4) == 0) return texture_decode_pkm(source, user, image);
+	if (memcmp(magic, etc1_ktx_identifier, 4) == 0) return texture_decode_ktx(source, user, image);
+	if (magic[0] == 'P' && (magic[1] == '5' || magic[1] == '6')) return texture_decode_pnm(source, user, image);
+	return -1;
+}
@@ -0,0 +1,201 @@
+/***********************************************************
+ * File: trace.c
+ *
+ * Description:
+ *   Chrome trace-event recorder with sampled GPU timing. See trace.h.
+ *
+ ***********************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "GLES2/gl2.h"
+#include "frame_clock.h"
+#include "trace.h"
+
+static void trace_record(TRACE_T *trace, const char *name, uint64_t begin_ns, uint64_t end_ns, TRACE_TRACK_T track)
+{
+	if (trace->count == TRACE_MAX_EVENTS)
+	{
+		trace->dropped++;
+		return;
+	}
+
+	TRACE_EVENT_T *event = &trace->events[trace->count++];
+	event->name = name;
+	event->begin_ns = begin_ns;
+	event->end_ns = end_ns;
+	event->frame = trace->frame;
+	event->track = track;
+}
+
+/***********************************************************
+ * Name: trace_init
+ *
+ * Arguments:
+ *   TRACE_T *trace = trace to initialise
+ *   const char *path = JSON output file, NULL to disable tracing
+ *   uint32_t sample_every = take a GPU sample on one frame in this many, 0 for CPU only
+ *
+ * Description:
+ *   Preallocates the event store so recording never allocates in the render loop
+ *
+ * Returns:
+ *   int = 0 on success, -1 on allocation failure
+ *
+ ***********************************************************/
+int trace_init(TRACE_T *trace, const char *path, uint32_t sample_every)
+{
+	memset(trace, 0, sizeof(*trace));
+	if (!path) return 0;
+
+	trace->events = malloc(TRACE_MAX_EVENTS * sizeof(TRACE_EVENT_T));
+	if (!trace->events) return -1;
+	trace->path = path;
+	trace->sample_every = sample_every;
+	return 0;
+}
+
+/***********************************************************
+ * Name: trace_begin_frame
+ *
+ * Arguments:
+ *   TRACE_T *trace = trace to advance
+ *
+ * Description:
+ *   Starts a new frame and decides whether it is a GPU sample
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void trace_begin_frame(TRACE_T *trace)
+{
+	if (!trace->events) return;
+
+	trace->frame++;
+	trace->sampling = trace->sample_every && (trace->frame % trace->sample_every) == 0;
+	trace->depth = 0;
+	trace->overflow = 0;
+}
+
+/***********************************************************
+ * Name: trace_begin
+ *
+ * Arguments:
+ *   TRACE_T *trace = trace to record into
+ *   const char *name = scope name, kept by reference
+ *
+ * Description:
+ *   Opens a scope. On a sampled frame outstanding GPU work is drained first, so the
+ *   scope's GPU interval covers only its own commands. Scopes nested deeper than
+ *   TRACE_MAX_DEPTH are not recorded.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void trace_begin(TRACE_T *trace, const char *name)
+{
+	if (!trace->events) return;
+	if (trace->depth == TRACE_MAX_DEPTH)
+	{
+		trace->overflow++;
+		return;
+	}
+
+	if (trace->sampling) glFinish();
+	trace->stack[trace->depth].name = name;
+	trace->stack[trace->depth].begin_ns = frame_clock_now();
+	trace->depth++;
+}
+
+/***********************************************************
+ * Name: trace_end
+ *
+ * Arguments:
+ *   TRACE_T *trace = trace to record into
+ *
+ * Description:
+ *   Closes the innermost scope, recording its CPU interval and, on a sampled frame,
+ *   waiting for the GPU to record its GPU interval too
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void trace_end(TRACE_T *trace)
+{
+	if (!trace->events) return;
+	if (trace->overflow)
+	{
+		trace->overflow--;
+		return;
+	}
+	if (trace->depth == 0) return;
+
+	trace->depth--;
+	const char *name = trace->stack[trace->depth].name;
+	uint64_t begin_ns = trace->stack[trace->depth].begin_ns;
+	uint64_t cpu_end_ns = frame_clock_now();
+	trace_record(trace, name, begin_ns, cpu_end_ns, TRACE_TRACK_CPU);
+
+	if (trace->sampling)
+	{
+		glFinish();
+		trace_record(trace, name, begin_ns, frame_clock_now(), TRACE_TRACK_GPU);
+	}
+}
+
+/***********************************************************
+ * Name: trace_write
+ *
+ * Arguments:
+ *   TRACE_T *trace = trace to save
+ *
+ * Description:
+ *   Writes all recorded events as complete ("X") events in the Chrome trace-event JSON
+ *   format, with the CPU and GPU on separate named tracks. Timestamps are microseconds
+ *   relative to the first event.
+ *
+ * Returns:
+ *   int = 0 on success or when tracing is disabled, -1 if the file could not be written
+ *
+ ***********************************************************/
+int trace_write(TRACE_T *trace)
+{
+	if (!trace->events) return 0;
+
+	FILE *out = fopen(trace->path, "w");
+	if (!out) return -1;
+
+	uint64_t origin = trace->count ? trace->events[0].begin_ns : 0;
+	for (uint32_t i = 0; i < trace->count; i++)
+		if (trace->events[i].begin_ns < origin) origin = trace->events[i].begin_ns;
+
+	fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"CPU\"}},\n", TRACE_TRACK_CPU + 1);
+	fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"GPU (sampled)\"}}", TRACE_TRACK_GPU + 1);
+	for (uint32_t i = 0; i < trace->count; i++)
+	{
+		const TRACE_EVENT_T *event = &trace->events[i];
+		fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%u}}",
+			event->name,
+			event->track == TRACE_TRACK_GPU ? "gpu" : "cpu",
+			event->track + 1,
+			(event->begin_ns - origin) / 1000.0,
+			(event->end_ns - event->begin_ns) / 1000.0,
+			event->frame);
+	}
+	fprintf(out, "\n],\"otherData\":{\"sample_every\":%u,\"dropped_events\":%u}}\n", trace->sample_every, trace->dropped);
+
+	int failed = ferror(out);
+	failed |= fclose(out);
+	return failed ? -1 : 0;
+}
+
+void trace_destroy(TRACE_T *trace)
+{
+	free(trace->events);
+	memset(trace, 0, sizeof(*trace));
+}
@@ -0,0 +1,66 @@
+/***********************************************************
+ * File: trace.h
+ *
+ * Description:
+ *   Per-pass timing instrumentation written as Chrome trace-event JSON, viewable in
+ *   chrome://tracing or Perfetto. Each logical pass (clear, draw, swap) is wrapped in a
+ *   named scope. CPU time is recorded for every scope on every frame. GPU time is only
+ *   sampled on one frame in sample_every: on those frames each scope is bracketed with
+ *   glFinish() so its GPU work runs in isolation, and the normal path is never forced
+ *   to serialise.
+ *
+ ***********************************************************/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_MAX_EVENTS 65536 // Events beyond this are counted but not stored
+#define TRACE_MAX_DEPTH 8
+#define TRACE_DEFAULT_SAMPLE_EVERY 60
+
+typedef enum
+{
+	TRACE_TRACK_CPU, // Time the CPU spent issuing the scope's commands
+	TRACE_TRACK_GPU // Time until the GPU finished the scope's commands, sampled frames only
+} TRACE_TRACK_T;
+
+typedef struct
+{
+	const char *name; // Must be a string literal or otherwise outlive the trace
+	uint64_t begin_ns;
+	uint64_t end_ns;
+	uint32_t frame;
+	TRACE_TRACK_T track;
+} TRACE_EVENT_T;
+
+typedef struct
+{
+	const char *path; // Output file, NULL when tracing is disabled
+	uint32_t sample_every; // GPU timing is sampled on one frame in this many
+	uint32_t frame; // Frame counter
+	int sampling; // Current frame is a GPU sample
+
+	// Scopes currently open
+	struct
+	{
+		const char *name;
+		uint64_t begin_ns;
+	} stack[TRACE_MAX_DEPTH];
+	uint32_t depth;
+	uint32_t overflow; // Scopes opened beyond TRACE_MAX_DEPTH, their trace_end() calls are ignored
+
+	TRACE_EVENT_T *events;
+	uint32_t count;
+	uint32_t dropped;
+} TRACE_T;
+
+int trace_init(TRACE_T *trace, const char *path, uint32_t sample_every);
+void trace_begin_frame(TRACE_T *trace);
+void trace_begin(TRACE_T *trace, const char *name);
+void trace_end(TRACE_T *trace);
+int trace_write(TRACE_T *trace);
+void trace_destroy(TRACE_T *trace);
+
+#endif
@@ -12,57 +12,341 @@
 
 #include <stdio.h>
 #include <fcntl.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <assert.h>
 #include <unistd.h>
-#include <sys/time.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
 #include "bcm_host.h"
 #include "GLES2/gl2.h"
+#include "GLES2/gl2ext.h"
 #include "EGL/egl.h"
 #include "EGL/eglext.h"
+#include "check.h"
+#include "shader.h"
+#include "gl_cache.h"
+#include "batch.h"
+#include "stream.h"
+#include "bench.h"
+#include "frame_clock.h"
+#include "stats.h"
+#include "trace.h"
+#include "update.h"
+#include "workers.h"
+#include "cmdbuf.h"
+#include "arena.h"
+#include "kernels.h"
+#include "vertex_format.h"
+#include "mesh.h"
+#include "mesh_file.h"
+#include "texture.h"
+#include "atlas.h"
+#include "damage.h"
+#include "render_scale.h"
+#include "render_pass.h"
+#include "layer.h"
+#include "pacing.h"
+#include "uniform_cache.h"
+#include "overdraw.h"
+#include "startup.h"
+#include "scene_graph.h"
+#include "governor.h"
+#include "capture.h"
+
+#define BATCH_DEFAULT_PRIMITIVES 2000
+#define STREAM_POSITION_RANGE 2.0f // Clip-space extent covered by the stream scene's short positions
+#define STREAM_VERTEX_BYTES (4 * sizeof(GLshort) + 4) // Uploaded size: short4 position plus RGBA8 colour
+#define STREAM_SOURCE_BYTES (8 * sizeof(GLfloat)) // Simulated size: vec4 position plus vec4 colour
+#define TEXTURE_PATTERN_TILES 16 // Generated images in the texture scene when no files are given
+#define TEXTURE_PATTERN_SIZE 512
+#define TEXTURE_TILES_MAX 256 // Tiles drawn by the texture scene, atlas sprites beyond this are ignored
+#define BATCH_WORLD_CELL 0.25f // Scene graph grid cell in view units, the view is 2 high
+#define OVERLAY_WIDTH 256 // Frame time graph drawn on the overlay layer, in pixels
+#define OVERLAY_HEIGHT 96
+#define OVERLAY_MARGIN 16 // Distance from the bottom-left corner of the display
+#define OVERLAY_BARS 64 // Frames shown, one bar each
+#define OVERLAY_SAME_DISPLAY UINT32_MAX // Put the overlay on the scene's display
+#define OVERLAY_BUDGET_US 16667 // Frame time marked on the graph without --target-frame-ms
+
+typedef enum
+{
+	SCENE_TRIANGLE, // The original single full-screen triangle
+	SCENE_BATCH, // Many small spinning primitives through the batch renderer
+	SCENE_STREAM, // CPU-animated geometry rewritten every frame through a streaming buffer
+	SCENE_MESH, // Static indexed grid mesh drawn with glDrawElements
+	SCENE_TEXTURE // Grid of tiles whose textures are decoded and uploaded in the background
+} SCENE_T;
+
+typedef enum
+{
+	VERTEX_FLOAT, // 32-bit float components
+	VERTEX_SHORT, // Normalized 16-bit positions, 4-byte aligned vertices
+	VERTEX_PACKED // Normalized 16-bit positions, 2-byte aligned vertices
+} VERTEX_PRECISION_T;
+
+typedef struct
+{
+	GLfloat radius; // Orbit radius in view space
+	GLfloat angle; // Current position on the orbit in radians
+	GLfloat speed; // Angular velocity in radians per second
+	GLfloat size; // Half-size of the particle's triangle
+	GLfloat color[4]; // RGBA, brightness pulses as the particle orbits
+} PARTICLE_T;
 
 typedef struct
 {
-	// Screen dimensions in pixels
+	// Render surface dimensions in pixels, smaller than the display when rendering is scaled
 	uint32_t screen_width;
 	uint32_t screen_height;
+	uint32_t display_width; // Display mode, DispmanX scales the surface up to this
+	uint32_t display_height;
 
 	// OpenGL|ES objects
 	EGLDisplay display;
-	EGLSurface surface;
 	EGLContext context;
+	EGLConfig config; // Of the scene's surface, kept for layers created after startup
+
+	// Shadow of the GL state, so unchanged state is never re-sent to the driver
+	GL_CACHE_T gl_cache;
+
+	// DispmanX layers: the scene, and optionally a UI overlay blended on top of it by the
+	// display compositor. Each has its own window surface and update rate.
+	uint32_t display_id; // DispmanX display showing the scene
+	LAYER_T main_layer;
+	uint32_t overlay_hz; // Overlay redraws per second, 0 for no overlay
+	uint32_t overlay_display_id; // OVERLAY_SAME_DISPLAY or a DispmanX display
+	LAYER_T overlay;
+	RENDER_PASS_T overlay_pass;
+	uint32_t overlay_history[OVERLAY_BARS]; // Ring of recent frame times in microseconds
+	uint32_t overlay_next;
+
+	// Shader programs are built and cached by the shader manager
+	SHADER_MANAGER_T shaders;
+	const char *shader_cache_dir; // Program binary cache directory, NULL to disable
 
 	// Internal resource references
-	GLuint vshader; // Vertex shader
-	GLuint fshader; // Fragment shader
-	GLuint program; // Shader program
-	GLuint attr_vertex; // List of vertices for points of the triangle
+	int shader; // Shader manager handle of the triangle program
+	GLuint program; // Shader program, 0 until built
+	UNIFORM_CACHE_T uniforms; // Of program
+	GLint uniform_color; // Uniform cache slot
+	VERTEX_PRECISION_T vertex_precision; // Encoding of static triangle and batch vertices
+	VERTEX_FORMAT_T triangle_format; // Layout of vbo_triangle, drives the attribute setup
 	GLuint vbo_triangle; // Vertex buffer in GPU memory
 
+	// Batched scene
+	SCENE_T scene; // Which scene begin_scene() builds
+	uint32_t primitive_count; // Number of primitives in the batched scene
+	BATCH_T batch; // Batch renderer
+	BATCH_PRIMITIVE_T *primitives; // Per-primitive transform and colour
+	GLfloat *spin; // Per-primitive angular velocity in radians per second
+	GLuint sort_draws; // Translucent content, blended, with opaque primitives drawn first so blending is switched once
+
+	// Batched scene spread over a world larger than the view, culled through the scene graph
+	GLfloat world_scale; // World side in view sizes, 0 for the classic screen-sized scene
+	SCENE_GRAPH_T graph;
+	GLfloat world_time; // Seconds, drives the camera and the node rotations
+	uint64_t visible_total; // Primitives handed to the batch renderer, summed over frames
+	uint32_t cull_frames;
+
+	// Batched scene recorded on worker threads and replayed here in state-sorted order
+	uint32_t workers; // Recording threads including this one, 0 to draw directly
+	WORKER_POOL_T worker_pool;
+	CMD_LIST_T cmd_lists[WORKERS_MAX]; // One per worker, carved from the frame arena
+	uint32_t cmd_list_bytes; // Arena bytes given to each list per frame
+	CMD_QUEUE_T cmd_queue;
+	const BATCH_PRIMITIVE_T *record_primitives; // Input to the current recording job
+	uint32_t record_count; // Primitives in record_primitives
+	uint32_t record_draws; // Draw calls in the current recording job
+
+	// Streamed scene
+	STREAM_BUFFER_T stream; // Per-frame vertex storage
+	uint32_t stream_buffers; // VBOs in the stream rotation, 1 to orphan instead
+	PARTICLE_T *particles; // CPU-side particle state
+	GLfloat *stream_source; // Float vec4 positions then vec4 colours, converted by the kernels at upload
+	GLfloat *stream_clip; // Clip-space positions between the transform and quantise kernels
+	uint32_t stream_dropped; // Frames not drawn because the streaming buffer was full
+	int stream_shader; // Shader manager handle of stream_program
+	GLuint stream_program; // Per-vertex colour shader, 0 until built
+	GLint attr_stream_position;
+	GLint attr_stream_color;
+
+	// Indexed mesh scene
+	MESH_T mesh;
+	const char *mesh_path; // Binary mesh file to load instead of the generated grid
+	int mesh_shader; // Shader manager handle of mesh_program
+	GLuint mesh_program; // 0 until built
+	UNIFORM_CACHE_T mesh_uniforms;
+	GLint uniform_mesh_time; // Uniform cache slot
+	GLfloat mesh_time; // Seconds of animation
+
+	// Streamed texture scene
+	TEXTURE_MANAGER_T textures;
+	const char *texture_paths[TEXTURE_MAX]; // Images to show, generated patterns when empty
+	uint32_t texture_path_count;
+	const char *atlas_path; // Atlas manifest whose sprites are shown instead
+	ATLAS_T atlas;
+	uint32_t texture_upload_bytes; // Per-frame upload budget
+	uint32_t tile_count;
+	int tile_textures[TEXTURE_TILES_MAX]; // Texture manager handles, atlas tiles share their page's
+	GLfloat tile_uv[TEXTURE_TILES_MAX][4]; // Texture rectangle of each tile, u0 v0 u1 v1
+	GLuint tile_shown[TEXTURE_TILES_MAX]; // Texture each tile was last damaged for, 0 for the placeholder
+	GLuint tile_placeholder; // 1x1 grey texture drawn until a tile's own is ready
+	GLuint vbo_tile; // Unit quad
+	int tile_shader; // Shader manager handle of tile_program
+	GLuint tile_program; // 0 until built
+	GLint attr_tile_corner;
+	UNIFORM_CACHE_T tile_uniforms;
+	GLint uniform_tile_rect; // Uniform cache slots
+	GLint uniform_tile_uv;
+
+	// Texture scene with per-tile constants packed into vertex attributes, so a run of
+	// tiles sharing a texture (atlas sprites on one page) is a single draw
+	GLuint pack_constants;
+	GLuint vbo_tile_packed; // Six vertices per tile: corner, rect, uv
+	int tile_packed_shader;
+	GLuint tile_packed_program; // 0 until built
+	GLint attr_packed_corner;
+	GLint attr_packed_rect;
+	GLint attr_packed_uv;
+	uint32_t tile_draws; // Draw calls of the last frame
+
+	// Simulation on a dedicated thread, handing snapshots to render() through a triple buffer
+	uint32_t update_hz; // Update rate, 0 to advance the scene on the render thread instead
+	UPDATE_THREAD_T updater;
+	void *snapshots[3]; // Primitives (batch scene) or finished vertices (stream scene)
+
+	// Transient per-frame allocations, reset at the top of every loop iteration
+	FRAME_ARENA_T frame_arena;
+	uint32_t frame_arena_bytes; // Capacity of each of the arena's two regions
+
+	// Offscreen render target used when frames are not presented
+	GLuint fbo; // Framebuffer object
+	GLuint fbo_color; // Colour renderbuffer attached to fbo
+	GLuint fbo_depth; // Depth renderbuffer attached to fbo with --depth-buffer, otherwise 0
+
+	// Presentation options
+	EGLint swap_interval; // Value passed to eglSwapInterval, or -1 to keep the EGL default
+	GLuint late_start; // Start each frame as late as the next vblank allows
+	uint32_t max_frames_in_flight; // Unfinished frames allowed after a swap, 0 to leave it to EGL
+	uint32_t pace_margin_us;
+	PACING_T pacing;
+	GLuint offscreen; // Render into fbo and never call eglSwapBuffers
+
+	// Tile load/store actions of the frame
+	GLuint depth_buffer; // Ask for depth and stencil buffers, nothing draws with them yet
+	GLuint legacy_pass; // Clear colour only and never discard, the behaviour before render passes
+	EGLint depth_bits; // Of the surface actually used
+	EGLint stencil_bits;
+	RENDER_PASS_T pass;
+
+	// Damage tracking: frames are only drawn when the scene changed, and small changes
+	// are drawn under a scissor
+	GLuint damage_tracking;
+	GLuint buffer_preserved; // The window surface uses EGL_BUFFER_PRESERVED swaps
+	DAMAGE_T damage;
+
+	// Reduced-resolution rendering, upscaled to the display by DispmanX
+	GLfloat render_scale; // Surface size as a fraction of the display, 1 for native
+	uint32_t render_width; // Fixed surface size overriding render_scale, 0 when unset
+	uint32_t render_height;
+	uint32_t target_frame_us; // Frame time the dynamic scale holds, 0 for a fixed scale
+	RENDER_SCALE_T scaler;
+	uint32_t viewport_width; // Part of the surface drawn, the whole surface unless scaled dynamically
+	uint32_t viewport_height;
+	GLuint crop_pending; // The DispmanX source rectangle has to follow a new viewport after the next swap
+
+	// Overdraw visualisation: scenes count fragments and the frame shows them as a heatmap
+	GLuint overdraw_mode;
+	OVERDRAW_T overdraw;
+
+	// Quality governor: steps render scale, the overlay and the frame rate down ahead of
+	// thermal throttling, and back up when there is headroom
+	GLuint governor_enabled;
+	int32_t governor_limit_mc; // Step-down temperature
+	GOVERNOR_T governor;
+
+	// Startup: phase timings, and loads that overlap EGL initialisation
+	GLuint startup_profile; // Print the phase breakdown after the first frame
+	int texture_decode_phase; // Background span of the scene's first texture decodes
+
 	//
 	GLuint verbose;
 } OPENGL_STATE_T;
 static OPENGL_STATE_T _state, *state=&_state;
-static float fps_continuous = 0.0;
+static STATS_T _stats, *stats=&_stats;
+static FRAME_CLOCK_T _frame_clock, *frame_clock=&_frame_clock;
+static TRACE_T _trace, *trace=&_trace;
+static STARTUP_T _startup, *startup=&_startup;
+static volatile sig_atomic_t running = 1;
 
-#define check() assert(glGetError() == 0)
+// Shapes used by the batched scene, in model space
+static const GLfloat shape_triangle[] = {
+	-1.0f, -0.8f,   1.0f, -0.8f,   0.0f,  1.0f
+};
+static const GLfloat shape_quad[] = {
+	-1.0f, -1.0f,   1.0f, -1.0f,   1.0f,  1.0f,
+	-1.0f, -1.0f,   1.0f,  1.0f,  -1.0f,  1.0f
+};
+static const BATCH_SHAPE_T batch_shapes[] = {
+	{ shape_triangle, 3 },
+	{ shape_quad, 6 }
+};
 
-static void showlog(GLint shader)
+// In overdraw mode every scene counts its fragments instead of shading them
+static const GLchar *scene_fragment_source(const GLchar *source)
 {
-	// Prints the compile log for a shader
-	char log[1024];
-	glGetShaderInfoLog(shader,sizeof log,NULL,log);
-	printf("%d:shader:\n%s\n", shader, log);
+	return state->overdraw_mode ? overdraw_fragment_source : source;
 }
 
-static void showprogramlog(GLint shader)
+/***********************************************************
+ * Name: init_overlay
+ *
+ * Arguments:
+ *   EGLConfig config = config of the shared context
+ *
+ * Description:
+ *   Adds the overlay as a blended layer in front of the scene, in the bottom-left
+ *   corner of its display. The overlay surface swaps without waiting for vblank, so
+ *   presenting it never delays the scene's frame.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void init_overlay(EGLConfig config)
 {
-	// Prints the information log for a program object
-	char log[1024];
-	glGetProgramInfoLog(shader,sizeof log,NULL,log);
-	printf("%d:program:\n%s\n", shader, log);
+	uint32_t display_id = state->overlay_display_id == OVERLAY_SAME_DISPLAY ? state->display_id : state->overlay_display_id;
+	uint32_t width = state->display_width, height = state->display_height;
+	VC_RECT_T dst_rect;
+
+	if (display_id != state->display_id && layer_display_size(display_id, &width, &height) != 0)
+	{
+		fprintf(stderr, "No DispmanX display %u, overlay disabled\n", display_id);
+		return;
+	}
+	dst_rect.x = OVERLAY_MARGIN;
+	dst_rect.y = height - OVERLAY_HEIGHT - OVERLAY_MARGIN;
+	dst_rect.width = OVERLAY_WIDTH;
+	dst_rect.height = OVERLAY_HEIGHT;
+	if (layer_create(&state->overlay, state->display, config, display_id, 1, &dst_rect, OVERLAY_WIDTH, OVERLAY_HEIGHT, 1) != 0)
+	{
+		fprintf(stderr, "Unable to create the overlay layer on display %u\n", display_id);
+		return;
+	}
+	state->overlay.interval_ns = 1000000000ull / state->overlay_hz;
+
+	eglMakeCurrent(state->display, state->overlay.surface, state->overlay.surface, state->context);
+	eglSwapInterval(state->display, 0);
+	render_pass_init(&state->overlay_pass, 0, GL_COLOR_BUFFER_BIT |
+		(state->depth_bits ? GL_DEPTH_BUFFER_BIT : 0) | (state->stencil_bits ? GL_STENCIL_BUFFER_BIT : 0));
+	render_pass_set_actions(&state->overlay_pass, RENDER_PASS_BUFFERS, 0, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+	eglMakeCurrent(state->display, state->main_layer.surface, state->main_layer.surface, state->context);
+	check();
+	if (state->verbose) printf("Overlay: %ux%u on display %u, %u updates per second\n", OVERLAY_WIDTH, OVERLAY_HEIGHT, display_id, state->overlay_hz);
 }
 
 /***********************************************************
@@ -80,29 +364,42 @@ static void showprogramlog(GLint shader)
  ***********************************************************/
 static void init_ogl(OPENGL_STATE_T *state)
 {
+	startup_phase(startup, "bcm_host_init");
 	bcm_host_init();
 	int32_t success = 0;
 	EGLBoolean result;
 	EGLint num_config;
 
-	static EGL_DISPMANX_WINDOW_T nativewindow;
-
-	DISPMANX_ELEMENT_HANDLE_T dispman_element;
-	DISPMANX_DISPLAY_HANDLE_T dispman_display;
-	DISPMANX_UPDATE_HANDLE_T dispman_update;
 	VC_RECT_T dst_rect;
-	VC_RECT_T src_rect;
 
-	static const EGLint attribute_list[] =
+	// Depth and stencil are only requested when asked for, every extra buffer is more
+	// tile memory traffic unless the render pass clears and discards it
+	const EGLint depth_size = state->depth_buffer ? 24 : 0, stencil_size = state->depth_buffer ? 8 : 0;
+	const EGLint attribute_list[] =
 	{
 		EGL_RED_SIZE, 8,
 		EGL_GREEN_SIZE, 8,
 		EGL_BLUE_SIZE, 8,
 		EGL_ALPHA_SIZE, 8,
+		EGL_DEPTH_SIZE, depth_size,
+		EGL_STENCIL_SIZE, stencil_size,
 		EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
 		EGL_NONE
 	};
 
+	// Same, but able to keep the back buffer across swaps for partial damage updates
+	const EGLint preserved_attribute_list[] =
+	{
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_DEPTH_SIZE, depth_size,
+		EGL_STENCIL_SIZE, stencil_size,
+		EGL_SURFACE_TYPE, EGL_WINDOW_BIT | EGL_SWAP_BEHAVIOR_PRESERVED_BIT,
+		EGL_NONE
+	};
+
 	static const EGLint context_attributes[] =
 	{
 		EGL_CONTEXT_CLIENT_VERSION, 2,
@@ -111,6 +408,7 @@ static void init_ogl(OPENGL_STATE_T *state)
 	EGLConfig config;
 
 	// Get an EGL display connection
+	startup_phase(startup, "eglInitialize");
 	state->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
 	assert(state->display!=EGL_NO_DISPLAY);
 	check();
@@ -121,8 +419,20 @@ static void init_ogl(OPENGL_STATE_T *state)
 	check();
 
 	// Get an appropriate EGL frame buffer configuration
-	result = eglChooseConfig(state->display, attribute_list, &config, 1, &num_config);
-	assert(EGL_FALSE != result);
+	startup_phase(startup, "eglChooseConfig");
+	num_config = 0;
+	if (state->damage_tracking && !state->offscreen)
+		eglChooseConfig(state->display, preserved_attribute_list, &config, 1, &num_config);
+	if (num_config == 0)
+	{
+		result = eglChooseConfig(state->display, attribute_list, &config, 1, &num_config);
+		assert(EGL_FALSE != result);
+	}
+	state->config = config;
+
+	// The sizes are minimums, the config may still come with buffers nobody asked for
+	eglGetConfigAttrib(state->display, config, EGL_DEPTH_SIZE, &state->depth_bits);
+	eglGetConfigAttrib(state->display, config, EGL_STENCIL_SIZE, &state->stencil_bits);
 	check();
 
 	// Get an appropriate EGL frame buffer configuration
@@ -131,46 +441,72 @@ static void init_ogl(OPENGL_STATE_T *state)
 	check();
 
 	// Create an EGL rendering context
+	startup_phase(startup, "eglCreateContext");
 	state->context = eglCreateContext(state->display, config, EGL_NO_CONTEXT, context_attributes);
 	assert(state->context!=EGL_NO_CONTEXT);
 	check();
 
 	// Create an EGL window surface
-	success = graphics_get_display_size(0 /* LCD */, &state->screen_width, &state->screen_height);
+	startup_phase(startup, "DispmanX surface");
+	success = layer_display_size(state->display_id, &state->display_width, &state->display_height);
 	assert( success >= 0 );
 
+	// A smaller surface is scaled up to the full display by the compositor, so the GPU
+	// only shades the reduced resolution and the upscale costs nothing
+	if (state->render_width && state->render_height)
+	{
+		state->screen_width = state->render_width < state->display_width ? state->render_width : state->display_width;
+		state->screen_height = state->render_height < state->display_height ? state->render_height : state->display_height;
+	}
+	else
+	{
+		state->screen_width = (uint32_t)(state->display_width * state->render_scale + 1.0f) & ~1u;
+		state->screen_height = (uint32_t)(state->display_height * state->render_scale + 1.0f) & ~1u;
+	}
+	if (state->screen_width < RENDER_SCALE_MIN_SIZE) state->screen_width = RENDER_SCALE_MIN_SIZE;
+	if (state->screen_height < RENDER_SCALE_MIN_SIZE) state->screen_height = RENDER_SCALE_MIN_SIZE;
+	if (state->verbose && (state->screen_width != state->display_width || state->screen_height != state->display_height))
+		printf("Rendering at %ux%u, upscaled to %ux%u\n", state->screen_width, state->screen_height, state->display_width, state->display_height);
+
 	dst_rect.x = 0;
 	dst_rect.y = 0;
-	dst_rect.width = state->screen_width;
-	dst_rect.height = state->screen_height;
+	dst_rect.width = state->display_width;
+	dst_rect.height = state->display_height;
 
-	src_rect.x = 0;
-	src_rect.y = 0;
-	src_rect.width = state->screen_width << 16;
-	src_rect.height = state->screen_height << 16;
-
-	dispman_display = vc_dispmanx_display_open( 0 /* LCD */);
-	dispman_update = vc_dispmanx_update_start( 0 );
-
-	dispman_element = vc_dispmanx_element_add ( dispman_update, dispman_display,
-		0/*layer*/, &dst_rect, 0/*src*/,
-		&src_rect, DISPMANX_PROTECTION_NONE, 0 /*alpha*/, 0/*clamp*/, 0/*transform*/);
-
-	nativewindow.element = dispman_element;
-	nativewindow.width = state->screen_width;
-	nativewindow.height = state->screen_height;
-	vc_dispmanx_update_submit_sync( dispman_update );
-	check();
-
-	state->surface = eglCreateWindowSurface( state->display, config, &nativewindow, NULL );
-	assert(state->surface != EGL_NO_SURFACE);
+	// The scene is the opaque bottom layer
+	success = layer_create(&state->main_layer, state->display, config, state->display_id, 0, &dst_rect,
+		state->screen_width, state->screen_height, 0);
+	assert( success == 0 );
 	check();
 
 	// Connect the context to the surface
-	result = eglMakeCurrent(state->display, state->surface, state->surface, state->context);
+	result = eglMakeCurrent(state->display, state->main_layer.surface, state->main_layer.surface, state->context);
 	assert(EGL_FALSE != result);
 	check();
 
+	// Partial updates draw over the previous frame, which only exists with preserved swaps
+	if (state->damage_tracking && !state->offscreen)
+	{
+		EGLint behavior = EGL_BUFFER_DESTROYED;
+		if (eglSurfaceAttrib(state->display, state->main_layer.surface, EGL_SWAP_BEHAVIOR, EGL_BUFFER_PRESERVED))
+			eglQuerySurface(state->display, state->main_layer.surface, EGL_SWAP_BEHAVIOR, &behavior);
+		state->buffer_preserved = behavior == EGL_BUFFER_PRESERVED;
+		if (state->verbose)
+			printf("Damage tracking: %s\n", state->buffer_preserved ? "preserved swaps, partial updates enabled" : "no preserved swaps, damaged frames are redrawn in full");
+	}
+
+	// Vsync control: 0 presents immediately, 1 waits for every vblank, 2 for every other one
+	if (state->swap_interval >= 0)
+	{
+		EGLint min_interval = 0, max_interval = 0;
+		eglGetConfigAttrib(state->display, config, EGL_MIN_SWAP_INTERVAL, &min_interval);
+		eglGetConfigAttrib(state->display, config, EGL_MAX_SWAP_INTERVAL, &max_interval);
+		if (state->swap_interval < min_interval || state->swap_interval > max_interval)
+			fprintf(stderr, "Swap interval %d outside supported range %d..%d, EGL will clamp it\n", state->swap_interval, min_interval, max_interval);
+		result = eglSwapInterval(state->display, state->swap_interval);
+		assert(EGL_FALSE != result);
+	}
+
 	// Set background color and clear buffers
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
@@ -178,175 +514,1939 @@ static void init_ogl(OPENGL_STATE_T *state)
 }
 
 /***********************************************************
- * Name: begin_scene
+ * Name: init_offscreen
  *
  * Arguments:
- *   void
+ *   OPENGL_STATE_T *state = holds OGLES model/state info
  *
  * Description:
- *   Creates simple shaders and loads the triangle vertex array into GPU memory.
- *   These are one-time setup operations for the entire scene.
+ *   Creates a screen-sized framebuffer object and binds it in place of the window
+ *   surface, so frames can be rendered without ever being presented. This takes the
+ *   display refresh out of the measurement and shows the raw throughput of the pipeline.
  *
  * Returns:
  *   void
  *
  ***********************************************************/
-void begin_scene()
+static void init_offscreen(OPENGL_STATE_T *state)
 {
-	const GLchar *vShaderSource =
-		"attribute vec4 vertex;     \n"
-		"void main()                \n"
-		"{                          \n"
-		"    gl_Position = vertex;  \n"
-		"}                          \n";
-
-	const GLchar *fShaderSource =
-		"void main()                                    \n"
-		"{                                              \n"
-		"    gl_FragColor = vec4(0.0, 0.0, 1.0, 0.5);   \n"
-		"}                                              \n";
+	// Match the 8888 window surface where the driver allows it
+	const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
+	GLenum format = (extensions && strstr(extensions, "GL_OES_rgb8_rgba8")) ? GL_RGBA8_OES : GL_RGB565;
 
-	// Vertex shader
-	state->vshader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(state->vshader, 1, &vShaderSource, 0);
-	glCompileShader(state->vshader);
+	glGenRenderbuffers(1, &state->fbo_color);
+	glBindRenderbuffer(GL_RENDERBUFFER, state->fbo_color);
+	glRenderbufferStorage(GL_RENDERBUFFER, format, state->screen_width, state->screen_height);
 	check();
-	if (state->verbose) showlog(state->vshader);
 
-	// Fragment shader
-	state->fshader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(state->fshader, 1, &fShaderSource, 0);
-	glCompileShader(state->fshader);
-	check();
-	if (state->verbose) showlog(state->fshader);
+	glGenFramebuffers(1, &state->fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, state->fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, state->fbo_color);
 
-	// Linked shader program
-	state->program = glCreateProgram();
-	glAttachShader(state->program, state->vshader);
-	glAttachShader(state->program, state->fshader);
-	glLinkProgram(state->program);
+	// The window surface's depth and stencil are not used offscreen, only this one
+	state->depth_bits = state->stencil_bits = 0;
+	if (state->depth_buffer)
+	{
+		glGenRenderbuffers(1, &state->fbo_depth);
+		glBindRenderbuffer(GL_RENDERBUFFER, state->fbo_depth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, state->screen_width, state->screen_height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, state->fbo_depth);
+		state->depth_bits = 16;
+	}
+	assert(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
 	check();
-	if (state->verbose) showprogramlog(state->program);
+}
 
-	// Shader resources are no longer needed after compiling and linking
-	glDeleteShader(state->vshader);
-	glDeleteShader(state->fshader);
+/***********************************************************
+ * Name: exit_offscreen
+ *
+ * Arguments:
+ *   OPENGL_STATE_T *state = holds OGLES model/state info
+ *
+ * Description:
+ *   Releases the framebuffer created in init_offscreen()
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void exit_offscreen(OPENGL_STATE_T *state)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &state->fbo);
+	glDeleteRenderbuffers(1, &state->fbo_color);
+	glDeleteRenderbuffers(1, &state->fbo_depth);
+}
 
-	// Get the "vertex" attribute location
-	state->attr_vertex = glGetAttribLocation(state->program, "vertex");
+/***********************************************************
+ * Name: init_render_pass
+ *
+ * Arguments:
+ *   void
+ *
+ * Description:
+ *   Sets the frame's load and store actions for the surface in use. Every buffer is
+ *   cleared at the start, so no tile is loaded from memory. Colour is stored, since it
+ *   is presented (and read back by partial damage updates); depth and stencil are
+ *   discarded at the end, so they are never written out. Legacy mode clears only
+ *   colour and discards nothing, as the loop did before, to measure the difference.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void init_render_pass()
+{
+	GLbitfield buffers = GL_COLOR_BUFFER_BIT;
+	if (state->depth_bits) buffers |= GL_DEPTH_BUFFER_BIT;
+	if (state->stencil_bits) buffers |= GL_STENCIL_BUFFER_BIT;
 
-	// A counter-clockwise triangle
-	GLfloat triangle_vertex_data[] = {
-		-1.0f, -1.0f, 0.0f, // Lower left
-		 1.0f, -1.0f, 0.0f, // Lower right
-		 0.0f,  1.0f, 0.0f  // Top center
-	};
+	render_pass_init(&state->pass, state->fbo, buffers);
+	if (state->legacy_pass) render_pass_set_actions(&state->pass, GL_COLOR_BUFFER_BIT, 0, 0);
+	else render_pass_set_actions(&state->pass, RENDER_PASS_BUFFERS, 0, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+	if (state->verbose)
+		printf("Render pass: %s, depth %d bits, stencil %d bits, discard %s\n", state->legacy_pass ? "legacy" : "tiled",
+			state->depth_bits, state->stencil_bits, state->pass.discard ? "supported" : "not supported");
+}
 
-	// Upload triangle vertex data to a buffer
-	glGenBuffers(1, &state->vbo_triangle);
-	check();
-	glBindBuffer(GL_ARRAY_BUFFER, state->vbo_triangle);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(triangle_vertex_data), triangle_vertex_data, GL_STATIC_DRAW);
+/***********************************************************
+ * Name: exit_ogl
+ *
+ * Arguments:
+ *   OPENGL_STATE_T *state = holds OGLES model/state info
+ *
+ * Description:
+ *   Tears down everything created in init_ogl(), in reverse order
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void exit_ogl(OPENGL_STATE_T *state)
+{
+	// Release the context, then remove the DispmanX elements so the console reappears
+	eglMakeCurrent(state->display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (state->overlay.surface) layer_destroy(&state->overlay, state->display);
+	layer_destroy(&state->main_layer, state->display);
+	eglDestroyContext(state->display, state->context);
+	eglTerminate(state->display);
+
+	bcm_host_deinit();
 }
 
 /***********************************************************
- * Name: render
+ * Name: init_vertex_format
  *
  * Arguments:
- *   long delta = microseconds since last call to render(delta)
+ *   VERTEX_FORMAT_T *format = format to build
+ *   GLint position_size = components of the "position" attribute
+ *   const char *position_name = name of that attribute in the shader
+ *   int with_instance = also add the batch renderer's "instance" slot attribute
  *
  * Description:
- *   Standard OpenGL rendering function with time variance for smooth animations (not used here).
- *   This would typically be called repeatedly inside a continuous rendering loop.
+ *   Builds the vertex layout for the selected precision. In the short formats the
+ *   instance slot is a plain unsigned byte, so a batch vertex shrinks from 12 bytes to
+ *   8 (or 6 when packed) and a triangle vertex from 12 to 8 (or 6).
  *
  * Returns:
  *   void
  *
  ***********************************************************/
-void render(long delta)
+static void init_vertex_format(VERTEX_FORMAT_T *format, GLint position_size, const char *position_name, int with_instance)
 {
-	// Show FPS as part of the demo
-	//printf("%ld microseconds\n", delta);
-	float fps = 1000000.0f / (float)delta; //Frames per second is 1E6/delta because delta is in microseconds
-	fps_continuous = (9.0f / 10.0f) * fps_continuous + fps / 10.0f; //Running average of FPS
-	printf("%.2f fps\n", fps_continuous);
+	if (state->vertex_precision == VERTEX_FLOAT)
+	{
+		vertex_format_init(format, 4);
+		vertex_format_add(format, position_name, position_size, GL_FLOAT, GL_FALSE);
+		if (with_instance) vertex_format_add(format, "instance", 1, GL_FLOAT, GL_FALSE);
+		return;
+	}
+	vertex_format_init(format, state->vertex_precision == VERTEX_PACKED ? 2 : 4);
+	vertex_format_add(format, position_name, position_size, GL_SHORT, GL_TRUE);
+	if (with_instance) vertex_format_add(format, "instance", 1, GL_UNSIGNED_BYTE, GL_FALSE);
+}
 
-	// Render the triangle
-	glUseProgram(state->program);
-	glVertexAttribPointer(state->attr_vertex, 3, GL_FLOAT, 0, 3 * sizeof(GLfloat), 0);
-	glEnableVertexAttribArray(state->attr_vertex);
-	glDrawArrays(GL_TRIANGLES, 0, 3);
+static void update_batch_scene(BATCH_PRIMITIVE_T *primitives, uint32_t delta_us)
+{
+	GLfloat seconds = delta_us / 1000000.0f;
+	for (uint32_t i = 0; i < state->primitive_count; i++) primitives[i].rotation += state->spin[i] * seconds;
+}
+
+static void update_batch_snapshot(void *snapshot, uint32_t delta_us, void *user)
+{
+	// Runs on the update thread, which owns state->primitives while it is running
+	update_batch_scene(state->primitives, delta_us);
+	memcpy(snapshot, state->primitives, state->primitive_count * sizeof(BATCH_PRIMITIVE_T));
+}
+
+static void record_batch_slice(void *user, uint32_t worker, uint32_t worker_count)
+{
+	// Each worker records a contiguous range of draw calls into its own list
+	uint32_t first = state->record_draws * worker / worker_count;
+	uint32_t end = state->record_draws * (worker + 1) / worker_count;
+	batch_record(&state->batch, &state->cmd_lists[worker], state->record_primitives, state->record_count, first, end);
 }
 
 /***********************************************************
- * Name: end_scene
+ * Name: cull_batch_world
+ *
+ * Arguments:
+ *   uint32_t delta_us = time since the last frame
+ *
+ * Description:
+ *   Moves the camera along a slow Lissajous path that keeps the view inside the world,
+ *   culls the scene graph against the view and gathers the visible nodes into
+ *   state->primitives, relative to the camera.
+ *
+ * Returns:
+ *   uint32_t = number of visible primitives
+ *
+ ***********************************************************/
+static uint32_t cull_batch_world(uint32_t delta_us)
+{
+	GLfloat aspect = (GLfloat)state->screen_width / state->screen_height;
+	GLfloat range = state->world_scale - 1.0f;
+	state->world_time += delta_us / 1000000.0f;
+
+	GLfloat x = aspect * range * sinf(state->world_time * 0.11f);
+	GLfloat y = range * sinf(state->world_time * 0.07f);
+	scene_graph_cull(&state->graph, x - aspect, y - 1.0f, x + aspect, y + 1.0f);
+	uint32_t count = scene_graph_gather(&state->graph, state->primitives, x, y, state->world_time);
+	state->visible_total += count;
+	state->cull_frames++;
+	return count;
+}
+
+/***********************************************************
+ * Name: sort_batch_scene
  *
  * Arguments:
  *   void
  *
  * Description:
- *   Releases all resources allocated/created in begin_scene()
+ *   Reorders the primitives so every opaque one comes before every translucent one,
+ *   keeping scene order within each group. Only the one draw call straddling the
+ *   boundary then mixes the two, and blending is switched on once per frame instead
+ *   of for every draw call. The scene is flat and has no depth test, so opaque
+ *   primitives stay in painter's order rather than front to back.
  *
  * Returns:
  *   void
  *
  ***********************************************************/
-void end_scene()
+static void sort_batch_scene()
 {
-	// Cleanup
-	glDeleteProgram(state->program);
-	glDeleteBuffers(1, &state->vbo_triangle);
+	uint32_t n = state->primitive_count, sorted = 0;
+	BATCH_PRIMITIVE_T *primitives = malloc(n * sizeof(BATCH_PRIMITIVE_T));
+	GLfloat *spin = malloc(n * sizeof(GLfloat));
+	assert(primitives && spin);
+
+	for (int translucent = 0; translucent < 2; translucent++)
+	{
+		for (uint32_t i = 0; i < n; i++)
+		{
+			if ((state->primitives[i].color[3] < 1.0f) != translucent) continue;
+			primitives[sorted] = state->primitives[i];
+			spin[sorted++] = state->spin[i];
+		}
+	}
+	free(state->primitives);
+	free(state->spin);
+	state->primitives = primitives;
+	state->spin = spin;
 }
 
 /***********************************************************
- * Name: main
+ * Name: begin_batch_scene
  *
  * Arguments:
  *   void
  *
  * Description:
- *   Program entry point: setup the OpenGL screen, the scene, and then run the rendering loop
+ *   Scatters primitive_count small triangles and quads over the screen, each with its
+ *   own colour and spin rate. A fixed seed keeps the scene identical between runs so
+ *   benchmark results are comparable. With sort_draws one in four is half transparent
+ *   and the opaque primitives are moved ahead of the translucent ones. With a world
+ *   scale the primitives are spread over a world that many screens wide and high and go
+ *   into the scene graph, and state->primitives only receives the visible ones each
+ *   frame.
  *
  * Returns:
- *   int
+ *   void
  *
  ***********************************************************/
-int main ()
+static void begin_batch_scene()
 {
-	// Timings for smooth render() animation, if needed
-	struct timeval tv, tv_last;
+	GLfloat aspect = (GLfloat)state->screen_width / state->screen_height;
+	GLfloat spread = state->world_scale > 1.0f ? state->world_scale : 1.0f;
+	VERTEX_FORMAT_T format;
+	init_vertex_format(&format, 2, "position", 1);
+	int result = batch_init(&state->batch, &state->gl_cache, &state->shaders, &format, batch_shapes, sizeof(batch_shapes) / sizeof(batch_shapes[0]),
+		state->primitive_count, state->overdraw_mode ? overdraw_fragment_source : NULL);
+	assert(result == 0);
 
-	// Clear application state
-	memset( state, 0, sizeof( *state ) );
+	state->primitives = malloc(state->primitive_count * sizeof(BATCH_PRIMITIVE_T));
+	state->spin = malloc(state->primitive_count * sizeof(GLfloat));
+	assert(state->primitives && state->spin);
 
-	// Start OGLES
-	init_ogl(state);
+	srand(1);
+	for (uint32_t i = 0; i < state->primitive_count; i++)
+	{
+		BATCH_PRIMITIVE_T *p = &state->primitives[i];
+		p->shape = i % 2;
+		p->x = spread * aspect * (2.0f * rand() / RAND_MAX - 1.0f);
+		p->y = spread * (2.0f * rand() / RAND_MAX - 1.0f);
+		p->scale = 0.01f + 0.03f * rand() / RAND_MAX;
+		p->rotation = 6.2831853f * rand() / RAND_MAX;
+		p->color[0] = (GLfloat)rand() / RAND_MAX;
+		p->color[1] = (GLfloat)rand() / RAND_MAX;
+		p->color[2] = (GLfloat)rand() / RAND_MAX;
+		p->color[3] = state->sort_draws && i % 4 == 3 ? 0.5f : 1.0f;
+		state->spin[i] = 4.0f * rand() / RAND_MAX - 2.0f;
+	}
+	if (state->sort_draws) sort_batch_scene();
 
-	// Create simple fragment and vertex shaders, and load geometry buffers
-	begin_scene();
+	// Shapes fit in the unit square, so a circle of sqrt(2) * scale bounds every rotation
+	if (state->world_scale > 1.0f)
+	{
+		result = scene_graph_init(&state->graph, state->primitive_count, BATCH_WORLD_CELL);
+		assert(result == 0);
+		for (uint32_t i = 0; i < state->primitive_count; i++)
+			scene_graph_add(&state->graph, &state->primitives[i], 1.4142136f * state->primitives[i].scale, state->spin[i]);
+		result = scene_graph_build_index(&state->graph);
+		assert(result == 0);
+		if (state->verbose)
+			printf("Scene graph: %u nodes, %ux%u grid of %.2f cells\n", state->graph.count, state->graph.columns, state->graph.rows, state->graph.cell_size);
+	}
 
-	// Set the viewport to fill the screen
-	glViewport(0, 0, state->screen_width, state->screen_height);
+	// Threaded simulation: every snapshot starts as a copy of the initial scene
+	if (state->update_hz)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			state->snapshots[i] = malloc(state->primitive_count * sizeof(BATCH_PRIMITIVE_T));
+			assert(state->snapshots[i]);
+			memcpy(state->snapshots[i], state->primitives, state->primitive_count * sizeof(BATCH_PRIMITIVE_T));
+		}
+		result = update_start(&state->updater, state->snapshots, state->update_hz, update_batch_snapshot, NULL);
+		assert(result == 0);
+	}
 
-	// Render loop
-	while(1)
+	// Recording threads. Each list is given enough frame arena for its share of the draw calls.
+	if (state->workers)
 	{
-		// Clear
-		glClear(GL_COLOR_BUFFER_BIT);
+		result = workers_init(&state->worker_pool, state->workers);
+		assert(result == 0);
+		state->workers = state->worker_pool.count;
+
+		uint32_t per_draw = sizeof(CMD_DRAW_T) + CMD_ALIGNMENT + state->batch.instances_per_draw * 8 * sizeof(GLfloat);
+		uint32_t max_draws = (state->primitive_count + state->batch.instances_per_draw - 1) / state->batch.instances_per_draw;
+		state->cmd_list_bytes = (max_draws / state->workers + 1) * per_draw;
+		cmd_queue_init(&state->cmd_queue);
+	}
+}
 
-		// Draw
-		gettimeofday(&tv, NULL);
-		render((tv.tv_sec - tv_last.tv_sec) * 1e6 + tv.tv_usec - tv_last.tv_usec); // Elapsed microseconds
-		tv_last = tv;
+static void stream_program_ready(GLuint program, void *user)
+{
+	state->stream_program = program;
+	state->attr_stream_position = glGetAttribLocation(program, "position");
+	state->attr_stream_color = glGetAttribLocation(program, "color");
+}
 
-		// Update the display by swapping front/back buffers
-		eglSwapBuffers(state->display, state->surface);
-		check();
+/***********************************************************
+ * Name: update_stream_scene
+ *
+ * Arguments:
+ *   GLfloat *source = receives three model-space vec4 positions per particle, followed
+ *     by three vec4 colours per particle
+ *   uint32_t delta_us = microseconds to advance the particles by
+ *
+ * Description:
+ *   Advances every particle and writes its triangle in full precision. Conversion to
+ *   the compact vertex format happens at upload, see render_stream_scene().
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void update_stream_scene(GLfloat *source, uint32_t delta_us)
+{
+	GLfloat seconds = delta_us / 1000000.0f;
+	GLfloat *v = source;
+	GLfloat *color = source + state->primitive_count * 3 * 4;
+
+	for (uint32_t i = 0; i < state->primitive_count; i++, v += 12)
+	{
+		PARTICLE_T *p = &state->particles[i];
+		p->angle += p->speed * seconds;
+
+		// Triangle pointing along the direction of travel
+		GLfloat c = cosf(p->angle), s = sinf(p->angle);
+		GLfloat x = p->radius * c, y = p->radius * s;
+		v[0] = x - s * p->size * 2.0f; v[1] = y + c * p->size * 2.0f;
+		v[4] = x - c * p->size;        v[5] = y - s * p->size;
+		v[8] = x + c * p->size;        v[9] = y + s * p->size;
+		v[2] = v[6] = v[10] = 0.0f;
+		v[3] = v[7] = v[11] = 1.0f;
+
+		GLfloat brightness = 0.75f + 0.25f * sinf(3.0f * p->angle);
+		for (int k = 0; k < 3; k++, color += 4)
+		{
+			color[0] = p->color[0] * brightness;
+			color[1] = p->color[1] * brightness;
+			color[2] = p->color[2] * brightness;
+			color[3] = p->color[3];
+		}
 	}
+}
 
-	// Cleanup
-	end_scene();
+static void update_stream_snapshot(void *snapshot, uint32_t delta_us, void *user)
+{
+	// Runs on the update thread, which owns state->particles while it is running
+	update_stream_scene((GLfloat *)snapshot, delta_us);
+}
 
-	// Exit
-	return 0;
+/***********************************************************
+ * Name: begin_stream_scene
+ *
+ * Arguments:
+ *   void
+ *
+ * Description:
+ *   Creates primitive_count orbiting particles whose triangles are rebuilt on the CPU
+ *   every frame, plus the streaming buffer they are written into
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void begin_stream_scene()
+{
+	// Positions arrive as normalized shorts scaled by 1 / STREAM_POSITION_RANGE
+	const GLchar *vShaderSource =
+		"attribute vec2 position;                                 \n"
+		"attribute vec4 color;                                    \n"
+		"varying lowp vec4 v_color;                               \n"
+		"void main()                                              \n"
+		"{                                                        \n"
+		"    v_color = color;                                     \n"
+		"    gl_Position = vec4(position * 2.0, 0.0, 1.0);        \n"
+		"}                                                        \n";
+
+	const GLchar *fShaderSource =
+		"varying lowp vec4 v_color;                     \n"
+		"void main()                                    \n"
+		"{                                              \n"
+		"    gl_FragColor = v_color;                    \n"
+		"}                                              \n";
+
+	state->stream_shader = shader_request(&state->shaders, vShaderSource, scene_fragment_source(fShaderSource), SHADER_DEFERRED, stream_program_ready, NULL);
+	assert(state->stream_shader >= 0);
+
+	int result = stream_init(&state->stream, &state->gl_cache, state->stream_buffers, state->primitive_count * 3 * STREAM_VERTEX_BYTES + 2 * STREAM_ALIGNMENT);
+	assert(result == 0);
+
+	state->particles = malloc(state->primitive_count * sizeof(PARTICLE_T));
+	state->stream_source = malloc(state->primitive_count * 3 * STREAM_SOURCE_BYTES);
+	state->stream_clip = malloc(state->primitive_count * 3 * 4 * sizeof(GLfloat));
+	assert(state->particles && state->stream_source && state->stream_clip);
+
+	srand(1);
+	for (uint32_t i = 0; i < state->primitive_count; i++)
+	{
+		PARTICLE_T *p = &state->particles[i];
+		p->radius = 0.05f + 0.95f * rand() / RAND_MAX;
+		p->angle = 6.2831853f * rand() / RAND_MAX;
+		p->speed = (0.2f + 0.8f * rand() / RAND_MAX) / p->radius;
+		p->size = 0.005f + 0.02f * rand() / RAND_MAX;
+		p->color[0] = (GLfloat)rand() / RAND_MAX;
+		p->color[1] = (GLfloat)rand() / RAND_MAX;
+		p->color[2] = (GLfloat)rand() / RAND_MAX;
+		p->color[3] = 1.0f;
+	}
+
+	// Threaded simulation: the update thread produces full-precision vertices
+	if (state->update_hz)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			state->snapshots[i] = malloc(state->primitive_count * 3 * STREAM_SOURCE_BYTES);
+			assert(state->snapshots[i]);
+			update_stream_scene(state->snapshots[i], 0);
+		}
+		result = update_start(&state->updater, state->snapshots, state->update_hz, update_stream_snapshot, NULL);
+		assert(result == 0);
+	}
+}
+
+/***********************************************************
+ * Name: render_stream_scene
+ *
+ * Arguments:
+ *   long delta = microseconds since the last frame
+ *
+ * Description:
+ *   Advances every particle (or picks up the update thread's latest snapshot), then
+ *   converts the full-precision vertices straight into this frame's slice of the
+ *   streaming buffer with the SIMD kernels: positions are transformed to clip space and
+ *   quantised to normalized shorts, colours are packed to RGBA8. Everything is drawn
+ *   with one call.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void render_stream_scene(long delta)
+{
+	uint32_t position_offset, color_offset;
+	uint32_t vertices = state->primitive_count * 3;
+
+	if (!state->stream_program) return;
+	const GLfloat *source = state->stream_source;
+	if (state->update_hz) source = update_latest(&state->updater);
+	else update_stream_scene(state->stream_source, delta);
+
+	// Aspect correction, applied on the CPU since positions leave here in clip space
+	const GLfloat view[16] = {
+		(GLfloat)state->screen_height / state->screen_width, 0.0f, 0.0f, 0.0f,
+		0.0f, 1.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, 1.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f
+	};
+
+	stream_begin_frame(&state->stream);
+	GLshort *positions = stream_alloc(&state->stream, vertices * 4 * sizeof(GLshort), &position_offset);
+	uint32_t *colors = stream_alloc(&state->stream, vertices * sizeof(uint32_t), &color_offset);
+	if (!positions || !colors)
+	{
+		state->stream_dropped++;
+		return;
+	}
+
+	kernel_transform_vec4(view, source, state->stream_clip, vertices);
+	kernel_quantize_short(state->stream_clip, positions, vertices * 4, 32767.0f / STREAM_POSITION_RANGE);
+	kernel_pack_rgba8(source + vertices * 4, colors, vertices);
+
+	stream_upload(&state->stream);
+	gl_cache_use_program(&state->gl_cache, state->stream_program);
+	gl_cache_vertex_attrib_pointer(&state->gl_cache, state->attr_stream_position, 2, GL_SHORT, GL_TRUE, 4 * sizeof(GLshort), (const void *)(uintptr_t)position_offset);
+	gl_cache_vertex_attrib_pointer(&state->gl_cache, state->attr_stream_color, 4, GL_UNSIGNED_BYTE, GL_TRUE, 4, (const void *)(uintptr_t)color_offset);
+	gl_cache_enable_attribs(&state->gl_cache, GL_CACHE_ATTRIB_BIT(state->attr_stream_position) | GL_CACHE_ATTRIB_BIT(state->attr_stream_color));
+	glDrawArrays(GL_TRIANGLES, 0, vertices);
+}
+
+static void mesh_program_ready(GLuint program, void *user)
+{
+	state->mesh_program = program;
+	int result = uniform_cache_init(&state->mesh_uniforms, &state->gl_cache, program);
+	assert(result == 0);
+	state->uniform_mesh_time = uniform_cache_find(&state->mesh_uniforms, "time");
+	mesh_bind_program(&state->mesh, program);
+}
+
+/***********************************************************
+ * Name: begin_mesh_scene
+ *
+ * Arguments:
+ *   void
+ *
+ * Description:
+ *   Loads mesh_path if given, otherwise builds a full-screen grid of roughly
+ *   primitive_count triangles as an indexed mesh. Grid indices are generated row by
+ *   row, the worst order for the vertex cache, and the mesh optimiser reorders them.
+ *   Grids above 65535 vertices are split into parts.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void begin_mesh_scene()
+{
+	const GLchar *vShaderSource =
+		"uniform float time;                                      \n"
+		"attribute vec2 position;                                 \n"
+		"attribute vec4 color;                                    \n"
+		"varying lowp vec4 v_color;                               \n"
+		"void main()                                              \n"
+		"{                                                        \n"
+		"    float ripple = sin(length(position) * 12.0 - time * 3.0);\n"
+		"    v_color = color * (0.75 + 0.25 * ripple);            \n"
+		"    gl_Position = vec4(position, 0.0, 1.0);              \n"
+		"}                                                        \n";
+
+	const GLchar *fShaderSource =
+		"varying lowp vec4 v_color;                     \n"
+		"void main()                                    \n"
+		"{                                              \n"
+		"    gl_FragColor = v_color;                    \n"
+		"}                                              \n";
+
+	state->mesh_shader = shader_request(&state->shaders, vShaderSource, scene_fragment_source(fShaderSource), SHADER_DEFERRED, mesh_program_ready, NULL);
+	assert(state->mesh_shader >= 0);
+
+	// Preconverted asset: mapped and uploaded without parsing
+	if (state->mesh_path)
+	{
+		uint64_t start = frame_clock_now();
+		if (mesh_load(&state->mesh, &state->gl_cache, state->mesh_path) != 0)
+		{
+			fprintf(stderr, "Unable to load mesh %s\n", state->mesh_path);
+			return;
+		}
+		if (state->verbose)
+			printf("Mesh: loaded %s in %.2f ms, %u parts, %u vertices, %u indices\n", state->mesh_path,
+				(frame_clock_now() - start) / 1e6, state->mesh.part_count, state->mesh.vertex_count, state->mesh.index_count);
+		return;
+	}
+
+	// Two triangles per grid cell
+	uint32_t side = (uint32_t)sqrtf(state->primitive_count / 2.0f) + 2;
+	uint32_t vertex_count = side * side;
+	uint32_t index_count = (side - 1) * (side - 1) * 6;
+
+	VERTEX_FORMAT_T format;
+	init_vertex_format(&format, 2, "position", 0);
+	vertex_format_add(&format, "color", 4, GL_UNSIGNED_BYTE, GL_TRUE);
+
+	GLfloat *positions = malloc(vertex_count * 2 * sizeof(GLfloat));
+	GLfloat *colors = malloc(vertex_count * 4 * sizeof(GLfloat));
+	uint32_t *indices = malloc(index_count * sizeof(uint32_t));
+	void *encoded = malloc((size_t)vertex_count * format.stride);
+	assert(positions && colors && indices && encoded);
+
+	for (uint32_t y = 0, v = 0; y < side; y++)
+		for (uint32_t x = 0; x < side; x++, v++)
+		{
+			GLfloat u = (GLfloat)x / (side - 1), w = (GLfloat)y / (side - 1);
+			positions[v * 2] = 2.0f * u - 1.0f;
+			positions[v * 2 + 1] = 2.0f * w - 1.0f;
+			colors[v * 4] = u;
+			colors[v * 4 + 1] = w;
+			colors[v * 4 + 2] = 1.0f - u;
+			colors[v * 4 + 3] = 1.0f;
+		}
+
+	uint32_t *i = indices;
+	for (uint32_t y = 0; y + 1 < side; y++)
+		for (uint32_t x = 0; x + 1 < side; x++)
+		{
+			uint32_t a = y * side + x;
+			*i++ = a; *i++ = a + 1; *i++ = a + side;
+			*i++ = a + 1; *i++ = a + side + 1; *i++ = a + side;
+		}
+
+	const GLfloat *sources[2] = { positions, colors };
+	vertex_format_encode(&format, sources, vertex_count, encoded);
+	int result = mesh_init(&state->mesh, &state->gl_cache, &format, encoded, vertex_count, indices, index_count, MESH_OPTIMIZE);
+	assert(result == 0);
+	if (state->verbose)
+		printf("Mesh: %u parts, %u vertices, %u indices, ACMR %.3f -> %.3f\n", state->mesh.part_count,
+			state->mesh.vertex_count, state->mesh.index_count, state->mesh.acmr_before, state->mesh.acmr_after);
+
+	free(positions);
+	free(colors);
+	free(indices);
+	free(encoded);
+}
+
+static void render_mesh_scene(long delta)
+{
+	if (!state->mesh_program) return;
+	state->mesh_time += delta / 1000000.0f;
+	gl_cache_use_program(&state->gl_cache, state->mesh_program);
+	uniform_cache_1f(&state->mesh_uniforms, state->uniform_mesh_time, state->mesh_time);
+	mesh_draw(&state->mesh);
+}
+
+static void tile_program_ready(GLuint program, void *user)
+{
+	state->tile_program = program;
+	state->attr_tile_corner = glGetAttribLocation(program, "corner");
+	int result = uniform_cache_init(&state->tile_uniforms, &state->gl_cache, program);
+	assert(result == 0);
+	state->uniform_tile_rect = uniform_cache_find(&state->tile_uniforms, "rect");
+	state->uniform_tile_uv = uniform_cache_find(&state->tile_uniforms, "uv");
+	damage_all(&state->damage);
+}
+
+static void tile_packed_program_ready(GLuint program, void *user)
+{
+	state->tile_packed_program = program;
+	state->attr_packed_corner = glGetAttribLocation(program, "corner");
+	state->attr_packed_rect = glGetAttribLocation(program, "rect");
+	state->attr_packed_uv = glGetAttribLocation(program, "uv");
+	damage_all(&state->damage);
+}
+
+/***********************************************************
+ * Name: decode_pattern
+ *
+ * Arguments:
+ *   const char *source = unused
+ *   void *user = tile index, selects the colours
+ *   TEXTURE_IMAGE_T *image = receives a TEXTURE_PATTERN_SIZE square RGBA image
+ *
+ * Description:
+ *   Stand-in decoder for the texture scene when no image files are given. It costs a
+ *   few milliseconds per image, on a decode thread like a real decoder.
+ *
+ * Returns:
+ *   int = 0 on success, -1 if the staging buffer is too small
+ *
+ ***********************************************************/
+static int decode_pattern(const char *source, void *user, TEXTURE_IMAGE_T *image)
+{
+	uint32_t size = TEXTURE_PATTERN_SIZE;
+	if ((uint64_t)size * size * 4 > image->capacity) return -1;
+
+	GLfloat hue = (uintptr_t)user * 0.61803f * 6.2831853f;
+	GLfloat tint[3] = { 0.5f + 0.5f * cosf(hue), 0.5f + 0.5f * cosf(hue + 2.0944f), 0.5f + 0.5f * cosf(hue + 4.1888f) };
+	uint8_t *p = image->pixels;
+	for (uint32_t y = 0; y < size; y++)
+		for (uint32_t x = 0; x < size; x++, p += 4)
+		{
+			GLfloat u = (GLfloat)x / size - 0.5f, v = (GLfloat)y / size - 0.5f;
+			GLfloat ring = 0.5f + 0.5f * sinf(sqrtf(u * u + v * v) * 60.0f);
+			for (int c = 0; c < 3; c++) p[c] = (uint8_t)(255.0f * ring * tint[c]);
+			p[3] = 255;
+		}
+	image->width = size;
+	image->height = size;
+	image->format = GL_RGBA;
+	return 0;
+}
+
+/***********************************************************
+ * Name: start_texture_loads
+ *
+ * Arguments:
+ *   void
+ *
+ * Description:
+ *   Starts the texture manager and requests one texture per tile, from the --texture
+ *   files or generated. With --atlas every sprite is a tile instead, and tiles on the
+ *   same page share its texture. None of this needs GL, so it runs before the context
+ *   is created and the first images decode while EGL initialises.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void start_texture_loads()
+{
+	state->texture_decode_phase = startup_begin_background(startup, "texture decode");
+	int result = texture_manager_init(&state->textures, TEXTURE_DEFAULT_THREADS, TEXTURE_DEFAULT_STAGING_BUFFERS, TEXTURE_DEFAULT_STAGING_BYTES, state->verbose);
+	assert(result == 0);
+
+	// Atlas sprites come grouped by page, so the page binding only changes a few times per frame
+	if (state->atlas_path)
+	{
+		if (atlas_load(&state->atlas, &state->textures, state->atlas_path) != 0)
+		{
+			fprintf(stderr, "Unable to load atlas %s\n", state->atlas_path);
+			return;
+		}
+		state->tile_count = state->atlas.sprite_count < TEXTURE_TILES_MAX ? state->atlas.sprite_count : TEXTURE_TILES_MAX;
+		for (uint32_t i = 0; i < state->tile_count; i++)
+		{
+			const ATLAS_SPRITE_T *sprite = &state->atlas.sprites[i];
+			state->tile_textures[i] = state->atlas.pages[sprite->page];
+			memcpy(state->tile_uv[i], sprite->uv, sizeof(state->tile_uv[i]));
+		}
+		if (state->verbose)
+			printf("Atlas: %u sprites on %u pages\n", state->atlas.sprite_count, state->atlas.page_count);
+		return;
+	}
+
+	state->tile_count = state->texture_path_count ? state->texture_path_count : TEXTURE_PATTERN_TILES;
+	for (uint32_t i = 0; i < state->tile_count; i++)
+	{
+		if (state->texture_path_count) state->tile_textures[i] = texture_request(&state->textures, state->texture_paths[i], texture_decode_file, NULL);
+		else state->tile_textures[i] = texture_request(&state->textures, NULL, decode_pattern, (void *)(uintptr_t)i);
+		assert(state->tile_textures[i] >= 0);
+		GLfloat *uv = state->tile_uv[i];
+		uv[0] = uv[1] = 0.0f;
+		uv[2] = uv[3] = 1.0f;
+	}
+}
+
+/***********************************************************
+ * Name: begin_texture_scene
+ *
+ * Arguments:
+ *   void
+ *
+ * Description:
+ *   Builds the tile program, quad and placeholder for the textures requested by
+ *   start_texture_loads(). Nothing waits for the textures: tiles show a placeholder
+ *   until texture_pump() has finished uploading their image.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void begin_texture_scene()
+{
+	const GLchar *vShaderSource =
+		"attribute vec2 corner;                                   \n"
+		"uniform vec4 rect;                                       \n"
+		"uniform vec4 uv;                                         \n"
+		"varying mediump vec2 v_uv;                               \n"
+		"void main()                                              \n"
+		"{                                                        \n"
+		"    v_uv = mix(uv.xy, uv.zw, vec2(corner.x, 1.0 - corner.y));\n"
+		"    gl_Position = vec4(rect.xy + corner * rect.zw, 0.0, 1.0);\n"
+		"}                                                        \n";
+
+	const GLchar *fShaderSource =
+		"uniform sampler2D image;                       \n"
+		"varying mediump vec2 v_uv;                     \n"
+		"void main()                                    \n"
+		"{                                              \n"
+		"    gl_FragColor = texture2D(image, v_uv);     \n"
+		"}                                              \n";
+
+	// The same tile, with its constants arriving as vertex attributes instead of uniforms
+	const GLchar *vPackedShaderSource =
+		"attribute vec2 corner;                                   \n"
+		"attribute vec4 rect;                                     \n"
+		"attribute vec4 uv;                                       \n"
+		"varying mediump vec2 v_uv;                               \n"
+		"void main()                                              \n"
+		"{                                                        \n"
+		"    v_uv = mix(uv.xy, uv.zw, vec2(corner.x, 1.0 - corner.y));\n"
+		"    gl_Position = vec4(rect.xy + corner * rect.zw, 0.0, 1.0);\n"
+		"}                                                        \n";
+
+	if (state->pack_constants)
+	{
+		state->tile_packed_shader = shader_request(&state->shaders, vPackedShaderSource, scene_fragment_source(fShaderSource), SHADER_DEFERRED, tile_packed_program_ready, NULL);
+		assert(state->tile_packed_shader >= 0);
+	}
+	else
+	{
+		state->tile_shader = shader_request(&state->shaders, vShaderSource, scene_fragment_source(fShaderSource), SHADER_DEFERRED, tile_program_ready, NULL);
+		assert(state->tile_shader >= 0);
+	}
+
+	static const GLfloat corners[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+	glGenBuffers(1, &state->vbo_tile);
+	gl_cache_bind_buffer(&state->gl_cache, GL_ARRAY_BUFFER, state->vbo_tile);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+
+	static const GLubyte grey[4] = { 64, 64, 64, 255 };
+	glGenTextures(1, &state->tile_placeholder);
+	gl_cache_bind_texture(&state->gl_cache, state->tile_placeholder);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+	check();
+}
+
+// Clip-space rectangle of a tile: x, y of the bottom-left corner, width, height
+static void tile_rect(uint32_t tile, GLfloat rect[4])
+{
+	// Square-ish grid of tiles with a small gap between them
+	uint32_t columns = (uint32_t)ceilf(sqrtf((GLfloat)state->tile_count));
+	uint32_t rows = (state->tile_count + columns - 1) / columns;
+	GLfloat width = 2.0f / columns, height = 2.0f / rows;
+	GLfloat gap = 0.02f;
+	rect[0] = -1.0f + (tile % columns) * width + gap;
+	rect[1] = 1.0f - (tile / columns + 1) * height + gap;
+	rect[2] = width - 2.0f * gap;
+	rect[3] = height - 2.0f * gap;
+}
+
+// Damages the tiles whose texture has finished uploading since they were last drawn
+static void damage_texture_scene()
+{
+	for (uint32_t i = 0; i < state->tile_count; i++)
+	{
+		GLuint texture = texture_get(&state->textures, state->tile_textures[i]);
+		if (texture == state->tile_shown[i]) continue;
+		state->tile_shown[i] = texture;
+
+		GLfloat rect[4];
+		tile_rect(i, rect);
+		damage_add_clip(&state->damage, rect[0], rect[1], rect[0] + rect[2], rect[1] + rect[3]);
+	}
+}
+
+static GLuint tile_texture(uint32_t tile)
+{
+	GLuint texture = texture_get(&state->textures, state->tile_textures[tile]);
+	return texture ? texture : state->tile_placeholder;
+}
+
+/***********************************************************
+ * Name: pack_tile_constants
+ *
+ * Arguments:
+ *   void
+ *
+ * Description:
+ *   Writes every tile's rectangle and texture coordinates into each of its six
+ *   vertices. The constants are static, so this happens once, on the first frame
+ *   after the tile count is known.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void pack_tile_constants()
+{
+	size_t bytes = (size_t)state->tile_count * 6 * 10 * sizeof(GLfloat);
+	GLfloat *vertices = malloc(bytes ? bytes : 1), *v = vertices;
+	static const GLfloat corners[6][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 0, 1 }, { 1, 0 }, { 1, 1 } };
+	assert(vertices);
+
+	for (uint32_t i = 0; i < state->tile_count; i++)
+	{
+		GLfloat rect[4];
+		tile_rect(i, rect);
+		for (int c = 0; c < 6; c++, v += 10)
+		{
+			memcpy(v, corners[c], 2 * sizeof(GLfloat));
+			memcpy(v + 2, rect, 4 * sizeof(GLfloat));
+			memcpy(v + 6, state->tile_uv[i], 4 * sizeof(GLfloat));
+		}
+	}
+	glGenBuffers(1, &state->vbo_tile_packed);
+	gl_cache_bind_buffer(&state->gl_cache, GL_ARRAY_BUFFER, state->vbo_tile_packed);
+	glBufferData(GL_ARRAY_BUFFER, bytes, vertices, GL_STATIC_DRAW);
+	free(vertices);
+	check();
+}
+
+// Packed mode: one glDrawArrays per run of consecutive tiles showing the same texture
+static void render_packed_tiles()
+{
+	if (!state->tile_packed_program || !state->tile_count) return;
+	if (!state->vbo_tile_packed) pack_tile_constants();
+
+	const GLsizei stride = 10 * sizeof(GLfloat);
+	gl_cache_use_program(&state->gl_cache, state->tile_packed_program);
+	gl_cache_bind_buffer(&state->gl_cache, GL_ARRAY_BUFFER, state->vbo_tile_packed);
+	gl_cache_vertex_attrib_pointer(&state->gl_cache, state->attr_packed_corner, 2, GL_FLOAT, GL_FALSE, stride, 0);
+	gl_cache_vertex_attrib_pointer(&state->gl_cache, state->attr_packed_rect, 4, GL_FLOAT, GL_FALSE, stride, (const void *)(2 * sizeof(GLfloat)));
+	gl_cache_vertex_attrib_pointer(&state->gl_cache, state->attr_packed_uv, 4, GL_FLOAT, GL_FALSE, stride, (const void *)(6 * sizeof(GLfloat)));
+	gl_cache_enable_attribs(&state->gl_cache, GL_CACHE_ATTRIB_BIT(state->attr_packed_corner) |
+		GL_CACHE_ATTRIB_BIT(state->attr_packed_rect) | GL_CACHE_ATTRIB_BIT(state->attr_packed_uv));
+
+	state->tile_draws = 0;
+	for (uint32_t first = 0, end; first < state->tile_count; first = end)
+	{
+		GLuint texture = tile_texture(first);
+		for (end = first + 1; end < state->tile_count && tile_texture(end) == texture; end++);
+		gl_cache_bind_texture(&state->gl_cache, texture);
+		glDrawArrays(GL_TRIANGLES, first * 6, (end - first) * 6);
+		state->tile_draws++;
+	}
+}
+
+static void render_texture_scene()
+{
+	if (state->pack_constants)
+	{
+		render_packed_tiles();
+		return;
+	}
+	if (!state->tile_program) return;
+
+	gl_cache_use_program(&state->gl_cache, state->tile_program);
+	gl_cache_bind_buffer(&state->gl_cache, GL_ARRAY_BUFFER, state->vbo_tile);
+	gl_cache_vertex_attrib_pointer(&state->gl_cache, state->attr_tile_corner, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), 0);
+	gl_cache_enable_attribs(&state->gl_cache, GL_CACHE_ATTRIB_BIT(state->attr_tile_corner));
+
+	for (uint32_t i = 0; i < state->tile_count; i++)
+	{
+		GLfloat rect[4];
+		tile_rect(i, rect);
+		gl_cache_bind_texture(&state->gl_cache, tile_texture(i));
+		uniform_cache_4fv(&state->tile_uniforms, state->uniform_tile_rect, 1, rect);
+		uniform_cache_4fv(&state->tile_uniforms, state->uniform_tile_uv, 1, state->tile_uv[i]);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	}
+	state->tile_draws = state->tile_count;
+}
+
+static void triangle_program_ready(GLuint program, void *user)
+{
+	state->program = program;
+
+	// Resolve the attribute locations of the triangle's vertex format
+	vertex_format_bind(&state->triangle_format, program);
+	int result = uniform_cache_init(&state->uniforms, &state->gl_cache, program);
+	assert(result == 0);
+	state->uniform_color = uniform_cache_find(&state->uniforms, "color");
+	damage_all(&state->damage);
+}
+
+/***********************************************************
+ * Name: begin_scene
+ *
+ * Arguments:
+ *   void
+ *
+ * Description:
+ *   Creates simple shaders and loads the triangle vertex array into GPU memory.
+ *   These are one-time setup operations for the entire scene. Shader programs are
+ *   deferred: unless a cached binary exists they are compiled after the first frame.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void begin_scene()
+{
+	if (state->scene == SCENE_BATCH)
+	{
+		begin_batch_scene();
+		return;
+	}
+	if (state->scene == SCENE_STREAM)
+	{
+		begin_stream_scene();
+		return;
+	}
+	if (state->scene == SCENE_MESH)
+	{
+		begin_mesh_scene();
+		return;
+	}
+	if (state->scene == SCENE_TEXTURE)
+	{
+		begin_texture_scene();
+		return;
+	}
+
+	const GLchar *vShaderSource =
+		"attribute vec4 vertex;     \n"
+		"void main()                \n"
+		"{                          \n"
+		"    gl_Position = vertex;  \n"
+		"}                          \n";
+
+	const GLchar *fShaderSource =
+		"uniform lowp vec4 color;                       \n"
+		"void main()                                    \n"
+		"{                                              \n"
+		"    gl_FragColor = color;                      \n"
+		"}                                              \n";
+
+	// Shader program, from the binary cache or compiled on the background pass
+	state->shader = shader_request(&state->shaders, vShaderSource, scene_fragment_source(fShaderSource), SHADER_DEFERRED, triangle_program_ready, NULL);
+	assert(state->shader >= 0);
+
+	// A counter-clockwise triangle
+	GLfloat triangle_vertex_data[] = {
+		-1.0f, -1.0f, 0.0f, // Lower left
+		 1.0f, -1.0f, 0.0f, // Lower right
+		 0.0f,  1.0f, 0.0f  // Top center
+	};
+
+	// Encode it in the selected vertex format
+	const GLfloat *sources[1] = { triangle_vertex_data };
+	GLubyte encoded[3 * 3 * sizeof(GLfloat)];
+	init_vertex_format(&state->triangle_format, 3, "vertex", 0);
+	vertex_format_encode(&state->triangle_format, sources, 3, encoded);
+
+	// Upload triangle vertex data to a buffer
+	glGenBuffers(1, &state->vbo_triangle);
+	check();
+	gl_cache_bind_buffer(&state->gl_cache, GL_ARRAY_BUFFER, state->vbo_triangle);
+	glBufferData(GL_ARRAY_BUFFER, 3 * state->triangle_format.stride, encoded, GL_STATIC_DRAW);
+}
+
+/***********************************************************
+ * Name: render
+ *
+ * Arguments:
+ *   long delta = microseconds since last call to render(delta)
+ *
+ * Description:
+ *   Standard OpenGL rendering function with time variance for smooth animations (not used here).
+ *   This would typically be called repeatedly inside a continuous rendering loop.
+ *   Frame timing is reported by the stats thread, so nothing here writes to stdout.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void render(long delta)
+{
+	if (state->scene == SCENE_BATCH)
+	{
+		// Advance the animation (or pick up the update thread's latest snapshot), then draw
+		// every primitive in a handful of draw calls
+		// In a world larger than the view only the primitives that survive culling are
+		// animated and handed to the batch renderer
+		const BATCH_PRIMITIVE_T *primitives = state->primitives;
+		uint32_t count = state->primitive_count;
+		if (state->world_scale > 1.0f) count = cull_batch_world(delta);
+		else if (state->update_hz) primitives = update_latest(&state->updater);
+		else update_batch_scene(state->primitives, delta);
+		GLfloat aspect = (GLfloat)state->screen_width / state->screen_height;
+		if (!state->workers)
+		{
+			batch_draw(&state->batch, primitives, count, aspect);
+			return;
+		}
+
+		// Uniform packing is spread over the workers, then everything is issued from here
+		state->record_primitives = primitives;
+		state->record_count = count;
+		state->record_draws = batch_prepare(&state->batch, primitives, count, aspect);
+		if (!state->record_draws) return;
+		for (uint32_t i = 0; i < state->workers; i++)
+			cmd_list_begin(&state->cmd_lists[i], frame_arena_alloc(&state->frame_arena, state->cmd_list_bytes), state->cmd_list_bytes);
+		workers_run(&state->worker_pool, record_batch_slice, NULL);
+		cmd_submit(&state->cmd_queue, &state->gl_cache, state->cmd_lists, state->workers);
+		return;
+	}
+	if (state->scene == SCENE_STREAM)
+	{
+		render_stream_scene(delta);
+		return;
+	}
+	if (state->scene == SCENE_MESH)
+	{
+		render_mesh_scene(delta);
+		return;
+	}
+	if (state->scene == SCENE_TEXTURE)
+	{
+		render_texture_scene();
+		return;
+	}
+
+	if (!state->program) return;
+
+	// Render the triangle, blended with sort_draws since it is half transparent and opaque
+	// otherwise. Nothing changes between frames, so after the first frame the state cache
+	// elides all of these.
+	gl_cache_use_program(&state->gl_cache, state->program);
+	gl_cache_blend(&state->gl_cache, state->sort_draws ? GL_TRUE : GL_FALSE);
+	if (state->sort_draws) gl_cache_blend_func(&state->gl_cache, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	gl_cache_bind_buffer(&state->gl_cache, GL_ARRAY_BUFFER, state->vbo_triangle);
+	vertex_format_apply(&state->triangle_format, &state->gl_cache, 0);
+	static const GLfloat blue[4] = { 0.0f, 0.0f, 1.0f, 0.5f };
+	uniform_cache_4fv(&state->uniforms, state->uniform_color, 1, blue);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+/***********************************************************
+ * Name: end_scene
+ *
+ * Arguments:
+ *   void
+ *
+ * Description:
+ *   Releases all resources allocated/created in begin_scene()
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void end_scene()
+{
+	// Cleanup
+	if (state->update_hz && (state->scene == SCENE_BATCH || state->scene == SCENE_STREAM))
+	{
+		update_stop(&state->updater);
+		for (int i = 0; i < 3; i++) free(state->snapshots[i]);
+	}
+	if (state->scene == SCENE_BATCH)
+	{
+		if (state->workers)
+		{
+			workers_destroy(&state->worker_pool);
+			cmd_queue_destroy(&state->cmd_queue);
+		}
+		batch_destroy(&state->batch);
+		if (state->world_scale > 1.0f) scene_graph_destroy(&state->graph);
+		free(state->primitives);
+		free(state->spin);
+		return;
+	}
+	if (state->scene == SCENE_STREAM)
+	{
+		stream_destroy(&state->stream);
+		gl_cache_forget_program(&state->gl_cache, state->stream_program);
+		shader_release(&state->shaders, state->stream_shader);
+		free(state->particles);
+		free(state->stream_source);
+		free(state->stream_clip);
+		return;
+	}
+	if (state->scene == SCENE_MESH)
+	{
+		mesh_destroy(&state->mesh);
+		gl_cache_forget_program(&state->gl_cache, state->mesh_program);
+		shader_release(&state->shaders, state->mesh_shader);
+		uniform_cache_destroy(&state->mesh_uniforms);
+		return;
+	}
+	if (state->scene == SCENE_TEXTURE)
+	{
+		// Cancels decodes still in flight and deletes every streamed texture
+		if (state->atlas_path) atlas_destroy(&state->atlas, &state->textures, &state->gl_cache);
+		texture_manager_destroy(&state->textures, &state->gl_cache);
+		gl_cache_forget_texture(&state->gl_cache, state->tile_placeholder);
+		glDeleteTextures(1, &state->tile_placeholder);
+		gl_cache_forget_buffer(&state->gl_cache, state->vbo_tile);
+		glDeleteBuffers(1, &state->vbo_tile);
+		if (state->pack_constants)
+		{
+			gl_cache_forget_buffer(&state->gl_cache, state->vbo_tile_packed);
+			glDeleteBuffers(1, &state->vbo_tile_packed);
+			gl_cache_forget_program(&state->gl_cache, state->tile_packed_program);
+			shader_release(&state->shaders, state->tile_packed_shader);
+			return;
+		}
+		gl_cache_forget_program(&state->gl_cache, state->tile_program);
+		shader_release(&state->shaders, state->tile_shader);
+		uniform_cache_destroy(&state->tile_uniforms);
+		return;
+	}
+	gl_cache_forget_program(&state->gl_cache, state->program);
+	gl_cache_forget_buffer(&state->gl_cache, state->vbo_triangle);
+	shader_release(&state->shaders, state->shader);
+	uniform_cache_destroy(&state->uniforms);
+	glDeleteBuffers(1, &state->vbo_triangle);
+}
+
+static void on_signal(int signum)
+{
+	// Leave the render loop so that end_scene() and exit_ogl() run
+	running = 0;
+}
+
+/***********************************************************
+ * Name: wait_for_damage
+ *
+ * Arguments:
+ *   void
+ *
+ * Description:
+ *   Damage tracking: blocks until the scene has changed something on screen, then sets
+ *   up the frame through damage_begin_frame(). The animated scenes damage everything
+ *   every frame; the triangle is damaged when its program is built and the texture
+ *   scene when a tile's texture arrives. Shader builds and texture uploads continue
+ *   while idle, since they are what ends the idling.
+ *
+ * Returns:
+ *   int = 1 when a frame should be drawn, 0 if the loop is shutting down
+ *
+ ***********************************************************/
+static int wait_for_damage()
+{
+	const struct timespec idle = { 0, DAMAGE_IDLE_US * 1000L };
+	for (;;)
+	{
+		if (state->scene == SCENE_BATCH || state->scene == SCENE_STREAM || state->scene == SCENE_MESH) damage_all(&state->damage);
+		if (state->scene == SCENE_TEXTURE) damage_texture_scene();
+		if (damage_begin_frame(&state->damage) != DAMAGE_NONE) return 1;
+		if (!running) return 0;
+
+		shader_pump(&state->shaders, 1);
+		if (state->scene == SCENE_TEXTURE) texture_pump(&state->textures, &state->gl_cache, state->texture_upload_bytes);
+		nanosleep(&idle, NULL);
+	}
+}
+
+/***********************************************************
+ * Name: apply_render_scale
+ *
+ * Arguments:
+ *   void
+ *
+ * Description:
+ *   Dynamic render scale: the EGL surface keeps the size it was created with, so a new
+ *   scale shrinks the viewport to the bottom-left part of the surface instead. Scenes
+ *   keep drawing to the whole viewport, and after the next swap present_render_scale()
+ *   crops the DispmanX source rectangle to the same region so it still fills the display.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void apply_render_scale()
+{
+	uint32_t width = (uint32_t)(state->screen_width * state->scaler.scale + 1.0f) & ~1u;
+	uint32_t height = (uint32_t)(state->screen_height * state->scaler.scale + 1.0f) & ~1u;
+	if (width < RENDER_SCALE_MIN_SIZE) width = RENDER_SCALE_MIN_SIZE;
+	if (height < RENDER_SCALE_MIN_SIZE) height = RENDER_SCALE_MIN_SIZE;
+	if (width > state->screen_width) width = state->screen_width;
+	if (height > state->screen_height) height = state->screen_height;
+	if (width == state->viewport_width && height == state->viewport_height) return;
+
+	state->viewport_width = width;
+	state->viewport_height = height;
+	gl_cache_viewport(&state->gl_cache, 0, 0, width, height);
+	damage_resize(&state->damage, width, height);
+	state->crop_pending = !state->offscreen;
+	if (state->verbose) printf("Render scale %.2f, %ux%u\n", state->scaler.scale, width, height);
+}
+
+// Shows the new viewport once a frame drawn with it has been swapped, never before
+static void present_render_scale()
+{
+	// GL's origin is bottom-left, DispmanX's top-left
+	layer_set_source(&state->main_layer, 0, state->screen_height - state->viewport_height, state->viewport_width, state->viewport_height);
+	state->crop_pending = 0;
+}
+
+/***********************************************************
+ * Name: apply_quality_level
+ *
+ * Arguments:
+ *   int level = governor level, 0 for full quality
+ *
+ * Description:
+ *   Maps a governor level onto the quality levers, cheapest to give up first:
+ *   1 caps the render scale at 0.85, 2 at 0.7 and stops redrawing the overlay,
+ *   3 also halves the frame rate with a swap interval of 2. A dynamic render scale
+ *   keeps adapting below the cap. The governor's frame target follows the frame cap.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void apply_quality_level(int level)
+{
+	static const float scale_cap[GOVERNOR_LEVELS] = { 1.0f, 0.85f, 0.7f, 0.7f };
+	uint32_t target_us = state->target_frame_us ? state->target_frame_us : GOVERNOR_DEFAULT_FRAME_US;
+
+	state->scaler.max_scale = scale_cap[level];
+	if (!state->target_frame_us || state->scaler.scale > scale_cap[level]) state->scaler.scale = scale_cap[level];
+	apply_render_scale();
+
+	// Offscreen frames are never presented, so only the render scale applies
+	if (!state->offscreen)
+	{
+		EGLint interval = state->swap_interval >= 0 ? state->swap_interval : 1;
+		if (level == GOVERNOR_LEVELS - 1 && interval < 2)
+		{
+			interval = 2;
+			target_us *= 2;
+		}
+		eglSwapInterval(state->display, interval);
+	}
+	state->governor.target_us = target_us;
+}
+
+/***********************************************************
+ * Name: draw_overlay
+ *
+ * Arguments:
+ *   void
+ *
+ * Description:
+ *   Redraws the overlay layer: a translucent panel with one bar per recent frame, red
+ *   when the frame went over budget, and a line at the budget. Every shape is a
+ *   scissored clear, so the overlay needs no shaders or geometry. The scene's surface
+ *   is current again afterwards, with its viewport restored.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void draw_overlay()
+{
+	LAYER_T *overlay = &state->overlay;
+	uint32_t budget_us = state->target_frame_us ? state->target_frame_us : OVERLAY_BUDGET_US;
+	uint32_t graph_height = overlay->height - 8, bar_width = overlay->width / OVERLAY_BARS;
+
+	if (!eglMakeCurrent(state->display, overlay->surface, overlay->surface, state->context)) return;
+	gl_cache_viewport(&state->gl_cache, 0, 0, overlay->width, overlay->height);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.5f);
+	render_pass_begin(&state->overlay_pass);
+
+	// Oldest frame on the left, the graph's full height is twice the budget
+	glEnable(GL_SCISSOR_TEST);
+	for (uint32_t i = 0; i < OVERLAY_BARS; i++)
+	{
+		uint32_t frame_us = state->overlay_history[(state->overlay_next + i) % OVERLAY_BARS];
+		uint32_t height = (uint32_t)((uint64_t)frame_us * graph_height / (2 * budget_us));
+		if (height > graph_height) height = graph_height;
+		if (!height) continue;
+		if (frame_us > budget_us) glClearColor(0.9f, 0.2f, 0.1f, 1.0f);
+		else glClearColor(0.2f, 0.8f, 0.3f, 1.0f);
+		glScissor(i * bar_width, 4, bar_width - 1, height);
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+	glClearColor(1.0f, 1.0f, 1.0f, 0.8f);
+	glScissor(0, 4 + graph_height / 2, overlay->width, 1);
+	glClear(GL_COLOR_BUFFER_BIT);
+	glDisable(GL_SCISSOR_TEST);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+	render_pass_end(&state->overlay_pass);
+	eglSwapBuffers(state->display, overlay->surface);
+	eglMakeCurrent(state->display, state->main_layer.surface, state->main_layer.surface, state->context);
+	gl_cache_viewport(&state->gl_cache, 0, 0, state->viewport_width, state->viewport_height);
+	check();
+}
+
+/***********************************************************
+ * Name: usage
+ *
+ * Arguments:
+ *   const char *argv0 = program name
+ *
+ * Description:
+ *   Prints command line help
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+static void usage(const char *argv0)
+{
+	printf("Usage: %s [options]\n", argv0);
+	printf("  -i, --stats-interval MS   Frame time summary interval in milliseconds (default %d)\n", STATS_DEFAULT_INTERVAL_MS);
+	printf("  -b, --bench FRAMES        Benchmark: measure FRAMES frames, write JSON results and exit\n");
+	printf("  -w, --warmup FRAMES       Frames to render before benchmark measurement starts (default %d)\n", BENCH_DEFAULT_WARMUP_FRAMES);
+	printf("  -o, --bench-output FILE   Write benchmark JSON to FILE instead of stdout\n");
+	printf("  -s, --swap-interval N     Call eglSwapInterval(N): 0 = vsync off, 1 = every vblank, 2 = every other\n");
+	printf("  -L, --latency             Start each frame as late as possible before the vblank it is shown on\n");
+	printf("  -M, --max-frames-in-flight N  Unfinished frames allowed on the GPU after a swap (max %d, 1 with --latency)\n", PACING_MAX_IN_FLIGHT);
+	printf("  -K, --pace-margin US      Slack --latency keeps before the vblank (default %d)\n", PACING_DEFAULT_MARGIN_US);
+	printf("  -f, --offscreen           Render to an offscreen framebuffer and never present\n");
+	printf("  -y, --display N           DispmanX display for the scene: 0 main (default), 2 HDMI, 3 SDTV\n");
+	printf("  -O, --overlay HZ          Show a frame time graph on its own layer, redrawn HZ times a second\n");
+	printf("  -Y, --overlay-display N   DispmanX display for the overlay (default: the scene's)\n");
+	printf("  -D, --depth-buffer        Give the surface depth and stencil buffers\n");
+	printf("  -P, --render-pass MODE    Tile load/store actions: tiled (default, clear all, discard unused) or legacy\n");
+	printf("  -c, --scene NAME          Scene to draw: triangle (default), batch, stream, mesh or texture\n");
+	printf("  -n, --count N             Number of primitives in the batch, stream and mesh scenes (default %d)\n", BATCH_DEFAULT_PRIMITIVES);
+	printf("  -r, --stream-buffers N    VBOs rotated by the stream scene, 1 to orphan a single buffer (default %d)\n", STREAM_DEFAULT_BUFFERS);
+	printf("  -x, --shader-cache DIR    Cache linked program binaries in DIR (needs GL_OES_get_program_binary)\n");
+	printf("  -t, --trace FILE          Write per-pass CPU/GPU timings to FILE as Chrome trace-event JSON\n");
+	printf("  -e, --trace-every N       Sample GPU timings with glFinish on one frame in N (default %d)\n", TRACE_DEFAULT_SAMPLE_EVERY);
+	printf("  -g, --gl-check MODE       GL error checking: off, sampled (once per frame) or strict (every call)\n");
+	printf("  -u, --update-hz HZ        Run the batch/stream simulation on its own thread at HZ updates per second\n");
+	printf("  -j, --workers N           Record the batch scene on N threads and replay it sorted by state (max %d)\n", WORKERS_MAX);
+	printf("  -a, --frame-arena KB      Per-frame transient memory, double-buffered (default %d)\n", FRAME_ARENA_DEFAULT_BYTES / 1024);
+	printf("  -m, --mesh FILE           Draw a mesh converted with meshconv.bin in the mesh scene\n");
+	printf("  -T, --texture FILE        PGM, PPM, ETC1 PKM or KTX image for the texture scene, repeat for more tiles (max %d)\n", TEXTURE_MAX);
+	printf("  -A, --atlas FILE          Show the sprites of an atlas from atlaspack.bin in the texture scene\n");
+	printf("  -U, --upload-budget KB    Texture bytes uploaded per frame in the texture scene (default %d)\n", TEXTURE_DEFAULT_UPLOAD_BYTES / 1024);
+	printf("  -k, --pack-constants      Texture scene: per-tile constants as vertex attributes, one draw per shared texture\n");
+	printf("  -d, --damage              Only draw frames that change something, scissored to the change\n");
+	printf("  -R, --render-scale S      Render at S times the display size (e.g. 0.75) or at WxH, upscaled by DispmanX\n");
+	printf("  -F, --target-frame-ms MS  Lower the render scale at run time to hold MS per frame\n");
+	printf("  -Z, --startup-profile     Print how long each startup phase took once the first frame is shown\n");
+	printf("  -S, --sort-draws          Blend translucent content (the triangle, one batch primitive in four), opaque draws first\n");
+	printf("  -W, --world SCALE         Batch scene: spread over SCALE screens each way, panned over and culled\n");
+	printf("  -V, --overdraw            Show a heatmap of fragments shaded per pixel instead of the scene\n");
+	printf("  -G, --governor            Lower quality ahead of thermal throttling and restore it when cool\n");
+	printf("  -H, --governor-temp C     Temperature the governor steps down at (default: %d)\n", GOVERNOR_DEFAULT_LIMIT_MC / 1000);
+	printf("  -C, --capture FILE        Record every GL call to FILE for replay.bin, without the overlay (make CAPTURE=1 builds)\n");
+	printf("  -p, --vertex-format NAME  Triangle, batch and mesh vertices: float (default), short or packed\n");
+	printf("  -v, --verbose             Print shader compile and link logs\n");
+	printf("  -h, --help                Show this help\n");
+}
+
+/***********************************************************
+ * Name: main
+ *
+ * Arguments:
+ *   int argc = number of command line arguments
+ *   char **argv = command line arguments
+ *
+ * Description:
+ *   Program entry point: setup the OpenGL screen, the scene, and then run the rendering loop
+ *
+ * Returns:
+ *   int
+ *
+ ***********************************************************/
+int main (int argc, char **argv)
+{
+	STATS_SAMPLE_T sample;
+	uint32_t stats_interval_ms = STATS_DEFAULT_INTERVAL_MS;
+	BENCH_CONFIG_T bench = { .warmup_frames = BENCH_DEFAULT_WARMUP_FRAMES, .swap_interval = -1 };
+	uint64_t frame;
+	int status = 0;
+	const char *trace_path = NULL;
+	const char *capture_path = NULL;
+	uint32_t trace_every = TRACE_DEFAULT_SAMPLE_EVERY;
+
+	// Everything until the first frame is shown is timed
+	startup_init(startup);
+	startup_phase(startup, "setup");
+
+	// Clear application state
+	memset( state, 0, sizeof( *state ) );
+	state->swap_interval = -1;
+	state->primitive_count = BATCH_DEFAULT_PRIMITIVES;
+	state->stream_buffers = STREAM_DEFAULT_BUFFERS;
+	state->frame_arena_bytes = FRAME_ARENA_DEFAULT_BYTES;
+	state->texture_upload_bytes = TEXTURE_DEFAULT_UPLOAD_BYTES;
+	state->render_scale = 1.0f;
+	state->overlay_display_id = OVERLAY_SAME_DISPLAY;
+	state->pace_margin_us = PACING_DEFAULT_MARGIN_US;
+	state->texture_decode_phase = -1;
+	state->governor_limit_mc = GOVERNOR_DEFAULT_LIMIT_MC;
+	memset(&sample, 0, sizeof(sample));
+
+	// Command line
+	static const struct option long_options[] =
+	{
+		{ "stats-interval", required_argument, NULL, 'i' },
+		{ "bench",          required_argument, NULL, 'b' },
+		{ "warmup",         required_argument, NULL, 'w' },
+		{ "bench-output",   required_argument, NULL, 'o' },
+		{ "swap-interval",  required_argument, NULL, 's' },
+		{ "latency",        no_argument,       NULL, 'L' },
+		{ "max-frames-in-flight", required_argument, NULL, 'M' },
+		{ "pace-margin",    required_argument, NULL, 'K' },
+		{ "offscreen",      no_argument,       NULL, 'f' },
+		{ "depth-buffer",   no_argument,       NULL, 'D' },
+		{ "display",        required_argument, NULL, 'y' },
+		{ "overlay",        required_argument, NULL, 'O' },
+		{ "overlay-display", required_argument, NULL, 'Y' },
+		{ "render-pass",    required_argument, NULL, 'P' },
+		{ "scene",          required_argument, NULL, 'c' },
+		{ "count",          required_argument, NULL, 'n' },
+		{ "stream-buffers", required_argument, NULL, 'r' },
+		{ "shader-cache",   required_argument, NULL, 'x' },
+		{ "trace",          required_argument, NULL, 't' },
+		{ "trace-every",    required_argument, NULL, 'e' },
+		{ "gl-check",       required_argument, NULL, 'g' },
+		{ "update-hz",      required_argument, NULL, 'u' },
+		{ "workers",        required_argument, NULL, 'j' },
+		{ "frame-arena",    required_argument, NULL, 'a' },
+		{ "mesh",           required_argument, NULL, 'm' },
+		{ "texture",        required_argument, NULL, 'T' },
+		{ "atlas",          required_argument, NULL, 'A' },
+		{ "upload-budget",  required_argument, NULL, 'U' },
+		{ "pack-constants", no_argument,       NULL, 'k' },
+		{ "damage",         no_argument,       NULL, 'd' },
+		{ "render-scale",   required_argument, NULL, 'R' },
+		{ "target-frame-ms", required_argument, NULL, 'F' },
+		{ "startup-profile", no_argument,      NULL, 'Z' },
+		{ "sort-draws",     no_argument,       NULL, 'S' },
+		{ "world",          required_argument, NULL, 'W' },
+		{ "overdraw",       no_argument,       NULL, 'V' },
+		{ "governor",       no_argument,       NULL, 'G' },
+		{ "governor-temp",  required_argument, NULL, 'H' },
+		{ "capture",        required_argument, NULL, 'C' },
+		{ "vertex-format",  required_argument, NULL, 'p' },
+		{ "verbose",        no_argument,       NULL, 'v' },
+		{ "help",           no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	int opt;
+	while ((opt = getopt_long(argc, argv, "i:b:w:o:s:LM:K:fDP:y:O:Y:c:n:r:x:t:e:g:u:j:a:m:T:A:U:kdR:F:ZSW:VGH:C:p:vh", long_options, NULL)) != -1)
+	{
+		switch (opt)
+		{
+			case 'i': stats_interval_ms = (uint32_t)strtoul(optarg, NULL, 10); break;
+			case 'b': bench.measured_frames = (uint32_t)strtoul(optarg, NULL, 10); break;
+			case 'w': bench.warmup_frames = (uint32_t)strtoul(optarg, NULL, 10); break;
+			case 'o': bench.output_path = optarg; break;
+			case 's': state->swap_interval = (EGLint)strtol(optarg, NULL, 10); break;
+			case 'L': state->late_start = 1; break;
+			case 'M': state->max_frames_in_flight = (uint32_t)strtoul(optarg, NULL, 10); break;
+			case 'K': state->pace_margin_us = (uint32_t)strtoul(optarg, NULL, 10); break;
+			case 'f': state->offscreen = 1; break;
+			case 'D': state->depth_buffer = 1; break;
+			case 'y': state->display_id = (uint32_t)strtoul(optarg, NULL, 10); break;
+			case 'O': state->overlay_hz = (uint32_t)strtoul(optarg, NULL, 10); break;
+			case 'Y': state->overlay_display_id = (uint32_t)strtoul(optarg, NULL, 10); break;
+			case 'P':
+				if (strcmp(optarg, "tiled") == 0) state->legacy_pass = 0;
+				else if (strcmp(optarg, "legacy") == 0) state->legacy_pass = 1;
+				else { usage(argv[0]); return 1; }
+				break;
+			case 'c':
+				if (strcmp(optarg, "triangle") == 0) state->scene = SCENE_TRIANGLE;
+				else if (strcmp(optarg, "batch") == 0) state->scene = SCENE_BATCH;
+				else if (strcmp(optarg, "stream") == 0) state->scene = SCENE_STREAM;
+				else if (strcmp(optarg, "mesh") == 0) state->scene = SCENE_MESH;
+				else if (strcmp(optarg, "texture") == 0) state->scene = SCENE_TEXTURE;
+				else { usage(argv[0]); return 1; }
+				break;
+			case 'n': state->primitive_count = (uint32_t)strtoul(optarg, NULL, 10); if (!state->primitive_count) state->primitive_count = 1; break;
+			case 'r': state->stream_buffers = (uint32_t)strtoul(optarg, NULL, 10); break;
+			case 'x': state->shader_cache_dir = optarg; break;
+			case 't': trace_path = optarg; break;
+			case 'e': trace_every = (uint32_t)strtoul(optarg, NULL, 10); break;
+			case 'g':
+			{
+				static const char *const mode_names[] = { "off", "sampled", "strict" };
+				int mode = strcmp(optarg, "off") == 0 ? GL_CHECK_OFF : strcmp(optarg, "sampled") == 0 ? GL_CHECK_SAMPLED :
+					strcmp(optarg, "strict") == 0 ? GL_CHECK_STRICT : -1;
+				if (mode < 0) { usage(argv[0]); return 1; }
+				int actual = gl_check_set_mode(mode);
+				if (actual != mode) fprintf(stderr, "GL check mode %s not compiled in, using %s\n", optarg, mode_names[actual]);
+				break;
+			}
+			case 'u':
+				state->update_hz = (uint32_t)strtoul(optarg, NULL, 10);
+				if (state->update_hz > UPDATE_MAX_HZ)
+				{
+					fprintf(stderr, "--update-hz %s is above %u, clamping\n", optarg, UPDATE_MAX_HZ);
+					state->update_hz = UPDATE_MAX_HZ;
+				}
+				break;
+			case 'j': state->workers = (uint32_t)strtoul(optarg, NULL, 10); break;
+			case 'a': state->frame_arena_bytes = (uint32_t)strtoul(optarg, NULL, 10) * 1024; break;
+			case 'm': state->mesh_path = optarg; break;
+			case 'T': if (state->texture_path_count < TEXTURE_MAX) state->texture_paths[state->texture_path_count++] = optarg; break;
+			case 'A': state->atlas_path = optarg; break;
+			case 'k': state->pack_constants = 1; break;
+			case 'd': state->damage_tracking = 1; break;
+			case 'U': state->texture_upload_bytes = (uint32_t)strtoul(optarg, NULL, 10) * 1024; break;
+			case 'R':
+				if (sscanf(optarg, "%ux%u", &state->render_width, &state->render_height) == 2 && state->render_width && state->render_height) break;
+				state->render_width = state->render_height = 0;
+				state->render_scale = strtof(optarg, NULL);
+				if (!(state->render_scale > 0.0f && state->render_scale <= 1.0f)) { usage(argv[0]); return 1; }
+				break;
+			case 'F': state->target_frame_us = (uint32_t)(strtof(optarg, NULL) * 1000.0f); break;
+			case 'Z': state->startup_profile = 1; break;
+			case 'S': state->sort_draws = 1; break;
+			case 'W': state->world_scale = strtof(optarg, NULL); break;
+			case 'V': state->overdraw_mode = 1; break;
+			case 'G': state->governor_enabled = 1; break;
+			case 'C': capture_path = optarg; break;
+			case 'H': state->governor_limit_mc = (int32_t)(strtof(optarg, NULL) * 1000.0f); break;
+			case 'p':
+				if (strcmp(optarg, "float") == 0) state->vertex_precision = VERTEX_FLOAT;
+				else if (strcmp(optarg, "short") == 0) state->vertex_precision = VERTEX_SHORT;
+				else if (strcmp(optarg, "packed") == 0) state->vertex_precision = VERTEX_PACKED;
+				else { usage(argv[0]); return 1; }
+				break;
+			case 'v': state->verbose = 1; break;
+			case 'h': usage(argv[0]); return 0;
+			default: usage(argv[0]); return 1;
+		}
+	}
+
+	// Culling reads and animates the scene graph on the render thread
+	if (state->world_scale > 1.0f && state->update_hz)
+	{
+		fprintf(stderr, "--world animates on the render thread, ignoring --update-hz\n");
+		state->update_hz = 0;
+	}
+
+	// With damage tracking the frame period includes idle time, which the governor would read
+	// as load
+	if (state->governor_enabled && state->damage_tracking)
+	{
+		fprintf(stderr, "--damage skips idle frames, ignoring --governor\n");
+		state->governor_enabled = 0;
+	}
+
+	// The static scenes stop drawing under damage tracking once they are on screen, so a
+	// benchmark would never reach its frame count
+	if (bench.measured_frames && state->damage_tracking && (state->scene == SCENE_TRIANGLE || state->scene == SCENE_TEXTURE))
+	{
+		fprintf(stderr, "--bench needs a scene that redraws every frame, it cannot be combined with --damage here\n");
+		return 1;
+	}
+
+	// Warm the page cache with the assets read later, while the main thread brings up EGL
+	startup_prefetch_add(startup, state->mesh_path);
+	startup_prefetch_add(startup, state->shader_cache_dir);
+	if (startup_prefetch_start(startup) != 0) fprintf(stderr, "Unable to start asset prefetch thread\n");
+
+	// Frame timings are reported from a background thread so the render loop never blocks on stdout.
+	// Benchmark runs stay quiet and only print the final JSON.
+	if (!bench.measured_frames && stats_start(stats, stats_interval_ms, stdout) != 0)
+	{
+		fprintf(stderr, "Unable to start stats reporter thread\n");
+		return 1;
+	}
+
+	// Per-pass timing capture, written out when the loop ends
+	if (trace_init(trace, trace_path, trace_every) != 0)
+	{
+		fprintf(stderr, "Unable to allocate trace buffer\n");
+		return 1;
+	}
+
+	// Ctrl-C or a service stop ends the loop cleanly
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	// Transient frame memory, allocated once so the render loop never touches the heap
+	if (frame_arena_init(&state->frame_arena, state->frame_arena_bytes) != 0)
+	{
+		fprintf(stderr, "Unable to allocate frame arena\n");
+		return 1;
+	}
+
+	// Texture decoding needs no context, so it runs on the decode threads during EGL setup
+	if (state->scene == SCENE_TEXTURE)
+	{
+		startup_phase(startup, "texture requests");
+		start_texture_loads();
+	}
+
+	// Capture from before the context exists, so the trace holds all GL state. The overlay
+	// layer draws to a second surface, which a replay does not have.
+	if (capture_path)
+	{
+		if (!CAPTURE_AVAILABLE)
+		{
+			fprintf(stderr, "GL capture not compiled in, build with make CAPTURE=1\n");
+			return 1;
+		}
+		if (capture_start(capture_path) != 0)
+		{
+			fprintf(stderr, "Unable to create %s\n", capture_path);
+			return 1;
+		}
+		state->overlay_hz = 0;
+	}
+
+	// Start OGLES
+	init_ogl(state);
+	capture_set_surface(state->screen_width, state->screen_height, state->depth_bits, state->stencil_bits,
+		(state->offscreen ? CAPTURE_FLAG_OFFSCREEN : 0) | (state->buffer_preserved ? CAPTURE_FLAG_PRESERVED : 0));
+	startup_phase(startup, "GL setup");
+	if (state->offscreen) init_offscreen(state);
+	init_render_pass();
+	shader_manager_init(&state->shaders, state->shader_cache_dir, state->verbose);
+	damage_init(&state->damage, state->screen_width, state->screen_height, state->offscreen || state->buffer_preserved);
+	if (state->overdraw_mode && overdraw_init(&state->overdraw, &state->gl_cache, &state->shaders, state->screen_width, state->screen_height, state->fbo) != 0)
+	{
+		fprintf(stderr, "Overdraw mode needs a renderable RGBA texture, drawing normally\n");
+		state->overdraw_mode = 0;
+	}
+
+	// Create simple fragment and vertex shaders, and load geometry buffers
+	startup_phase(startup, "begin_scene");
+	begin_scene();
+	startup_phase(startup, "render setup");
+
+	// Set the viewport to fill the screen
+	gl_cache_viewport(&state->gl_cache, 0, 0, state->screen_width, state->screen_height);
+	state->viewport_width = state->screen_width;
+	state->viewport_height = state->screen_height;
+	if (state->target_frame_us) render_scale_init(&state->scaler, 1.0f, state->target_frame_us);
+	else state->scaler.scale = 1.0f;
+
+	// The sensors are read through the firmware, which init_ogl() has brought up
+	if (state->governor_enabled && governor_start(&state->governor, state->governor_limit_mc, state->target_frame_us) != 0)
+	{
+		fprintf(stderr, "No VideoCore command channel, quality governor disabled\n");
+		state->governor_enabled = 0;
+	}
+
+	// A latency-bound kiosk wants one frame in flight unless told otherwise
+	if (state->late_start && !state->max_frames_in_flight) state->max_frames_in_flight = 1;
+	// Offscreen frames already finish before the next one starts, and are never shown
+	if (state->offscreen) state->late_start = state->max_frames_in_flight = 0;
+	pacing_init(&state->pacing, state->display, state->main_layer.display, state->late_start,
+		state->max_frames_in_flight, state->pace_margin_us);
+	if (state->verbose && (state->late_start || state->max_frames_in_flight))
+		printf("Frame pacing: late start %s (%s), %u frames in flight (%s)\n", state->late_start ? "on" : "off",
+			state->pacing.callback ? "vsync callback" : "swap timing", state->max_frames_in_flight,
+			state->pacing.create_sync ? "fences" : state->max_frames_in_flight == 1 ? "glFinish" : "unbounded, no fence sync");
+
+	// Timings for smooth render() animation and for the stats reporter
+	capture_setup_done();
+	frame_clock_init(frame_clock);
+	startup_phase(startup, "first frame");
+
+	// Render loop, forever unless benchmarking
+	for (frame = 0; running; frame++)
+	{
+		if (bench.measured_frames)
+		{
+			if (frame == bench.warmup_frames) frame_clock_reset_histograms(frame_clock);
+			if (frame == (uint64_t)bench.warmup_frames + bench.measured_frames) break;
+		}
+
+		// Frames that would draw the same pixels again are never started
+		if (state->damage_tracking && !wait_for_damage()) break;
+
+		// Latency mode: sleep off the slack now, so the frame samples its inputs late
+		pacing_wait_for_start(&state->pacing);
+		frame_clock_begin(frame_clock);
+		frame_arena_begin_frame(&state->frame_arena);
+		trace_begin_frame(trace);
+		trace_begin(trace, "frame");
+
+		// Clear, or discard, everything the frame does not load
+		trace_begin(trace, "clear");
+		render_pass_begin(&state->pass);
+		trace_end(trace);
+
+		// Draw, into the fragment counter in overdraw mode
+		trace_begin(trace, "draw");
+		if (state->overdraw_mode) overdraw_begin(&state->overdraw);
+		render(frame_clock->frame_us);
+		if (state->overdraw_mode) overdraw_end(&state->overdraw, state->viewport_width, state->viewport_height);
+		trace_end(trace);
+		if (state->damage_tracking) damage_end_frame(&state->damage);
+		render_pass_end(&state->pass);
+		frame_clock_submitted(frame_clock);
+
+		// Update the display by swapping front/back buffers. Offscreen frames are not presented,
+		// so wait for the GPU instead to keep the CPU from queueing work without bound.
+		trace_begin(trace, "swap");
+		if (state->offscreen) glFinish();
+		else eglSwapBuffers(state->display, state->main_layer.surface);
+		check();
+		trace_end(trace);
+		trace_end(trace);
+		capture_frame(!state->offscreen);
+		frame_clock_swapped(frame_clock);
+		pacing_frame_swapped(&state->pacing);
+
+		// Startup ends with the first swap. The overlay is not needed for that frame, so its
+		// layer and surface are only created now.
+		if (!startup->first_frame_ns)
+		{
+			startup_first_frame(startup);
+			startup_phase(startup, state->overlay_hz && !state->offscreen ? "overlay layer" : NULL);
+			if (state->overlay_hz && !state->offscreen) init_overlay(state->config);
+			startup_phase(startup, NULL);
+			if (state->startup_profile) startup_report(startup, stderr);
+		}
+
+		// Dynamic render scale. With damage tracking the frame period includes idle time, so
+		// it says nothing about the GPU load and the scale stays where it is.
+		if (state->crop_pending) present_render_scale();
+		if (state->target_frame_us && !state->damage_tracking && render_scale_update(&state->scaler, frame_clock->frame_us))
+			apply_render_scale();
+
+		// Quality governor, levels change at most once per sensor sample. The decision is
+		// logged by the stats reporter.
+		sample.governor_reason = NULL;
+		if (state->governor_enabled)
+		{
+			int from = state->governor.level;
+			if (governor_update(&state->governor, frame_clock->frame_us))
+			{
+				const GOVERNOR_T *governor = &state->governor;
+				apply_quality_level(governor->level);
+				sample.governor_reason = governor->reason;
+				sample.governor_from = (int8_t)from;
+				sample.governor_to = (int8_t)governor->level;
+				sample.governor_temp_mc = governor->sample.temp_mc;
+				sample.governor_arm_mhz = (uint16_t)governor->sample.arm_mhz;
+				sample.governor_core_mhz = (uint16_t)governor->sample.core_mhz;
+				sample.governor_throttled = governor->sample.throttled;
+				sample.governor_frame_us = governor->frame_mean_us;
+			}
+		}
+
+		// The overlay layer keeps its own, much lower, update rate. From governor level 2 it
+		// keeps showing its last frame.
+		state->overlay_history[state->overlay_next++ % OVERLAY_BARS] = frame_clock->frame_us;
+		state->overlay_next %= OVERLAY_BARS;
+		if (state->overlay.surface && state->governor.level < 2 && layer_due(&state->overlay, frame_clock_now())) draw_overlay();
+
+		// Background shader compilation, one program per frame once the first frame is up
+		shader_pump(&state->shaders, 1);
+
+		// Budgeted texture uploads, the decoding itself happens on the texture threads
+		sample.upload_bytes = 0;
+		if (state->scene == SCENE_TEXTURE) sample.upload_bytes = texture_pump(&state->textures, &state->gl_cache, state->texture_upload_bytes);
+		if (state->texture_decode_phase >= 0 && !texture_decodes_pending(&state->textures))
+		{
+			startup_end_background(startup, state->texture_decode_phase);
+			state->texture_decode_phase = -1;
+		}
+
+		// In sampled mode this is the only glGetError() of the frame
+		check_frame();
+
+		sample.frame_us = frame_clock->frame_us;
+		sample.submit_us = frame_clock->submit_us;
+		sample.swap_us = frame_clock->swap_us;
+		gl_cache_end_frame(&state->gl_cache, &sample.state_issued, &sample.state_elided);
+		sample.arena_bytes = state->frame_arena.requested;
+		if (!bench.measured_frames) stats_push(stats, &sample);
+	}
+
+	// Results are written while the context is still current so driver strings can be queried
+	bench.swap_interval = state->swap_interval;
+	bench.offscreen = state->offscreen;
+	bench.render_pass = state->legacy_pass ? "legacy" : "tiled";
+	bench.depth_bits = state->depth_bits;
+	bench.stencil_bits = state->stencil_bits;
+	if (bench.measured_frames && bench_write_json(&bench, frame_clock, state->screen_width, state->screen_height) != 0)
+	{
+		fprintf(stderr, "Unable to write benchmark results\n");
+		status = 1;
+	}
+
+	if (trace_write(trace) != 0)
+	{
+		fprintf(stderr, "Unable to write trace to %s\n", trace_path);
+		status = 1;
+	}
+	trace_destroy(trace);
+
+	// Fragment counts of the last frame, read back before the scene is torn down
+	if (state->overdraw_mode && overdraw_measure(&state->overdraw, state->viewport_width, state->viewport_height) == 0 && state->overdraw.pixels)
+		fprintf(stderr, "Overdraw: %.2f fragments per pixel, %.2f per covered pixel, %.1f%% covered, max %u%s\n",
+			(double)state->overdraw.fragments / state->overdraw.pixels,
+			state->overdraw.covered ? (double)state->overdraw.fragments / state->overdraw.covered : 0.0,
+			100.0 * state->overdraw.covered / state->overdraw.pixels, state->overdraw.max,
+			state->overdraw.max == OVERDRAW_MAX_COUNT ? " (saturated)" : "");
+
+	// Culling statistics, before end_scene() releases the scene graph
+	if (state->scene == SCENE_BATCH && state->world_scale > 1.0f && state->verbose && state->cull_frames)
+		fprintf(stderr, "Scene graph: %.1f of %u primitives visible per frame, last frame %u cells and %u nodes tested, %u index builds\n",
+			(double)state->visible_total / state->cull_frames, state->primitive_count, state->graph.cells_visited,
+			state->graph.nodes_tested, state->graph.index_builds);
+
+	// Cleanup
+	governor_stop(&state->governor);
+	end_scene();
+	if (state->overdraw_mode) overdraw_destroy(&state->overdraw);
+	shader_manager_destroy(&state->shaders);
+	pacing_destroy(&state->pacing);
+	if (state->offscreen) exit_offscreen(state);
+	if (capture_path)
+	{
+		if (capture_stop() != 0)
+		{
+			fprintf(stderr, "Unable to write the GL capture to %s\n", capture_path);
+			status = 1;
+		}
+		else if (state->verbose)
+			fprintf(stderr, "Capture: %u frames, %.1f MB in %s\n", capture_frames(), capture_bytes() / 1048576.0, capture_path);
+	}
+	exit_ogl(state);
+	stats_stop(stats);
+	if (state->verbose || state->frame_arena.failed)
+		fprintf(stderr, "Frame arena high water %u of %u bytes, %u allocations refused\n",
+			state->frame_arena.high_water, state->frame_arena.capacity, state->frame_arena.failed);
+	frame_arena_destroy(&state->frame_arena);
+	startup_destroy(startup);
+	if (state->startup_profile && startup->path_count)
+		fprintf(stderr, "Startup prefetch: %u files, %llu KB\n", startup->prefetched_files, (unsigned long long)(startup->prefetched_bytes / 1024));
+	if ((state->late_start || state->max_frames_in_flight) && state->verbose && state->pacing.frames)
+		fprintf(stderr, "Frame pacing: %u frames, %.2f ms slept and %.2f ms waiting on the GPU per frame, busy estimate %.2f ms, refresh %.3f ms\n",
+			state->pacing.frames, state->pacing.slept_ns / 1e6 / state->pacing.frames, state->pacing.waited_ns / 1e6 / state->pacing.frames,
+			state->pacing.busy_ns / 1e6, state->pacing.period_ns / 1e6);
+	if (state->scene == SCENE_BATCH && state->verbose)
+		fprintf(stderr, "Batch scene: %u blend changes in the last frame\n",
+			state->workers ? state->cmd_queue.blend_changes : state->batch.blend_changes);
+	if (state->scene == SCENE_STREAM && state->stream_dropped)
+		fprintf(stderr, "Stream scene: %u frames not drawn, the streaming buffer was full\n", state->stream_dropped);
+	if (state->scene == SCENE_TEXTURE && state->verbose)
+		fprintf(stderr, "Texture scene: %u tiles in %u draw calls per frame\n", state->tile_count, state->tile_draws);
+	if (state->overlay_hz && state->verbose)
+		fprintf(stderr, "Overlay: %u updates\n", state->overlay.updates);
+	if (state->governor_enabled && state->verbose)
+		fprintf(stderr, "Governor: %u steps down, %u steps up, ended at level %d, peak arm clock %u MHz\n",
+			state->governor.steps_down, state->governor.steps_up, state->governor.level, state->governor.peak_arm_mhz);
+	if (state->damage_tracking && state->verbose)
+		fprintf(stderr, "Damage tracking: %u full frames, %u partial frames, %u idle checks\n",
+			state->damage.full_frames, state->damage.partial_frames, state->damage.skipped);
+
+	// Exit
+	return status;
 }
@@ -0,0 +1,90 @@
+/***********************************************************
+ * File: triple_buffer.c
+ *
+ * Description:
+ *   Single-producer/single-consumer triple buffer. See triple_buffer.h.
+ *
+ ***********************************************************/
+
+#include "triple_buffer.h"
+
+#define SLOT_MASK 3u
+#define FRESH 4u // Middle slot holds a snapshot the consumer has not picked up yet
+
+/***********************************************************
+ * Name: triple_buffer_init
+ *
+ * Arguments:
+ *   TRIPLE_BUFFER_T *buffer = buffer to initialise
+ *   void *slot0, *slot1, *slot2 = three equally sized snapshot areas
+ *
+ * Description:
+ *   The consumer starts on slot0 and the producer on slot1, so all three slots should
+ *   hold a valid initial snapshot before either thread starts
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void triple_buffer_init(TRIPLE_BUFFER_T *buffer, void *slot0, void *slot1, void *slot2)
+{
+	buffer->slots[0] = slot0;
+	buffer->slots[1] = slot1;
+	buffer->slots[2] = slot2;
+	buffer->front = 0;
+	buffer->back = 1;
+	atomic_init(&buffer->middle, 2);
+	atomic_init(&buffer->published, 0);
+}
+
+void *triple_buffer_write_slot(TRIPLE_BUFFER_T *buffer)
+{
+	return buffer->slots[buffer->back];
+}
+
+/***********************************************************
+ * Name: triple_buffer_publish
+ *
+ * Arguments:
+ *   TRIPLE_BUFFER_T *buffer = buffer written by this thread
+ *
+ * Description:
+ *   Producer side: makes the slot just written the newest snapshot and takes the old
+ *   middle slot as the next one to write. An unread snapshot in the middle slot is
+ *   simply superseded.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void triple_buffer_publish(TRIPLE_BUFFER_T *buffer)
+{
+	unsigned previous = atomic_exchange_explicit(&buffer->middle, buffer->back | FRESH, memory_order_acq_rel);
+	buffer->back = previous & SLOT_MASK;
+	atomic_fetch_add_explicit(&buffer->published, 1, memory_order_relaxed);
+}
+
+/***********************************************************
+ * Name: triple_buffer_read_slot
+ *
+ * Arguments:
+ *   TRIPLE_BUFFER_T *buffer = buffer read by this thread
+ *
+ * Description:
+ *   Consumer side: picks up the newest snapshot if one has been published since the
+ *   last call, otherwise keeps the current one. The returned slot stays untouched by
+ *   the producer until the next call.
+ *
+ * Returns:
+ *   void * = the consumer's snapshot
+ *
+ ***********************************************************/
+void *triple_buffer_read_slot(TRIPLE_BUFFER_T *buffer)
+{
+	if (atomic_load_explicit(&buffer->middle, memory_order_relaxed) & FRESH)
+	{
+		unsigned previous = atomic_exchange_explicit(&buffer->middle, buffer->front, memory_order_acq_rel);
+		buffer->front = previous & SLOT_MASK;
+	}
+	return buffer->slots[buffer->front];
+}
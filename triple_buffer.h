@@ -0,0 +1,33 @@
+/***********************************************************
+ * File: triple_buffer.h
+ *
+ * Description:
+ *   Lock-free triple buffer for handing complete snapshots from one producer thread to
+ *   one consumer thread. The producer always has a slot to write, the consumer always
+ *   has a stable slot to read, and the third slot holds the most recently published
+ *   snapshot. Neither side ever waits for the other; the consumer simply sees the
+ *   newest snapshot available when it asks.
+ *
+ ***********************************************************/
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+typedef struct
+{
+	void *slots[3];
+	uint32_t back; // Slot owned by the producer
+	uint32_t front; // Slot owned by the consumer
+	atomic_uint middle; // Slot in between, bit 2 set when it holds an unread snapshot
+	atomic_uint published; // Snapshots published so far
+} TRIPLE_BUFFER_T;
+
+void triple_buffer_init(TRIPLE_BUFFER_T *buffer, void *slot0, void *slot1, void *slot2);
+void *triple_buffer_write_slot(TRIPLE_BUFFER_T *buffer);
+void triple_buffer_publish(TRIPLE_BUFFER_T *buffer);
+void *triple_buffer_read_slot(TRIPLE_BUFFER_T *buffer);
+
+#endif
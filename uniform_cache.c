@@ -0,0 +1,154 @@
+/***********************************************************
+ * File: uniform_cache.c
+ *
+ * Description:
+ *   Shadowed uniform values per program. See uniform_cache.h.
+ *
+ ***********************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include "uniform_cache.h"
+
+static uint32_t type_components(GLenum type)
+{
+	switch (type)
+	{
+		case GL_FLOAT: case GL_INT: case GL_BOOL: case GL_SAMPLER_2D: case GL_SAMPLER_CUBE: return 1;
+		case GL_FLOAT_VEC2: case GL_INT_VEC2: case GL_BOOL_VEC2: return 2;
+		case GL_FLOAT_VEC3: case GL_INT_VEC3: case GL_BOOL_VEC3: return 3;
+		case GL_FLOAT_VEC4: case GL_INT_VEC4: case GL_BOOL_VEC4: case GL_FLOAT_MAT2: return 4;
+		case GL_FLOAT_MAT3: return 9;
+		case GL_FLOAT_MAT4: return 16;
+		default: return 0;
+	}
+}
+
+/***********************************************************
+ * Name: uniform_cache_init
+ *
+ * Arguments:
+ *   UNIFORM_CACHE_T *uniforms = cache to initialise, zeroed or previously initialised
+ *   GL_CACHE_T *cache = state cache that makes the program current and counts calls
+ *   GLuint program = linked program
+ *
+ * Description:
+ *   Enumerates the program's active uniforms and their locations. Every shadow value
+ *   starts unknown, so the first set of each uniform is always sent. Calling it again for a
+ *   relinked program frees the previous shadow values first.
+ *
+ * Returns:
+ *   int = 0 on success, -1 if the shadow values cannot be allocated
+ *
+ ***********************************************************/
+int uniform_cache_init(UNIFORM_CACHE_T *uniforms, GL_CACHE_T *cache, GLuint program)
+{
+	GLint active = 0;
+	uint32_t words = 0;
+
+	uniform_cache_destroy(uniforms);
+	uniforms->cache = cache;
+	uniforms->program = program;
+
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &active);
+	for (GLint i = 0; i < active && uniforms->count < UNIFORM_CACHE_MAX_UNIFORMS; i++)
+	{
+		UNIFORM_CACHE_ENTRY_T *u = &uniforms->uniforms[uniforms->count];
+		GLsizei length = 0;
+		glGetActiveUniform(program, i, sizeof(u->name), &length, &u->elements, &u->type, u->name);
+		char *bracket = strchr(u->name, '[');
+		if (bracket) *bracket = '\0';
+		u->location = glGetUniformLocation(program, u->name);
+		u->components = type_components(u->type);
+		if (u->location < 0 || !u->components) continue;
+		u->offset = words;
+		words += u->components * u->elements;
+		uniforms->count++;
+	}
+
+	uniforms->values = calloc(words ? words : 1, sizeof(uint32_t));
+	return uniforms->values ? 0 : -1;
+}
+
+GLint uniform_cache_find(const UNIFORM_CACHE_T *uniforms, const char *name)
+{
+	for (uint32_t i = 0; i < uniforms->count; i++)
+		if (strcmp(uniforms->uniforms[i].name, name) == 0) return (GLint)i;
+	return -1;
+}
+
+GLint uniform_cache_location(const UNIFORM_CACHE_T *uniforms, GLint slot)
+{
+	return slot < 0 ? -1 : uniforms->uniforms[slot].location;
+}
+
+// The uniform was set behind the cache's back, e.g. by a replayed command list
+void uniform_cache_forget(UNIFORM_CACHE_T *uniforms, GLint slot)
+{
+	if (slot >= 0) uniforms->uniforms[slot].valid = 0;
+}
+
+/***********************************************************
+ * Name: uniform_changed
+ *
+ * Arguments:
+ *   UNIFORM_CACHE_T *uniforms = cache
+ *   GLint slot = uniform slot, -1 to ignore
+ *   const void *data = new value, elements of the uniform's own size
+ *   GLsizei elements = number of array elements being set, from the first
+ *
+ * Description:
+ *   Compares against the shadow value and updates it. Setting a prefix of an array
+ *   that has never been set in full leaves the rest unknown, so it is not yet valid.
+ *
+ * Returns:
+ *   int = 1 if the caller has to send the value, with the program made current
+ *
+ ***********************************************************/
+static int uniform_changed(UNIFORM_CACHE_T *uniforms, GLint slot, const void *data, GLsizei elements)
+{
+	if (slot < 0 || !uniforms->values) return 0;
+	UNIFORM_CACHE_ENTRY_T *u = &uniforms->uniforms[slot];
+	if (elements > u->elements) elements = u->elements;
+	uint32_t *shadow = uniforms->values + u->offset;
+	size_t bytes = (size_t)elements * u->components * sizeof(uint32_t);
+
+	if (u->valid && memcmp(shadow, data, bytes) == 0)
+	{
+		uniforms->cache->elided++;
+		return 0;
+	}
+	memcpy(shadow, data, bytes);
+	if (elements == u->elements) u->valid = 1;
+	uniforms->cache->issued++;
+	gl_cache_use_program(uniforms->cache, uniforms->program);
+	return 1;
+}
+
+void uniform_cache_1f(UNIFORM_CACHE_T *uniforms, GLint slot, GLfloat x)
+{
+	if (uniform_changed(uniforms, slot, &x, 1)) glUniform1f(uniforms->uniforms[slot].location, x);
+}
+
+void uniform_cache_2f(UNIFORM_CACHE_T *uniforms, GLint slot, GLfloat x, GLfloat y)
+{
+	GLfloat v[2] = { x, y };
+	if (uniform_changed(uniforms, slot, v, 1)) glUniform2fv(uniforms->uniforms[slot].location, 1, v);
+}
+
+// count is in vec4s, as for glUniform4fv
+void uniform_cache_4fv(UNIFORM_CACHE_T *uniforms, GLint slot, GLsizei count, const GLfloat *values)
+{
+	if (uniform_changed(uniforms, slot, values, count)) glUniform4fv(uniforms->uniforms[slot].location, count, values);
+}
+
+void uniform_cache_1i(UNIFORM_CACHE_T *uniforms, GLint slot, GLint x)
+{
+	if (uniform_changed(uniforms, slot, &x, 1)) glUniform1i(uniforms->uniforms[slot].location, x);
+}
+
+void uniform_cache_destroy(UNIFORM_CACHE_T *uniforms)
+{
+	free(uniforms->values);
+	memset(uniforms, 0, sizeof(*uniforms));
+}
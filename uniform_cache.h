@@ -0,0 +1,57 @@
+/***********************************************************
+ * File: uniform_cache.h
+ *
+ * Description:
+ *   Per-program uniform cache. Locations of a program's active uniforms are looked up
+ *   once after link and kept with a shadow copy of each value, so setting a uniform to
+ *   the value it already has never reaches the driver. On the Broadcom driver every
+ *   glUniform* call costs validation and a re-upload of the program's uniform stream,
+ *   which adds up quickly with many objects per frame.
+ *
+ *   Uniforms are addressed by slot, from uniform_cache_find(); -1 slots are ignored,
+ *   like -1 locations in GL. Setters make the program current through the GL state
+ *   cache only when a value actually changes, and count issued and elided calls there.
+ *
+ ***********************************************************/
+
+#ifndef UNIFORM_CACHE_H
+#define UNIFORM_CACHE_H
+
+#include <stdint.h>
+#include "GLES2/gl2.h"
+#include "gl_cache.h"
+
+#define UNIFORM_CACHE_MAX_UNIFORMS 16
+#define UNIFORM_CACHE_NAME_LENGTH 32
+
+typedef struct
+{
+	char name[UNIFORM_CACHE_NAME_LENGTH]; // Without the "[0]" of arrays
+	GLint location;
+	GLenum type; // As reported by glGetActiveUniform
+	GLint elements; // Array length, 1 for plain uniforms
+	uint32_t components; // 32-bit values per element
+	uint32_t offset; // Of the shadow value in the cache's values
+	int valid; // The shadow value is what the program holds
+} UNIFORM_CACHE_ENTRY_T;
+
+typedef struct
+{
+	GL_CACHE_T *cache;
+	GLuint program;
+	uint32_t count;
+	UNIFORM_CACHE_ENTRY_T uniforms[UNIFORM_CACHE_MAX_UNIFORMS];
+	uint32_t *values; // Shadow values, floats and ints stored bit for bit
+} UNIFORM_CACHE_T;
+
+int uniform_cache_init(UNIFORM_CACHE_T *uniforms, GL_CACHE_T *cache, GLuint program);
+GLint uniform_cache_find(const UNIFORM_CACHE_T *uniforms, const char *name);
+GLint uniform_cache_location(const UNIFORM_CACHE_T *uniforms, GLint slot);
+void uniform_cache_forget(UNIFORM_CACHE_T *uniforms, GLint slot);
+void uniform_cache_1f(UNIFORM_CACHE_T *uniforms, GLint slot, GLfloat x);
+void uniform_cache_2f(UNIFORM_CACHE_T *uniforms, GLint slot, GLfloat x, GLfloat y);
+void uniform_cache_4fv(UNIFORM_CACHE_T *uniforms, GLint slot, GLsizei count, const GLfloat *values);
+void uniform_cache_1i(UNIFORM_CACHE_T *uniforms, GLint slot, GLint x);
+void uniform_cache_destroy(UNIFORM_CACHE_T *uniforms);
+
+#endif
@@ -0,0 +1,104 @@
+/***********************************************************
+ * File: update.c
+ *
+ * Description:
+ *   Simulation thread publishing through a triple buffer. See update.h.
+ *
+ ***********************************************************/
+
+#include <string.h>
+#include <time.h>
+#include "frame_clock.h"
+#include "update.h"
+
+static void *update_thread(void *arg)
+{
+	UPDATE_THREAD_T *updater = (UPDATE_THREAD_T *)arg;
+	uint64_t last = frame_clock_now();
+	uint64_t next = last;
+
+	while (atomic_load_explicit(&updater->running, memory_order_acquire))
+	{
+		// Sleep until the next tick on an absolute schedule so the rate does not drift
+		next += (uint64_t)updater->period_us * 1000;
+		uint64_t now = frame_clock_now();
+		if (next > now)
+		{
+			struct timespec wait = { (time_t)((next - now) / 1000000000ull), (long)((next - now) % 1000000000ull) };
+			nanosleep(&wait, NULL);
+			now = frame_clock_now();
+		}
+		else
+		{
+			next = now; // Fell behind, do not try to catch up with a burst of updates
+		}
+
+		uint64_t delta_us = (now - last) / 1000;
+		last = now;
+		updater->update(triple_buffer_write_slot(&updater->buffer), delta_us > UINT32_MAX ? UINT32_MAX : (uint32_t)delta_us, updater->user);
+		triple_buffer_publish(&updater->buffer);
+	}
+	return NULL;
+}
+
+/***********************************************************
+ * Name: update_start
+ *
+ * Arguments:
+ *   UPDATE_THREAD_T *updater = updater to start
+ *   void *slots[3] = three snapshot areas, all holding the initial state
+ *   uint32_t hz = updates per second, clamped to UPDATE_MAX_HZ
+ *   UPDATE_FN update = simulation step, runs on the update thread
+ *   void *user = passed to update; the state behind it belongs to the update thread
+ *     until update_stop()
+ *
+ * Description:
+ *   Starts the update thread
+ *
+ * Returns:
+ *   int = 0 on success, -1 if the thread could not be created
+ *
+ ***********************************************************/
+int update_start(UPDATE_THREAD_T *updater, void *slots[3], uint32_t hz, UPDATE_FN update, void *user)
+{
+	memset(updater, 0, sizeof(*updater));
+	triple_buffer_init(&updater->buffer, slots[0], slots[1], slots[2]);
+	updater->update = update;
+	updater->user = user;
+	if (!hz) hz = UPDATE_DEFAULT_HZ;
+	if (hz > UPDATE_MAX_HZ) hz = UPDATE_MAX_HZ;
+	updater->period_us = 1000000 / hz;
+	atomic_store(&updater->running, 1);
+
+	if (pthread_create(&updater->thread, NULL, update_thread, updater) != 0)
+	{
+		atomic_store(&updater->running, 0);
+		return -1;
+	}
+	return 0;
+}
+
+/***********************************************************
+ * Name: update_latest
+ *
+ * Arguments:
+ *   UPDATE_THREAD_T *updater = running updater
+ *
+ * Description:
+ *   GL thread side: returns the newest published snapshot. It stays valid and unchanged
+ *   until the next call.
+ *
+ * Returns:
+ *   const void * = snapshot
+ *
+ ***********************************************************/
+const void *update_latest(UPDATE_THREAD_T *updater)
+{
+	return triple_buffer_read_slot(&updater->buffer);
+}
+
+void update_stop(UPDATE_THREAD_T *updater)
+{
+	if (!atomic_exchange(&updater->running, 0)) return;
+	pthread_join(updater->thread, NULL);
+}
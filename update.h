@@ -0,0 +1,40 @@
+/***********************************************************
+ * File: update.h
+ *
+ * Description:
+ *   Dedicated simulation thread. It advances scene state at a fixed rate using the
+ *   measured time between updates and publishes each result through a triple buffer,
+ *   so the GL thread only picks up the latest snapshot and submits draw calls.
+ *
+ ***********************************************************/
+
+#ifndef UPDATE_H
+#define UPDATE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "triple_buffer.h"
+
+#define UPDATE_DEFAULT_HZ 120
+#define UPDATE_MAX_HZ 1000000 // Period of 1 us, the finest the update thread can sleep for
+
+// Advances the simulation by delta_us and writes the complete new state into snapshot
+typedef void (*UPDATE_FN)(void *snapshot, uint32_t delta_us, void *user);
+
+typedef struct
+{
+	TRIPLE_BUFFER_T buffer;
+	UPDATE_FN update;
+	void *user;
+	uint32_t period_us; // Target time between updates
+
+	pthread_t thread;
+	atomic_int running;
+} UPDATE_THREAD_T;
+
+int update_start(UPDATE_THREAD_T *updater, void *slots[3], uint32_t hz, UPDATE_FN update, void *user);
+const void *update_latest(UPDATE_THREAD_T *updater);
+void update_stop(UPDATE_THREAD_T *updater);
+
+#endif
@@ -0,0 +1,150 @@
+/***********************************************************
+ * File: vertex_format.c
+ *
+ * Description:
+ *   Vertex format descriptors. See vertex_format.h. Makes no GL calls, so offline tools
+ *   link it without the GL libraries; binding to a program is in vertex_format_gl.c.
+ *
+ ***********************************************************/
+
+#include <string.h>
+#include "vertex_format.h"
+
+static uint32_t type_bytes(GLenum type)
+{
+	switch (type)
+	{
+		case GL_BYTE:
+		case GL_UNSIGNED_BYTE: return 1;
+		case GL_SHORT:
+		case GL_UNSIGNED_SHORT: return 2;
+		case GL_FLOAT: return 4;
+		default: return 0;
+	}
+}
+
+static uint32_t align_up(uint32_t n, uint32_t alignment)
+{
+	return (n + alignment - 1) / alignment * alignment;
+}
+
+void vertex_format_init(VERTEX_FORMAT_T *format, uint32_t alignment)
+{
+	memset(format, 0, sizeof(*format));
+	format->alignment = alignment ? alignment : 1;
+}
+
+/***********************************************************
+ * Name: vertex_format_add
+ *
+ * Arguments:
+ *   VERTEX_FORMAT_T *format = format to extend
+ *   const char *name = attribute name in the shader, must outlive the format
+ *   GLint size, GLenum type, GLboolean normalized = as for glVertexAttribPointer
+ *
+ * Description:
+ *   Appends an attribute after the previous one. Each attribute starts on a multiple
+ *   of its component size, or of the format's alignment if that is larger, and the
+ *   stride grows to a multiple of the alignment.
+ *
+ * Returns:
+ *   int = attribute index, or -1 if the format is full or the type is unsupported
+ *
+ ***********************************************************/
+int vertex_format_add(VERTEX_FORMAT_T *format, const char *name, GLint size, GLenum type, GLboolean normalized)
+{
+	uint32_t bytes = type_bytes(type);
+	if (format->attrib_count >= VERTEX_FORMAT_MAX_ATTRIBS || !bytes || size < 1 || size > 4) return -1;
+
+	uint32_t end = 0;
+	if (format->attrib_count)
+	{
+		const VERTEX_ATTRIB_T *last = &format->attribs[format->attrib_count - 1];
+		end = last->offset + last->size * type_bytes(last->type);
+	}
+
+	VERTEX_ATTRIB_T *a = &format->attribs[format->attrib_count];
+	a->name = name;
+	a->size = size;
+	a->type = type;
+	a->normalized = normalized;
+	a->offset = align_up(end, bytes > format->alignment ? bytes : format->alignment);
+	a->location = -1;
+	format->stride = align_up(a->offset + size * bytes, format->alignment);
+	return (int)format->attrib_count++;
+}
+
+static void encode_component(GLenum type, GLboolean normalized, GLfloat v, uint8_t *out)
+{
+	if (normalized && type != GL_FLOAT)
+	{
+		// Clamp to the representable range and round, matching the GLES2 conversion rules
+		GLfloat lo = (type == GL_BYTE || type == GL_SHORT) ? -1.0f : 0.0f;
+		v = v < lo ? lo : v > 1.0f ? 1.0f : v;
+		if (type == GL_BYTE) v *= 127.0f;
+		else if (type == GL_UNSIGNED_BYTE) v *= 255.0f;
+		else if (type == GL_SHORT) v *= 32767.0f;
+		else v *= 65535.0f;
+	}
+	v += v < 0.0f ? -0.5f : 0.5f;
+
+	switch (type)
+	{
+		case GL_BYTE: { int8_t x = (int8_t)v; memcpy(out, &x, 1); break; }
+		case GL_UNSIGNED_BYTE: { uint8_t x = (uint8_t)v; memcpy(out, &x, 1); break; }
+		case GL_SHORT: { int16_t x = (int16_t)v; memcpy(out, &x, 2); break; }
+		case GL_UNSIGNED_SHORT: { uint16_t x = (uint16_t)v; memcpy(out, &x, 2); break; }
+		default: break;
+	}
+}
+
+/***********************************************************
+ * Name: vertex_format_encode
+ *
+ * Arguments:
+ *   const VERTEX_FORMAT_T *format = target layout
+ *   const GLfloat *const *sources = per attribute, count * size tightly packed floats
+ *   uint32_t count = number of vertices
+ *   void *out = receives count * stride bytes, padding is zeroed
+ *
+ * Description:
+ *   Converts float vertex data into the packed interleaved layout. Meant for load-time
+ *   conversion; per-frame data should go through the SIMD kernels.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void vertex_format_encode(const VERTEX_FORMAT_T *format, const GLfloat *const *sources, uint32_t count, void *out)
+{
+	uint8_t *vertex = out;
+	memset(out, 0, (size_t)count * format->stride);
+
+	for (uint32_t v = 0; v < count; v++, vertex += format->stride)
+	{
+		for (uint32_t i = 0; i < format->attrib_count; i++)
+		{
+			const VERTEX_ATTRIB_T *a = &format->attribs[i];
+			const GLfloat *src = sources[i] + (size_t)v * a->size;
+			uint32_t bytes = type_bytes(a->type);
+
+			for (GLint c = 0; c < a->size; c++)
+			{
+				if (a->type == GL_FLOAT) memcpy(vertex + a->offset + c * 4, &src[c], 4);
+				else encode_component(a->type, a->normalized, src[c], vertex + a->offset + c * bytes);
+			}
+		}
+	}
+}
+
+// Same layout for recorded draws, see cmdbuf.h
+void vertex_format_pipeline(const VERTEX_FORMAT_T *format, GLuint program, CMD_PIPELINE_T *pipeline)
+{
+	pipeline->program = program;
+	pipeline->attrib_count = format->attrib_count < CMD_MAX_PIPELINE_ATTRIBS ? format->attrib_count : CMD_MAX_PIPELINE_ATTRIBS;
+	for (uint32_t i = 0; i < pipeline->attrib_count; i++)
+	{
+		const VERTEX_ATTRIB_T *a = &format->attribs[i];
+		pipeline->attribs[i] = (CMD_ATTRIB_T){ a->location, a->size, a->type, a->normalized, format->stride, a->offset };
+	}
+}
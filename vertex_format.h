@@ -0,0 +1,52 @@
+/***********************************************************
+ * File: vertex_format.h
+ *
+ * Description:
+ *   Vertex format descriptors. A VERTEX_FORMAT_T lists the attributes of one
+ *   interleaved vertex (name, component count, GL type, normalization) and works out
+ *   their offsets and the stride for a chosen alignment. The same descriptor encodes
+ *   float source data into the packed layout and drives glVertexAttribPointer through
+ *   the state cache, so a mesh can switch between e.g. 12-byte float and 8-byte
+ *   normalized short positions without touching its draw code.
+ *
+ *   VideoCore IV fetches attributes fastest when each starts on a 4-byte boundary, so
+ *   4 is the usual alignment; 2 allows tightly packed 6-byte short3 vertices.
+ *
+ ***********************************************************/
+
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <stdint.h>
+#include "GLES2/gl2.h"
+#include "gl_cache.h"
+#include "cmdbuf.h"
+
+#define VERTEX_FORMAT_MAX_ATTRIBS 4
+
+typedef struct
+{
+	const char *name; // Attribute name in the shader
+	GLint size; // Components, 1 to 4
+	GLenum type; // GL_FLOAT, GL_SHORT, GL_UNSIGNED_SHORT, GL_BYTE or GL_UNSIGNED_BYTE
+	GLboolean normalized; // Integer types map to [0, 1] or [-1, 1]
+	uint32_t offset; // Byte offset within the vertex
+	GLint location; // Resolved by vertex_format_bind(), -1 if the program lacks it
+} VERTEX_ATTRIB_T;
+
+typedef struct
+{
+	VERTEX_ATTRIB_T attribs[VERTEX_FORMAT_MAX_ATTRIBS];
+	uint32_t attrib_count;
+	uint32_t alignment; // Stride is rounded up to a multiple of this
+	uint32_t stride; // Bytes per vertex
+} VERTEX_FORMAT_T;
+
+void vertex_format_init(VERTEX_FORMAT_T *format, uint32_t alignment);
+int vertex_format_add(VERTEX_FORMAT_T *format, const char *name, GLint size, GLenum type, GLboolean normalized);
+void vertex_format_bind(VERTEX_FORMAT_T *format, GLuint program);
+void vertex_format_encode(const VERTEX_FORMAT_T *format, const GLfloat *const *sources, uint32_t count, void *out);
+void vertex_format_apply(const VERTEX_FORMAT_T *format, GL_CACHE_T *cache, uint32_t base_offset);
+void vertex_format_pipeline(const VERTEX_FORMAT_T *format, GLuint program, CMD_PIPELINE_T *pipeline);
+
+#endif
@@ -0,0 +1,44 @@
+/***********************************************************
+ * File: vertex_format_gl.c
+ *
+ * Description:
+ *   Binding vertex format descriptors to programs and attribute arrays. See
+ *   vertex_format.h.
+ *
+ ***********************************************************/
+
+#include "vertex_format.h"
+
+void vertex_format_bind(VERTEX_FORMAT_T *format, GLuint program)
+{
+	for (uint32_t i = 0; i < format->attrib_count; i++)
+		format->attribs[i].location = glGetAttribLocation(program, format->attribs[i].name);
+}
+
+/***********************************************************
+ * Name: vertex_format_apply
+ *
+ * Arguments:
+ *   const VERTEX_FORMAT_T *format = layout of the bound GL_ARRAY_BUFFER, bound to a program
+ *   GL_CACHE_T *cache = state cache the pointers are set through
+ *   uint32_t base_offset = byte offset of the first vertex in the buffer
+ *
+ * Description:
+ *   Points every attribute the program uses at the current GL_ARRAY_BUFFER and enables
+ *   exactly those arrays
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void vertex_format_apply(const VERTEX_FORMAT_T *format, GL_CACHE_T *cache, uint32_t base_offset)
+{
+	uint32_t enabled = 0;
+	for (uint32_t i = 0; i < format->attrib_count; i++)
+	{
+		const VERTEX_ATTRIB_T *a = &format->attribs[i];
+		gl_cache_vertex_attrib_pointer(cache, a->location, a->size, a->type, a->normalized, format->stride, (const void *)(uintptr_t)(base_offset + a->offset));
+		enabled |= GL_CACHE_ATTRIB_BIT(a->location);
+	}
+	gl_cache_enable_attribs(cache, enabled);
+}
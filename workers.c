@@ -0,0 +1,124 @@
+/***********************************************************
+ * File: workers.c
+ *
+ * Description:
+ *   Fork/join worker pool. See workers.h.
+ *
+ ***********************************************************/
+
+#include <string.h>
+#include "workers.h"
+
+static void *worker_thread(void *arg)
+{
+	WORKER_POOL_T *pool = (WORKER_POOL_T *)arg;
+	uint32_t seen = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	uint32_t index = ++pool->started;
+	for (;;)
+	{
+		while (!pool->quit && pool->generation == seen) pthread_cond_wait(&pool->start, &pool->lock);
+		if (pool->quit) break;
+		seen = pool->generation;
+
+		WORKER_FN fn = pool->fn;
+		void *user = pool->user;
+		pthread_mutex_unlock(&pool->lock);
+		fn(user, index, pool->count);
+		pthread_mutex_lock(&pool->lock);
+
+		if (--pool->remaining == 0) pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+/***********************************************************
+ * Name: workers_init
+ *
+ * Arguments:
+ *   WORKER_POOL_T *pool = pool to initialise
+ *   uint32_t count = total workers including the caller, 1 runs everything inline
+ *
+ * Description:
+ *   Starts count - 1 helper threads that sleep until workers_run() posts a job
+ *
+ * Returns:
+ *   int = 0 on success, -1 if a thread could not be created
+ *
+ ***********************************************************/
+int workers_init(WORKER_POOL_T *pool, uint32_t count)
+{
+	memset(pool, 0, sizeof(*pool));
+	if (count < 1) count = 1;
+	if (count > WORKERS_MAX) count = WORKERS_MAX;
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	pool->count = 1;
+	for (uint32_t i = 1; i < count; i++)
+	{
+		if (pthread_create(&pool->threads[i], NULL, worker_thread, pool) != 0)
+		{
+			workers_destroy(pool);
+			return -1;
+		}
+		pool->count++;
+	}
+	return 0;
+}
+
+/***********************************************************
+ * Name: workers_run
+ *
+ * Arguments:
+ *   WORKER_POOL_T *pool = pool to run on
+ *   WORKER_FN fn = job, called as fn(user, worker, worker_count) for every worker
+ *   void *user = passed to fn
+ *
+ * Description:
+ *   Runs one job across the pool and waits for it to complete. The caller runs
+ *   worker 0 itself rather than idling.
+ *
+ * Returns:
+ *   void
+ *
+ ***********************************************************/
+void workers_run(WORKER_POOL_T *pool, WORKER_FN fn, void *user)
+{
+	if (pool->count > 1)
+	{
+		pthread_mutex_lock(&pool->lock);
+		pool->fn = fn;
+		pool->user = user;
+		pool->remaining = pool->count - 1;
+		pool->generation++;
+		pthread_cond_broadcast(&pool->start);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	fn(user, 0, pool->count);
+
+	if (pool->count > 1)
+	{
+		pthread_mutex_lock(&pool->lock);
+		while (pool->remaining) pthread_cond_wait(&pool->done, &pool->lock);
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+void workers_destroy(WORKER_POOL_T *pool)
+{
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	for (uint32_t i = 1; i < pool->count; i++) pthread_join(pool->threads[i], NULL);
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+	pool->count = 0;
+}
@@ -0,0 +1,42 @@
+/***********************************************************
+ * File: workers.h
+ *
+ * Description:
+ *   Small fork/join worker pool for spreading CPU-side frame work over the Pi's cores.
+ *   workers_run() calls the job once per worker, with the calling thread taking part
+ *   as worker 0, and returns when every worker has finished. Jobs must not touch GL.
+ *
+ ***********************************************************/
+
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define WORKERS_MAX 8
+
+typedef void (*WORKER_FN)(void *user, uint32_t worker, uint32_t worker_count);
+
+typedef struct
+{
+	pthread_t threads[WORKERS_MAX];
+	uint32_t count; // Workers including the calling thread
+
+	pthread_mutex_t lock;
+	pthread_cond_t start; // Signalled when a new job is posted
+	pthread_cond_t done; // Signalled when the last helper finishes
+	uint32_t generation; // Incremented per job so helpers run each job exactly once
+	uint32_t remaining; // Helpers still running the current job
+	uint32_t started; // Helpers that have taken their worker index
+	int quit;
+
+	WORKER_FN fn;
+	void *user;
+} WORKER_POOL_T;
+
+int workers_init(WORKER_POOL_T *pool, uint32_t count);
+void workers_run(WORKER_POOL_T *pool, WORKER_FN fn, void *user);
+void workers_destroy(WORKER_POOL_T *pool);
+
+#endif